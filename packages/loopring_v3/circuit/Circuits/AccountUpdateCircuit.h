@@ -219,6 +219,7 @@ class AccountUpdateCircuit : public BaseTransactionCircuit
 
     void generate_r1cs_witness(const AccountUpdateTx &update)
     {
+        ProfileWitness profile(annotation_prefix);
         LOG(LogDebug, "in AccountUpdateCircuit", "generate_r1cs_witness");
         // Inputs
         owner.generate_r1cs_witness(pb, update.owner);
@@ -270,6 +271,7 @@ class AccountUpdateCircuit : public BaseTransactionCircuit
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         LOG(LogDebug, "in AccountUpdateCircuit", "generate_r1cs_constraints");
         // Inputs
         owner.generate_r1cs_constraints();
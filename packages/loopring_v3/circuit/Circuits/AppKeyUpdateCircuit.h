@@ -167,6 +167,7 @@ class AppKeyUpdateCircuit : public BaseTransactionCircuit
 
     void generate_r1cs_witness(const AppKeyUpdate &update)
     {
+        ProfileWitness profile(annotation_prefix);
         LOG(LogDebug, "in AppKeyUpdateCircuit", "generate_r1cs_witness");
         typeTx.generate_r1cs_witness();
         typeTxPad.generate_r1cs_witness();
@@ -208,6 +209,7 @@ class AppKeyUpdateCircuit : public BaseTransactionCircuit
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         LOG(LogDebug, "in AppKeyUpdateCircuit", "generate_r1cs_constraints");
         typeTx.generate_r1cs_constraints();
         typeTxPad.generate_r1cs_constraints();
@@ -173,11 +173,13 @@ class BatchSpotTradeCircuit : public BaseTransactionCircuit
 
         for (size_t i = 0; i < 3; i++) 
         {
-            tokensDual.emplace_back(pb, NUM_BITS_TOKEN, ".tokensDual" + std::to_string(i));
+            tokensDual.emplace_back(pb, NUM_BITS_TOKEN, FMT("", ".tokensDual%zu", i));
             tokens.emplace_back(tokensDual.back().packed);
         }
         validTokens.reset(new ValidTokensGadget(pb, constants, tokens, bindTokenID.packed, isBatchSpotTradeTx.result(), FMT(prefix, ".validTokens")));
 
+        // The nested gadgets refer to each other, the users can't be moved
+        users.reserve(BATCH_SPOT_TRADE_MAX_USER);
         for (unsigned int i = 0; i < BATCH_SPOT_TRADE_MAX_USER; i++) 
         {
             LOG(LogDebug, "in BatchSpotTradeCircuit i", std::to_string(i));
@@ -187,50 +189,50 @@ class BatchSpotTradeCircuit : public BaseTransactionCircuit
                 for (unsigned int j = 0; j < state.accountA.storageArray.size(); j++) {
                     storageGadgets.emplace_back(state.accountA.storageArray[j]);
                 }
-                users.emplace_back(pb, constants, state.timestamp, blockExchange, maxTradingFeeBips, tokens, storageGadgets, state.accountA, state.type, isBatchSpotTradeTx.result(), constants._0, ORDER_SIZE_USER_A, prefix + std::string("user_") + std::to_string(i));
+                users.emplace_back(pb, constants, state.timestamp, blockExchange, maxTradingFeeBips, tokens, storageGadgets, state.accountA, state.type, isBatchSpotTradeTx.result(), constants._0, ORDER_SIZE_USER_A, FMT(prefix, "user_%u", i));
             } else if (i == 1) {
                 storageGadgets.emplace_back(state.accountB.storage);
                 for (unsigned int j = 0; j < state.accountB.storageArray.size(); j++) {
                     storageGadgets.emplace_back(state.accountB.storageArray[j]);
                 }
-                users.emplace_back(pb, constants, state.timestamp, blockExchange, maxTradingFeeBips, tokens, storageGadgets, state.accountB, state.type, isBatchSpotTradeTx.result(), constants._1, ORDER_SIZE_USER_B, prefix + std::string("user_") + std::to_string(i));
+                users.emplace_back(pb, constants, state.timestamp, blockExchange, maxTradingFeeBips, tokens, storageGadgets, state.accountB, state.type, isBatchSpotTradeTx.result(), constants._1, ORDER_SIZE_USER_B, FMT(prefix, "user_%u", i));
             } else if (i == 2) {
                 for (unsigned int j = 0; j < state.accountC.storageArray.size(); j++) {
                     storageGadgets.emplace_back(state.accountC.storageArray[j]);
                 }
-                users.emplace_back(pb, constants, state.timestamp, blockExchange, maxTradingFeeBips, tokens, storageGadgets, state.accountC, state.type, isBatchSpotTradeTx.result(), constants._1, ORDER_SIZE_USER_C, prefix + std::string("user_") + std::to_string(i));
+                users.emplace_back(pb, constants, state.timestamp, blockExchange, maxTradingFeeBips, tokens, storageGadgets, state.accountC, state.type, isBatchSpotTradeTx.result(), constants._1, ORDER_SIZE_USER_C, FMT(prefix, "user_%u", i));
             } else if (i == 3) {
                 for (unsigned int j = 0; j < state.accountD.storageArray.size(); j++) {
                     storageGadgets.emplace_back(state.accountD.storageArray[j]);
                 }
-                users.emplace_back(pb, constants, state.timestamp, blockExchange, maxTradingFeeBips, tokens, storageGadgets, state.accountD, state.type, isBatchSpotTradeTx.result(), constants._1, ORDER_SIZE_USER_D, prefix + std::string("user_") + std::to_string(i));
+                users.emplace_back(pb, constants, state.timestamp, blockExchange, maxTradingFeeBips, tokens, storageGadgets, state.accountD, state.type, isBatchSpotTradeTx.result(), constants._1, ORDER_SIZE_USER_D, FMT(prefix, "user_%u", i));
             } else if (i == 4) {
                 for (unsigned int j = 0; j < state.accountE.storageArray.size(); j++) {
                     storageGadgets.emplace_back(state.accountE.storageArray[j]);
                 }
-                users.emplace_back(pb, constants, state.timestamp, blockExchange, maxTradingFeeBips, tokens, storageGadgets, state.accountE, state.type, isBatchSpotTradeTx.result(), constants._1, ORDER_SIZE_USER_E, prefix + std::string("user_") + std::to_string(i));
+                users.emplace_back(pb, constants, state.timestamp, blockExchange, maxTradingFeeBips, tokens, storageGadgets, state.accountE, state.type, isBatchSpotTradeTx.result(), constants._1, ORDER_SIZE_USER_E, FMT(prefix, "user_%u", i));
             } else if (i == 5) {
                 for (unsigned int j = 0; j < state.accountF.storageArray.size(); j++) {
                     storageGadgets.emplace_back(state.accountF.storageArray[j]);
                 }
-                users.emplace_back(pb, constants, state.timestamp, blockExchange, maxTradingFeeBips, tokens, storageGadgets, state.accountF, state.type, isBatchSpotTradeTx.result(), constants._1, ORDER_SIZE_USER_F, prefix + std::string("user_") + std::to_string(i));
+                users.emplace_back(pb, constants, state.timestamp, blockExchange, maxTradingFeeBips, tokens, storageGadgets, state.accountF, state.type, isBatchSpotTradeTx.result(), constants._1, ORDER_SIZE_USER_F, FMT(prefix, "user_%u", i));
             }
 
-            forwardOneAmounts.emplace_back(pb, (i == 0) ? constants._0 : forwardOneAmounts.back().result(), users.back().getTokenOneForwardAmount(), NUM_BITS_AMOUNT, std::string(".forwardOneAmounts_") + std::to_string(i));
-            forwardTwoAmounts.emplace_back(pb, (i == 0) ? constants._0 : forwardTwoAmounts.back().result(), users.back().getTokenTwoForwardAmount(), NUM_BITS_AMOUNT, std::string(".forwardTwoAmounts_") + std::to_string(i));
-            forwardThreeAmounts.emplace_back(pb, (i == 0) ? constants._0 : forwardThreeAmounts.back().result(), users.back().getTokenThreeForwardAmount(), NUM_BITS_AMOUNT, std::string(".forwardThreeAmounts_") + std::to_string(i));
+            forwardOneAmounts.emplace_back(pb, (i == 0) ? constants._0 : forwardOneAmounts.back().result(), users.back().getTokenOneForwardAmount(), NUM_BITS_AMOUNT, FMT("", ".forwardOneAmounts_%u", i));
+            forwardTwoAmounts.emplace_back(pb, (i == 0) ? constants._0 : forwardTwoAmounts.back().result(), users.back().getTokenTwoForwardAmount(), NUM_BITS_AMOUNT, FMT("", ".forwardTwoAmounts_%u", i));
+            forwardThreeAmounts.emplace_back(pb, (i == 0) ? constants._0 : forwardThreeAmounts.back().result(), users.back().getTokenThreeForwardAmount(), NUM_BITS_AMOUNT, FMT("", ".forwardThreeAmounts_%u", i));
             
-            reverseOneAmounts.emplace_back(pb, (i == 0) ? constants._0 : reverseOneAmounts.back().result(), users.back().getTokenOneReverseAmount(), NUM_BITS_AMOUNT, std::string(".reverseOneAmounts_") + std::to_string(i));
-            reverseTwoAmounts.emplace_back(pb, (i == 0) ? constants._0 : reverseTwoAmounts.back().result(), users.back().getTokenTwoReverseAmount(), NUM_BITS_AMOUNT, std::string(".reverseTwoAmounts_") + std::to_string(i));
-            reverseThreeAmounts.emplace_back(pb, (i == 0) ? constants._0 : reverseThreeAmounts.back().result(), users.back().getTokenThreeReverseAmount(), NUM_BITS_AMOUNT, std::string(".reverseThreeAmounts_") + std::to_string(i));
+            reverseOneAmounts.emplace_back(pb, (i == 0) ? constants._0 : reverseOneAmounts.back().result(), users.back().getTokenOneReverseAmount(), NUM_BITS_AMOUNT, FMT("", ".reverseOneAmounts_%u", i));
+            reverseTwoAmounts.emplace_back(pb, (i == 0) ? constants._0 : reverseTwoAmounts.back().result(), users.back().getTokenTwoReverseAmount(), NUM_BITS_AMOUNT, FMT("", ".reverseTwoAmounts_%u", i));
+            reverseThreeAmounts.emplace_back(pb, (i == 0) ? constants._0 : reverseThreeAmounts.back().result(), users.back().getTokenThreeReverseAmount(), NUM_BITS_AMOUNT, FMT("", ".reverseThreeAmounts_%u", i));
 
-            tokenOneFloatForward.emplace_back(pb, (i == 0) ? constants._0 : tokenOneFloatForward.back().result(), users.back().getTokenOneFloatIncrease(), NUM_BITS_AMOUNT, std::string(".tokenOneFloatForward_") + std::to_string(i));
-            tokenTwoFloatForward.emplace_back(pb, (i == 0) ? constants._0 : tokenTwoFloatForward.back().result(), users.back().getTokenTwoFloatIncrease(), NUM_BITS_AMOUNT, std::string(".tokenTwoFloatForward_") + std::to_string(i));
-            tokenThreeFloatForward.emplace_back(pb, (i == 0) ? constants._0 : tokenThreeFloatForward.back().result(), users.back().getTokenThreeFloatIncrease(), NUM_BITS_AMOUNT, std::string(".tokenThreeFloatForward_") + std::to_string(i));
+            tokenOneFloatForward.emplace_back(pb, (i == 0) ? constants._0 : tokenOneFloatForward.back().result(), users.back().getTokenOneFloatIncrease(), NUM_BITS_AMOUNT, FMT("", ".tokenOneFloatForward_%u", i));
+            tokenTwoFloatForward.emplace_back(pb, (i == 0) ? constants._0 : tokenTwoFloatForward.back().result(), users.back().getTokenTwoFloatIncrease(), NUM_BITS_AMOUNT, FMT("", ".tokenTwoFloatForward_%u", i));
+            tokenThreeFloatForward.emplace_back(pb, (i == 0) ? constants._0 : tokenThreeFloatForward.back().result(), users.back().getTokenThreeFloatIncrease(), NUM_BITS_AMOUNT, FMT("", ".tokenThreeFloatForward_%u", i));
 
-            tokenOneFloatReverse.emplace_back(pb, (i == 0) ? constants._0 : tokenOneFloatReverse.back().result(), users.back().getTokenOneFloatReduce(), NUM_BITS_AMOUNT, std::string(".tokenOneFloatReduce_") + std::to_string(i));
-            tokenTwoFloatReverse.emplace_back(pb, (i == 0) ? constants._0 : tokenTwoFloatReverse.back().result(), users.back().getTokenTwoFloatReduce(), NUM_BITS_AMOUNT, std::string(".tokenTwoFloatReduce_") + std::to_string(i));
-            tokenThreeFloatReverse.emplace_back(pb, (i == 0) ? constants._0 : tokenThreeFloatReverse.back().result(), users.back().getTokenThreeFloatReduce(), NUM_BITS_AMOUNT, std::string(".tokenThreeFloatReduce_") + std::to_string(i));
+            tokenOneFloatReverse.emplace_back(pb, (i == 0) ? constants._0 : tokenOneFloatReverse.back().result(), users.back().getTokenOneFloatReduce(), NUM_BITS_AMOUNT, FMT("", ".tokenOneFloatReduce_%u", i));
+            tokenTwoFloatReverse.emplace_back(pb, (i == 0) ? constants._0 : tokenTwoFloatReverse.back().result(), users.back().getTokenTwoFloatReduce(), NUM_BITS_AMOUNT, FMT("", ".tokenTwoFloatReduce_%u", i));
+            tokenThreeFloatReverse.emplace_back(pb, (i == 0) ? constants._0 : tokenThreeFloatReverse.back().result(), users.back().getTokenThreeFloatReduce(), NUM_BITS_AMOUNT, FMT("", ".tokenThreeFloatReduce_%u", i));
         }
 
         requireUserAOrderNotNoop.reset(new IfThenRequireEqualGadget(pb, isBatchSpotTradeTx.result(), users[0].orders[0].isNoop.packed, constants._0, FMT(prefix, ".requireUserAOrderNotNoop")));
@@ -601,9 +603,9 @@ class BatchSpotTradeCircuit : public BaseTransactionCircuit
             FMT(prefix, ".balanceA_O_Increase")
         ));
         LOG(LogDebug, "in BatchUserGadget before tokenOneMatch", "");
-        tokenOneMatch.reset(new RequireEqualGadget(pb, forwardOneAmounts.back().result(), reverseOneAmounts.back().result(), prefix + std::string(".tokenOneMatch")));
-        tokenTwoMatch.reset(new RequireEqualGadget(pb, forwardTwoAmounts.back().result(), reverseTwoAmounts.back().result(), prefix + std::string(".tokenTwoMatch")));
-        tokenThreeMatch.reset(new RequireEqualGadget(pb, forwardThreeAmounts.back().result(), reverseThreeAmounts.back().result(), prefix + std::string(".tokenThreeMatch")));
+        tokenOneMatch.reset(new RequireEqualGadget(pb, forwardOneAmounts.back().result(), reverseOneAmounts.back().result(), FMT(prefix, ".tokenOneMatch")));
+        tokenTwoMatch.reset(new RequireEqualGadget(pb, forwardTwoAmounts.back().result(), reverseTwoAmounts.back().result(), FMT(prefix, ".tokenTwoMatch")));
+        tokenThreeMatch.reset(new RequireEqualGadget(pb, forwardThreeAmounts.back().result(), reverseThreeAmounts.back().result(), FMT(prefix, ".tokenThreeMatch")));
 
         LOG(LogDebug, "in BatchUserGadget before setUserAData", "");
         setUserAData(users[0]);
@@ -619,6 +621,7 @@ class BatchSpotTradeCircuit : public BaseTransactionCircuit
     }
     void generate_r1cs_witness(const BatchSpotTrade &batchSpotTrade)
     {
+        ProfileWitness profile(annotation_prefix);
         LOG(LogDebug, "in BatchSpotTradeCircuit", "generate_r1cs_witness");
         typeTx.generate_r1cs_witness();
         bindTokenID.generate_r1cs_witness(pb, batchSpotTrade.bindTokenID);
@@ -763,6 +766,7 @@ class BatchSpotTradeCircuit : public BaseTransactionCircuit
     }
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         LOG(LogDebug, "in BatchSpotTradeCircuit", "generate_r1cs_constraints");
         typeTx.generate_r1cs_constraints();
         bindTokenID.generate_r1cs_constraints(true);
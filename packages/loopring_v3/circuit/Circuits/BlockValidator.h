@@ -0,0 +1,908 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+// Modified by DeGate DAO, 2022
+#ifndef _BLOCKVALIDATOR_H_
+#define _BLOCKVALIDATOR_H_
+
+#include "../Utils/Constants.h"
+#include "../Utils/Data.h"
+#include "../Utils/Utils.h"
+#include "../Gadgets/MerkleTree.h"
+
+#include "ethsnarks.hpp"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ethsnarks;
+
+namespace Loopring
+{
+
+// Evaluates a hash gadget on a private protoboard. Only the witness is generated, so no constraints are
+// created, and the result is always exactly what the circuit computes.
+template <typename HashT, unsigned int NumInputs> class NativeHash
+{
+  public:
+    NativeHash() : inputs(make_var_array(pb, NumInputs, "inputs")), hasher(pb, inputs, "hasher")
+    {
+    }
+
+    FieldT operator()(const std::vector<FieldT> &values)
+    {
+        assert(values.size() == NumInputs);
+        inputs.fill_with_field_elements(pb, values);
+        hasher.generate_r1cs_witness();
+        return pb.val(hasher.result());
+    }
+
+  private:
+    ProtoboardT pb;
+    VariableArrayT inputs;
+    HashT hasher;
+};
+
+// Native versions of the leaf hashes and the quad Merkle tree path of the Update*Gadgets
+class NativeMerkleHashers
+{
+  public:
+    FieldT accountLeaf(const AccountLeaf &leaf)
+    {
+        return hashAccountLeaf(
+          {leaf.owner,
+           leaf.publicKey.x,
+           leaf.publicKey.y,
+           leaf.appKeyPublicKey.x,
+           leaf.appKeyPublicKey.y,
+           leaf.nonce,
+           leaf.disableAppKeySpotTrade,
+           leaf.disableAppKeyWithdraw,
+           leaf.disableAppKeyTransferToOther,
+           leaf.balancesRoot,
+           leaf.storageRoot});
+    }
+
+    FieldT assetAccountLeaf(const AccountLeaf &leaf)
+    {
+        return hashAssetAccountLeaf({leaf.owner, leaf.publicKey.x, leaf.publicKey.y, leaf.nonce, leaf.balancesRoot});
+    }
+
+    FieldT balanceLeaf(const BalanceLeaf &leaf)
+    {
+        return hashBalanceLeaf({leaf.balance});
+    }
+
+    FieldT storageLeaf(const StorageLeaf &leaf)
+    {
+        return hashStorageLeaf(
+          {leaf.tokenSID, leaf.tokenBID, leaf.data, leaf.storageID, leaf.gasFee, leaf.cancelled, leaf.forward});
+    }
+
+    // Same as merkle_path_compute_4: two address bits per level select the position of the node
+    FieldT root(unsigned int depth, const FieldT &address, const FieldT &leaf, const std::vector<FieldT> &proof)
+    {
+        const auto addressBits = address.as_bigint();
+        FieldT node = leaf;
+        for (unsigned int i = 0; i < depth; i++)
+        {
+            unsigned int position = (addressBits.test_bit(i * 2) ? 1 : 0) + (addressBits.test_bit(i * 2 + 1) ? 2 : 0);
+            std::vector<FieldT> children;
+            unsigned int sibling = 0;
+            for (unsigned int c = 0; c < 4; c++)
+            {
+                children.push_back((c == position) ? node : proof[i * 3 + sibling++]);
+            }
+            node = hashMerkleTree(children);
+        }
+        return node;
+    }
+
+  private:
+    NativeHash<HashAccountLeaf, 11> hashAccountLeaf;
+    NativeHash<HashAssetAccountLeaf, 5> hashAssetAccountLeaf;
+    NativeHash<HashBalanceLeaf, 1> hashBalanceLeaf;
+    NativeHash<HashStorageLeaf, 7> hashStorageLeaf;
+    NativeHash<HashMerkleTree, 4> hashMerkleTree;
+};
+
+// Checks a block natively before any witness is generated so invalid blocks are rejected with a precise reason
+// instead of failing in validateCircuit after a full witness pass:
+// - the state roots are chained correctly over all updates (accounts, balances and storage)
+// - the Merkle proofs of all updates that modify the state match the roots before and after
+// - nonces only stay the same or increase by one, the operator nonce is increased by one
+// - when the operator fees are deferred (the block has operator fee updates) the operator balances are only
+//   updated at the end of the block, the operator updates of the transactions are ignored
+// - the number of conditional transactions never decreases
+// - no balance is negative, and the balance changes of deposits, transfers and withdrawals match their amount
+//   and fee: the tokens taken from one balance are added to the other (see checkTransactionBalances)
+// - account updates, app key updates and order cancellations pay their fee and increase the nonce of the
+//   account, an order cancellation marks the storage slot of the order as cancelled
+// Not checked natively, only by the circuit: the fills, trading fees and order limits of spot trades and
+// batch spot trades, the signatures and hashes of all transactions, the data availability and the validity
+// and expiry limits (validUntil, maxFee, storage IDs) of the transactions.
+class BlockValidator
+{
+  public:
+    // Returns an empty string if no problem was found, the reason the block is invalid otherwise
+    std::string validate(const Block &block)
+    {
+        const bool deferOperatorFees = !block.operatorFeeUpdates.empty();
+        std::string error = validateChain(block);
+        if (!error.empty())
+        {
+            return error;
+        }
+
+        // The Merkle proofs of all transactions are independent, only report the first invalid transaction
+        const int numTransactions = block.transactions.size();
+        int firstInvalid = numTransactions;
+#ifdef MULTICORE
+#pragma omp parallel
+#endif
+        {
+            NativeMerkleHashers hashers;
+#ifdef MULTICORE
+#pragma omp for schedule(dynamic)
+#endif
+            for (int i = 0; i < numTransactions; i++)
+            {
+                std::string txError = validateProofs(hashers, block.transactions[i].witness, deferOperatorFees);
+                if (!txError.empty())
+                {
+#ifdef MULTICORE
+#pragma omp critical(block_validator)
+#endif
+                    {
+                        if (i < firstInvalid)
+                        {
+                            firstInvalid = i;
+                            error = txError;
+                        }
+                    }
+                }
+            }
+        }
+        if (firstInvalid < numTransactions)
+        {
+            return "tx " + std::to_string(firstInvalid) + ": " + error;
+        }
+
+        NativeMerkleHashers hashers;
+        error = validateAccountProof(hashers, "accountUpdate_P", block.accountUpdate_P);
+        for (unsigned int i = 0; i < block.operatorFeeUpdates.size() && error.empty(); i++)
+        {
+            error = validateBalanceProof(
+              hashers, "operatorFeeUpdates[" + std::to_string(i) + "]", block.operatorFeeUpdates[i]);
+        }
+        if (error.empty())
+        {
+            error = validateAccountProof(hashers, "accountUpdate_O", block.accountUpdate_O);
+        }
+        return error;
+    }
+
+  private:
+    static std::string toString(const FieldT &value)
+    {
+        std::stringstream ss;
+        ss << value;
+        return ss.str();
+    }
+
+    static std::string mismatch(const std::string &what, const FieldT &expected, const FieldT &actual)
+    {
+        return what + " is " + toString(actual) + ", expected " + toString(expected);
+    }
+
+    static bool isValidNonceUpdate(const AccountLeaf &before, const AccountLeaf &after)
+    {
+        return after.nonce == before.nonce || after.nonce == before.nonce + FieldT::one();
+    }
+
+    // Keeps track of the account and asset roots while walking over all account updates
+    struct RootChain
+    {
+        FieldT root;
+        FieldT assetRoot;
+    };
+
+    static std::string chainAccount(RootChain &chain, const std::string &name, const AccountUpdate &update)
+    {
+        if (update.rootBefore != chain.root)
+        {
+            return mismatch(name + ".rootBefore", chain.root, update.rootBefore);
+        }
+        if (update.assetRootBefore != chain.assetRoot)
+        {
+            return mismatch(name + ".assetRootBefore", chain.assetRoot, update.assetRootBefore);
+        }
+        if (!isValidNonceUpdate(update.before, update.after))
+        {
+            return name + ": invalid nonce update from " + toString(update.before.nonce) + " to " +
+                   toString(update.after.nonce);
+        }
+        chain.root = update.rootAfter;
+        chain.assetRoot = update.assetRootAfter;
+        return "";
+    }
+
+    static std::string chainBalances(
+      const std::string &account,
+      const AccountUpdate &accountUpdate,
+      const std::vector<std::pair<std::string, const BalanceUpdate *>> &updates)
+    {
+        FieldT root = accountUpdate.before.balancesRoot;
+        for (const auto &update : updates)
+        {
+            if (update.second->rootBefore != root)
+            {
+                return mismatch(update.first + ".rootBefore", root, update.second->rootBefore);
+            }
+            root = update.second->rootAfter;
+        }
+        if (accountUpdate.after.balancesRoot != root)
+        {
+            return mismatch(account + ".after.balancesRoot", root, accountUpdate.after.balancesRoot);
+        }
+        return "";
+    }
+
+    static std::string chainStorage(
+      const std::string &account,
+      const AccountUpdate &accountUpdate,
+      const StorageUpdate *first,
+      const std::string &arrayName,
+      const std::vector<StorageUpdate> &updates,
+      unsigned int expectedSize)
+    {
+        if (updates.size() != expectedSize)
+        {
+            return arrayName + " has " + std::to_string(updates.size()) + " updates, expected " +
+                   std::to_string(expectedSize);
+        }
+        FieldT root = accountUpdate.before.storageRoot;
+        if (first != nullptr)
+        {
+            if (first->rootBefore != root)
+            {
+                return mismatch(account + " storageUpdate.rootBefore", root, first->rootBefore);
+            }
+            root = first->rootAfter;
+        }
+        for (unsigned int i = 0; i < updates.size(); i++)
+        {
+            if (updates[i].rootBefore != root)
+            {
+                return mismatch(arrayName + "[" + std::to_string(i) + "].rootBefore", root, updates[i].rootBefore);
+            }
+            root = updates[i].rootAfter;
+        }
+        if (accountUpdate.after.storageRoot != root)
+        {
+            return mismatch(account + ".after.storageRoot", root, accountUpdate.after.storageRoot);
+        }
+        return "";
+    }
+
+    // Same update order as TransactionGadget
+    static std::string chainTransaction(RootChain &chain, const Witness &w, bool deferOperatorFees)
+    {
+        std::string error;
+        // UserA
+        error = chainStorage("accountUpdate_A", w.accountUpdate_A, &w.storageUpdate_A, "storageUpdate_A_array",
+                             w.storageUpdate_A_array, ORDER_SIZE_USER_A - 1);
+        if (error.empty())
+        {
+            error = chainBalances(
+              "accountUpdate_A",
+              w.accountUpdate_A,
+              {{"balanceUpdateS_A", &w.balanceUpdateS_A},
+               {"balanceUpdateB_A", &w.balanceUpdateB_A},
+               {"balanceUpdateFee_A", &w.balanceUpdateFee_A}});
+        }
+        if (error.empty())
+        {
+            error = chainAccount(chain, "accountUpdate_A", w.accountUpdate_A);
+        }
+        // UserB
+        if (error.empty())
+        {
+            error = chainStorage("accountUpdate_B", w.accountUpdate_B, &w.storageUpdate_B, "storageUpdate_B_array",
+                                 w.storageUpdate_B_array, ORDER_SIZE_USER_B - 1);
+        }
+        if (error.empty())
+        {
+            error = chainBalances(
+              "accountUpdate_B",
+              w.accountUpdate_B,
+              {{"balanceUpdateS_B", &w.balanceUpdateS_B},
+               {"balanceUpdateB_B", &w.balanceUpdateB_B},
+               {"balanceUpdateFee_B", &w.balanceUpdateFee_B}});
+        }
+        if (error.empty())
+        {
+            error = chainAccount(chain, "accountUpdate_B", w.accountUpdate_B);
+        }
+        // UserC
+        if (error.empty())
+        {
+            error = chainStorage("accountUpdate_C", w.accountUpdate_C, nullptr, "storageUpdate_C_array",
+                                 w.storageUpdate_C_array, ORDER_SIZE_USER_C);
+        }
+        if (error.empty())
+        {
+            error = chainBalances(
+              "accountUpdate_C",
+              w.accountUpdate_C,
+              {{"balanceUpdateS_C", &w.balanceUpdateS_C},
+               {"balanceUpdateB_C", &w.balanceUpdateB_C},
+               {"balanceUpdateFee_C", &w.balanceUpdateFee_C}});
+        }
+        if (error.empty())
+        {
+            error = chainAccount(chain, "accountUpdate_C", w.accountUpdate_C);
+        }
+        // UserD
+        if (error.empty())
+        {
+            error = chainStorage("accountUpdate_D", w.accountUpdate_D, nullptr, "storageUpdate_D_array",
+                                 w.storageUpdate_D_array, ORDER_SIZE_USER_D);
+        }
+        if (error.empty())
+        {
+            error = chainBalances(
+              "accountUpdate_D",
+              w.accountUpdate_D,
+              {{"balanceUpdateS_D", &w.balanceUpdateS_D},
+               {"balanceUpdateB_D", &w.balanceUpdateB_D},
+               {"balanceUpdateFee_D", &w.balanceUpdateFee_D}});
+        }
+        if (error.empty())
+        {
+            error = chainAccount(chain, "accountUpdate_D", w.accountUpdate_D);
+        }
+        // UserE
+        if (error.empty())
+        {
+            error = chainStorage("accountUpdate_E", w.accountUpdate_E, nullptr, "storageUpdate_E_array",
+                                 w.storageUpdate_E_array, ORDER_SIZE_USER_E);
+        }
+        if (error.empty())
+        {
+            error = chainBalances(
+              "accountUpdate_E",
+              w.accountUpdate_E,
+              {{"balanceUpdateS_E", &w.balanceUpdateS_E},
+               {"balanceUpdateB_E", &w.balanceUpdateB_E},
+               {"balanceUpdateFee_E", &w.balanceUpdateFee_E}});
+        }
+        if (error.empty())
+        {
+            error = chainAccount(chain, "accountUpdate_E", w.accountUpdate_E);
+        }
+        // UserF
+        if (error.empty())
+        {
+            error = chainStorage("accountUpdate_F", w.accountUpdate_F, nullptr, "storageUpdate_F_array",
+                                 w.storageUpdate_F_array, ORDER_SIZE_USER_F);
+        }
+        if (error.empty())
+        {
+            error = chainBalances(
+              "accountUpdate_F",
+              w.accountUpdate_F,
+              {{"balanceUpdateS_F", &w.balanceUpdateS_F},
+               {"balanceUpdateB_F", &w.balanceUpdateB_F},
+               {"balanceUpdateFee_F", &w.balanceUpdateFee_F}});
+        }
+        if (error.empty())
+        {
+            error = chainAccount(chain, "accountUpdate_F", w.accountUpdate_F);
+        }
+        // Operator
+        if (deferOperatorFees)
+        {
+            return error;
+        }
+        if (error.empty())
+        {
+            error = chainBalances(
+              "accountUpdate_O",
+              w.accountUpdate_O,
+              {{"balanceUpdateD_O", &w.balanceUpdateD_O},
+               {"balanceUpdateC_O", &w.balanceUpdateC_O},
+               {"balanceUpdateB_O", &w.balanceUpdateB_O},
+               {"balanceUpdateA_O", &w.balanceUpdateA_O}});
+        }
+        if (error.empty())
+        {
+            error = chainAccount(chain, "accountUpdate_O", w.accountUpdate_O);
+        }
+        return error;
+    }
+
+    // Walks over all updates of the block in the order of UniversalCircuit, without any hashing
+    static std::string validateChain(const Block &block)
+    {
+        const bool deferOperatorFees = !block.operatorFeeUpdates.empty();
+        RootChain chain{block.merkleRootBefore, block.merkleAssetRootBefore};
+        FieldT numConditionalTransactions = FieldT::zero();
+        for (unsigned int i = 0; i < block.transactions.size(); i++)
+        {
+            const UniversalTransaction &tx = block.transactions[i];
+            const std::string prefix = "tx " + std::to_string(i) + ": ";
+            if (tx.type.as_ulong() >= (unsigned long)TransactionType::COUNT)
+            {
+                return prefix + "invalid transaction type " + toString(tx.type);
+            }
+            std::string error = chainTransaction(chain, tx.witness, deferOperatorFees);
+            if (error.empty())
+            {
+                error = checkTransactionBalances(tx, deferOperatorFees);
+            }
+            if (!error.empty())
+            {
+                return prefix + error;
+            }
+            if (tx.witness.numConditionalTransactionsAfter.as_ulong() < numConditionalTransactions.as_ulong())
+            {
+                return prefix + mismatch(
+                                  "numConditionalTransactionsAfter",
+                                  numConditionalTransactions,
+                                  tx.witness.numConditionalTransactionsAfter);
+            }
+            numConditionalTransactions = tx.witness.numConditionalTransactionsAfter;
+        }
+
+        // Protocol pool and operator
+        std::string error = chainAccount(chain, "accountUpdate_P", block.accountUpdate_P);
+        if (error.empty())
+        {
+            if (block.accountUpdate_O.accountID != block.operatorAccountID)
+            {
+                return mismatch("accountUpdate_O.accountID", block.operatorAccountID, block.accountUpdate_O.accountID);
+            }
+            if (block.accountUpdate_O.after.nonce != block.accountUpdate_O.before.nonce + FieldT::one())
+            {
+                return mismatch(
+                  "accountUpdate_O.after.nonce",
+                  block.accountUpdate_O.before.nonce + FieldT::one(),
+                  block.accountUpdate_O.after.nonce);
+            }
+            std::vector<std::pair<std::string, const BalanceUpdate *>> operatorFeeUpdates;
+            for (unsigned int i = 0; i < block.operatorFeeUpdates.size(); i++)
+            {
+                operatorFeeUpdates.emplace_back(
+                  "operatorFeeUpdates[" + std::to_string(i) + "]", &block.operatorFeeUpdates[i]);
+            }
+            error = chainBalances("accountUpdate_O", block.accountUpdate_O, operatorFeeUpdates);
+        }
+        if (error.empty())
+        {
+            error = chainAccount(chain, "accountUpdate_O", block.accountUpdate_O);
+        }
+        if (!error.empty())
+        {
+            return error;
+        }
+        if (chain.root != block.merkleRootAfter)
+        {
+            return mismatch("merkleRootAfter", chain.root, block.merkleRootAfter);
+        }
+        if (chain.assetRoot != block.merkleAssetRootAfter)
+        {
+            return mismatch("merkleAssetRootAfter", chain.assetRoot, block.merkleAssetRootAfter);
+        }
+        return "";
+    }
+
+    // All balance updates of a transaction, the operator updates are the last ones
+    static std::vector<std::pair<std::string, const BalanceUpdate *>> getBalanceUpdates(const Witness &w)
+    {
+        return {
+          {"balanceUpdateS_A", &w.balanceUpdateS_A},   {"balanceUpdateB_A", &w.balanceUpdateB_A},
+          {"balanceUpdateFee_A", &w.balanceUpdateFee_A}, {"balanceUpdateS_B", &w.balanceUpdateS_B},
+          {"balanceUpdateB_B", &w.balanceUpdateB_B},   {"balanceUpdateFee_B", &w.balanceUpdateFee_B},
+          {"balanceUpdateS_C", &w.balanceUpdateS_C},   {"balanceUpdateB_C", &w.balanceUpdateB_C},
+          {"balanceUpdateFee_C", &w.balanceUpdateFee_C}, {"balanceUpdateS_D", &w.balanceUpdateS_D},
+          {"balanceUpdateB_D", &w.balanceUpdateB_D},   {"balanceUpdateFee_D", &w.balanceUpdateFee_D},
+          {"balanceUpdateS_E", &w.balanceUpdateS_E},   {"balanceUpdateB_E", &w.balanceUpdateB_E},
+          {"balanceUpdateFee_E", &w.balanceUpdateFee_E}, {"balanceUpdateS_F", &w.balanceUpdateS_F},
+          {"balanceUpdateB_F", &w.balanceUpdateB_F},   {"balanceUpdateFee_F", &w.balanceUpdateFee_F},
+          {"balanceUpdateD_O", &w.balanceUpdateD_O},   {"balanceUpdateC_O", &w.balanceUpdateC_O},
+          {"balanceUpdateB_O", &w.balanceUpdateB_O},   {"balanceUpdateA_O", &w.balanceUpdateA_O}};
+    }
+
+    // The circuit limits balances to NUM_BITS_AMOUNT_MAX bits, a negative balance wraps around to a much larger
+    // field element
+    static std::string checkBalanceRange(const std::string &name, const FieldT &balance)
+    {
+        if (balance.as_bigint().num_bits() > NUM_BITS_AMOUNT_MAX)
+        {
+            return name + " is negative or too large: " + toString(balance);
+        }
+        return "";
+    }
+
+    // The balance of tokenID is increased or decreased by amount. Both balances are in range, so the field
+    // arithmetic cannot wrap around.
+    static std::string checkBalanceChange(
+      const std::string &name,
+      const BalanceUpdate &update,
+      const FieldT &tokenID,
+      const FieldT &amount,
+      bool increase)
+    {
+        if (update.tokenID != tokenID)
+        {
+            return mismatch(name + ".tokenID", tokenID, update.tokenID);
+        }
+        const FieldT expected = increase ? update.before.balance + amount : update.before.balance - amount;
+        if (update.after.balance != expected)
+        {
+            return mismatch(name + ".after.balance", expected, update.after.balance);
+        }
+        return "";
+    }
+
+    // The fee is paid from a balance of account A to an operator balance (TransferGadget feePayment)
+    static std::string checkFeePayment(
+      const std::pair<std::string, const BalanceUpdate *> &from,
+      const std::pair<std::string, const BalanceUpdate *> &to,
+      const FieldT &feeTokenID,
+      const FieldT &fee,
+      bool deferOperatorFees)
+    {
+        if (fee.as_bigint().num_bits() > NUM_BITS_AMOUNT)
+        {
+            return "fee is too large: " + toString(fee);
+        }
+        const FieldT feeValue = roundToFloatValue(fee, Float16Encoding);
+        std::string error = checkBalanceChange(from.first, *from.second, feeTokenID, feeValue, false);
+        // With deferred operator fees the fee is added to the operator fee table instead
+        if (error.empty() && !deferOperatorFees)
+        {
+            error = checkBalanceChange(to.first, *to.second, feeTokenID, feeValue, true);
+        }
+        return error;
+    }
+
+    // Transfers and withdrawals pay the fee from balance B of account A to balance A of the operator
+    static std::string checkFeePayment(
+      const Witness &w,
+      const FieldT &feeTokenID,
+      const FieldT &fee,
+      bool deferOperatorFees)
+    {
+        return checkFeePayment(
+          {"balanceUpdateB_A", &w.balanceUpdateB_A},
+          {"balanceUpdateA_O", &w.balanceUpdateA_O},
+          feeTokenID,
+          fee,
+          deferOperatorFees);
+    }
+
+    // Account updates, app key updates and order cancellations pay the fee from balance S of account A to
+    // balance B of the operator
+    static std::string checkOtherFeePayment(
+      const Witness &w,
+      const FieldT &feeTokenID,
+      const FieldT &fee,
+      bool deferOperatorFees)
+    {
+        return checkFeePayment(
+          {"balanceUpdateS_A", &w.balanceUpdateS_A},
+          {"balanceUpdateB_O", &w.balanceUpdateB_O},
+          feeTokenID,
+          fee,
+          deferOperatorFees);
+    }
+
+    // Account updates and app key updates always increase the nonce of account A
+    static std::string checkNonceIncrease(const Witness &w)
+    {
+        const AccountUpdate &update = w.accountUpdate_A;
+        if (update.after.nonce != update.before.nonce + FieldT::one())
+        {
+            return mismatch("accountUpdate_A.after.nonce", update.before.nonce + FieldT::one(), update.after.nonce);
+        }
+        return "";
+    }
+
+    // Cheap native checks of the balances of a transaction, without executing the transaction
+    static std::string checkTransactionBalances(const UniversalTransaction &tx, bool deferOperatorFees)
+    {
+        const Witness &w = tx.witness;
+        const auto balanceUpdates = getBalanceUpdates(w);
+        const unsigned int numBalanceUpdates = balanceUpdates.size() - (deferOperatorFees ? 4 : 0);
+        for (unsigned int i = 0; i < numBalanceUpdates; i++)
+        {
+            const BalanceUpdate &update = *balanceUpdates[i].second;
+            std::string error = checkBalanceRange(balanceUpdates[i].first + ".before.balance", update.before.balance);
+            if (error.empty())
+            {
+                error = checkBalanceRange(balanceUpdates[i].first + ".after.balance", update.after.balance);
+            }
+            if (!error.empty())
+            {
+                return error;
+            }
+        }
+
+        std::string error;
+        switch (TransactionType(tx.type.as_ulong()))
+        {
+            case TransactionType::Deposit:
+            {
+                error = checkBalanceChange(
+                  "balanceUpdateS_A", w.balanceUpdateS_A, tx.deposit.tokenID, tx.deposit.amount, true);
+                break;
+            }
+            case TransactionType::Transfer:
+            {
+                // The amount is taken from A and added to B, rounded the same way as in the data availability
+                if (tx.transfer.amount.as_bigint().num_bits() > NUM_BITS_AMOUNT)
+                {
+                    return "transfer amount is too large: " + toString(tx.transfer.amount);
+                }
+                const FieldT amount = roundToFloatValue(tx.transfer.amount, Float32Encoding);
+                error = checkBalanceChange("balanceUpdateS_A", w.balanceUpdateS_A, tx.transfer.tokenID, amount, false);
+                if (error.empty())
+                {
+                    error =
+                      checkBalanceChange("balanceUpdateB_B", w.balanceUpdateB_B, tx.transfer.tokenID, amount, true);
+                }
+                if (error.empty())
+                {
+                    error = checkFeePayment(w, tx.transfer.feeTokenID, tx.transfer.fee, deferOperatorFees);
+                }
+                break;
+            }
+            case TransactionType::Withdrawal:
+            {
+                const FieldT &amount = tx.withdraw.amount;
+                if (toBigInt(amount) > toBigInt(w.balanceUpdateS_A.before.balance))
+                {
+                    return "withdrawal amount " + toString(amount) + " exceeds the balance " +
+                           toString(w.balanceUpdateS_A.before.balance);
+                }
+                error = checkBalanceChange("balanceUpdateS_A", w.balanceUpdateS_A, tx.withdraw.tokenID, amount, false);
+                if (error.empty())
+                {
+                    error = checkFeePayment(w, tx.withdraw.feeTokenID, tx.withdraw.fee, deferOperatorFees);
+                }
+                break;
+            }
+            case TransactionType::AccountUpdate:
+            {
+                error = checkNonceIncrease(w);
+                if (error.empty())
+                {
+                    error = checkOtherFeePayment(
+                      w, tx.accountUpdate.feeTokenID, tx.accountUpdate.fee, deferOperatorFees);
+                }
+                break;
+            }
+            case TransactionType::AppKeyUpdate:
+            {
+                error = checkNonceIncrease(w);
+                if (error.empty())
+                {
+                    error =
+                      checkOtherFeePayment(w, tx.appKeyUpdate.feeTokenID, tx.appKeyUpdate.fee, deferOperatorFees);
+                }
+                break;
+            }
+            case TransactionType::OrderCancel:
+            {
+                // The storage slot of the order is marked as cancelled
+                const StorageLeaf &storage = w.storageUpdate_A.after;
+                if (storage.storageID != tx.orderCancel.storageID)
+                {
+                    return mismatch("storageUpdate_A.after.storageID", tx.orderCancel.storageID, storage.storageID);
+                }
+                if (storage.cancelled != FieldT::one())
+                {
+                    return mismatch("storageUpdate_A.after.cancelled", FieldT::one(), storage.cancelled);
+                }
+                error =
+                  checkOtherFeePayment(w, tx.orderCancel.feeTokenID, tx.orderCancel.fee, deferOperatorFees);
+                break;
+            }
+            // Spot trades and batch spot trades (fills, trading fees, order limits) are only checked by the
+            // circuit
+            default:
+                break;
+        }
+        return error;
+    }
+
+    static std::string checkProofSize(const std::string &name, const Proof &proof, unsigned int depth)
+    {
+        if (proof.data.size() != depth * 3)
+        {
+            return name + " has " + std::to_string(proof.data.size()) + " proof elements, expected " +
+                   std::to_string(depth * 3);
+        }
+        return "";
+    }
+
+    // Updates that do not modify the state are only checked by the root chain. The address of an
+    // unused update is not known without executing the transaction.
+    static std::string validateAccountProof(
+      NativeMerkleHashers &hashers,
+      const std::string &name,
+      const AccountUpdate &update)
+    {
+        if (update.rootBefore == update.rootAfter && update.assetRootBefore == update.assetRootAfter)
+        {
+            return "";
+        }
+        std::string error = checkProofSize(name + ".proof", update.proof, TREE_DEPTH_ACCOUNTS);
+        if (error.empty())
+        {
+            error = checkProofSize(name + ".assetProof", update.assetProof, TREE_DEPTH_ACCOUNTS);
+        }
+        if (!error.empty())
+        {
+            return error;
+        }
+        const std::vector<FieldT> &proof = update.proof.data;
+        const std::vector<FieldT> &assetProof = update.assetProof.data;
+        FieldT root = hashers.root(TREE_DEPTH_ACCOUNTS, update.accountID, hashers.accountLeaf(update.before), proof);
+        if (root != update.rootBefore)
+        {
+            return name + ": Merkle proof of the leaf before does not match rootBefore";
+        }
+        root = hashers.root(TREE_DEPTH_ACCOUNTS, update.accountID, hashers.accountLeaf(update.after), proof);
+        if (root != update.rootAfter)
+        {
+            return name + ": Merkle proof of the leaf after does not match rootAfter";
+        }
+        root = hashers.root(
+          TREE_DEPTH_ACCOUNTS, update.accountID, hashers.assetAccountLeaf(update.before), assetProof);
+        if (root != update.assetRootBefore)
+        {
+            return name + ": Merkle proof of the asset leaf before does not match assetRootBefore";
+        }
+        root =
+          hashers.root(TREE_DEPTH_ACCOUNTS, update.accountID, hashers.assetAccountLeaf(update.after), assetProof);
+        if (root != update.assetRootAfter)
+        {
+            return name + ": Merkle proof of the asset leaf after does not match assetRootAfter";
+        }
+        return "";
+    }
+
+    static std::string validateBalanceProof(
+      NativeMerkleHashers &hashers,
+      const std::string &name,
+      const BalanceUpdate &update)
+    {
+        if (update.rootBefore == update.rootAfter)
+        {
+            return "";
+        }
+        std::string error = checkProofSize(name + ".proof", update.proof, TREE_DEPTH_TOKENS);
+        if (!error.empty())
+        {
+            return error;
+        }
+        if (hashers.root(TREE_DEPTH_TOKENS, update.tokenID, hashers.balanceLeaf(update.before), update.proof.data) !=
+            update.rootBefore)
+        {
+            return name + ": Merkle proof of the leaf before does not match rootBefore";
+        }
+        if (hashers.root(TREE_DEPTH_TOKENS, update.tokenID, hashers.balanceLeaf(update.after), update.proof.data) !=
+            update.rootAfter)
+        {
+            return name + ": Merkle proof of the leaf after does not match rootAfter";
+        }
+        return "";
+    }
+
+    static std::string validateStorageProof(
+      NativeMerkleHashers &hashers,
+      const std::string &name,
+      const StorageUpdate &update)
+    {
+        if (update.rootBefore == update.rootAfter)
+        {
+            return "";
+        }
+        std::string error = checkProofSize(name + ".proof", update.proof, TREE_DEPTH_STORAGE);
+        if (!error.empty())
+        {
+            return error;
+        }
+        // The slot is stored in the lowest bits of the storageID
+        if (hashers.root(
+              TREE_DEPTH_STORAGE, update.storageID, hashers.storageLeaf(update.before), update.proof.data) !=
+            update.rootBefore)
+        {
+            return name + ": Merkle proof of the leaf before does not match rootBefore";
+        }
+        if (hashers.root(TREE_DEPTH_STORAGE, update.storageID, hashers.storageLeaf(update.after), update.proof.data) !=
+            update.rootAfter)
+        {
+            return name + ": Merkle proof of the leaf after does not match rootAfter";
+        }
+        return "";
+    }
+
+    static std::string validateStorageProofs(
+      NativeMerkleHashers &hashers,
+      const std::string &name,
+      const std::vector<StorageUpdate> &updates)
+    {
+        for (unsigned int i = 0; i < updates.size(); i++)
+        {
+            std::string error = validateStorageProof(hashers, name + "[" + std::to_string(i) + "]", updates[i]);
+            if (!error.empty())
+            {
+                return error;
+            }
+        }
+        return "";
+    }
+
+    static std::string validateProofs(NativeMerkleHashers &hashers, const Witness &w, bool deferOperatorFees)
+    {
+        const std::vector<std::pair<std::string, const BalanceUpdate *>> balanceUpdates = getBalanceUpdates(w);
+        const std::vector<std::pair<std::string, const AccountUpdate *>> accountUpdates = {
+          {"accountUpdate_A", &w.accountUpdate_A},
+          {"accountUpdate_B", &w.accountUpdate_B},
+          {"accountUpdate_C", &w.accountUpdate_C},
+          {"accountUpdate_D", &w.accountUpdate_D},
+          {"accountUpdate_E", &w.accountUpdate_E},
+          {"accountUpdate_F", &w.accountUpdate_F},
+          {"accountUpdate_O", &w.accountUpdate_O}};
+
+        std::string error = validateStorageProof(hashers, "storageUpdate_A", w.storageUpdate_A);
+        if (error.empty())
+        {
+            error = validateStorageProofs(hashers, "storageUpdate_A_array", w.storageUpdate_A_array);
+        }
+        if (error.empty())
+        {
+            error = validateStorageProof(hashers, "storageUpdate_B", w.storageUpdate_B);
+        }
+        if (error.empty())
+        {
+            error = validateStorageProofs(hashers, "storageUpdate_B_array", w.storageUpdate_B_array);
+        }
+        if (error.empty())
+        {
+            error = validateStorageProofs(hashers, "storageUpdate_C_array", w.storageUpdate_C_array);
+        }
+        if (error.empty())
+        {
+            error = validateStorageProofs(hashers, "storageUpdate_D_array", w.storageUpdate_D_array);
+        }
+        if (error.empty())
+        {
+            error = validateStorageProofs(hashers, "storageUpdate_E_array", w.storageUpdate_E_array);
+        }
+        if (error.empty())
+        {
+            error = validateStorageProofs(hashers, "storageUpdate_F_array", w.storageUpdate_F_array);
+        }
+        // The operator updates are always the last ones
+        const unsigned int numBalanceUpdates = balanceUpdates.size() - (deferOperatorFees ? 4 : 0);
+        const unsigned int numAccountUpdates = accountUpdates.size() - (deferOperatorFees ? 1 : 0);
+        for (unsigned int i = 0; i < numBalanceUpdates && error.empty(); i++)
+        {
+            error = validateBalanceProof(hashers, balanceUpdates[i].first, *balanceUpdates[i].second);
+        }
+        for (unsigned int i = 0; i < numAccountUpdates && error.empty(); i++)
+        {
+            error = validateAccountProof(hashers, accountUpdates[i].first, *accountUpdates[i].second);
+        }
+        return error;
+    }
+};
+
+} // namespace Loopring
+
+#endif
@@ -4,7 +4,9 @@
 #define _CIRCUIT_H_
 
 #include "ethsnarks.hpp"
+#include "../Utils/Annotations.h"
 #include "../Utils/Data.h"
+#include "../Utils/ConstraintSystemOptimizer.h"
 
 using namespace ethsnarks;
 
@@ -14,6 +16,32 @@ namespace Loopring
 class Circuit : public GadgetT
 {
   public:
+    // When false the transaction gadgets are created but their constraints are not generated, the constraints
+    // are loaded from the constraint system cache instead (see Utils/ConstraintSystemCache.h). Always creates
+    // the transactions on the main protoboard.
+    bool transactionConstraints = true;
+    // When true the transaction gadgets are only kept for the few kinds of slots, the constraints of every slot
+    // are copied from the gadgets of its kind and the witness of every slot is generated with them (with a copy
+    // of the gadgets per thread).
+#ifdef CIRCUIT_STAMP_TRANSACTIONS
+    bool stampTransactions = true;
+#else
+    bool stampTransactions = false;
+#endif
+    // When true every transaction gadget is created on its own protoboard and spliced into the main protoboard
+    // (see UniversalCircuit::generateConstraints). Every transaction keeps its protoboard and gadgets: a second
+    // copy of the values of all its variables, and every witness copies those values to the main protoboard.
+#ifdef CIRCUIT_PARALLEL_TRANSACTIONS
+    bool parallelTransactions = true;
+#else
+    bool parallelTransactions = false;
+#endif
+    // Transaction types supported in each slot, needs to be set before the constraints are generated
+    BlockLayout layout;
+    // Simplified copy of the constraint system (layout.optimizeConstraints). When available the keys are
+    // generated for and the proofs are created with this constraint system.
+    std::unique_ptr<ConstraintSystemOptimizer> optimizer;
+
     Circuit( //
       libsnark::protoboard<FieldT> &pb,
       const std::string &annotation_prefix)
@@ -21,13 +49,33 @@ class Circuit : public GadgetT
     virtual ~Circuit(){};
     virtual void generateConstraints(unsigned int blockSize) = 0;
     virtual bool generateWitness(const json &input) = 0;
+    virtual bool generateWitness(const Block &block) = 0;
     virtual unsigned int getBlockType() = 0;
     virtual unsigned int getBlockSize() = 0;
     virtual void printInfo() = 0;
 
+    // The protoboard the keys are generated for and the proofs are created with
     libsnark::protoboard<FieldT> &getPb()
     {
-        return pb;
+        return optimizer ? optimizer->pb : pb;
+    }
+
+    // Needs to be called after the constraints are generated
+    void optimizeConstraints()
+    {
+        optimizer.reset(new ConstraintSystemOptimizer(pb));
+        // Only the optimized constraints are needed from now on
+        pb.constraint_system.constraints.clear();
+        pb.constraint_system.constraints.shrink_to_fit();
+    }
+
+    // Needs to be called after the witness is generated
+    void mapWitness()
+    {
+        if (optimizer)
+        {
+            optimizer->mapWitness(pb);
+        }
     }
 };
 
@@ -96,6 +96,7 @@ class DepositCircuit : public BaseTransactionCircuit
 
     void generate_r1cs_witness(const Deposit &deposit)
     {
+        ProfileWitness profile(annotation_prefix);
         LOG(LogDebug, "in DepositCircuit", "generate_r1cs_witness");
         // Inputs
         owner.generate_r1cs_witness(pb, deposit.owner);
@@ -118,6 +119,7 @@ class DepositCircuit : public BaseTransactionCircuit
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         LOG(LogDebug, "in DepositCircuit", "generate_r1cs_constraints");
         // Inputs
         owner.generate_r1cs_constraints(true);
@@ -37,6 +37,7 @@ class NoopCircuit : public BaseTransactionCircuit
 
     void generate_r1cs_witness()
     {
+        ProfileWitness profile(annotation_prefix);
         LOG(LogDebug, "in NoopCircuit", "generate_r1cs_witness");
         typeTx.generate_r1cs_witness(pb, ethsnarks::FieldT(int(Loopring::TransactionType::Noop)));
         typeTxPad.generate_r1cs_witness(pb, ethsnarks::FieldT(0));
@@ -44,6 +45,7 @@ class NoopCircuit : public BaseTransactionCircuit
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         LOG(LogDebug, "in NoopCircuit", "generate_r1cs_constraints");
         typeTx.generate_r1cs_constraints(true);
         typeTxPad.generate_r1cs_constraints(true);
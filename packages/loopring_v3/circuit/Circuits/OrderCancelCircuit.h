@@ -143,6 +143,7 @@ class OrderCancelCircuit : public BaseTransactionCircuit
 
     void generate_r1cs_witness(const OrderCancel &update)
     {
+        ProfileWitness profile(annotation_prefix);
         LOG(LogDebug, "in OrderCancelCircuit", "generate_r1cs_witness");
         // Inputs
         typeTx.generate_r1cs_witness();
@@ -180,6 +181,7 @@ class OrderCancelCircuit : public BaseTransactionCircuit
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         LOG(LogDebug, "in OrderCancelCircuit", "generate_r1cs_constraints");
         typeTx.generate_r1cs_constraints();
         typeTxPad.generate_r1cs_constraints();
@@ -346,6 +346,7 @@ class SpotTradeCircuit : public BaseTransactionCircuit
 
     void generate_r1cs_witness(const SpotTrade &spotTrade)
     {
+        ProfileWitness profile(annotation_prefix);
         LOG(LogDebug, "in SpotTradeCircuit", "generate_r1cs_witness");
         typeTx.generate_r1cs_witness();
         typeTxPad.generate_r1cs_witness();
@@ -422,6 +423,7 @@ class SpotTradeCircuit : public BaseTransactionCircuit
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         LOG(LogDebug, "in SpotTradeCircuit", "generate_r1cs_constraints");
         typeTx.generate_r1cs_constraints();
         typeTxPad.generate_r1cs_constraints();
@@ -401,6 +401,7 @@ class TransferCircuit : public BaseTransactionCircuit
 
     void generate_r1cs_witness(const Transfer &transfer)
     {
+        ProfileWitness profile(annotation_prefix);
         LOG(LogDebug, "in TransferCircuit", "generate_r1cs_witness");
         typeTx.generate_r1cs_witness();
         typeTxPad.generate_r1cs_witness();
@@ -493,6 +494,7 @@ class TransferCircuit : public BaseTransactionCircuit
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         LOG(LogDebug, "in TransferCircuit", "generate_r1cs_constraints");
         typeTx.generate_r1cs_constraints();
         typeTxPad.generate_r1cs_constraints();
@@ -8,6 +8,7 @@
 #include "../Utils/Constants.h"
 #include "../Utils/Data.h"
 #include "../Utils/Utils.h"
+#include "../Utils/SubProtoboard.h"
 #include "../Gadgets/MatchingGadgets.h"
 #include "../Gadgets/AccountGadgets.h"
 #include "../Gadgets/StorageGadgets.h"
@@ -27,6 +28,10 @@
 #include "utils.hpp"
 #include "gadgets/subadd.hpp"
 
+#ifdef MULTICORE
+#include <omp.h>
+#endif
+
 using namespace ethsnarks;
 
 // Naming conventions:
@@ -56,33 +61,44 @@ class SelectTransactionGadget : public BaseTransactionCircuit
         assert(selector.size() == transactions.size());
 
         // Unsigned outputs
-        uSelects.reserve(uOutputs.size());
-        for (const auto &uPair : uOutputs)
+        // The outputs are selected in the order of TxVariable so the constraint system doesn't change
+        uSelects.reserve(outputs.count(TransactionOutputs::Type::Variable));
+        for (unsigned int v = 0; v < TXV_COUNT; v++)
         {
+            const TxVariable txVariable = TxVariable(v);
+            if (outputs.types[txVariable] != TransactionOutputs::Type::Variable)
+            {
+                continue;
+            }
             std::vector<VariableT> variables;
             for (unsigned int i = 0; i < transactions.size(); i++)
             {
-                variables.push_back(transactions[i]->getOutput(uPair.first));
+                variables.push_back(transactions[i]->getOutput(txVariable));
             }
             uSelects.emplace_back(pb, state.constants, selector, variables, FMT(annotation_prefix, ".uSelects"));
 
             // Set the output variable
-            setOutput(uPair.first, uSelects.back().result());
+            setOutput(txVariable, uSelects.back().result());
         }
 
         // Array outputs
-        aSelects.reserve(aOutputs.size());
-        for (const auto &aPair : aOutputs)
+        aSelects.reserve(outputs.count(TransactionOutputs::Type::Array));
+        for (unsigned int v = 0; v < TXV_COUNT; v++)
         {
+            const TxVariable txVariable = TxVariable(v);
+            if (outputs.types[txVariable] != TransactionOutputs::Type::Array)
+            {
+                continue;
+            }
             std::vector<VariableArrayT> variables;
             for (unsigned int i = 0; i < transactions.size(); i++)
             {
-                variables.push_back(transactions[i]->getArrayOutput(aPair.first));
+                variables.push_back(transactions[i]->getArrayOutput(txVariable));
             }
             aSelects.emplace_back(pb, state.constants, selector, variables, FMT(annotation_prefix, ".aSelects"));
 
             // Set the output variable
-            setArrayOutput(aPair.first, aSelects.back().result());
+            setArrayOutput(txVariable, aSelects.back().result());
         }
 
         // Public data
@@ -106,6 +122,7 @@ class SelectTransactionGadget : public BaseTransactionCircuit
 
     void generate_r1cs_witness()
     {
+        ProfileWitness profile(annotation_prefix);
         for (unsigned int i = 0; i < uSelects.size(); i++)
         {
             uSelects[i].generate_r1cs_witness();
@@ -122,6 +139,7 @@ class SelectTransactionGadget : public BaseTransactionCircuit
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         for (unsigned int i = 0; i < uSelects.size(); i++)
         {
             uSelects[i].generate_r1cs_constraints();
@@ -142,13 +160,15 @@ class SelectTransactionGadget : public BaseTransactionCircuit
     }
 };
 
+// Updates the storage slot of the order and the storage slots of the orders in the batch of user A
+// in a single pass over the storage tree of the account
 class BatchStorageAUpdateGadget : public GadgetT 
 {
   public:
-    SelectTransactionGadget tx;
-    TransactionAccountState account;
+    const SelectTransactionGadget &tx;
+    const TransactionAccountState &account;
     VariableT storageRoot;
-    std::vector<UpdateStorageGadget> updateStorages;
+    MultiUpdateStorageGadget updateStorages;
     
     BatchStorageAUpdateGadget(
       ProtoboardT &pb,
@@ -159,12 +179,22 @@ class BatchStorageAUpdateGadget : public GadgetT
         : GadgetT(pb, prefix),
         tx(_tx),
         account(_account),
-        storageRoot(_storageRoot)
-    {
-      updateStorages.emplace_back(UpdateStorageGadget(
+        storageRoot(_storageRoot),
+        updateStorages(
           pb,
           storageRoot,
-          tx.getArrayOutput(TXV_STORAGE_A_ADDRESS_ARRAY_0),
+          {tx.getArrayOutput(TXV_STORAGE_A_ADDRESS),
+           tx.getArrayOutput(TXV_STORAGE_A_ADDRESS_ARRAY_0),
+           tx.getArrayOutput(TXV_STORAGE_A_ADDRESS_ARRAY_1),
+           tx.getArrayOutput(TXV_STORAGE_A_ADDRESS_ARRAY_2)},
+          {{account.storage.tokenSID, 
+          account.storage.tokenBID, 
+          account.storage.data, 
+          account.storage.storageID, 
+          account.storage.gasFee, 
+          account.storage.cancelled, 
+          account.storage.forward},
+
           {account.storageArray[0].tokenSID, 
           account.storageArray[0].tokenBID, 
           account.storageArray[0].data, 
@@ -173,19 +203,6 @@ class BatchStorageAUpdateGadget : public GadgetT
           account.storageArray[0].cancelled, 
           account.storageArray[0].forward},
 
-          {tx.getOutput(TXV_STORAGE_A_TOKENSID_ARRAY_0), 
-          tx.getOutput(TXV_STORAGE_A_TOKENBID_ARRAY_0), 
-          tx.getOutput(TXV_STORAGE_A_DATA_ARRAY_0), 
-          tx.getOutput(TXV_STORAGE_A_STORAGEID_ARRAY_0), 
-          tx.getOutput(TXV_STORAGE_A_GASFEE_ARRAY_0), 
-          tx.getOutput(TXV_STORAGE_A_CANCELLED_ARRAY_0), 
-          tx.getOutput(TXV_STORAGE_A_FORWARD_ARRAY_0)},
-          std::string("BatchStorageUpdateGadget.updateStorages_0")
-        ));
-      updateStorages.emplace_back(UpdateStorageGadget(
-          pb,
-          updateStorages.back().result(),
-          tx.getArrayOutput(TXV_STORAGE_A_ADDRESS_ARRAY_1),
           {account.storageArray[1].tokenSID, 
           account.storageArray[1].tokenBID, 
           account.storageArray[1].data, 
@@ -194,6 +211,30 @@ class BatchStorageAUpdateGadget : public GadgetT
           account.storageArray[1].cancelled, 
           account.storageArray[1].forward},
 
+          {account.storageArray[2].tokenSID, 
+          account.storageArray[2].tokenBID, 
+          account.storageArray[2].data, 
+          account.storageArray[2].storageID, 
+          account.storageArray[2].gasFee, 
+          account.storageArray[2].cancelled, 
+          account.storageArray[2].forward}},
+
+          {{tx.getOutput(TXV_STORAGE_A_TOKENSID), 
+          tx.getOutput(TXV_STORAGE_A_TOKENBID), 
+          tx.getOutput(TXV_STORAGE_A_DATA), 
+          tx.getOutput(TXV_STORAGE_A_STORAGEID), 
+          tx.getOutput(TXV_STORAGE_A_GASFEE), 
+          tx.getOutput(TXV_STORAGE_A_CANCELLED), 
+          tx.getOutput(TXV_STORAGE_A_FORWARD)},
+
+          {tx.getOutput(TXV_STORAGE_A_TOKENSID_ARRAY_0), 
+          tx.getOutput(TXV_STORAGE_A_TOKENBID_ARRAY_0), 
+          tx.getOutput(TXV_STORAGE_A_DATA_ARRAY_0), 
+          tx.getOutput(TXV_STORAGE_A_STORAGEID_ARRAY_0), 
+          tx.getOutput(TXV_STORAGE_A_GASFEE_ARRAY_0), 
+          tx.getOutput(TXV_STORAGE_A_CANCELLED_ARRAY_0), 
+          tx.getOutput(TXV_STORAGE_A_FORWARD_ARRAY_0)},
+
           {tx.getOutput(TXV_STORAGE_A_TOKENSID_ARRAY_1), 
           tx.getOutput(TXV_STORAGE_A_TOKENBID_ARRAY_1), 
           tx.getOutput(TXV_STORAGE_A_DATA_ARRAY_1), 
@@ -201,19 +242,6 @@ class BatchStorageAUpdateGadget : public GadgetT
           tx.getOutput(TXV_STORAGE_A_GASFEE_ARRAY_1), 
           tx.getOutput(TXV_STORAGE_A_CANCELLED_ARRAY_1), 
           tx.getOutput(TXV_STORAGE_A_FORWARD_ARRAY_1)},
-          std::string("BatchStorageUpdateGadget.updateStorages_1")
-        ));
-      updateStorages.emplace_back(UpdateStorageGadget(
-          pb,
-          updateStorages.back().result(),
-          tx.getArrayOutput(TXV_STORAGE_A_ADDRESS_ARRAY_2),
-          {account.storageArray[2].tokenSID, 
-          account.storageArray[2].tokenBID, 
-          account.storageArray[2].data, 
-          account.storageArray[2].storageID, 
-          account.storageArray[2].gasFee, 
-          account.storageArray[2].cancelled, 
-          account.storageArray[2].forward},
 
           {tx.getOutput(TXV_STORAGE_A_TOKENSID_ARRAY_2), 
           tx.getOutput(TXV_STORAGE_A_TOKENBID_ARRAY_2), 
@@ -221,37 +249,37 @@ class BatchStorageAUpdateGadget : public GadgetT
           tx.getOutput(TXV_STORAGE_A_STORAGEID_ARRAY_2), 
           tx.getOutput(TXV_STORAGE_A_GASFEE_ARRAY_2), 
           tx.getOutput(TXV_STORAGE_A_CANCELLED_ARRAY_2), 
-          tx.getOutput(TXV_STORAGE_A_FORWARD_ARRAY_2)},
-          std::string("BatchStorageUpdateGadget.updateStorages_2")
-        ));
+          tx.getOutput(TXV_STORAGE_A_FORWARD_ARRAY_2)}},
+          FMT(prefix, ".updateStorages"))
+    {
     }
-    void generate_r1cs_witness(std::vector<StorageUpdate> storageUpdateArray) 
+    void generate_r1cs_witness(
+      const StorageUpdate &storageUpdate,
+      const std::vector<StorageUpdate> &storageUpdateArray) 
     {
-      for (size_t i = 0; i < account.storageArray.size(); i++) 
-      {
-        updateStorages[i].generate_r1cs_witness(storageUpdateArray[i]);
-      }
+      std::vector<StorageUpdate> storageUpdates = {storageUpdate};
+      storageUpdates.insert(storageUpdates.end(), storageUpdateArray.begin(), storageUpdateArray.end());
+      updateStorages.generate_r1cs_witness(storageUpdates);
     }
     void generate_r1cs_constraints() 
     {
-      for (size_t i = 0; i < updateStorages.size(); i++) 
-      {
-        updateStorages[i].generate_r1cs_constraints();
-      }
+      updateStorages.generate_r1cs_constraints();
     }
     const VariableT getHashRoot() const
     {
-        return updateStorages.back().result();
+        return updateStorages.result();
     }
 };
 
+// Updates the storage slot of the order and the storage slots of the orders in the batch of user B
+// in a single pass over the storage tree of the account
 class BatchStorageBUpdateGadget : public GadgetT 
 {
   public:
-    SelectTransactionGadget tx;
-    TransactionAccountState account;
+    const SelectTransactionGadget &tx;
+    const TransactionAccountState &account;
     VariableT storageRoot;
-    std::vector<UpdateStorageGadget> updateStorages;
+    MultiUpdateStorageGadget updateStorages;
     
     BatchStorageBUpdateGadget(
       ProtoboardT &pb,
@@ -262,19 +290,35 @@ class BatchStorageBUpdateGadget : public GadgetT
         : GadgetT(pb, prefix),
         tx(_tx),
         account(_account),
-        storageRoot(_storageRoot)
-    {
-      updateStorages.emplace_back(UpdateStorageGadget(
+        storageRoot(_storageRoot),
+        updateStorages(
           pb,
           storageRoot,
-          tx.getArrayOutput(TXV_STORAGE_B_ADDRESS_ARRAY_0),
+          {tx.getArrayOutput(TXV_STORAGE_B_ADDRESS),
+           tx.getArrayOutput(TXV_STORAGE_B_ADDRESS_ARRAY_0)},
+          {{account.storage.tokenSID, 
+          account.storage.tokenBID, 
+          account.storage.data, 
+          account.storage.storageID, 
+          account.storage.gasFee, 
+          account.storage.cancelled, 
+          account.storage.forward},
+
           {account.storageArray[0].tokenSID, 
           account.storageArray[0].tokenBID, 
           account.storageArray[0].data, 
           account.storageArray[0].storageID, 
           account.storageArray[0].gasFee, 
           account.storageArray[0].cancelled, 
-          account.storageArray[0].forward},
+          account.storageArray[0].forward}},
+
+          {{tx.getOutput(TXV_STORAGE_B_TOKENSID), 
+          tx.getOutput(TXV_STORAGE_B_TOKENBID), 
+          tx.getOutput(TXV_STORAGE_B_DATA), 
+          tx.getOutput(TXV_STORAGE_B_STORAGEID), 
+          tx.getOutput(TXV_STORAGE_B_GASFEE), 
+          tx.getOutput(TXV_STORAGE_B_CANCELLED), 
+          tx.getOutput(TXV_STORAGE_B_FORWARD)},
 
           {tx.getOutput(TXV_STORAGE_B_TOKENSID_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_B_TOKENBID_ARRAY_0), 
@@ -282,35 +326,33 @@ class BatchStorageBUpdateGadget : public GadgetT
           tx.getOutput(TXV_STORAGE_B_STORAGEID_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_B_GASFEE_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_B_CANCELLED_ARRAY_0), 
-          tx.getOutput(TXV_STORAGE_B_FORWARD_ARRAY_0)},
-          std::string("BatchStorageBUpdateGadget.updateStorages_0")
-        ));
+          tx.getOutput(TXV_STORAGE_B_FORWARD_ARRAY_0)}},
+          FMT(prefix, ".updateStorages"))
+    {
     }
-    void generate_r1cs_witness(std::vector<StorageUpdate> storageUpdateArray) 
+    void generate_r1cs_witness(
+      const StorageUpdate &storageUpdate,
+      const std::vector<StorageUpdate> &storageUpdateArray) 
     {
-      for (size_t i = 0; i < account.storageArray.size(); i++) 
-      {
-        updateStorages[i].generate_r1cs_witness(storageUpdateArray[i]);
-      }
+      std::vector<StorageUpdate> storageUpdates = {storageUpdate};
+      storageUpdates.insert(storageUpdates.end(), storageUpdateArray.begin(), storageUpdateArray.end());
+      updateStorages.generate_r1cs_witness(storageUpdates);
     }
     void generate_r1cs_constraints() 
     {
-      for (size_t i = 0; i < updateStorages.size(); i++) 
-      {
-        updateStorages[i].generate_r1cs_constraints();
-      }
+      updateStorages.generate_r1cs_constraints();
     }
     const VariableT getHashRoot() const
     {
-        return updateStorages.back().result();
+        return updateStorages.result();
     }
 };
 
 class BatchStorageCUpdateGadget : public GadgetT 
 {
   public:
-    SelectTransactionGadget tx;
-    BaseTransactionAccountState account;
+    const SelectTransactionGadget &tx;
+    const BaseTransactionAccountState &account;
     VariableT storageRoot;
     std::vector<UpdateStorageGadget> updateStorages;
     
@@ -325,11 +367,11 @@ class BatchStorageCUpdateGadget : public GadgetT
         account(_account),
         storageRoot(_storageRoot)
     {
-      updateStorages.emplace_back(UpdateStorageGadget(
+      updateStorages.emplace_back(
           pb,
           storageRoot,
           tx.getArrayOutput(TXV_STORAGE_C_ADDRESS_ARRAY_0),
-          {account.storageArray[0].tokenSID, 
+          StorageState{account.storageArray[0].tokenSID, 
           account.storageArray[0].tokenBID, 
           account.storageArray[0].data, 
           account.storageArray[0].storageID, 
@@ -337,17 +379,16 @@ class BatchStorageCUpdateGadget : public GadgetT
           account.storageArray[0].cancelled, 
           account.storageArray[0].forward},
 
-          {tx.getOutput(TXV_STORAGE_C_TOKENSID_ARRAY_0), 
+          StorageState{tx.getOutput(TXV_STORAGE_C_TOKENSID_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_C_TOKENBID_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_C_DATA_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_C_STORAGEID_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_C_GASFEE_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_C_CANCELLED_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_C_FORWARD_ARRAY_0)},
-          std::string("BatchStorageCUpdateGadget.updateStorages_0")
-        ));
+          FMT(prefix, ".updateStorages_0"));
     }
-    void generate_r1cs_witness(std::vector<StorageUpdate> storageUpdateArray) 
+    void generate_r1cs_witness(const std::vector<StorageUpdate> &storageUpdateArray) 
     {
       for (size_t i = 0; i < account.storageArray.size(); i++) 
       {
@@ -370,8 +411,8 @@ class BatchStorageCUpdateGadget : public GadgetT
 class BatchStorageDUpdateGadget : public GadgetT 
 {
   public:
-    SelectTransactionGadget tx;
-    BaseTransactionAccountState account;
+    const SelectTransactionGadget &tx;
+    const BaseTransactionAccountState &account;
     VariableT storageRoot;
     std::vector<UpdateStorageGadget> updateStorages;
     
@@ -386,11 +427,11 @@ class BatchStorageDUpdateGadget : public GadgetT
         account(_account),
         storageRoot(_storageRoot)
     {
-      updateStorages.emplace_back(UpdateStorageGadget(
+      updateStorages.emplace_back(
           pb,
           storageRoot,
           tx.getArrayOutput(TXV_STORAGE_D_ADDRESS_ARRAY_0),
-          {account.storageArray[0].tokenSID, 
+          StorageState{account.storageArray[0].tokenSID, 
           account.storageArray[0].tokenBID, 
           account.storageArray[0].data, 
           account.storageArray[0].storageID, 
@@ -398,17 +439,16 @@ class BatchStorageDUpdateGadget : public GadgetT
           account.storageArray[0].cancelled, 
           account.storageArray[0].forward},
 
-          {tx.getOutput(TXV_STORAGE_D_TOKENSID_ARRAY_0), 
+          StorageState{tx.getOutput(TXV_STORAGE_D_TOKENSID_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_D_TOKENBID_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_D_DATA_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_D_STORAGEID_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_D_GASFEE_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_D_CANCELLED_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_D_FORWARD_ARRAY_0)},
-          std::string("BatchStorageDUpdateGadget.updateStorages_0")
-        ));
+          FMT(prefix, ".updateStorages_0"));
     }
-    void generate_r1cs_witness(std::vector<StorageUpdate> storageUpdateArray) 
+    void generate_r1cs_witness(const std::vector<StorageUpdate> &storageUpdateArray) 
     {
       for (size_t i = 0; i < account.storageArray.size(); i++) 
       {
@@ -431,8 +471,8 @@ class BatchStorageDUpdateGadget : public GadgetT
 class BatchStorageEUpdateGadget : public GadgetT 
 {
   public:
-    SelectTransactionGadget tx;
-    BaseTransactionAccountState account;
+    const SelectTransactionGadget &tx;
+    const BaseTransactionAccountState &account;
     VariableT storageRoot;
     std::vector<UpdateStorageGadget> updateStorages;
     
@@ -447,11 +487,11 @@ class BatchStorageEUpdateGadget : public GadgetT
         account(_account),
         storageRoot(_storageRoot)
     {
-      updateStorages.emplace_back(UpdateStorageGadget(
+      updateStorages.emplace_back(
           pb,
           storageRoot,
           tx.getArrayOutput(TXV_STORAGE_E_ADDRESS_ARRAY_0),
-          {account.storageArray[0].tokenSID, 
+          StorageState{account.storageArray[0].tokenSID, 
           account.storageArray[0].tokenBID, 
           account.storageArray[0].data, 
           account.storageArray[0].storageID, 
@@ -459,17 +499,16 @@ class BatchStorageEUpdateGadget : public GadgetT
           account.storageArray[0].cancelled, 
           account.storageArray[0].forward},
 
-          {tx.getOutput(TXV_STORAGE_E_TOKENSID_ARRAY_0), 
+          StorageState{tx.getOutput(TXV_STORAGE_E_TOKENSID_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_E_TOKENBID_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_E_DATA_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_E_STORAGEID_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_E_GASFEE_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_E_CANCELLED_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_E_FORWARD_ARRAY_0)},
-          std::string("BatchStorageEUpdateGadget.updateStorages_0")
-        ));
+          FMT(prefix, ".updateStorages_0"));
     }
-    void generate_r1cs_witness(std::vector<StorageUpdate> storageUpdateArray) 
+    void generate_r1cs_witness(const std::vector<StorageUpdate> &storageUpdateArray) 
     {
       for (size_t i = 0; i < account.storageArray.size(); i++) 
       {
@@ -492,8 +531,8 @@ class BatchStorageEUpdateGadget : public GadgetT
 class BatchStorageFUpdateGadget : public GadgetT 
 {
   public:
-    SelectTransactionGadget tx;
-    BaseTransactionAccountState account;
+    const SelectTransactionGadget &tx;
+    const BaseTransactionAccountState &account;
     VariableT storageRoot;
     std::vector<UpdateStorageGadget> updateStorages;
     
@@ -508,11 +547,11 @@ class BatchStorageFUpdateGadget : public GadgetT
         account(_account),
         storageRoot(_storageRoot)
     {
-      updateStorages.emplace_back(UpdateStorageGadget(
+      updateStorages.emplace_back(
           pb,
           storageRoot,
           tx.getArrayOutput(TXV_STORAGE_F_ADDRESS_ARRAY_0),
-          {account.storageArray[0].tokenSID, 
+          StorageState{account.storageArray[0].tokenSID, 
           account.storageArray[0].tokenBID, 
           account.storageArray[0].data, 
           account.storageArray[0].storageID, 
@@ -520,17 +559,16 @@ class BatchStorageFUpdateGadget : public GadgetT
           account.storageArray[0].cancelled, 
           account.storageArray[0].forward},
 
-          {tx.getOutput(TXV_STORAGE_F_TOKENSID_ARRAY_0), 
+          StorageState{tx.getOutput(TXV_STORAGE_F_TOKENSID_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_F_TOKENBID_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_F_DATA_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_F_STORAGEID_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_F_GASFEE_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_F_CANCELLED_ARRAY_0), 
           tx.getOutput(TXV_STORAGE_F_FORWARD_ARRAY_0)},
-          std::string("BatchStorageFUpdateGadget.updateStorages_0")
-        ));
+          FMT(prefix, ".updateStorages_0"));
     }
-    void generate_r1cs_witness(std::vector<StorageUpdate> storageUpdateArray) 
+    void generate_r1cs_witness(const std::vector<StorageUpdate> &storageUpdateArray) 
     {
       for (size_t i = 0; i < account.storageArray.size(); i++) 
       {
@@ -550,88 +588,122 @@ class BatchStorageFUpdateGadget : public GadgetT
     }
 };
 
+static const std::vector<TxVariable> PUBKEY_X_ARRAYS = {
+  TXV_PUBKEY_X_A_ARRAY,
+  TXV_PUBKEY_X_B_ARRAY,
+  TXV_PUBKEY_X_C_ARRAY,
+  TXV_PUBKEY_X_D_ARRAY,
+  TXV_PUBKEY_X_E_ARRAY,
+  TXV_PUBKEY_X_F_ARRAY};
+static const std::vector<TxVariable> PUBKEY_Y_ARRAYS = {
+  TXV_PUBKEY_Y_A_ARRAY,
+  TXV_PUBKEY_Y_B_ARRAY,
+  TXV_PUBKEY_Y_C_ARRAY,
+  TXV_PUBKEY_Y_D_ARRAY,
+  TXV_PUBKEY_Y_E_ARRAY,
+  TXV_PUBKEY_Y_F_ARRAY};
+static const std::vector<TxVariable> HASH_ARRAYS = {
+  TXV_HASH_A_ARRAY,
+  TXV_HASH_B_ARRAY,
+  TXV_HASH_C_ARRAY,
+  TXV_HASH_D_ARRAY,
+  TXV_HASH_E_ARRAY,
+  TXV_HASH_F_ARRAY};
+static const std::vector<TxVariable> SIGNATURE_REQUIRED_ARRAYS = {
+  TXV_SIGNATURE_REQUIRED_A_ARRAY,
+  TXV_SIGNATURE_REQUIRED_B_ARRAY,
+  TXV_SIGNATURE_REQUIRED_C_ARRAY,
+  TXV_SIGNATURE_REQUIRED_D_ARRAY,
+  TXV_SIGNATURE_REQUIRED_E_ARRAY,
+  TXV_SIGNATURE_REQUIRED_F_ARRAY};
+
 class TransactionGadget : public GadgetT
 {
   public:
     const Constants &constants;
 
+    // Transaction types that can be processed in this slot (see BlockLayout)
+    const unsigned int allowedTypes;
+    // Only transfers and trades update account B, only batch spot trades update the storage arrays
+    // and accounts C-F. The gadgets are not created when none of these types is allowed, the state
+    // is unchanged for all other transaction types.
+    const bool hasAccountB;
+    const bool hasBatch;
+    // Size of the signature verifier pool
+    const unsigned int numSignatures;
+    // The operator balances are updated by the block (see OperatorBalanceLookupGadget) instead of here
+    const bool deferOperatorFees;
+
     SelectorGadget selector;
 
     TransactionState state;
 
-    // Process transaction
+    // Process transaction, only the circuits of the allowed transaction types are created
     NoopCircuit noop;
-    SpotTradeCircuit spotTrade;
-    DepositCircuit deposit;
-    WithdrawCircuit withdraw;
-    AccountUpdateCircuit accountUpdate;
-    TransferCircuit transfer;
-    OrderCancelCircuit orderCancel;
-    AppKeyUpdateCircuit appKeyUpdate;
-    BatchSpotTradeCircuit batchSpotTrade;
+    std::unique_ptr<SpotTradeCircuit> spotTrade;
+    std::unique_ptr<DepositCircuit> deposit;
+    std::unique_ptr<WithdrawCircuit> withdraw;
+    std::unique_ptr<AccountUpdateCircuit> accountUpdate;
+    std::unique_ptr<TransferCircuit> transfer;
+    std::unique_ptr<OrderCancelCircuit> orderCancel;
+    std::unique_ptr<AppKeyUpdateCircuit> appKeyUpdate;
+    std::unique_ptr<BatchSpotTradeCircuit> batchSpotTrade;
 
     SelectTransactionGadget tx;
 
     // verify signatures
-    SignatureVerifier signatureVerifierA;
-    SignatureVerifier signatureVerifierB;
-    BatchSignatureVerifier batchSignatureVerifierA;
-    BatchSignatureVerifier batchSignatureVerifierB;
-    BatchSignatureVerifier batchSignatureVerifierC;
-    BatchSignatureVerifier batchSignatureVerifierD;
-    BatchSignatureVerifier batchSignatureVerifierE;
-    BatchSignatureVerifier batchSignatureVerifierF;
+    BatchSignatureVerifier signatureVerifierPool;
 
     // Update UserA
-    UpdateStorageGadget updateStorage_A;
-    BatchStorageAUpdateGadget updateStorage_A_batch;
+    std::unique_ptr<UpdateStorageGadget> updateStorage_A;
+    std::unique_ptr<BatchStorageAUpdateGadget> updateStorage_A_batch;
     UpdateBalanceGadget updateBalanceS_A;
     UpdateBalanceGadget updateBalanceB_A;
     UpdateBalanceGadget updateBalanceFee_A;
     UpdateAccountGadget updateAccount_A;
 
     // Update UserB
-    UpdateStorageGadget updateStorage_B;
-    BatchStorageBUpdateGadget updateStorage_B_batch;
-    UpdateBalanceGadget updateBalanceS_B;
-    UpdateBalanceGadget updateBalanceB_B;
-    UpdateBalanceGadget updateBalanceFee_B;
-    UpdateAccountGadget updateAccount_B;
+    std::unique_ptr<UpdateStorageGadget> updateStorage_B;
+    std::unique_ptr<BatchStorageBUpdateGadget> updateStorage_B_batch;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceS_B;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceB_B;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceFee_B;
+    std::unique_ptr<UpdateAccountGadget> updateAccount_B;
 
     // Update UserC
-    BatchStorageCUpdateGadget updateStorage_C_batch;
-    UpdateBalanceGadget updateBalanceS_C;
-    UpdateBalanceGadget updateBalanceB_C;
-    UpdateBalanceGadget updateBalanceFee_C;
-    UpdateAccountGadget updateAccount_C;
+    std::unique_ptr<BatchStorageCUpdateGadget> updateStorage_C_batch;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceS_C;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceB_C;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceFee_C;
+    std::unique_ptr<UpdateAccountGadget> updateAccount_C;
 
     // Update UserD
-    BatchStorageDUpdateGadget updateStorage_D_batch;
-    UpdateBalanceGadget updateBalanceS_D;
-    UpdateBalanceGadget updateBalanceB_D;
-    UpdateBalanceGadget updateBalanceFee_D;
-    UpdateAccountGadget updateAccount_D;
+    std::unique_ptr<BatchStorageDUpdateGadget> updateStorage_D_batch;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceS_D;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceB_D;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceFee_D;
+    std::unique_ptr<UpdateAccountGadget> updateAccount_D;
 
     // Update UserE
-    BatchStorageEUpdateGadget updateStorage_E_batch;
-    UpdateBalanceGadget updateBalanceS_E;
-    UpdateBalanceGadget updateBalanceB_E;
-    UpdateBalanceGadget updateBalanceFee_E;
-    UpdateAccountGadget updateAccount_E;
+    std::unique_ptr<BatchStorageEUpdateGadget> updateStorage_E_batch;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceS_E;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceB_E;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceFee_E;
+    std::unique_ptr<UpdateAccountGadget> updateAccount_E;
 
     // Update UserF
-    BatchStorageFUpdateGadget updateStorage_F_batch;
-    UpdateBalanceGadget updateBalanceS_F;
-    UpdateBalanceGadget updateBalanceB_F;
-    UpdateBalanceGadget updateBalanceFee_F;
-    UpdateAccountGadget updateAccount_F;
+    std::unique_ptr<BatchStorageFUpdateGadget> updateStorage_F_batch;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceS_F;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceB_F;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceFee_F;
+    std::unique_ptr<UpdateAccountGadget> updateAccount_F;
 
     // Update Operator
-    UpdateBalanceGadget updateBalanceD_O;
-    UpdateBalanceGadget updateBalanceC_O;
-    UpdateBalanceGadget updateBalanceB_O;
-    UpdateBalanceGadget updateBalanceA_O;
-    UpdateAccountGadget updateAccount_O;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceD_O;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceC_O;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceB_O;
+    std::unique_ptr<UpdateBalanceGadget> updateBalanceA_O;
+    std::unique_ptr<UpdateAccountGadget> updateAccount_O;
 
     TransactionGadget(
       ProtoboardT &pb,
@@ -645,10 +717,19 @@ class TransactionGadget : public GadgetT
       const VariableArrayT &operatorAccountID,
       const VariableT &numConditionalTransactionsBefore,
       const VariableT type,
+      unsigned int _allowedTypes,
+      bool _deferOperatorFees,
       const std::string &prefix)
         : GadgetT(pb, prefix),
 
           constants(_constants),
+          allowedTypes(_allowedTypes),
+          hasAccountB(
+            isAllowed(TransactionType::Transfer) || isAllowed(TransactionType::SpotTrade) ||
+            isAllowed(TransactionType::BatchSpotTrade)),
+          hasBatch(isAllowed(TransactionType::BatchSpotTrade)),
+          numSignatures(getMaxNumSignatures(_allowedTypes)),
+          deferOperatorFees(_deferOperatorFees),
 
           selector(pb, constants, type, (unsigned int)TransactionType::COUNT, FMT(prefix, ".selector")),
 
@@ -665,121 +746,62 @@ class TransactionGadget : public GadgetT
 
           // Process transaction
           noop(pb, state, FMT(prefix, ".noop")),
-          spotTrade(pb, state, FMT(prefix, ".spotTrade")),
-          deposit(pb, state, FMT(prefix, ".deposit")),
-          withdraw(pb, state, FMT(prefix, ".withdraw")),
-          accountUpdate(pb, state, FMT(prefix, ".accountUpdate")),
-          transfer(pb, state, FMT(prefix, ".transfer")),
-          orderCancel(pb, state, FMT(prefix, ".orderCancel")),
-          appKeyUpdate(pb, state, FMT(prefix, ".appKeyUpdate")),
-          batchSpotTrade(pb, state, FMT(prefix, ".batchSpotTrade")),
-
-          tx(
-            pb,
-            state,
-            selector.result(),
-            {&noop, &transfer, &spotTrade, &orderCancel, &appKeyUpdate, &batchSpotTrade, 
-            &deposit, &accountUpdate, &withdraw},
-            FMT(prefix, ".tx")),
+          spotTrade(createIfAllowed<SpotTradeCircuit>(TransactionType::SpotTrade, FMT(prefix, ".spotTrade"))),
+          deposit(createIfAllowed<DepositCircuit>(TransactionType::Deposit, FMT(prefix, ".deposit"))),
+          withdraw(createIfAllowed<WithdrawCircuit>(TransactionType::Withdrawal, FMT(prefix, ".withdraw"))),
+          accountUpdate(
+            createIfAllowed<AccountUpdateCircuit>(TransactionType::AccountUpdate, FMT(prefix, ".accountUpdate"))),
+          transfer(createIfAllowed<TransferCircuit>(TransactionType::Transfer, FMT(prefix, ".transfer"))),
+          orderCancel(createIfAllowed<OrderCancelCircuit>(TransactionType::OrderCancel, FMT(prefix, ".orderCancel"))),
+          appKeyUpdate(
+            createIfAllowed<AppKeyUpdateCircuit>(TransactionType::AppKeyUpdate, FMT(prefix, ".appKeyUpdate"))),
+          batchSpotTrade(
+            createIfAllowed<BatchSpotTradeCircuit>(TransactionType::BatchSpotTrade, FMT(prefix, ".batchSpotTrade"))),
+
+          tx(pb, state, selector.result(), getTransactionCircuits(), FMT(prefix, ".tx")),
 
           // Check signatures
-          signatureVerifierA(
-            pb,
-            params,
-            state.constants,
-            jubjub::VariablePointT(tx.getOutput(TXV_PUBKEY_X_A), tx.getOutput(TXV_PUBKEY_Y_A)),
-            tx.getOutput(TXV_HASH_A),
-            tx.getOutput(TXV_SIGNATURE_REQUIRED_A),
-            FMT(prefix, ".signatureVerifierA")),
-          signatureVerifierB(
-            pb,
-            params,
-            state.constants,
-            jubjub::VariablePointT(tx.getOutput(TXV_PUBKEY_X_B), tx.getOutput(TXV_PUBKEY_Y_B)),
-            tx.getOutput(TXV_HASH_B),
-            tx.getOutput(TXV_SIGNATURE_REQUIRED_B),
-            FMT(prefix, ".signatureVerifierB")),
-          batchSignatureVerifierA(
-            pb,
-            params,
-            state.constants,
-            tx.getArrayOutput(TXV_PUBKEY_X_A_ARRAY),
-            tx.getArrayOutput(TXV_PUBKEY_Y_A_ARRAY),
-            tx.getArrayOutput(TXV_HASH_A_ARRAY),
-            tx.getArrayOutput(TXV_SIGNATURE_REQUIRED_A_ARRAY),
-            FMT(prefix, ".batchSignatureVerifierA")),
-          batchSignatureVerifierB(
-            pb,
-            params,
-            state.constants,
-            tx.getArrayOutput(TXV_PUBKEY_X_B_ARRAY),
-            tx.getArrayOutput(TXV_PUBKEY_Y_B_ARRAY),
-            tx.getArrayOutput(TXV_HASH_B_ARRAY),
-            tx.getArrayOutput(TXV_SIGNATURE_REQUIRED_B_ARRAY),
-            FMT(prefix, ".batchSignatureVerifierB")),
-          batchSignatureVerifierC(
-            pb,
-            params,
-            state.constants,
-            tx.getArrayOutput(TXV_PUBKEY_X_C_ARRAY),
-            tx.getArrayOutput(TXV_PUBKEY_Y_C_ARRAY),
-            tx.getArrayOutput(TXV_HASH_C_ARRAY),
-            tx.getArrayOutput(TXV_SIGNATURE_REQUIRED_C_ARRAY),
-            FMT(prefix, ".batchSignatureVerifierC")),
-          batchSignatureVerifierD(
-            pb,
-            params,
-            state.constants,
-            tx.getArrayOutput(TXV_PUBKEY_X_D_ARRAY),
-            tx.getArrayOutput(TXV_PUBKEY_Y_D_ARRAY),
-            tx.getArrayOutput(TXV_HASH_D_ARRAY),
-            tx.getArrayOutput(TXV_SIGNATURE_REQUIRED_D_ARRAY),
-            FMT(prefix, ".batchSignatureVerifierD")),
-          batchSignatureVerifierE(
-            pb,
-            params,
-            state.constants,
-            tx.getArrayOutput(TXV_PUBKEY_X_E_ARRAY),
-            tx.getArrayOutput(TXV_PUBKEY_Y_E_ARRAY),
-            tx.getArrayOutput(TXV_HASH_E_ARRAY),
-            tx.getArrayOutput(TXV_SIGNATURE_REQUIRED_E_ARRAY),
-            FMT(prefix, ".batchSignatureVerifierE")),
-          batchSignatureVerifierF(
+          signatureVerifierPool(
             pb,
             params,
             state.constants,
-            tx.getArrayOutput(TXV_PUBKEY_X_F_ARRAY),
-            tx.getArrayOutput(TXV_PUBKEY_Y_F_ARRAY),
-            tx.getArrayOutput(TXV_HASH_F_ARRAY),
-            tx.getArrayOutput(TXV_SIGNATURE_REQUIRED_F_ARRAY),
-            FMT(prefix, ".batchSignatureVerifierF")),
+            getSignatureInputs(TXV_PUBKEY_X_A, TXV_PUBKEY_X_B, PUBKEY_X_ARRAYS),
+            getSignatureInputs(TXV_PUBKEY_Y_A, TXV_PUBKEY_Y_B, PUBKEY_Y_ARRAYS),
+            getSignatureInputs(TXV_HASH_A, TXV_HASH_B, HASH_ARRAYS),
+            getSignatureInputs(TXV_SIGNATURE_REQUIRED_A, TXV_SIGNATURE_REQUIRED_B, SIGNATURE_REQUIRED_ARRAYS),
+            FMT(prefix, ".signatureVerifierPool")),
 
           // Update UserA
+          // The batch gadget also updates the storage slot of the order itself
           updateStorage_A(
-            pb,
-            state.accountA.account.storageRoot,
-            tx.getArrayOutput(TXV_STORAGE_A_ADDRESS),
-            {state.accountA.storage.tokenSID, 
-            state.accountA.storage.tokenBID, 
-            state.accountA.storage.data, 
-            state.accountA.storage.storageID, 
-            state.accountA.storage.gasFee, 
-            state.accountA.storage.cancelled, 
-            state.accountA.storage.forward},
-            {tx.getOutput(TXV_STORAGE_A_TOKENSID), 
-            tx.getOutput(TXV_STORAGE_A_TOKENBID), 
-            tx.getOutput(TXV_STORAGE_A_DATA), 
-            tx.getOutput(TXV_STORAGE_A_STORAGEID), 
-            tx.getOutput(TXV_STORAGE_A_GASFEE), 
-            tx.getOutput(TXV_STORAGE_A_CANCELLED), 
-            tx.getOutput(TXV_STORAGE_A_FORWARD)},
-            FMT(prefix, ".updateStorage_A")),
+            !hasBatch ? new UpdateStorageGadget(
+                pb,
+                state.accountA.account.storageRoot,
+                tx.getArrayOutput(TXV_STORAGE_A_ADDRESS),
+                {state.accountA.storage.tokenSID, 
+                state.accountA.storage.tokenBID, 
+                state.accountA.storage.data, 
+                state.accountA.storage.storageID, 
+                state.accountA.storage.gasFee, 
+                state.accountA.storage.cancelled, 
+                state.accountA.storage.forward},
+                {tx.getOutput(TXV_STORAGE_A_TOKENSID), 
+                tx.getOutput(TXV_STORAGE_A_TOKENBID), 
+                tx.getOutput(TXV_STORAGE_A_DATA), 
+                tx.getOutput(TXV_STORAGE_A_STORAGEID), 
+                tx.getOutput(TXV_STORAGE_A_GASFEE), 
+                tx.getOutput(TXV_STORAGE_A_CANCELLED), 
+                tx.getOutput(TXV_STORAGE_A_FORWARD)},
+                FMT(prefix, ".updateStorage_A"))
+                      : nullptr),
           updateStorage_A_batch(
-            pb, 
-            tx, 
-            state.accountA, 
-            updateStorage_A.result(), 
-            FMT(prefix, ".updateStorage_A_batch")),
+            hasBatch ? new BatchStorageAUpdateGadget(
+                         pb,
+                         tx,
+                         state.accountA,
+                         state.accountA.account.storageRoot,
+                         FMT(prefix, ".updateStorage_A_batch"))
+                     : nullptr),
           updateBalanceS_A(
             pb,
             state.accountA.account.balancesRoot,
@@ -827,374 +849,558 @@ class TransactionGadget : public GadgetT
              tx.getOutput(TXV_ACCOUNT_A_DISABLE_APPKEY_WITHDRAW_TO_OTHER),
              tx.getOutput(TXV_ACCOUNT_A_DISABLE_APPKEY_TRANSFER_TO_OTHER),
              updateBalanceFee_A.result(),
-             updateStorage_A_batch.getHashRoot()},
+             hasBatch ? updateStorage_A_batch->getHashRoot() : updateStorage_A->result()},
             FMT(prefix, ".updateAccount_A")),
 
           // Update UserB
           updateStorage_B(
-            pb,
-            state.accountB.account.storageRoot,
-            tx.getArrayOutput(TXV_STORAGE_B_ADDRESS),
-            {state.accountB.storage.tokenSID, 
-            state.accountB.storage.tokenBID, 
-            state.accountB.storage.data, 
-            state.accountB.storage.storageID, 
-            state.accountB.storage.gasFee, 
-            state.accountB.storage.cancelled, 
-            state.accountB.storage.forward},
-            {tx.getOutput(TXV_STORAGE_B_TOKENSID), 
-            tx.getOutput(TXV_STORAGE_B_TOKENBID), 
-            tx.getOutput(TXV_STORAGE_B_DATA), 
-            tx.getOutput(TXV_STORAGE_B_STORAGEID), 
-            tx.getOutput(TXV_STORAGE_B_GASFEE), 
-            tx.getOutput(TXV_STORAGE_B_CANCELLED), 
-            tx.getOutput(TXV_STORAGE_B_FORWARD)},
-            FMT(prefix, ".updateStorage_B")),
+            (hasAccountB && !hasBatch) ? new UpdateStorageGadget(
+                pb,
+                state.accountB.account.storageRoot,
+                tx.getArrayOutput(TXV_STORAGE_B_ADDRESS),
+                {state.accountB.storage.tokenSID, 
+                state.accountB.storage.tokenBID, 
+                state.accountB.storage.data, 
+                state.accountB.storage.storageID, 
+                state.accountB.storage.gasFee, 
+                state.accountB.storage.cancelled, 
+                state.accountB.storage.forward},
+                {tx.getOutput(TXV_STORAGE_B_TOKENSID), 
+                tx.getOutput(TXV_STORAGE_B_TOKENBID), 
+                tx.getOutput(TXV_STORAGE_B_DATA), 
+                tx.getOutput(TXV_STORAGE_B_STORAGEID), 
+                tx.getOutput(TXV_STORAGE_B_GASFEE), 
+                tx.getOutput(TXV_STORAGE_B_CANCELLED), 
+                tx.getOutput(TXV_STORAGE_B_FORWARD)},
+                FMT(prefix, ".updateStorage_B"))
+                        : nullptr),
           updateStorage_B_batch(
-            pb, 
-            tx, 
-            state.accountB, 
-            updateStorage_B.result(), 
-            FMT(prefix, ".updateStorage_B_batch")),
+            hasBatch ? new BatchStorageBUpdateGadget(
+                pb, 
+                tx, 
+                state.accountB, 
+                state.accountB.account.storageRoot, 
+                FMT(prefix, ".updateStorage_B_batch"))
+                        : nullptr),
           updateBalanceS_B(
-            pb,
-            state.accountB.account.balancesRoot,
-            tx.getArrayOutput(TXV_BALANCE_B_S_ADDRESS),
-            {state.accountB.balanceS.balance},
-            {tx.getOutput(TXV_BALANCE_B_S_BALANCE)},
-            FMT(prefix, ".updateBalanceS_B")),
+            hasAccountB ? new UpdateBalanceGadget(
+                pb,
+                state.accountB.account.balancesRoot,
+                tx.getArrayOutput(TXV_BALANCE_B_S_ADDRESS),
+                {state.accountB.balanceS.balance},
+                {tx.getOutput(TXV_BALANCE_B_S_BALANCE)},
+                FMT(prefix, ".updateBalanceS_B"))
+                        : nullptr),
           updateBalanceB_B(
-            pb,
-            updateBalanceS_B.result(),
-            tx.getArrayOutput(TXV_BALANCE_B_B_ADDRESS),
-            {state.accountB.balanceB.balance},
-            {tx.getOutput(TXV_BALANCE_B_B_BALANCE)},
-            FMT(prefix, ".updateBalanceB_B")),
+            hasAccountB ? new UpdateBalanceGadget(
+                pb,
+                updateBalanceS_B->result(),
+                tx.getArrayOutput(TXV_BALANCE_B_B_ADDRESS),
+                {state.accountB.balanceB.balance},
+                {tx.getOutput(TXV_BALANCE_B_B_BALANCE)},
+                FMT(prefix, ".updateBalanceB_B"))
+                        : nullptr),
           updateBalanceFee_B(
-            pb,
-            updateBalanceB_B.result(),
-            tx.getArrayOutput(TXV_BALANCE_B_FEE_Address),
-            {state.accountB.balanceFee.balance},
-            {tx.getOutput(TXV_BALANCE_B_FEE_BALANCE)},
-            FMT(prefix, ".updateBalanceFee_B")),
+            hasAccountB ? new UpdateBalanceGadget(
+                pb,
+                updateBalanceB_B->result(),
+                tx.getArrayOutput(TXV_BALANCE_B_FEE_Address),
+                {state.accountB.balanceFee.balance},
+                {tx.getOutput(TXV_BALANCE_B_FEE_BALANCE)},
+                FMT(prefix, ".updateBalanceFee_B"))
+                        : nullptr),
           updateAccount_B(
-            pb,
-            updateAccount_A.result(),
-            updateAccount_A.assetResult(),
-            tx.getArrayOutput(TXV_ACCOUNT_B_ADDRESS),
-            {state.accountB.account.owner,
-             state.accountB.account.publicKey.x,
-             state.accountB.account.publicKey.y,
-             state.accountB.account.appKeyPublicKey.x,
-             state.accountB.account.appKeyPublicKey.y,
-             state.accountB.account.nonce,
-             state.accountB.account.disableAppKeySpotTrade,
-             state.accountB.account.disableAppKeyWithdraw,
-             state.accountB.account.disableAppKeyTransferToOther,
-             state.accountB.account.balancesRoot,
-             state.accountB.account.storageRoot},
-            {tx.getOutput(TXV_ACCOUNT_B_OWNER),
-             tx.getOutput(TXV_ACCOUNT_B_PUBKEY_X),
-             tx.getOutput(TXV_ACCOUNT_B_PUBKEY_Y),
-             state.accountB.account.appKeyPublicKey.x,
-             state.accountB.account.appKeyPublicKey.y,
-             tx.getOutput(TXV_ACCOUNT_B_NONCE),
-             state.accountB.account.disableAppKeySpotTrade,
-             state.accountB.account.disableAppKeyWithdraw,
-             state.accountB.account.disableAppKeyTransferToOther,
-             updateBalanceFee_B.result(),
-             updateStorage_B_batch.getHashRoot()},
-            FMT(prefix, ".updateAccount_B")),
+            hasAccountB ? new UpdateAccountGadget(
+                pb,
+                updateAccount_A.result(),
+                updateAccount_A.assetResult(),
+                tx.getArrayOutput(TXV_ACCOUNT_B_ADDRESS),
+                {state.accountB.account.owner,
+                 state.accountB.account.publicKey.x,
+                 state.accountB.account.publicKey.y,
+                 state.accountB.account.appKeyPublicKey.x,
+                 state.accountB.account.appKeyPublicKey.y,
+                 state.accountB.account.nonce,
+                 state.accountB.account.disableAppKeySpotTrade,
+                 state.accountB.account.disableAppKeyWithdraw,
+                 state.accountB.account.disableAppKeyTransferToOther,
+                 state.accountB.account.balancesRoot,
+                 state.accountB.account.storageRoot},
+                {tx.getOutput(TXV_ACCOUNT_B_OWNER),
+                 tx.getOutput(TXV_ACCOUNT_B_PUBKEY_X),
+                 tx.getOutput(TXV_ACCOUNT_B_PUBKEY_Y),
+                 state.accountB.account.appKeyPublicKey.x,
+                 state.accountB.account.appKeyPublicKey.y,
+                 tx.getOutput(TXV_ACCOUNT_B_NONCE),
+                 state.accountB.account.disableAppKeySpotTrade,
+                 state.accountB.account.disableAppKeyWithdraw,
+                 state.accountB.account.disableAppKeyTransferToOther,
+                 updateBalanceFee_B->result(),
+                 hasBatch ? updateStorage_B_batch->getHashRoot() : updateStorage_B->result()},
+                FMT(prefix, ".updateAccount_B"))
+                        : nullptr),
           // Update UserC
           updateStorage_C_batch(
-            pb, 
-            tx, 
-            state.accountC, 
-            state.accountC.account.storageRoot, 
-            FMT(prefix, ".updateStorage_C_batch")),
+            hasBatch ? new BatchStorageCUpdateGadget(
+                pb, 
+                tx, 
+                state.accountC, 
+                state.accountC.account.storageRoot, 
+                FMT(prefix, ".updateStorage_C_batch"))
+                     : nullptr),
           updateBalanceS_C(
-            pb,
-            state.accountC.account.balancesRoot,
-            tx.getArrayOutput(TXV_BALANCE_C_S_ADDRESS),
-            {state.accountC.balanceS.balance},
-            {tx.getOutput(TXV_BALANCE_C_S_BALANCE)},
-            FMT(prefix, ".updateBalanceS_C")),
+            hasBatch ? new UpdateBalanceGadget(
+                pb,
+                state.accountC.account.balancesRoot,
+                tx.getArrayOutput(TXV_BALANCE_C_S_ADDRESS),
+                {state.accountC.balanceS.balance},
+                {tx.getOutput(TXV_BALANCE_C_S_BALANCE)},
+                FMT(prefix, ".updateBalanceS_C"))
+                     : nullptr),
           updateBalanceB_C(
-            pb,
-            updateBalanceS_C.result(),
-            tx.getArrayOutput(TXV_BALANCE_C_B_ADDRESS),
-            {state.accountC.balanceB.balance},
-            {tx.getOutput(TXV_BALANCE_C_B_BALANCE)},
-            FMT(prefix, ".updateBalanceB_C")),
+            hasBatch ? new UpdateBalanceGadget(
+                pb,
+                updateBalanceS_C->result(),
+                tx.getArrayOutput(TXV_BALANCE_C_B_ADDRESS),
+                {state.accountC.balanceB.balance},
+                {tx.getOutput(TXV_BALANCE_C_B_BALANCE)},
+                FMT(prefix, ".updateBalanceB_C"))
+                     : nullptr),
           updateBalanceFee_C(
-            pb,
-            updateBalanceB_C.result(),
-            tx.getArrayOutput(TXV_BALANCE_C_FEE_Address),
-            {state.accountC.balanceFee.balance},
-            {tx.getOutput(TXV_BALANCE_C_FEE_BALANCE)},
-            FMT(prefix, ".updateBalanceFee_C")),
+            hasBatch ? new UpdateBalanceGadget(
+                pb,
+                updateBalanceB_C->result(),
+                tx.getArrayOutput(TXV_BALANCE_C_FEE_Address),
+                {state.accountC.balanceFee.balance},
+                {tx.getOutput(TXV_BALANCE_C_FEE_BALANCE)},
+                FMT(prefix, ".updateBalanceFee_C"))
+                     : nullptr),
           updateAccount_C(
-            pb,
-            updateAccount_B.result(),
-            updateAccount_B.assetResult(),
-            tx.getArrayOutput(TXV_ACCOUNT_C_ADDRESS),
-            {state.accountC.account.owner,
-             state.accountC.account.publicKey.x,
-             state.accountC.account.publicKey.y,
-             state.accountC.account.appKeyPublicKey.x,
-             state.accountC.account.appKeyPublicKey.y,
-             state.accountC.account.nonce,
-             state.accountC.account.disableAppKeySpotTrade,
-             state.accountC.account.disableAppKeyWithdraw,
-             state.accountC.account.disableAppKeyTransferToOther,
-             state.accountC.account.balancesRoot,
-             state.accountC.account.storageRoot},
-            {tx.getOutput(TXV_ACCOUNT_C_OWNER),
-             tx.getOutput(TXV_ACCOUNT_C_PUBKEY_X),
-             tx.getOutput(TXV_ACCOUNT_C_PUBKEY_Y),
-             state.accountC.account.appKeyPublicKey.x,
-             state.accountC.account.appKeyPublicKey.y,
-             tx.getOutput(TXV_ACCOUNT_C_NONCE),
-             state.accountC.account.disableAppKeySpotTrade,
-             state.accountC.account.disableAppKeyWithdraw,
-             state.accountC.account.disableAppKeyTransferToOther,
-             updateBalanceFee_C.result(),
-             updateStorage_C_batch.getHashRoot()},
-            FMT(prefix, ".updateAccount_C")),          
+            hasBatch ? new UpdateAccountGadget(
+                pb,
+                updateAccount_B->result(),
+                updateAccount_B->assetResult(),
+                tx.getArrayOutput(TXV_ACCOUNT_C_ADDRESS),
+                {state.accountC.account.owner,
+                 state.accountC.account.publicKey.x,
+                 state.accountC.account.publicKey.y,
+                 state.accountC.account.appKeyPublicKey.x,
+                 state.accountC.account.appKeyPublicKey.y,
+                 state.accountC.account.nonce,
+                 state.accountC.account.disableAppKeySpotTrade,
+                 state.accountC.account.disableAppKeyWithdraw,
+                 state.accountC.account.disableAppKeyTransferToOther,
+                 state.accountC.account.balancesRoot,
+                 state.accountC.account.storageRoot},
+                {tx.getOutput(TXV_ACCOUNT_C_OWNER),
+                 tx.getOutput(TXV_ACCOUNT_C_PUBKEY_X),
+                 tx.getOutput(TXV_ACCOUNT_C_PUBKEY_Y),
+                 state.accountC.account.appKeyPublicKey.x,
+                 state.accountC.account.appKeyPublicKey.y,
+                 tx.getOutput(TXV_ACCOUNT_C_NONCE),
+                 state.accountC.account.disableAppKeySpotTrade,
+                 state.accountC.account.disableAppKeyWithdraw,
+                 state.accountC.account.disableAppKeyTransferToOther,
+                 updateBalanceFee_C->result(),
+                 updateStorage_C_batch->getHashRoot()},
+                FMT(prefix, ".updateAccount_C"))
+                     : nullptr),
           // Update UserD
           updateStorage_D_batch(
-            pb, 
-            tx, 
-            state.accountD, 
-            state.accountD.account.storageRoot, 
-            FMT(prefix, ".updateStorage_D_batch")),
+            hasBatch ? new BatchStorageDUpdateGadget(
+                pb, 
+                tx, 
+                state.accountD, 
+                state.accountD.account.storageRoot, 
+                FMT(prefix, ".updateStorage_D_batch"))
+                     : nullptr),
           updateBalanceS_D(
-            pb,
-            state.accountD.account.balancesRoot,
-            tx.getArrayOutput(TXV_BALANCE_D_S_ADDRESS),
-            {state.accountD.balanceS.balance},
-            {tx.getOutput(TXV_BALANCE_D_S_BALANCE)},
-            FMT(prefix, ".updateBalanceS_D")),
+            hasBatch ? new UpdateBalanceGadget(
+                pb,
+                state.accountD.account.balancesRoot,
+                tx.getArrayOutput(TXV_BALANCE_D_S_ADDRESS),
+                {state.accountD.balanceS.balance},
+                {tx.getOutput(TXV_BALANCE_D_S_BALANCE)},
+                FMT(prefix, ".updateBalanceS_D"))
+                     : nullptr),
           updateBalanceB_D(
-            pb,
-            updateBalanceS_D.result(),
-            tx.getArrayOutput(TXV_BALANCE_D_B_ADDRESS),
-            {state.accountD.balanceB.balance},
-            {tx.getOutput(TXV_BALANCE_D_B_BALANCE)},
-            FMT(prefix, ".updateBalanceB_D")),
+            hasBatch ? new UpdateBalanceGadget(
+                pb,
+                updateBalanceS_D->result(),
+                tx.getArrayOutput(TXV_BALANCE_D_B_ADDRESS),
+                {state.accountD.balanceB.balance},
+                {tx.getOutput(TXV_BALANCE_D_B_BALANCE)},
+                FMT(prefix, ".updateBalanceB_D"))
+                     : nullptr),
           updateBalanceFee_D(
-            pb,
-            updateBalanceB_D.result(),
-            tx.getArrayOutput(TXV_BALANCE_D_FEE_Address),
-            {state.accountD.balanceFee.balance},
-            {tx.getOutput(TXV_BALANCE_D_FEE_BALANCE)},
-            FMT(prefix, ".updateBalanceFee_D")),
+            hasBatch ? new UpdateBalanceGadget(
+                pb,
+                updateBalanceB_D->result(),
+                tx.getArrayOutput(TXV_BALANCE_D_FEE_Address),
+                {state.accountD.balanceFee.balance},
+                {tx.getOutput(TXV_BALANCE_D_FEE_BALANCE)},
+                FMT(prefix, ".updateBalanceFee_D"))
+                     : nullptr),
           updateAccount_D(
-            pb,
-            updateAccount_C.result(),
-            updateAccount_C.assetResult(),
-            tx.getArrayOutput(TXV_ACCOUNT_D_ADDRESS),
-            {state.accountD.account.owner,
-             state.accountD.account.publicKey.x,
-             state.accountD.account.publicKey.y,
-             state.accountD.account.appKeyPublicKey.x,
-             state.accountD.account.appKeyPublicKey.y,
-             state.accountD.account.nonce,
-             state.accountD.account.disableAppKeySpotTrade,
-             state.accountD.account.disableAppKeyWithdraw,
-             state.accountD.account.disableAppKeyTransferToOther,
-             state.accountD.account.balancesRoot,
-             state.accountD.account.storageRoot},
-            {tx.getOutput(TXV_ACCOUNT_D_OWNER),
-             tx.getOutput(TXV_ACCOUNT_D_PUBKEY_X),
-             tx.getOutput(TXV_ACCOUNT_D_PUBKEY_Y),
-             state.accountD.account.appKeyPublicKey.x,
-             state.accountD.account.appKeyPublicKey.y,
-             tx.getOutput(TXV_ACCOUNT_D_NONCE),
-             state.accountD.account.disableAppKeySpotTrade,
-             state.accountD.account.disableAppKeyWithdraw,
-             state.accountD.account.disableAppKeyTransferToOther,
-             updateBalanceFee_D.result(),
-             updateStorage_D_batch.getHashRoot()},
-            FMT(prefix, ".updateAccount_D")),
+            hasBatch ? new UpdateAccountGadget(
+                pb,
+                updateAccount_C->result(),
+                updateAccount_C->assetResult(),
+                tx.getArrayOutput(TXV_ACCOUNT_D_ADDRESS),
+                {state.accountD.account.owner,
+                 state.accountD.account.publicKey.x,
+                 state.accountD.account.publicKey.y,
+                 state.accountD.account.appKeyPublicKey.x,
+                 state.accountD.account.appKeyPublicKey.y,
+                 state.accountD.account.nonce,
+                 state.accountD.account.disableAppKeySpotTrade,
+                 state.accountD.account.disableAppKeyWithdraw,
+                 state.accountD.account.disableAppKeyTransferToOther,
+                 state.accountD.account.balancesRoot,
+                 state.accountD.account.storageRoot},
+                {tx.getOutput(TXV_ACCOUNT_D_OWNER),
+                 tx.getOutput(TXV_ACCOUNT_D_PUBKEY_X),
+                 tx.getOutput(TXV_ACCOUNT_D_PUBKEY_Y),
+                 state.accountD.account.appKeyPublicKey.x,
+                 state.accountD.account.appKeyPublicKey.y,
+                 tx.getOutput(TXV_ACCOUNT_D_NONCE),
+                 state.accountD.account.disableAppKeySpotTrade,
+                 state.accountD.account.disableAppKeyWithdraw,
+                 state.accountD.account.disableAppKeyTransferToOther,
+                 updateBalanceFee_D->result(),
+                 updateStorage_D_batch->getHashRoot()},
+                FMT(prefix, ".updateAccount_D"))
+                     : nullptr),
           // Update UserE
           updateStorage_E_batch(
-            pb, 
-            tx, 
-            state.accountE, 
-            state.accountE.account.storageRoot, 
-            FMT(prefix, ".updateStorage_E_batch")),
+            hasBatch ? new BatchStorageEUpdateGadget(
+                pb, 
+                tx, 
+                state.accountE, 
+                state.accountE.account.storageRoot, 
+                FMT(prefix, ".updateStorage_E_batch"))
+                     : nullptr),
           updateBalanceS_E(
-            pb,
-            state.accountE.account.balancesRoot,
-            tx.getArrayOutput(TXV_BALANCE_E_S_ADDRESS),
-            {state.accountE.balanceS.balance},
-            {tx.getOutput(TXV_BALANCE_E_S_BALANCE)},
-            FMT(prefix, ".updateBalanceS_E")),
+            hasBatch ? new UpdateBalanceGadget(
+                pb,
+                state.accountE.account.balancesRoot,
+                tx.getArrayOutput(TXV_BALANCE_E_S_ADDRESS),
+                {state.accountE.balanceS.balance},
+                {tx.getOutput(TXV_BALANCE_E_S_BALANCE)},
+                FMT(prefix, ".updateBalanceS_E"))
+                     : nullptr),
           updateBalanceB_E(
-            pb,
-            updateBalanceS_E.result(),
-            tx.getArrayOutput(TXV_BALANCE_E_B_ADDRESS),
-            {state.accountE.balanceB.balance},
-            {tx.getOutput(TXV_BALANCE_E_B_BALANCE)},
-            FMT(prefix, ".updateBalanceB_E")),
+            hasBatch ? new UpdateBalanceGadget(
+                pb,
+                updateBalanceS_E->result(),
+                tx.getArrayOutput(TXV_BALANCE_E_B_ADDRESS),
+                {state.accountE.balanceB.balance},
+                {tx.getOutput(TXV_BALANCE_E_B_BALANCE)},
+                FMT(prefix, ".updateBalanceB_E"))
+                     : nullptr),
           updateBalanceFee_E(
-            pb,
-            updateBalanceB_E.result(),
-            tx.getArrayOutput(TXV_BALANCE_E_FEE_Address),
-            {state.accountE.balanceFee.balance},
-            {tx.getOutput(TXV_BALANCE_E_FEE_BALANCE)},
-            FMT(prefix, ".updateBalanceFee_E")),
+            hasBatch ? new UpdateBalanceGadget(
+                pb,
+                updateBalanceB_E->result(),
+                tx.getArrayOutput(TXV_BALANCE_E_FEE_Address),
+                {state.accountE.balanceFee.balance},
+                {tx.getOutput(TXV_BALANCE_E_FEE_BALANCE)},
+                FMT(prefix, ".updateBalanceFee_E"))
+                     : nullptr),
           updateAccount_E(
-            pb,
-            updateAccount_D.result(),
-            updateAccount_D.assetResult(),
-            tx.getArrayOutput(TXV_ACCOUNT_E_ADDRESS),
-            {state.accountE.account.owner,
-             state.accountE.account.publicKey.x,
-             state.accountE.account.publicKey.y,
-             state.accountE.account.appKeyPublicKey.x,
-             state.accountE.account.appKeyPublicKey.y,
-             state.accountE.account.nonce,
-             state.accountE.account.disableAppKeySpotTrade,
-             state.accountE.account.disableAppKeyWithdraw,
-             state.accountE.account.disableAppKeyTransferToOther,
-             state.accountE.account.balancesRoot,
-             state.accountE.account.storageRoot},
-            {tx.getOutput(TXV_ACCOUNT_E_OWNER),
-             tx.getOutput(TXV_ACCOUNT_E_PUBKEY_X),
-             tx.getOutput(TXV_ACCOUNT_E_PUBKEY_Y),
-             state.accountE.account.appKeyPublicKey.x,
-             state.accountE.account.appKeyPublicKey.y,
-             tx.getOutput(TXV_ACCOUNT_E_NONCE),
-             state.accountE.account.disableAppKeySpotTrade,
-             state.accountE.account.disableAppKeyWithdraw,
-             state.accountE.account.disableAppKeyTransferToOther,
-             updateBalanceFee_E.result(),
-             updateStorage_E_batch.getHashRoot()},
-            FMT(prefix, ".updateAccount_E")),   
+            hasBatch ? new UpdateAccountGadget(
+                pb,
+                updateAccount_D->result(),
+                updateAccount_D->assetResult(),
+                tx.getArrayOutput(TXV_ACCOUNT_E_ADDRESS),
+                {state.accountE.account.owner,
+                 state.accountE.account.publicKey.x,
+                 state.accountE.account.publicKey.y,
+                 state.accountE.account.appKeyPublicKey.x,
+                 state.accountE.account.appKeyPublicKey.y,
+                 state.accountE.account.nonce,
+                 state.accountE.account.disableAppKeySpotTrade,
+                 state.accountE.account.disableAppKeyWithdraw,
+                 state.accountE.account.disableAppKeyTransferToOther,
+                 state.accountE.account.balancesRoot,
+                 state.accountE.account.storageRoot},
+                {tx.getOutput(TXV_ACCOUNT_E_OWNER),
+                 tx.getOutput(TXV_ACCOUNT_E_PUBKEY_X),
+                 tx.getOutput(TXV_ACCOUNT_E_PUBKEY_Y),
+                 state.accountE.account.appKeyPublicKey.x,
+                 state.accountE.account.appKeyPublicKey.y,
+                 tx.getOutput(TXV_ACCOUNT_E_NONCE),
+                 state.accountE.account.disableAppKeySpotTrade,
+                 state.accountE.account.disableAppKeyWithdraw,
+                 state.accountE.account.disableAppKeyTransferToOther,
+                 updateBalanceFee_E->result(),
+                 updateStorage_E_batch->getHashRoot()},
+                FMT(prefix, ".updateAccount_E"))
+                     : nullptr),
 
           // Update UserF
           updateStorage_F_batch(
-            pb, 
-            tx, 
-            state.accountF, 
-            state.accountF.account.storageRoot, 
-            FMT(prefix, ".updateStorage_F_batch")),
+            hasBatch ? new BatchStorageFUpdateGadget(
+                pb, 
+                tx, 
+                state.accountF, 
+                state.accountF.account.storageRoot, 
+                FMT(prefix, ".updateStorage_F_batch"))
+                     : nullptr),
           updateBalanceS_F(
-            pb,
-            state.accountF.account.balancesRoot,
-            tx.getArrayOutput(TXV_BALANCE_F_S_ADDRESS),
-            {state.accountF.balanceS.balance},
-            {tx.getOutput(TXV_BALANCE_F_S_BALANCE)},
-            FMT(prefix, ".updateBalanceS_F")),
+            hasBatch ? new UpdateBalanceGadget(
+                pb,
+                state.accountF.account.balancesRoot,
+                tx.getArrayOutput(TXV_BALANCE_F_S_ADDRESS),
+                {state.accountF.balanceS.balance},
+                {tx.getOutput(TXV_BALANCE_F_S_BALANCE)},
+                FMT(prefix, ".updateBalanceS_F"))
+                     : nullptr),
           updateBalanceB_F(
-            pb,
-            updateBalanceS_F.result(),
-            tx.getArrayOutput(TXV_BALANCE_F_B_ADDRESS),
-            {state.accountF.balanceB.balance},
-            {tx.getOutput(TXV_BALANCE_F_B_BALANCE)},
-            FMT(prefix, ".updateBalanceB_F")),
+            hasBatch ? new UpdateBalanceGadget(
+                pb,
+                updateBalanceS_F->result(),
+                tx.getArrayOutput(TXV_BALANCE_F_B_ADDRESS),
+                {state.accountF.balanceB.balance},
+                {tx.getOutput(TXV_BALANCE_F_B_BALANCE)},
+                FMT(prefix, ".updateBalanceB_F"))
+                     : nullptr),
           updateBalanceFee_F(
-            pb,
-            updateBalanceB_F.result(),
-            tx.getArrayOutput(TXV_BALANCE_F_FEE_Address),
-            {state.accountF.balanceFee.balance},
-            {tx.getOutput(TXV_BALANCE_F_FEE_BALANCE)},
-            FMT(prefix, ".updateBalanceFee_F")),
+            hasBatch ? new UpdateBalanceGadget(
+                pb,
+                updateBalanceB_F->result(),
+                tx.getArrayOutput(TXV_BALANCE_F_FEE_Address),
+                {state.accountF.balanceFee.balance},
+                {tx.getOutput(TXV_BALANCE_F_FEE_BALANCE)},
+                FMT(prefix, ".updateBalanceFee_F"))
+                     : nullptr),
           updateAccount_F(
-            pb,
-            updateAccount_E.result(),
-            updateAccount_E.assetResult(),
-            tx.getArrayOutput(TXV_ACCOUNT_F_ADDRESS),
-            {state.accountF.account.owner,
-             state.accountF.account.publicKey.x,
-             state.accountF.account.publicKey.y,
-             state.accountF.account.appKeyPublicKey.x,
-             state.accountF.account.appKeyPublicKey.y,
-             state.accountF.account.nonce,
-             state.accountF.account.disableAppKeySpotTrade,
-             state.accountF.account.disableAppKeyWithdraw,
-             state.accountF.account.disableAppKeyTransferToOther,
-             state.accountF.account.balancesRoot,
-             state.accountF.account.storageRoot},
-            {tx.getOutput(TXV_ACCOUNT_F_OWNER),
-             tx.getOutput(TXV_ACCOUNT_F_PUBKEY_X),
-             tx.getOutput(TXV_ACCOUNT_F_PUBKEY_Y),
-             state.accountF.account.appKeyPublicKey.x,
-             state.accountF.account.appKeyPublicKey.y,
-             tx.getOutput(TXV_ACCOUNT_F_NONCE),
-             state.accountF.account.disableAppKeySpotTrade,
-             state.accountF.account.disableAppKeyWithdraw,
-             state.accountF.account.disableAppKeyTransferToOther,
-             updateBalanceFee_F.result(),
-             updateStorage_F_batch.getHashRoot()},
-            FMT(prefix, ".updateAccount_F")),   
+            hasBatch ? new UpdateAccountGadget(
+                pb,
+                updateAccount_E->result(),
+                updateAccount_E->assetResult(),
+                tx.getArrayOutput(TXV_ACCOUNT_F_ADDRESS),
+                {state.accountF.account.owner,
+                 state.accountF.account.publicKey.x,
+                 state.accountF.account.publicKey.y,
+                 state.accountF.account.appKeyPublicKey.x,
+                 state.accountF.account.appKeyPublicKey.y,
+                 state.accountF.account.nonce,
+                 state.accountF.account.disableAppKeySpotTrade,
+                 state.accountF.account.disableAppKeyWithdraw,
+                 state.accountF.account.disableAppKeyTransferToOther,
+                 state.accountF.account.balancesRoot,
+                 state.accountF.account.storageRoot},
+                {tx.getOutput(TXV_ACCOUNT_F_OWNER),
+                 tx.getOutput(TXV_ACCOUNT_F_PUBKEY_X),
+                 tx.getOutput(TXV_ACCOUNT_F_PUBKEY_Y),
+                 state.accountF.account.appKeyPublicKey.x,
+                 state.accountF.account.appKeyPublicKey.y,
+                 tx.getOutput(TXV_ACCOUNT_F_NONCE),
+                 state.accountF.account.disableAppKeySpotTrade,
+                 state.accountF.account.disableAppKeyWithdraw,
+                 state.accountF.account.disableAppKeyTransferToOther,
+                 updateBalanceFee_F->result(),
+                 updateStorage_F_batch->getHashRoot()},
+                FMT(prefix, ".updateAccount_F"))
+                     : nullptr),
 
           // Update Operator
           updateBalanceD_O(
-            pb,
-            state.oper.account.balancesRoot,
-            tx.getArrayOutput(TXV_BALANCE_O_D_Address),
-            {state.oper.balanceD.balance},
-            {tx.getOutput(TXV_BALANCE_O_D_BALANCE)},
-            FMT(prefix, ".updateBalanceD_O")),
+            !deferOperatorFees ? new UpdateBalanceGadget(
+                pb,
+                state.oper.account.balancesRoot,
+                tx.getArrayOutput(TXV_BALANCE_O_D_Address),
+                {state.oper.balanceD.balance},
+                {tx.getOutput(TXV_BALANCE_O_D_BALANCE)},
+                FMT(prefix, ".updateBalanceD_O"))
+                               : nullptr),
           updateBalanceC_O(
-            pb,
-            updateBalanceD_O.result(),
-            tx.getArrayOutput(TXV_BALANCE_O_C_Address),
-            {state.oper.balanceC.balance},
-            {tx.getOutput(TXV_BALANCE_O_C_BALANCE)},
-            FMT(prefix, ".updateBalanceC_O")),
+            !deferOperatorFees ? new UpdateBalanceGadget(
+                pb,
+                updateBalanceD_O->result(),
+                tx.getArrayOutput(TXV_BALANCE_O_C_Address),
+                {state.oper.balanceC.balance},
+                {tx.getOutput(TXV_BALANCE_O_C_BALANCE)},
+                FMT(prefix, ".updateBalanceC_O"))
+                               : nullptr),
           updateBalanceB_O(
-            pb,
-            updateBalanceC_O.result(),
-            tx.getArrayOutput(TXV_BALANCE_O_B_Address),
-            {state.oper.balanceB.balance},
-            {tx.getOutput(TXV_BALANCE_O_B_BALANCE)},
-            FMT(prefix, ".updateBalanceB_O")),
+            !deferOperatorFees ? new UpdateBalanceGadget(
+                pb,
+                updateBalanceC_O->result(),
+                tx.getArrayOutput(TXV_BALANCE_O_B_Address),
+                {state.oper.balanceB.balance},
+                {tx.getOutput(TXV_BALANCE_O_B_BALANCE)},
+                FMT(prefix, ".updateBalanceB_O"))
+                               : nullptr),
           updateBalanceA_O(
-            pb,
-            updateBalanceB_O.result(),
-            tx.getArrayOutput(TXV_BALANCE_O_A_Address),
-            {state.oper.balanceA.balance},
-            {tx.getOutput(TXV_BALANCE_O_A_BALANCE)},
-            FMT(prefix, ".updateBalanceA_O")),
+            !deferOperatorFees ? new UpdateBalanceGadget(
+                pb,
+                updateBalanceB_O->result(),
+                tx.getArrayOutput(TXV_BALANCE_O_A_Address),
+                {state.oper.balanceA.balance},
+                {tx.getOutput(TXV_BALANCE_O_A_BALANCE)},
+                FMT(prefix, ".updateBalanceA_O"))
+                               : nullptr),
           updateAccount_O(
-            pb,
-            updateAccount_F.result(),
-            updateAccount_F.assetResult(),
-            operatorAccountID,
-            {state.oper.account.owner,
-             state.oper.account.publicKey.x,
-             state.oper.account.publicKey.y,
-             state.oper.account.appKeyPublicKey.x,
-             state.oper.account.appKeyPublicKey.y,
-             state.oper.account.nonce,
-             state.oper.account.disableAppKeySpotTrade,
-             state.oper.account.disableAppKeyWithdraw,
-             state.oper.account.disableAppKeyTransferToOther,
-             state.oper.account.balancesRoot,
-             state.oper.account.storageRoot},
-            {state.oper.account.owner,
-             state.oper.account.publicKey.x,
-             state.oper.account.publicKey.y,
-             state.oper.account.appKeyPublicKey.x,
-             state.oper.account.appKeyPublicKey.y,
-             state.oper.account.nonce,
-             state.oper.account.disableAppKeySpotTrade,
-             state.oper.account.disableAppKeyWithdraw,
-             state.oper.account.disableAppKeyTransferToOther,
-             updateBalanceA_O.result(),
-             state.oper.account.storageRoot},
-            FMT(prefix, ".updateAccount_O"))
+            !deferOperatorFees ? new UpdateAccountGadget(
+                pb,
+                getLastAccountUpdate().result(),
+                getLastAccountUpdate().assetResult(),
+                operatorAccountID,
+                {state.oper.account.owner,
+                 state.oper.account.publicKey.x,
+                 state.oper.account.publicKey.y,
+                 state.oper.account.appKeyPublicKey.x,
+                 state.oper.account.appKeyPublicKey.y,
+                 state.oper.account.nonce,
+                 state.oper.account.disableAppKeySpotTrade,
+                 state.oper.account.disableAppKeyWithdraw,
+                 state.oper.account.disableAppKeyTransferToOther,
+                 state.oper.account.balancesRoot,
+                 state.oper.account.storageRoot},
+                {state.oper.account.owner,
+                 state.oper.account.publicKey.x,
+                 state.oper.account.publicKey.y,
+                 state.oper.account.appKeyPublicKey.x,
+                 state.oper.account.appKeyPublicKey.y,
+                 state.oper.account.nonce,
+                 state.oper.account.disableAppKeySpotTrade,
+                 state.oper.account.disableAppKeyWithdraw,
+                 state.oper.account.disableAppKeyTransferToOther,
+                 updateBalanceA_O->result(),
+                 state.oper.account.storageRoot},
+                FMT(prefix, ".updateAccount_O"))
+                               : nullptr)
+
+    {
+        if (withdraw)
+        {
+            withdraw->createOnChainDataHash();
+        }
+    }
+
+    bool isAllowed(TransactionType type) const
+    {
+        return (allowedTypes & getTransactionTypeBit(type)) != 0;
+    }
 
+    template <typename CircuitT> CircuitT *createIfAllowed(TransactionType type, const std::string &name)
     {
-      
+        return isAllowed(type) ? new CircuitT(pb, state, name) : nullptr;
+    }
+
+    // Same order as TransactionType, the noop circuit takes the place of the types that are not allowed
+    // (their selector bits are constrained to 0)
+    std::vector<BaseTransactionCircuit *> getTransactionCircuits()
+    {
+        std::vector<BaseTransactionCircuit *> circuits = {
+          &noop,
+          transfer.get(),
+          spotTrade.get(),
+          orderCancel.get(),
+          appKeyUpdate.get(),
+          batchSpotTrade.get(),
+          deposit.get(),
+          accountUpdate.get(),
+          withdraw.get()};
+        for (unsigned int i = 0; i < circuits.size(); i++)
+        {
+            if (circuits[i] == nullptr)
+            {
+                circuits[i] = &noop;
+            }
+        }
+        return circuits;
+    }
+
+    // Signatures are verified in pool order: A, B, then the order arrays of the batch spot trade users A-F.
+    // Every transaction type puts its signatures in the first getNumSignatures(type) entries and never requires
+    // the entries after them, so the pool only needs to be as large as the maximum over the allowed types.
+    static unsigned int getNumSignatures(TransactionType type)
+    {
+        switch (type)
+        {
+            case TransactionType::Noop:
+            case TransactionType::Deposit:
+                return 0;
+            case TransactionType::AccountUpdate:
+            case TransactionType::AppKeyUpdate:
+            case TransactionType::OrderCancel:
+            case TransactionType::Withdrawal:
+                return 1;
+            case TransactionType::Transfer:
+            case TransactionType::SpotTrade:
+                return 2;
+            case TransactionType::BatchSpotTrade:
+                return ORDER_SIZE_USER_A + ORDER_SIZE_USER_B + ORDER_SIZE_USER_C + ORDER_SIZE_USER_D +
+                       ORDER_SIZE_USER_E + ORDER_SIZE_USER_F;
+            default:
+                return 0;
+        }
+    }
+
+    static unsigned int getMaxNumSignatures(unsigned int allowedTypes)
+    {
+        unsigned int maxNumSignatures = 0;
+        for (unsigned int i = 0; i < (unsigned int)TransactionType::COUNT; i++)
+        {
+            if (allowedTypes & getTransactionTypeBit(TransactionType(i)))
+            {
+                maxNumSignatures = std::max(maxNumSignatures, getNumSignatures(TransactionType(i)));
+            }
+        }
+        return maxNumSignatures;
+    }
+
+    VariableArrayT getSignatureInputs(TxVariable a, TxVariable b, const std::vector<TxVariable> &arrays) const
+    {
+        VariableArrayT inputs;
+        inputs.emplace_back(tx.getOutput(a));
+        inputs.emplace_back(tx.getOutput(b));
+        for (const TxVariable &array : arrays)
+        {
+            const VariableArrayT &values = tx.getArrayOutput(array);
+            inputs.insert(inputs.end(), values.begin(), values.end());
+        }
+        assert(inputs.size() >= numSignatures);
+        inputs.resize(numSignatures);
+        return inputs;
+    }
+
+    std::vector<Signature> getSignatures(const Witness &witness) const
+    {
+        const unsigned int arraySizes[BATCH_SPOT_TRADE_MAX_USER] = {
+          ORDER_SIZE_USER_A - 1,
+          ORDER_SIZE_USER_B - 1,
+          ORDER_SIZE_USER_C,
+          ORDER_SIZE_USER_D,
+          ORDER_SIZE_USER_E,
+          ORDER_SIZE_USER_F};
+        std::vector<Signature> signatures = {witness.signatureA, witness.signatureB};
+        for (unsigned int i = 0; i < BATCH_SPOT_TRADE_MAX_USER; i++)
+        {
+            for (unsigned int j = 0; j < arraySizes[i]; j++)
+            {
+                signatures.push_back(witness.signatureArray[i][j]);
+            }
+        }
+        signatures.resize(numSignatures);
+        return signatures;
+    }
+
+    const UpdateAccountGadget &getLastAccountUpdate() const
+    {
+        if (hasBatch)
+        {
+            return *updateAccount_F;
+        }
+        return hasAccountB ? *updateAccount_B : updateAccount_A;
     }
 
     void generate_r1cs_witness(const UniversalTransaction &uTx)
     {
+        ProfileWitness profile(annotation_prefix);
         selector.generate_r1cs_witness();
 
         state.generate_r1cs_witness(
@@ -1244,32 +1450,55 @@ class TransactionGadget : public GadgetT
           );
 
         noop.generate_r1cs_witness();
-        spotTrade.generate_r1cs_witness(uTx.spotTrade);
-        deposit.generate_r1cs_witness(uTx.deposit);
-        withdraw.generate_r1cs_witness(uTx.withdraw);
-        accountUpdate.generate_r1cs_witness(uTx.accountUpdate);
-        transfer.generate_r1cs_witness(uTx.transfer);
-        orderCancel.generate_r1cs_witness(uTx.orderCancel);
-        appKeyUpdate.generate_r1cs_witness(uTx.appKeyUpdate);
-        batchSpotTrade.generate_r1cs_witness(uTx.batchSpotTrade);
+        if (spotTrade)
+        {
+            spotTrade->generate_r1cs_witness(uTx.spotTrade);
+        }
+        if (deposit)
+        {
+            deposit->generate_r1cs_witness(uTx.deposit);
+        }
+        if (withdraw)
+        {
+            withdraw->generate_r1cs_witness(uTx.withdraw);
+        }
+        if (accountUpdate)
+        {
+            accountUpdate->generate_r1cs_witness(uTx.accountUpdate);
+        }
+        if (transfer)
+        {
+            transfer->generate_r1cs_witness(uTx.transfer);
+        }
+        if (orderCancel)
+        {
+            orderCancel->generate_r1cs_witness(uTx.orderCancel);
+        }
+        if (appKeyUpdate)
+        {
+            appKeyUpdate->generate_r1cs_witness(uTx.appKeyUpdate);
+        }
+        if (batchSpotTrade)
+        {
+            batchSpotTrade->generate_r1cs_witness(uTx.batchSpotTrade);
+        }
         tx.generate_r1cs_witness();
 
 
         // Check signatures
-        signatureVerifierA.generate_r1cs_witness(uTx.witness.signatureA);
-        signatureVerifierB.generate_r1cs_witness(uTx.witness.signatureB);
-
-        batchSignatureVerifierA.generate_r1cs_witness(uTx.witness.signatureArray[0]);
-        batchSignatureVerifierB.generate_r1cs_witness(uTx.witness.signatureArray[1]);
-        batchSignatureVerifierC.generate_r1cs_witness(uTx.witness.signatureArray[2]);
-        batchSignatureVerifierD.generate_r1cs_witness(uTx.witness.signatureArray[3]);
-        batchSignatureVerifierE.generate_r1cs_witness(uTx.witness.signatureArray[4]);
-        batchSignatureVerifierF.generate_r1cs_witness(uTx.witness.signatureArray[5]);
-        // Update UserA
-        updateStorage_A.generate_r1cs_witness(uTx.witness.storageUpdate_A);
+        signatureVerifierPool.generate_r1cs_witness(getSignatures(uTx.witness));
 
-        // batch spot trade Storage
-        updateStorage_A_batch.generate_r1cs_witness(uTx.witness.storageUpdate_A_array);
+        // Update UserA
+        if (hasBatch)
+        {
+            // batch spot trade Storage
+            updateStorage_A_batch->generate_r1cs_witness(
+              uTx.witness.storageUpdate_A, uTx.witness.storageUpdate_A_array);
+        }
+        else
+        {
+            updateStorage_A->generate_r1cs_witness(uTx.witness.storageUpdate_A);
+        }
 
         updateBalanceS_A.generate_r1cs_witness(uTx.witness.balanceUpdateS_A);
         updateBalanceB_A.generate_r1cs_witness(uTx.witness.balanceUpdateB_A);
@@ -1277,137 +1506,198 @@ class TransactionGadget : public GadgetT
         updateAccount_A.generate_r1cs_witness(uTx.witness.accountUpdate_A);
 
         // Update UserB
-        updateStorage_B.generate_r1cs_witness(uTx.witness.storageUpdate_B);
-
-        // batch spot trade Storage
-        updateStorage_B_batch.generate_r1cs_witness(uTx.witness.storageUpdate_B_array);
-        updateBalanceS_B.generate_r1cs_witness(uTx.witness.balanceUpdateS_B);
-        updateBalanceB_B.generate_r1cs_witness(uTx.witness.balanceUpdateB_B);
-        updateBalanceFee_B.generate_r1cs_witness(uTx.witness.balanceUpdateFee_B);
-        updateAccount_B.generate_r1cs_witness(uTx.witness.accountUpdate_B);
-
-        // Update UserC
-        // batch spot trade Storage
-        updateStorage_C_batch.generate_r1cs_witness(uTx.witness.storageUpdate_C_array);
-
-        updateBalanceS_C.generate_r1cs_witness(uTx.witness.balanceUpdateS_C);
-        updateBalanceB_C.generate_r1cs_witness(uTx.witness.balanceUpdateB_C);
-        updateBalanceFee_C.generate_r1cs_witness(uTx.witness.balanceUpdateFee_C);
-        updateAccount_C.generate_r1cs_witness(uTx.witness.accountUpdate_C);
-
-        // Update UserD
-        // batch spot trade Storage
-        updateStorage_D_batch.generate_r1cs_witness(uTx.witness.storageUpdate_D_array);
-
-        updateBalanceS_D.generate_r1cs_witness(uTx.witness.balanceUpdateS_D);
-        updateBalanceB_D.generate_r1cs_witness(uTx.witness.balanceUpdateB_D);
-        updateBalanceFee_D.generate_r1cs_witness(uTx.witness.balanceUpdateFee_D);
-        updateAccount_D.generate_r1cs_witness(uTx.witness.accountUpdate_D);
-
-        // Update UserE
-        // batch spot trade Storage
-        updateStorage_E_batch.generate_r1cs_witness(uTx.witness.storageUpdate_E_array);
-
-        updateBalanceS_E.generate_r1cs_witness(uTx.witness.balanceUpdateS_E);
-        updateBalanceB_E.generate_r1cs_witness(uTx.witness.balanceUpdateB_E);
-        updateBalanceFee_E.generate_r1cs_witness(uTx.witness.balanceUpdateFee_E);
-        updateAccount_E.generate_r1cs_witness(uTx.witness.accountUpdate_E);
-
-        // Update UserF
-        // batch spot trade Storage
-        updateStorage_F_batch.generate_r1cs_witness(uTx.witness.storageUpdate_F_array);
-
-        updateBalanceS_F.generate_r1cs_witness(uTx.witness.balanceUpdateS_F);
-        updateBalanceB_F.generate_r1cs_witness(uTx.witness.balanceUpdateB_F);
-        updateBalanceFee_F.generate_r1cs_witness(uTx.witness.balanceUpdateFee_F);
-        updateAccount_F.generate_r1cs_witness(uTx.witness.accountUpdate_F);
+        if (hasAccountB)
+        {
+            if (hasBatch)
+            {
+                // batch spot trade Storage
+                updateStorage_B_batch->generate_r1cs_witness(
+                  uTx.witness.storageUpdate_B, uTx.witness.storageUpdate_B_array);
+            }
+            else
+            {
+                updateStorage_B->generate_r1cs_witness(uTx.witness.storageUpdate_B);
+            }
+            updateBalanceS_B->generate_r1cs_witness(uTx.witness.balanceUpdateS_B);
+            updateBalanceB_B->generate_r1cs_witness(uTx.witness.balanceUpdateB_B);
+            updateBalanceFee_B->generate_r1cs_witness(uTx.witness.balanceUpdateFee_B);
+            updateAccount_B->generate_r1cs_witness(uTx.witness.accountUpdate_B);
+        }
+
+        if (hasBatch)
+        {
+            // Update UserC
+            // batch spot trade Storage
+            updateStorage_C_batch->generate_r1cs_witness(uTx.witness.storageUpdate_C_array);
+
+            updateBalanceS_C->generate_r1cs_witness(uTx.witness.balanceUpdateS_C);
+            updateBalanceB_C->generate_r1cs_witness(uTx.witness.balanceUpdateB_C);
+            updateBalanceFee_C->generate_r1cs_witness(uTx.witness.balanceUpdateFee_C);
+            updateAccount_C->generate_r1cs_witness(uTx.witness.accountUpdate_C);
+
+            // Update UserD
+            // batch spot trade Storage
+            updateStorage_D_batch->generate_r1cs_witness(uTx.witness.storageUpdate_D_array);
+
+            updateBalanceS_D->generate_r1cs_witness(uTx.witness.balanceUpdateS_D);
+            updateBalanceB_D->generate_r1cs_witness(uTx.witness.balanceUpdateB_D);
+            updateBalanceFee_D->generate_r1cs_witness(uTx.witness.balanceUpdateFee_D);
+            updateAccount_D->generate_r1cs_witness(uTx.witness.accountUpdate_D);
+
+            // Update UserE
+            // batch spot trade Storage
+            updateStorage_E_batch->generate_r1cs_witness(uTx.witness.storageUpdate_E_array);
+
+            updateBalanceS_E->generate_r1cs_witness(uTx.witness.balanceUpdateS_E);
+            updateBalanceB_E->generate_r1cs_witness(uTx.witness.balanceUpdateB_E);
+            updateBalanceFee_E->generate_r1cs_witness(uTx.witness.balanceUpdateFee_E);
+            updateAccount_E->generate_r1cs_witness(uTx.witness.accountUpdate_E);
+
+            // Update UserF
+            // batch spot trade Storage
+            updateStorage_F_batch->generate_r1cs_witness(uTx.witness.storageUpdate_F_array);
+
+            updateBalanceS_F->generate_r1cs_witness(uTx.witness.balanceUpdateS_F);
+            updateBalanceB_F->generate_r1cs_witness(uTx.witness.balanceUpdateB_F);
+            updateBalanceFee_F->generate_r1cs_witness(uTx.witness.balanceUpdateFee_F);
+            updateAccount_F->generate_r1cs_witness(uTx.witness.accountUpdate_F);
+        }
 
         // Update Operator
-        updateBalanceD_O.generate_r1cs_witness(uTx.witness.balanceUpdateD_O);
-        updateBalanceC_O.generate_r1cs_witness(uTx.witness.balanceUpdateC_O);
-        updateBalanceB_O.generate_r1cs_witness(uTx.witness.balanceUpdateB_O);
-        updateBalanceA_O.generate_r1cs_witness(uTx.witness.balanceUpdateA_O);
-        updateAccount_O.generate_r1cs_witness(uTx.witness.accountUpdate_O);
+        if (!deferOperatorFees)
+        {
+            updateBalanceD_O->generate_r1cs_witness(uTx.witness.balanceUpdateD_O);
+            updateBalanceC_O->generate_r1cs_witness(uTx.witness.balanceUpdateC_O);
+            updateBalanceB_O->generate_r1cs_witness(uTx.witness.balanceUpdateB_O);
+            updateBalanceA_O->generate_r1cs_witness(uTx.witness.balanceUpdateA_O);
+            updateAccount_O->generate_r1cs_witness(uTx.witness.accountUpdate_O);
+        }
 
     }
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         selector.generate_r1cs_constraints();
+        // Transaction types that are not allowed in this slot can never be selected
+        for (unsigned int i = 0; i < (unsigned int)TransactionType::COUNT; i++)
+        {
+            if (!isAllowed(TransactionType(i)))
+            {
+                requireEqual(pb, selector.result()[i], constants._0, FMT(annotation_prefix, ".typeNotAllowed"));
+            }
+        }
 
         noop.generate_r1cs_constraints();
-        spotTrade.generate_r1cs_constraints();
-        deposit.generate_r1cs_constraints();
-        withdraw.generate_r1cs_constraints();
-        accountUpdate.generate_r1cs_constraints();
-        transfer.generate_r1cs_constraints();
-        orderCancel.generate_r1cs_constraints();
-        appKeyUpdate.generate_r1cs_constraints();
-
-        batchSpotTrade.generate_r1cs_constraints();
+        if (spotTrade)
+        {
+            spotTrade->generate_r1cs_constraints();
+        }
+        if (deposit)
+        {
+            deposit->generate_r1cs_constraints();
+        }
+        if (withdraw)
+        {
+            withdraw->generate_r1cs_constraints();
+        }
+        if (accountUpdate)
+        {
+            accountUpdate->generate_r1cs_constraints();
+        }
+        if (transfer)
+        {
+            transfer->generate_r1cs_constraints();
+        }
+        if (orderCancel)
+        {
+            orderCancel->generate_r1cs_constraints();
+        }
+        if (appKeyUpdate)
+        {
+            appKeyUpdate->generate_r1cs_constraints();
+        }
+
+        if (batchSpotTrade)
+        {
+            batchSpotTrade->generate_r1cs_constraints();
+        }
         tx.generate_r1cs_constraints();
 
         // Check signatures
-        signatureVerifierA.generate_r1cs_constraints();
-        signatureVerifierB.generate_r1cs_constraints();
-
-        batchSignatureVerifierA.generate_r1cs_constraints();
-        batchSignatureVerifierB.generate_r1cs_constraints();
-        batchSignatureVerifierC.generate_r1cs_constraints();
-        batchSignatureVerifierD.generate_r1cs_constraints();
-        batchSignatureVerifierE.generate_r1cs_constraints();
-        batchSignatureVerifierF.generate_r1cs_constraints();
+        signatureVerifierPool.generate_r1cs_constraints();
 
         // Update UserA
-        updateStorage_A.generate_r1cs_constraints();
-        updateStorage_A_batch.generate_r1cs_constraints();
+        if (hasBatch)
+        {
+            updateStorage_A_batch->generate_r1cs_constraints();
+        }
+        else
+        {
+            updateStorage_A->generate_r1cs_constraints();
+        }
         updateBalanceS_A.generate_r1cs_constraints();
         updateBalanceB_A.generate_r1cs_constraints();
         updateBalanceFee_A.generate_r1cs_constraints();
         updateAccount_A.generate_r1cs_constraints();
 
         // Update UserB
-        updateStorage_B.generate_r1cs_constraints();
-        updateStorage_B_batch.generate_r1cs_constraints();
-        updateBalanceS_B.generate_r1cs_constraints();
-        updateBalanceB_B.generate_r1cs_constraints();
-        updateBalanceFee_B.generate_r1cs_constraints();
-        updateAccount_B.generate_r1cs_constraints();
-
-        // Update UserC
-        updateStorage_C_batch.generate_r1cs_constraints();
-        updateBalanceS_C.generate_r1cs_constraints();
-        updateBalanceB_C.generate_r1cs_constraints();
-        updateBalanceFee_C.generate_r1cs_constraints();
-        updateAccount_C.generate_r1cs_constraints();
-
-        // Update UserD
-        updateStorage_D_batch.generate_r1cs_constraints();
-        updateBalanceS_D.generate_r1cs_constraints();
-        updateBalanceB_D.generate_r1cs_constraints();
-        updateBalanceFee_D.generate_r1cs_constraints();
-        updateAccount_D.generate_r1cs_constraints();
-
-        // Update UserE
-        updateStorage_E_batch.generate_r1cs_constraints();
-        updateBalanceS_E.generate_r1cs_constraints();
-        updateBalanceB_E.generate_r1cs_constraints();
-        updateBalanceFee_E.generate_r1cs_constraints();
-        updateAccount_E.generate_r1cs_constraints();
-
-        // Update UserF
-        updateStorage_F_batch.generate_r1cs_constraints();
-        updateBalanceS_F.generate_r1cs_constraints();
-        updateBalanceB_F.generate_r1cs_constraints();
-        updateBalanceFee_F.generate_r1cs_constraints();
-        updateAccount_F.generate_r1cs_constraints();
+        if (hasAccountB)
+        {
+            if (hasBatch)
+            {
+                updateStorage_B_batch->generate_r1cs_constraints();
+            }
+            else
+            {
+                updateStorage_B->generate_r1cs_constraints();
+            }
+            updateBalanceS_B->generate_r1cs_constraints();
+            updateBalanceB_B->generate_r1cs_constraints();
+            updateBalanceFee_B->generate_r1cs_constraints();
+            updateAccount_B->generate_r1cs_constraints();
+        }
+
+        if (hasBatch)
+        {
+            // Update UserC
+            updateStorage_C_batch->generate_r1cs_constraints();
+            updateBalanceS_C->generate_r1cs_constraints();
+            updateBalanceB_C->generate_r1cs_constraints();
+            updateBalanceFee_C->generate_r1cs_constraints();
+            updateAccount_C->generate_r1cs_constraints();
+
+            // Update UserD
+            updateStorage_D_batch->generate_r1cs_constraints();
+            updateBalanceS_D->generate_r1cs_constraints();
+            updateBalanceB_D->generate_r1cs_constraints();
+            updateBalanceFee_D->generate_r1cs_constraints();
+            updateAccount_D->generate_r1cs_constraints();
+
+            // Update UserE
+            updateStorage_E_batch->generate_r1cs_constraints();
+            updateBalanceS_E->generate_r1cs_constraints();
+            updateBalanceB_E->generate_r1cs_constraints();
+            updateBalanceFee_E->generate_r1cs_constraints();
+            updateAccount_E->generate_r1cs_constraints();
+
+            // Update UserF
+            updateStorage_F_batch->generate_r1cs_constraints();
+            updateBalanceS_F->generate_r1cs_constraints();
+            updateBalanceB_F->generate_r1cs_constraints();
+            updateBalanceFee_F->generate_r1cs_constraints();
+            updateAccount_F->generate_r1cs_constraints();
+        }
 
         // Update Operator
-        updateBalanceD_O.generate_r1cs_constraints();
-        updateBalanceC_O.generate_r1cs_constraints();
-        updateBalanceB_O.generate_r1cs_constraints();
-        updateBalanceA_O.generate_r1cs_constraints();
-        updateAccount_O.generate_r1cs_constraints();
+        if (!deferOperatorFees)
+        {
+            updateBalanceD_O->generate_r1cs_constraints();
+            updateBalanceC_O->generate_r1cs_constraints();
+            updateBalanceB_O->generate_r1cs_constraints();
+            updateBalanceA_O->generate_r1cs_constraints();
+            updateAccount_O->generate_r1cs_constraints();
+        }
 
     }
 
@@ -1418,12 +1708,110 @@ class TransactionGadget : public GadgetT
 
     const VariableT &getNewAccountsRoot() const
     {
-        return updateAccount_O.result();
+        return deferOperatorFees ? getLastAccountUpdate().result() : updateAccount_O->result();
     }
 
     const VariableT &getNewAccountsAssetRoot() const
     {
-        return updateAccount_O.assetResult();
+        return deferOperatorFees ? getLastAccountUpdate().assetResult() : updateAccount_O->assetResult();
+    }
+};
+
+// Binds the constants allocated as placeholders on a SubProtoboard to the constants of the main protoboard.
+// _1 is the constant term on both protoboards. A constant that is not bound here is reported by stamp().
+static void bindConstants(SubProtoboard &sub, const Constants &placeholders, const Constants &constants)
+{
+    sub.bind(placeholders._0, constants._0);
+    sub.bind(placeholders._2, constants._2);
+    sub.bind(placeholders._3, constants._3);
+    sub.bind(placeholders._4, constants._4);
+    sub.bind(placeholders._5, constants._5);
+    sub.bind(placeholders._6, constants._6);
+    sub.bind(placeholders._7, constants._7);
+    sub.bind(placeholders._8, constants._8);
+    sub.bind(placeholders._9, constants._9);
+    sub.bind(placeholders._10, constants._10);
+    sub.bind(placeholders._11, constants._11);
+    sub.bind(placeholders._12, constants._12);
+    sub.bind(placeholders._13, constants._13);
+    sub.bind(placeholders._14, constants._14);
+    sub.bind(placeholders._15, constants._15);
+    sub.bind(placeholders._16, constants._16);
+    sub.bind(placeholders._17, constants._17);
+    sub.bind(placeholders._1000, constants._1000);
+    sub.bind(placeholders._1001, constants._1001);
+    sub.bind(placeholders._10000, constants._10000);
+    sub.bind(placeholders._2Pow30, constants._2Pow30);
+    sub.bind(placeholders.txTypeSpotTrade, constants.txTypeSpotTrade);
+    sub.bind(placeholders.txTypeBatchSpotTrade, constants.txTypeBatchSpotTrade);
+    sub.bind(placeholders.txTypeTransfer, constants.txTypeTransfer);
+    sub.bind(placeholders.txTypeWithdrawal, constants.txTypeWithdrawal);
+    sub.bind(placeholders.txTypeOrderCancel, constants.txTypeOrderCancel);
+    sub.bind(placeholders.txTypeAppKeyUpdate, constants.txTypeAppKeyUpdate);
+    sub.bind(placeholders.depositType, constants.depositType);
+    sub.bind(placeholders.accountUpdateType, constants.accountUpdateType);
+    sub.bind(placeholders.withdrawType, constants.withdrawType);
+}
+
+// The protoboard of a transaction slot when the transactions are created on separate protoboards (see
+// UniversalCircuit::generateConstraints). The constants and the inputs of the transaction are placeholders for
+// the variables on the main protoboard.
+struct TransactionSlot
+{
+    const bool first;
+    SubProtoboard sub;
+
+    Constants constants;
+    const VariableT exchange;
+    const VariableT accountsRoot;
+    const VariableT accountsAssetRoot;
+    const VariableT timestamp;
+    const VariableT protocolFeeBips;
+    const VariableArrayT operatorAccountID;
+    // The first transaction starts from 0, like on the main protoboard
+    const VariableT numConditionalTransactions;
+    const VariableT type;
+
+    TransactionSlot(bool _first, const std::string &prefix)
+        : first(_first),
+
+          constants(sub.pb, FMT(prefix, ".constants")),
+          exchange(make_variable(sub.pb, FMT(prefix, ".exchange"))),
+          accountsRoot(make_variable(sub.pb, FMT(prefix, ".accountsRoot"))),
+          accountsAssetRoot(make_variable(sub.pb, FMT(prefix, ".accountsAssetRoot"))),
+          timestamp(make_variable(sub.pb, FMT(prefix, ".timestamp"))),
+          protocolFeeBips(make_variable(sub.pb, FMT(prefix, ".protocolFeeBips"))),
+          operatorAccountID(make_var_array(sub.pb, NUM_BITS_ACCOUNT, FMT(prefix, ".operatorAccountID"))),
+          numConditionalTransactions(
+            _first ? constants._0 : make_variable(sub.pb, FMT(prefix, ".numConditionalTransactions"))),
+          type(make_variable(sub.pb, FMT(prefix, ".type")))
+    {
+        sub.endImports();
+    }
+
+    void bind(
+      const Constants &_constants,
+      const VariableT &_exchange,
+      const VariableT &_accountsRoot,
+      const VariableT &_accountsAssetRoot,
+      const VariableT &_timestamp,
+      const VariableT &_protocolFeeBips,
+      const VariableArrayT &_operatorAccountID,
+      const VariableT &_numConditionalTransactions,
+      const VariableT &_type)
+    {
+        bindConstants(sub, constants, _constants);
+        sub.bind(exchange, _exchange);
+        sub.bind(accountsRoot, _accountsRoot);
+        sub.bind(accountsAssetRoot, _accountsAssetRoot);
+        sub.bind(timestamp, _timestamp);
+        sub.bind(protocolFeeBips, _protocolFeeBips);
+        sub.bind(operatorAccountID, _operatorAccountID);
+        if (!first)
+        {
+            sub.bind(numConditionalTransactions, _numConditionalTransactions);
+        }
+        sub.bind(type, _type);
     }
 };
 
@@ -1458,7 +1846,28 @@ class UniversalCircuit : public Circuit
 
     // Transactions
     unsigned int numTransactions;
-    std::vector<TransactionGadget> transactions;
+    // When the transactions are stamped only the templates, see getTransaction()
+    std::vector<std::unique_ptr<TransactionGadget>> transactions;
+    // The protoboard of every transaction when the transactions are created in parallel, or of every template
+    // when the transactions are stamped
+    std::vector<std::unique_ptr<TransactionSlot>> slots;
+    // Where the variables of every transaction are on the main protoboard, empty when the transactions are
+    // created on the main protoboard
+    std::vector<SubProtoboard::Relocation> relocations;
+    // The template of every transaction when the transactions are stamped
+    std::vector<size_t> templateIndices;
+    // Copies of the templates that generate the witness of stamped transactions on the other threads (thread 1,
+    // 2, ...), see generateStampedWitness
+    std::vector<std::vector<std::unique_ptr<TransactionSlot>>> threadSlots;
+    std::vector<std::vector<std::unique_ptr<TransactionGadget>>> threadTransactions;
+
+    // Operator fee table, only used when the layout defers the operator fees
+    std::vector<DualVariableGadget> operatorFeeTokenIDs;
+    std::vector<BalanceGadget> operatorFeeBalancesBefore;
+    // Current balances of the table while the transactions are processed
+    VariableArrayT operatorFeeBalances;
+    std::vector<OperatorBalanceLookupGadget> operatorBalanceLookups;
+    std::vector<UpdateBalanceGadget> updateOperatorFeeBalances;
 
     // Update Protocol pool
     std::unique_ptr<UpdateAccountGadget> updateAccount_P;
@@ -1535,7 +1944,9 @@ class UniversalCircuit : public Circuit
 
     void generateConstraints(unsigned int blockSize) override
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         this->numTransactions = blockSize;
+        assert(layout.isValid(blockSize));
 
         constants.generate_r1cs_constraints();
 
@@ -1552,8 +1963,71 @@ class UniversalCircuit : public Circuit
         // Increase the nonce of the Operator
         nonce_after.generate_r1cs_constraints();
 
+        // Operator fee table
+        VariableArrayT operatorFeeTokenIDsPacked;
+        operatorFeeTokenIDs.reserve(layout.numOperatorFeeTokens);
+        operatorFeeBalancesBefore.reserve(layout.numOperatorFeeTokens);
+        for (unsigned int i = 0; i < layout.numOperatorFeeTokens; i++)
+        {
+            operatorFeeTokenIDs.emplace_back(pb, NUM_BITS_TOKEN, FMT(annotation_prefix, ".operatorFeeTokenIDs"));
+            operatorFeeTokenIDs.back().generate_r1cs_constraints(true);
+            operatorFeeBalancesBefore.emplace_back(pb, FMT(annotation_prefix, ".operatorFeeBalancesBefore"));
+            operatorFeeTokenIDsPacked.emplace_back(operatorFeeTokenIDs.back().packed);
+            operatorFeeBalances.emplace_back(operatorFeeBalancesBefore.back().balance);
+        }
+        if (layout.deferOperatorFees())
+        {
+            operatorBalanceLookups.reserve(numTransactions * 4);
+        }
+
         // Transactions
-        transactions.reserve(numTransactions);
+        // A transaction only depends on the previous transactions through the accounts roots and the number of
+        // conditional transactions. With parallelTransactions every transaction gadget is created on its own
+        // protoboard, and spliced into the main protoboard below in the same order as they would be created here.
+        // The profiler needs all constraints to be generated on the main protoboard, and without
+        // transactionConstraints the transaction constraints are not generated at all (they come from the cache).
+        // With stampTransactions all slots with the same allowed transaction types are copies of the same
+        // template (the first slot is a separate kind because it starts from constants._0).
+        transactions.clear();
+        slots.clear();
+        relocations.clear();
+        templateIndices.clear();
+        threadSlots.clear();
+        threadTransactions.clear();
+        if (stampTransactions && transactionConstraints && Profiler::active() == nullptr)
+        {
+            std::vector<std::pair<unsigned int, bool>> kinds;
+            templateIndices.resize(numTransactions);
+            for (size_t j = 0; j < numTransactions; j++)
+            {
+                const std::pair<unsigned int, bool> kind(layout.getAllowedTransactionTypes(j, numTransactions), j == 0);
+                templateIndices[j] = std::find(kinds.begin(), kinds.end(), kind) - kinds.begin();
+                if (templateIndices[j] == kinds.size())
+                {
+                    kinds.push_back(kind);
+                    slots.emplace_back(new TransactionSlot(j == 0, FMT(annotation_prefix, ".templates")));
+                    transactions.emplace_back(createTransaction(*slots.back(), j));
+                    transactions.back()->generate_r1cs_constraints();
+                }
+            }
+        }
+        else if (parallelTransactions && transactionConstraints && Profiler::active() == nullptr)
+        {
+            transactions.resize(numTransactions);
+            slots.resize(numTransactions);
+            // Not on multiple threads: every coefficient of a linear combination is added to the process-wide
+            // libsnark::ConstantStorage table, which is not known to be safe to insert into from multiple threads
+            for (size_t j = 0; j < numTransactions; j++)
+            {
+                slots[j].reset(new TransactionSlot(j == 0, FMT(annotation_prefix, ".slots")));
+                transactions[j].reset(createTransaction(*slots[j], j));
+                transactions[j]->generate_r1cs_constraints();
+            }
+        }
+        else
+        {
+            transactions.resize(numTransactions);
+        }
         for (size_t j = 0; j < numTransactions; j++)
         {
             txTypes.emplace_back(pb, NUM_BITS_TX_TYPE_FOR_SELECT, FMT(annotation_prefix, ".txTypes"));
@@ -1603,24 +2077,77 @@ class UniversalCircuit : public Circuit
             withdrawSizeAdd.back().generate_r1cs_constraints();
 
 
-            const VariableT txAccountsRoot =
-              (j == 0) ? merkleRootBefore.packed : transactions.back().getNewAccountsRoot();
-            const VariableT txAccountsAssetRoot =
-              (j == 0) ? merkleAssetRootBefore.packed : transactions.back().getNewAccountsAssetRoot();
-            transactions.emplace_back(
-              pb,
-              params,
-              constants,
-              exchange.packed,
-              txAccountsRoot,
-              txAccountsAssetRoot,
-              timestamp.packed,
-              protocolFeeBips.packed,
-              operatorAccountID.bits,
-              (j == 0) ? constants._0 : transactions.back().tx.getOutput(TXV_NUM_CONDITIONAL_TXS),
-              txTypes.back().packed,
-              std::string("tx_") + std::to_string(j));
-            transactions.back().generate_r1cs_constraints();
+            if (slots.empty())
+            {
+                const VariableT txAccountsRoot =
+                  (j == 0) ? merkleRootBefore.packed : transactions[j - 1]->getNewAccountsRoot();
+                const VariableT txAccountsAssetRoot =
+                  (j == 0) ? merkleAssetRootBefore.packed : transactions[j - 1]->getNewAccountsAssetRoot();
+                transactions[j].reset(createTransaction(
+                  pb,
+                  constants,
+                  exchange.packed,
+                  txAccountsRoot,
+                  txAccountsAssetRoot,
+                  timestamp.packed,
+                  protocolFeeBips.packed,
+                  operatorAccountID.bits,
+                  (j == 0) ? constants._0 : transactions[j - 1]->tx.getOutput(TXV_NUM_CONDITIONAL_TXS),
+                  txTypes.back().packed,
+                  j));
+                if (transactionConstraints)
+                {
+                    transactions[j]->generate_r1cs_constraints();
+                }
+            }
+            else
+            {
+                TransactionSlot &slot = isStamped() ? *slots[templateIndices[j]] : *slots[j];
+                slot.bind(
+                  constants,
+                  exchange.packed,
+                  (j == 0) ? merkleRootBefore.packed : toMain(j - 1, getTransaction(j - 1).getNewAccountsRoot()),
+                  (j == 0) ? merkleAssetRootBefore.packed
+                           : toMain(j - 1, getTransaction(j - 1).getNewAccountsAssetRoot()),
+                  timestamp.packed,
+                  protocolFeeBips.packed,
+                  operatorAccountID.bits,
+                  (j == 0) ? constants._0 : toMain(j - 1, getTransaction(j - 1).tx.getOutput(TXV_NUM_CONDITIONAL_TXS)),
+                  txTypes.back().packed);
+                slot.sub.stamp(pb, FMT("", "tx_%zu", j));
+                if (!isStamped())
+                {
+                    slot.sub.clearConstraints();
+                }
+                relocations.push_back(slot.sub.relocation);
+            }
+
+            if (layout.deferOperatorFees())
+            {
+                // Same order as the operator balance updates in TransactionGadget
+                const TransactionGadget &transaction = getTransaction(j);
+                addOperatorBalanceLookup(
+                  operatorFeeTokenIDsPacked, j, TXV_BALANCE_O_D_Address, transaction.state.oper.balanceD,
+                  TXV_BALANCE_O_D_BALANCE);
+                addOperatorBalanceLookup(
+                  operatorFeeTokenIDsPacked, j, TXV_BALANCE_O_C_Address, transaction.state.oper.balanceC,
+                  TXV_BALANCE_O_C_BALANCE);
+                addOperatorBalanceLookup(
+                  operatorFeeTokenIDsPacked, j, TXV_BALANCE_O_B_Address, transaction.state.oper.balanceB,
+                  TXV_BALANCE_O_B_BALANCE);
+                addOperatorBalanceLookup(
+                  operatorFeeTokenIDsPacked, j, TXV_BALANCE_O_A_Address, transaction.state.oper.balanceA,
+                  TXV_BALANCE_O_A_BALANCE);
+            }
+        }
+
+        // The constraints of the templates are only needed to stamp the transactions
+        if (isStamped())
+        {
+            for (auto &slot : slots)
+            {
+                slot->sub.clearConstraints();
+            }
         }
 
         depositSize.reset(new ToBitsGadget(pb, depositSizeAdd.back().result(), NUM_BITS_TX_SIZE, FMT(annotation_prefix, ".depositSize")));
@@ -1632,8 +2159,8 @@ class UniversalCircuit : public Circuit
         // Update Protocol pool
         updateAccount_P.reset(new UpdateAccountGadget(
           pb,
-          transactions.back().getNewAccountsRoot(),
-          transactions.back().getNewAccountsAssetRoot(),
+          toMain(numTransactions - 1, getTransaction(numTransactions - 1).getNewAccountsRoot()),
+          toMain(numTransactions - 1, getTransaction(numTransactions - 1).getNewAccountsAssetRoot()),
           constants.zeroAccount,
           {accountBefore_P.owner,
            accountBefore_P.publicKey.x,
@@ -1660,6 +2187,23 @@ class UniversalCircuit : public Circuit
           FMT(annotation_prefix, ".updateAccount_P")));
         updateAccount_P->generate_r1cs_constraints();
 
+        // Apply the operator fee table, once for every token
+        updateOperatorFeeBalances.reserve(layout.numOperatorFeeTokens);
+        for (unsigned int i = 0; i < layout.numOperatorFeeTokens; i++)
+        {
+            updateOperatorFeeBalances.emplace_back(
+              pb,
+              (i == 0) ? accountBefore_O.balancesRoot : updateOperatorFeeBalances.back().result(),
+              operatorFeeTokenIDs[i].bits,
+              BalanceState{operatorFeeBalancesBefore[i].balance},
+              BalanceState{operatorFeeBalances[i]},
+              FMT(annotation_prefix, ".updateOperatorFeeBalances"));
+            updateOperatorFeeBalances.back().generate_r1cs_constraints();
+        }
+        const VariableT &operatorBalancesRootAfter = updateOperatorFeeBalances.empty()
+                                                       ? accountBefore_O.balancesRoot
+                                                       : updateOperatorFeeBalances.back().result();
+
         // Update Operator
         updateAccount_O.reset(new UpdateAccountGadget(
           pb,
@@ -1686,14 +2230,17 @@ class UniversalCircuit : public Circuit
            accountBefore_O.disableAppKeySpotTrade,
            accountBefore_O.disableAppKeyWithdraw,
            accountBefore_O.disableAppKeyTransferToOther,
-           accountBefore_O.balancesRoot,
+           operatorBalancesRootAfter,
            accountBefore_O.storageRoot},
           FMT(annotation_prefix, ".updateAccount_O")));
         updateAccount_O->generate_r1cs_constraints();
 
         // Num of conditional transactions
         numConditionalTransactions.reset(new ToBitsGadget(
-          pb, transactions.back().tx.getOutput(TXV_NUM_CONDITIONAL_TXS), 32, ".numConditionalTransactions"));
+          pb,
+          toMain(numTransactions - 1, getTransaction(numTransactions - 1).tx.getOutput(TXV_NUM_CONDITIONAL_TXS)),
+          32,
+          ".numConditionalTransactions"));
         numConditionalTransactions->generate_r1cs_constraints();
 
         // Public data
@@ -1713,7 +2260,7 @@ class UniversalCircuit : public Circuit
         unsigned int start = publicData.publicDataBits.size();
         for (size_t j = 0; j < numTransactions; j++)
         {
-            publicData.add(reverse(transactions[j].getPublicData()));
+            publicData.add(reverse(toMain(j, getTransaction(j).getPublicData())));
         }
         publicData.transform(start, numTransactions, TX_DATA_AVAILABILITY_SIZE * 8);
         publicData.generate_r1cs_constraints();
@@ -1728,13 +2275,164 @@ class UniversalCircuit : public Circuit
         requireEqual(pb, updateAccount_O->assetResult(), merkleAssetRootAfter.packed, "newMerkleAssetRoot");
     }
 
-    bool generateWitness(const Block &block)
+    TransactionGadget *createTransaction(
+      ProtoboardT &txPb,
+      const Constants &txConstants,
+      const VariableT &txExchange,
+      const VariableT &txAccountsRoot,
+      const VariableT &txAccountsAssetRoot,
+      const VariableT &txTimestamp,
+      const VariableT &txProtocolFeeBips,
+      const VariableArrayT &txOperatorAccountID,
+      const VariableT &txNumConditionalTransactions,
+      const VariableT &txType,
+      size_t j) const
+    {
+        return new TransactionGadget(
+          txPb,
+          params,
+          txConstants,
+          txExchange,
+          txAccountsRoot,
+          txAccountsAssetRoot,
+          txTimestamp,
+          txProtocolFeeBips,
+          txOperatorAccountID,
+          txNumConditionalTransactions,
+          txType,
+          layout.getAllowedTransactionTypes(j, numTransactions),
+          layout.deferOperatorFees(),
+          FMT("", "tx_%zu", j));
+    }
+
+    TransactionGadget *createTransaction(TransactionSlot &slot, size_t j) const
+    {
+        return createTransaction(
+          slot.sub.pb,
+          slot.constants,
+          slot.exchange,
+          slot.accountsRoot,
+          slot.accountsAssetRoot,
+          slot.timestamp,
+          slot.protocolFeeBips,
+          slot.operatorAccountID,
+          slot.numConditionalTransactions,
+          slot.type,
+          j);
+    }
+
+    bool isStamped() const
+    {
+        return !templateIndices.empty();
+    }
+
+    // The gadget of transaction j, the template of the slot when the transactions are stamped. The variables
+    // are the variables on the protoboard of the gadget (see toMain).
+    const TransactionGadget &getTransaction(size_t j) const
+    {
+        return *transactions[isStamped() ? templateIndices[j] : j];
+    }
+
+    // A variable of transaction j on the main protoboard
+    VariableT toMain(size_t j, const VariableT &var) const
+    {
+        return relocations.empty() ? var : relocations[j].toMain(var);
+    }
+
+    VariableArrayT toMain(size_t j, const VariableArrayT &vars) const
+    {
+        return relocations.empty() ? vars : relocations[j].toMain(vars);
+    }
+
+    void addOperatorBalanceLookup(
+      const VariableArrayT &tableTokenIDs,
+      size_t j,
+      TxVariable address,
+      const BalanceGadget &balanceBefore,
+      TxVariable balanceAfter)
+    {
+        const TransactionGadget &transaction = getTransaction(j);
+        operatorBalanceLookups.emplace_back(
+          pb,
+          tableTokenIDs,
+          operatorFeeBalances,
+          toMain(j, transaction.tx.getArrayOutput(address)),
+          toMain(j, balanceBefore.balance),
+          toMain(j, transaction.tx.getOutput(balanceAfter)),
+          FMT(annotation_prefix, ".operatorBalanceLookup"));
+        operatorBalanceLookups.back().generate_r1cs_constraints();
+        operatorFeeBalances = operatorBalanceLookups.back().result();
+    }
+
+    // Creates the copies of the templates for the other threads, the same way as the templates so all variables
+    // have the same index as on the protoboard of the template. Only the variables and the gadgets are needed,
+    // the constraints are not generated.
+    void createThreadTemplates(size_t numThreads)
+    {
+        while (threadSlots.size() + 1 < numThreads)
+        {
+            threadSlots.emplace_back();
+            threadTransactions.emplace_back();
+            for (size_t k = 0; k < slots.size(); k++)
+            {
+                const size_t j = std::find(templateIndices.begin(), templateIndices.end(), k) - templateIndices.begin();
+                threadSlots.back().emplace_back(new TransactionSlot(j == 0, FMT(annotation_prefix, ".templates")));
+                threadTransactions.back().emplace_back(createTransaction(*threadSlots.back().back(), j));
+                ASSERT(
+                  threadSlots.back().back()->sub.pb.num_variables() == slots[k]->sub.pb.num_variables(),
+                  "the copy of template " << k << " has different variables");
+            }
+        }
+    }
+
+    // The witness of a stamped transaction is generated with the template of its slot (or the copy of the
+    // template of the current thread) by switching to the relocation of the transaction. The import values are
+    // read before, the previous transaction may be pushing its values on another thread.
+    void generateStampedWitness(
+      size_t i,
+      const std::vector<FieldT> &importValues,
+      const UniversalTransaction &transaction)
+    {
+#ifdef MULTICORE
+        const size_t thread = omp_get_thread_num();
+#else
+        const size_t thread = 0;
+#endif
+        const size_t k = templateIndices[i];
+        TransactionSlot &slot = (thread == 0) ? *slots[k] : *threadSlots[thread - 1][k];
+        TransactionGadget &gadget = (thread == 0) ? *transactions[k] : *threadTransactions[thread - 1][k];
+        slot.sub.relocation = relocations[i];
+        slot.sub.clearWitness();
+        slot.sub.pullWitness(importValues);
+        slot.sub.pb.val(gadget.tx.getOutput(TXV_NUM_CONDITIONAL_TXS)) =
+          transaction.witness.numConditionalTransactionsAfter;
+        gadget.generate_r1cs_witness(transaction);
+        slot.sub.pushWitness(pb);
+    }
+
+    bool generateWitness(const Block &block) override
     {
+        ProfileWitness profile(annotation_prefix);
         if (block.transactions.size() != numTransactions)
         {
             std::cout << "Invalid number of transactions: " << block.transactions.size() << std::endl;
             return false;
         }
+        for (unsigned int i = 0; i < block.transactions.size(); i++)
+        {
+            unsigned int type = block.transactions[i].type.as_ulong();
+            if (type >= (unsigned int)TransactionType::COUNT || !getTransaction(i).isAllowed(TransactionType(type)))
+            {
+                std::cout << "Transaction type " << type << " is not allowed in slot " << i << " of the block layout"
+                          << std::endl;
+                return false;
+            }
+        }
+        if (block.operatorFeeUpdates.size() != layout.numOperatorFeeTokens)
+        {
+            std::cout << "Invalid number of operator fee updates: " << block.operatorFeeUpdates.size() << std::endl;
+            return false;
+        }
 
         constants.generate_r1cs_witness();
 
@@ -1756,9 +2454,10 @@ class UniversalCircuit : public Circuit
         nonce_after.generate_r1cs_witness();
 
         // Transactions
+        std::vector<std::vector<FieldT>> importValues(isStamped() ? numTransactions : 0);
         for (unsigned int i = 0; i < block.transactions.size(); i++)
         {
-            pb.val(transactions[i].tx.getOutput(TXV_NUM_CONDITIONAL_TXS)) =
+            pb.val(toMain(i, getTransaction(i).tx.getOutput(TXV_NUM_CONDITIONAL_TXS))) =
               block.transactions[i].witness.numConditionalTransactionsAfter;
             
             txTypes[i].generate_r1cs_witness(pb, block.transactions[i].type);
@@ -1786,19 +2485,67 @@ class UniversalCircuit : public Circuit
             accountUpdateSizeAdd[i].generate_r1cs_witness();
             otherTransactionSizeAdd[i].generate_r1cs_witness();
             withdrawSizeAdd[i].generate_r1cs_witness();
+
+            // The inputs of the transaction. The accounts roots of the previous transaction aren't known yet, those
+            // are not used to generate the witness (same as when the transactions are on the main protoboard).
+            // Stamped transactions share the gadgets of their template, only the values are read here.
+            if (isStamped())
+            {
+                importValues[i] = relocations[i].importValues(pb);
+            }
+            else if (!relocations.empty())
+            {
+                slots[i]->sub.pullWitness(pb);
+            }
         }
+#ifdef MULTICORE
+        if (isStamped())
+        {
+            createThreadTemplates(omp_get_max_threads());
+        }
+#endif
 #ifdef MULTICORE
 #pragma omp parallel for
 #endif
         for (unsigned int i = 0; i < block.transactions.size(); i++)
         {
             std::cout << "--------------- tx: " << i << " ( " << block.transactions[i].type << " ) " << std::endl;
-            transactions[i].generate_r1cs_witness(block.transactions[i]);
+            if (isStamped())
+            {
+                generateStampedWitness(i, importValues[i], block.transactions[i]);
+            }
+            else if (!relocations.empty())
+            {
+                ProtoboardT &slotPb = slots[i]->sub.pb;
+                slotPb.val(transactions[i]->tx.getOutput(TXV_NUM_CONDITIONAL_TXS)) =
+                  block.transactions[i].witness.numConditionalTransactionsAfter;
+                transactions[i]->generate_r1cs_witness(block.transactions[i]);
+                slots[i]->sub.pushWitness(pb);
+            }
+            else
+            {
+                transactions[i]->generate_r1cs_witness(block.transactions[i]);
+            }
         }
         depositSize->generate_r1cs_witness();
         accountUpdateSize->generate_r1cs_witness();
         withdrawSize->generate_r1cs_witness();
 
+        // Operator fee table, the lookups depend on the previous transactions
+        for (unsigned int i = 0; i < block.operatorFeeUpdates.size(); i++)
+        {
+            operatorFeeTokenIDs[i].generate_r1cs_witness(pb, block.operatorFeeUpdates[i].tokenID);
+            operatorFeeBalancesBefore[i].generate_r1cs_witness(block.operatorFeeUpdates[i].before);
+        }
+        for (unsigned int i = 0; i < operatorBalanceLookups.size(); i++)
+        {
+            operatorBalanceLookups[i].generate_r1cs_witness();
+        }
+        for (unsigned int i = 0; i < block.operatorFeeUpdates.size(); i++)
+        {
+            updateOperatorFeeBalances[i].generate_r1cs_witness(block.operatorFeeUpdates[i]);
+        }
+
         // Update Protocol pool
         updateAccount_P->generate_r1cs_witness(block.accountUpdate_P);
 
@@ -1835,8 +2582,26 @@ class UniversalCircuit : public Circuit
 
     void printInfo() override
     {
-        std::cout << pb.num_constraints() << " constraints (" << (pb.num_constraints() / numTransactions) << "/tx)"
-                  << ";num_variables:" << pb.num_variables() << ";num_inputs:" << pb.num_inputs() << std::endl;
+        const ProtoboardT &provingPb = getPb();
+        std::cout << provingPb.num_constraints() << " constraints ("
+                  << (provingPb.num_constraints() / numTransactions) << "/tx)"
+                  << ";num_variables:" << provingPb.num_variables() << ";num_inputs:" << provingPb.num_inputs()
+                  << std::endl;
+        if (optimizer)
+        {
+            std::cout << "optimized: " << optimizer->numConstraintsBefore << " -> " << provingPb.num_constraints()
+                      << " constraints, " << optimizer->numVariablesBefore << " -> " << provingPb.num_variables()
+                      << " variables (" << optimizer->numSubstitutions << " substitutions)" << std::endl;
+        }
+        if (!layout.universal)
+        {
+            std::cout << "layout: " << layout.numDeposits << " deposits, " << layout.numAccountUpdates
+                      << " account updates, " << layout.numWithdrawals << " withdrawals" << std::endl;
+        }
+        if (layout.deferOperatorFees())
+        {
+            std::cout << "operator fee table: " << layout.numOperatorFeeTokens << " tokens" << std::endl;
+        }
     }
 };
 
@@ -57,8 +57,9 @@ class WithdrawCircuit : public BaseTransactionCircuit
 
     IfThenRequireEqualGadget ifUseAppKey_then_require_enable_switch;
 
-    // onChainDataHash is the hash of withdrawal attributes: minGas, to and amount
-    OnChainDataHashGadget onchainDataHashCalculate;
+    // onChainDataHash is the hash of withdrawal attributes: minGas, to and amount.
+    // Created by createOnChainDataHash after all other gadgets of the transaction.
+    std::unique_ptr<OnChainDataHashGadget> onchainDataHashCalculate;
 
     Poseidon_10 hash;
 
@@ -180,9 +181,6 @@ class WithdrawCircuit : public BaseTransactionCircuit
             state.constants._0,
             FMT(prefix, ".ifUseAppKey_then_require_enable_switch")),
           // Signature
-          onchainDataHashCalculate(
-            pb,
-            FMT(prefix, ".onchainDataHashCalculate")),
           hash(
             pb,
             var_array(
@@ -375,8 +373,23 @@ class WithdrawCircuit : public BaseTransactionCircuit
         setOutput(TXV_STORAGE_A_FORWARD, forwardValue.result());
     }
 
+    // Called by TransactionGadget after all its other gadgets are created, so the variables of the hash are
+    // allocated at the end of the transaction like when they were created while generating the constraints
+    void createOnChainDataHash()
+    {
+        onchainDataHashCalculate.reset(new OnChainDataHashGadget(
+          pb, {minGas.bits, to.bits, amount.bits}, FMT(annotation_prefix, ".onchainDataHashCalculate")));
+        requireValidOnChainDataHash.reset(new IfThenRequireEqualGadget(
+          pb,
+          isWithdrawalTx.result(),
+          onchainDataHash.packed,
+          onchainDataHashCalculate->result(),
+          FMT(annotation_prefix, ".requireValidOnChainDataHash")));
+    }
+
     void generate_r1cs_witness(const Withdrawal &withdrawal)
     {
+        ProfileWitness profile(annotation_prefix);
         LOG(LogDebug, "in WithdrawCircuit", "generate_r1cs_witness");
         // Inputs
         accountID.generate_r1cs_witness(pb, withdrawal.accountID);
@@ -408,7 +421,7 @@ class WithdrawCircuit : public BaseTransactionCircuit
         ifUseAppKey_then_require_enable_switch.generate_r1cs_witness();
 
         // Signature
-        onchainDataHashCalculate.generate_r1cs_witness();
+        onchainDataHashCalculate->generate_r1cs_witness();
         hash.generate_r1cs_witness();
 
         // Validate
@@ -469,6 +482,7 @@ class WithdrawCircuit : public BaseTransactionCircuit
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         LOG(LogDebug, "in WithdrawCircuit: generate_r1cs_constraints", "");
         // Inputs
         accountID.generate_r1cs_constraints(true);
@@ -500,17 +514,13 @@ class WithdrawCircuit : public BaseTransactionCircuit
         ifUseAppKey_then_require_enable_switch.generate_r1cs_constraints();
         
         // Signature
-        onchainDataHashCalculate.add(minGas.bits);
-        onchainDataHashCalculate.add(to.bits);
-        onchainDataHashCalculate.add(amount.bits);
-        onchainDataHashCalculate.generate_r1cs_constraints();
+        onchainDataHashCalculate->generate_r1cs_constraints();
         hash.generate_r1cs_constraints();
 
         // Validate
         requireValidUntil.generate_r1cs_constraints();
         requireValidFee.generate_r1cs_constraints();
 
-        requireValidOnChainDataHash.reset(new IfThenRequireEqualGadget(pb, isWithdrawalTx.result(), onchainDataHash.packed, onchainDataHashCalculate.result(), FMT(annotation_prefix, ".requireValidOnChainDataHash"))),
         requireValidOnChainDataHash->generate_r1cs_constraints();
 
         // Type
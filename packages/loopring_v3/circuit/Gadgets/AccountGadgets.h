@@ -114,12 +114,9 @@ class UpdateAccountGadget : public GadgetT
     AccountState valuesAfter;
 
     const VariableArrayT proof;
-    MerklePathCheckT proofVerifierBefore;
-    MerklePathT rootCalculatorAfter;
-
     const VariableArrayT assetProof;
-    MerklePathCheckT assetProofVerifierBefore;
-    MerklePathT assetRootCalculatorAfter;
+    // Both trees use the same address
+    MerkleDualPathUpdateT pathUpdate;
 
     UpdateAccountGadget(
       ProtoboardT &pb,
@@ -186,45 +183,27 @@ class UpdateAccountGadget : public GadgetT
             FMT(prefix, ".assetLeafAfter")),
 
           proof(make_var_array(pb, TREE_DEPTH_ACCOUNTS * 3, FMT(prefix, ".proof"))),
-          proofVerifierBefore(
+          assetProof(make_var_array(pb, TREE_DEPTH_ACCOUNTS * 3, FMT(prefix, ".assetProof"))),
+          pathUpdate(
             pb,
             TREE_DEPTH_ACCOUNTS,
             address,
             leafBefore.result(),
-            merkleRoot,
-            proof,
-            FMT(prefix, ".pathBefore")),
-          rootCalculatorAfter( //
-            pb,
-            TREE_DEPTH_ACCOUNTS,
-            address,
             leafAfter.result(),
+            merkleRoot,
             proof,
-            FMT(prefix, ".pathAfter")),
-          
-
-          assetProof(make_var_array(pb, TREE_DEPTH_ACCOUNTS * 3, FMT(prefix, ".assetProof"))),
-          assetProofVerifierBefore(
-            pb,
-            TREE_DEPTH_ACCOUNTS,
-            address,
             assetLeafBefore.result(),
-            merkleAssetRoot,
-            assetProof,
-            FMT(prefix, ".assetProofVerifierBefore")),
-          assetRootCalculatorAfter( //
-            pb,
-            TREE_DEPTH_ACCOUNTS,
-            address,
             assetLeafAfter.result(),
+            merkleAssetRoot,
             assetProof,
-            FMT(prefix, ".assetRootCalculatorAfter"))
+            FMT(prefix, ".pathUpdate"))
     {
         std::cout << "in UpdateAccountGadget" << std::endl;
     }
 
     void generate_r1cs_witness(const AccountUpdate &update)
     {
+        ProfileWitness profile(annotation_prefix);
         leafBefore.generate_r1cs_witness();
         leafAfter.generate_r1cs_witness();
 
@@ -232,50 +211,43 @@ class UpdateAccountGadget : public GadgetT
         assetLeafAfter.generate_r1cs_witness();
 
         proof.fill_with_field_elements(pb, update.proof.data);
-        proofVerifierBefore.generate_r1cs_witness();
-        rootCalculatorAfter.generate_r1cs_witness();
-
         assetProof.fill_with_field_elements(pb, update.assetProof.data);
-        assetProofVerifierBefore.generate_r1cs_witness();
-        assetRootCalculatorAfter.generate_r1cs_witness();
+        pathUpdate.generate_r1cs_witness();
         
-        if (pb.val(rootCalculatorAfter.result()) != update.rootAfter)
+        if (pb.val(pathUpdate.result()) != update.rootAfter)
         {
             printAccount(pb, valuesBefore);
             printAccount(pb, valuesAfter);
-            ASSERT(pb.val(rootCalculatorAfter.result()) == update.rootAfter, annotation_prefix);
+            ASSERT(pb.val(pathUpdate.result()) == update.rootAfter, annotation_prefix);
         }
-        if (pb.val(assetRootCalculatorAfter.result()) != update.assetRootAfter)
+        if (pb.val(pathUpdate.secondResult()) != update.assetRootAfter)
         {
             printAccount(pb, valuesBefore);
             printAccount(pb, valuesAfter);
-            ASSERT(pb.val(assetRootCalculatorAfter.result()) == update.assetRootAfter, annotation_prefix);
+            ASSERT(pb.val(pathUpdate.secondResult()) == update.assetRootAfter, annotation_prefix);
         }
     }
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         leafBefore.generate_r1cs_constraints();
         leafAfter.generate_r1cs_constraints();
 
         assetLeafBefore.generate_r1cs_constraints();
         assetLeafAfter.generate_r1cs_constraints();
 
-        proofVerifierBefore.generate_r1cs_constraints();
-        rootCalculatorAfter.generate_r1cs_constraints();
-
-        assetProofVerifierBefore.generate_r1cs_constraints();
-        assetRootCalculatorAfter.generate_r1cs_constraints();
+        pathUpdate.generate_r1cs_constraints();
     }
 
     const VariableT &result() const
     {
-        return rootCalculatorAfter.result();
+        return pathUpdate.result();
     }
 
     const VariableT &assetResult() const
     {
-        return assetRootCalculatorAfter.result();
+        return pathUpdate.secondResult();
     }
 };
 
@@ -321,8 +293,7 @@ class UpdateBalanceGadget : public GadgetT
     BalanceState valuesAfter;
 
     const VariableArrayT proof;
-    MerklePathCheckT proofVerifierBefore;
-    MerklePathT rootCalculatorAfter;
+    MerklePathUpdateT pathUpdate;
 
     UpdateBalanceGadget(
       ProtoboardT &pb,
@@ -346,57 +317,139 @@ class UpdateBalanceGadget : public GadgetT
             FMT(prefix, ".leafAfter")),
 
           proof(make_var_array(pb, TREE_DEPTH_TOKENS * 3, FMT(prefix, ".proof"))),
-          proofVerifierBefore(
+          pathUpdate(
             pb,
             TREE_DEPTH_TOKENS,
             tokenID,
             leafBefore.result(),
-            merkleRoot,
-            proof,
-            FMT(prefix, ".pathBefore")),
-          rootCalculatorAfter( //
-            pb,
-            TREE_DEPTH_TOKENS,
-            tokenID,
             leafAfter.result(),
+            merkleRoot,
             proof,
-            FMT(prefix, ".pathAfter"))
+            FMT(prefix, ".pathUpdate"))
     {
         LOG(LogDebug, "in UpdateBalanceGadget", "");
     }
 
     void generate_r1cs_witness(const BalanceUpdate &update)
     {
+        ProfileWitness profile(annotation_prefix);
         leafBefore.generate_r1cs_witness();
         leafAfter.generate_r1cs_witness();
 
         proof.fill_with_field_elements(pb, update.proof.data);
-        proofVerifierBefore.generate_r1cs_witness();
-        rootCalculatorAfter.generate_r1cs_witness();
+        pathUpdate.generate_r1cs_witness();
  
-        ASSERT(pb.val(proofVerifierBefore.m_expected_root) == update.rootBefore, annotation_prefix);
-        if (pb.val(rootCalculatorAfter.result()) != update.rootAfter)
+        ASSERT(pb.val(pathUpdate.m_expected_root) == update.rootBefore, annotation_prefix);
+        if (pb.val(pathUpdate.result()) != update.rootAfter)
         {
             printBalance(pb, valuesBefore);
             printBalance(pb, valuesAfter);
-            ASSERT(pb.val(rootCalculatorAfter.result()) == update.rootAfter, annotation_prefix);
+            ASSERT(pb.val(pathUpdate.result()) == update.rootAfter, annotation_prefix);
         }
     }
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         leafBefore.generate_r1cs_constraints();
         leafAfter.generate_r1cs_constraints();
 
-        proofVerifierBefore.generate_r1cs_constraints();
-        rootCalculatorAfter.generate_r1cs_constraints();
+        pathUpdate.generate_r1cs_constraints();
     }
 
     const VariableT &result() const
     {
-        return rootCalculatorAfter.result();
+        return pathUpdate.result();
+    }
+};
+
+// Operator balances of a block kept in a table of (tokenID, balance) pairs instead of in the Merkle tree
+// (see BlockLayout::numOperatorFeeTokens). Reads the balance of the token from the table, checks it against
+// the balance the transaction started from and updates the table with the new balance. The token needs to
+// be in the table exactly once.
+class OperatorBalanceLookupGadget : public GadgetT
+{
+  public:
+    const VariableArrayT tableTokenIDs;
+    const VariableArrayT tableBalances;
+    const VariableT balanceBefore;
+    const VariableT balanceAfter;
+
+    FromBitsGadget tokenID;
+    std::vector<EqualGadget> isToken;
+    // Balance of the entry of the token, 0 for all other entries
+    VariableArrayT selectedBalances;
+    VariableArrayT tableBalancesAfter;
+
+    OperatorBalanceLookupGadget(
+      ProtoboardT &pb,
+      const VariableArrayT &_tableTokenIDs,
+      const VariableArrayT &_tableBalances,
+      const VariableArrayT &address,
+      const VariableT &_balanceBefore,
+      const VariableT &_balanceAfter,
+      const std::string &prefix)
+        : GadgetT(pb, prefix),
+
+          tableTokenIDs(_tableTokenIDs),
+          tableBalances(_tableBalances),
+          balanceBefore(_balanceBefore),
+          balanceAfter(_balanceAfter),
+
+          tokenID(pb, address, FMT(prefix, ".tokenID")),
+          selectedBalances(make_var_array(pb, _tableTokenIDs.size(), FMT(prefix, ".selectedBalances"))),
+          tableBalancesAfter(make_var_array(pb, _tableTokenIDs.size(), FMT(prefix, ".tableBalancesAfter")))
+    {
+        assert(tableTokenIDs.size() == tableBalances.size());
+        isToken.reserve(tableTokenIDs.size());
+        for (unsigned int i = 0; i < tableTokenIDs.size(); i++)
+        {
+            isToken.emplace_back(pb, tokenID.packed, tableTokenIDs[i], FMT(prefix, ".isToken"));
+        }
+    }
+
+    void generate_r1cs_witness()
+    {
+        tokenID.generate_r1cs_witness();
+        for (unsigned int i = 0; i < isToken.size(); i++)
+        {
+            isToken[i].generate_r1cs_witness();
+            pb.val(selectedBalances[i]) = pb.val(isToken[i].result()) * pb.val(tableBalances[i]);
+            pb.val(tableBalancesAfter[i]) =
+              pb.val(tableBalances[i]) + pb.val(isToken[i].result()) * (pb.val(balanceAfter) - pb.val(balanceBefore));
+        }
+    }
+
+    void generate_r1cs_constraints()
+    {
+        // The address bits are already constrained by the transaction
+        tokenID.generate_r1cs_constraints(false);
+        libsnark::linear_combination<FieldT> numMatches;
+        libsnark::linear_combination<FieldT> selectedBalance;
+        for (unsigned int i = 0; i < isToken.size(); i++)
+        {
+            isToken[i].generate_r1cs_constraints();
+            pb.add_r1cs_constraint(
+              ConstraintT(isToken[i].result(), tableBalances[i], selectedBalances[i]),
+              FMT(annotation_prefix, ".selectedBalance"));
+            pb.add_r1cs_constraint(
+              ConstraintT(isToken[i].result(), balanceAfter - balanceBefore, tableBalancesAfter[i] - tableBalances[i]),
+              FMT(annotation_prefix, ".tableBalanceAfter"));
+            numMatches = numMatches + isToken[i].result();
+            selectedBalance = selectedBalance + selectedBalances[i];
+        }
+        pb.add_r1cs_constraint(
+          ConstraintT(numMatches, FieldT::one(), FieldT::one()), FMT(annotation_prefix, ".inTable"));
+        pb.add_r1cs_constraint(
+          ConstraintT(selectedBalance, FieldT::one(), balanceBefore), FMT(annotation_prefix, ".balanceBefore"));
+    }
+
+    const VariableArrayT &result() const
+    {
+        return tableBalancesAfter;
     }
 };
+
 // Calculcate the state of a user's open position
 class DynamicBalanceGadget : public DynamicVariableGadget
 {
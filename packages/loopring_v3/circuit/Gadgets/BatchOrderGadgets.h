@@ -230,7 +230,7 @@ class RequireValidNoopOrderGadget : public GadgetT
 class BatchOrderGadget : public GadgetT
 {
   public:
-    Constants constants;
+    const Constants &constants;
     std::vector<VariableT> tokens;
     OrderGadget order;
 
@@ -494,6 +494,7 @@ class BatchOrderGadget : public GadgetT
 
     void generate_r1cs_witness(const Order &orderEntity)
     {
+        ProfileWitness profile(annotation_prefix);
         // Inputs
         LOG(LogDebug, "in BatchOrderGadget", "generate_r1cs_witness");
         order.generate_r1cs_witness(orderEntity);
@@ -548,6 +549,7 @@ class BatchOrderGadget : public GadgetT
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         order.generate_r1cs_constraints();
 
         isNoop.generate_r1cs_constraints(true);
@@ -773,13 +775,13 @@ class BatchTokenAmountSumGadget : public GadgetT
         {
             for (size_t i = 0; i < tokenAmounts.size(); i++) 
             {
-                forwardSignsSelect.emplace_back(pb, tokenSigns[i], constants._1, std::string("forwardSignsSelect_") + std::to_string(i));
-                forwardAmountsSelect.emplace_back(pb, forwardSignsSelect.back().result(), tokenAmounts[i], constants._0, std::string("forwardAmountsSelect_") + std::to_string(i));
-                forwardAmounts.emplace_back(pb, (i == 0) ? constants._0 : forwardAmounts.back().result(), forwardAmountsSelect.back().result(), n, std::string("forwardAmounts_") + std::to_string(i));
+                forwardSignsSelect.emplace_back(pb, tokenSigns[i], constants._1, FMT(prefix, ".forwardSignsSelect_%zu", i));
+                forwardAmountsSelect.emplace_back(pb, forwardSignsSelect.back().result(), tokenAmounts[i], constants._0, FMT(prefix, ".forwardAmountsSelect_%zu", i));
+                forwardAmounts.emplace_back(pb, (i == 0) ? constants._0 : forwardAmounts.back().result(), forwardAmountsSelect.back().result(), n, FMT(prefix, ".forwardAmounts_%zu", i));
                 
-                reverseSignsSelect.emplace_back(pb, tokenSigns[i], constants._2, std::string("reverseSignsSelect_") + std::to_string(i));
-                reverseAmountsSelect.emplace_back(pb, reverseSignsSelect.back().result(), tokenAmounts[i], constants._0, std::string("reverseAmountsSelect_") + std::to_string(i));
-                reverseAmounts.emplace_back(pb, (i == 0) ? constants._0 : reverseAmounts.back().result(), reverseAmountsSelect.back().result(), n, std::string("reverseAmounts_") + std::to_string(i));
+                reverseSignsSelect.emplace_back(pb, tokenSigns[i], constants._2, FMT(prefix, ".reverseSignsSelect_%zu", i));
+                reverseAmountsSelect.emplace_back(pb, reverseSignsSelect.back().result(), tokenAmounts[i], constants._0, FMT(prefix, ".reverseAmountsSelect_%zu", i));
+                reverseAmounts.emplace_back(pb, (i == 0) ? constants._0 : reverseAmounts.back().result(), reverseAmountsSelect.back().result(), n, FMT(prefix, ".reverseAmounts_%zu", i));
             }
         }
         void generate_r1cs_witness() 
@@ -1233,18 +1235,17 @@ class BatchUserGadget: public GadgetT
 {
     public:
         std::vector<VariableT> tokens;
-        std::vector<StorageGadget> storageGadgets;
         ToBitsGadget firstToken;
         ToBitsGadget secondToken;
         ToBitsGadget thirdToken;
         DualVariableGadget accountID;
         // DualVariableGadget isNoop;
 
-        Constants constants;
+        const Constants &constants;
         VariableT timestamp;
         VariableT blockExchange;
         VariableT maxTradingFeeBips;
-        BaseTransactionAccountState account;
+        const BaseTransactionAccountState &account;
         VariableT type;
         VariableT isBatchSpotTradeTx;
         // EqualGadget isBatchSpotTradeTx;
@@ -1338,7 +1339,6 @@ class BatchUserGadget: public GadgetT
                 : GadgetT(pb, prefix),
                 timestamp(_timestamp),
                 tokens(_tokens),
-                storageGadgets(_storageGadgets),
                 account(_account),
                 type(_type),
                 isBatchSpotTradeTx(_isBatchSpotTradeTx),
@@ -1367,9 +1367,11 @@ class BatchUserGadget: public GadgetT
             std::vector<VariableT> tokenOneSigns;
             std::vector<VariableT> tokenTwoSigns;
             std::vector<VariableT> tokenThreeSigns;
+            // The nested gadgets refer to each other, the orders can't be moved
+            orders.reserve(orderSize);
             for (unsigned int i = 0; i < orderSize; i++) 
             {   
-                orders.emplace_back(pb, constants, timestamp, blockExchange, storageGadgets[i], maxTradingFeeBips, tokens, account, isBatchSpotTradeTx, prefix + std::string(".ordersize:") + std::to_string(orderSize) + std::string(".BatchUserGadget order_") + std::to_string(i));
+                orders.emplace_back(pb, constants, timestamp, blockExchange, _storageGadgets[i], maxTradingFeeBips, tokens, account, isBatchSpotTradeTx, FMT(prefix, ".ordersize:%u.BatchUserGadget order_%u", orderSize, i));
 
                 // set signature information
                 hashArray.emplace_back(orders[i].hash());
@@ -1391,21 +1393,21 @@ class BatchUserGadget: public GadgetT
                     (i == 0) ? constants._0 : tokenOneTradingFeeAmount.back().result(),
                     orders[i].getSelectTokenOneTradingFee(),
                     NUM_BITS_AMOUNT,
-                    std::string(".tokenOneTradingFeeAmount_") + std::to_string(i));
+                    FMT(prefix, ".tokenOneTradingFeeAmount_%u", i));
                 
                 tokenTwoTradingFeeAmount.emplace_back(
                     pb,
                     (i == 0) ? constants._0 : tokenTwoTradingFeeAmount.back().result(),
                     orders[i].getSelectTokenTwoTradingFee(),
                     NUM_BITS_AMOUNT,
-                    std::string(".tokenTwoTradingFeeAmount_") + std::to_string(i));
+                    FMT(prefix, ".tokenTwoTradingFeeAmount_%u", i));
 
                 tokenThreeTradingFeeAmount.emplace_back(
                     pb,
                     (i == 0) ? constants._0 : tokenThreeTradingFeeAmount.back().result(),
                     orders[i].getSelectTokenThreeTradingFee(),
                     NUM_BITS_AMOUNT,
-                    std::string(".tokenThreeTradingFeeAmount_") + std::to_string(i));
+                    FMT(prefix, ".tokenThreeTradingFeeAmount_%u", i));
 
                 // add up GasFee
                 tokenOneGasFeeAmount.emplace_back(
@@ -1413,26 +1415,26 @@ class BatchUserGadget: public GadgetT
                     (i == 0) ? constants._0 : tokenOneGasFeeAmount.back().result(),
                     orders[i].getSelectTokenOneGasFee(),
                     NUM_BITS_AMOUNT,
-                    std::string(".tokenOneGasFeeAmount_") + std::to_string(i));
+                    FMT(prefix, ".tokenOneGasFeeAmount_%u", i));
                 tokenTwoGasFeeAmount.emplace_back(
                     pb,
                     (i == 0) ? constants._0 : tokenTwoGasFeeAmount.back().result(),
                     orders[i].getSelectTokenTwoGasFee(),
                     NUM_BITS_AMOUNT,
-                    std::string(".tokenTwoGasFeeAmount_") + std::to_string(i));
+                    FMT(prefix, ".tokenTwoGasFeeAmount_%u", i));
                 tokenThreeGasFeeAmount.emplace_back(
                     pb,
                     (i == 0) ? constants._0 : tokenThreeGasFeeAmount.back().result(),
                     orders[i].getSelectTokenThreeGasFee(),
                     NUM_BITS_AMOUNT,
-                    std::string(".tokenThreeGasFeeAmount_") + std::to_string(i));
+                    FMT(prefix, ".tokenThreeGasFeeAmount_%u", i));
 
                 requireAccountsEqual.emplace_back(
                     pb,
                     orders.back().isNotNoop.result(),
                     accountID.packed,
                     orders.back().order.accountID.packed,
-                    std::string(".requireAccountsEqual_") + std::to_string(i));
+                    FMT(prefix, ".requireAccountsEqual_%u", i));
             }
             
             // Execute the accumulation operation according to the sign. Sign = = 1 is added to forward, sign = = 2 is added to reverse, 
@@ -1524,6 +1526,7 @@ class BatchUserGadget: public GadgetT
 
         void generate_r1cs_witness(const BatchSpotTradeUser &user)
         {
+            ProfileWitness profile(annotation_prefix);
             LOG(LogDebug, "in BatchUserGadget generate_r1cs_witness", "");
             firstToken.generate_r1cs_witness();
             secondToken.generate_r1cs_witness();
@@ -1591,6 +1594,7 @@ class BatchUserGadget: public GadgetT
         }
         void generate_r1cs_constraints() 
         {
+            ProfileConstraints profile(pb, annotation_prefix);
             LOG(LogDebug, "in BatchUserGadget", "generate_r1cs_constraints");
             firstToken.generate_r1cs_constraints();
             secondToken.generate_r1cs_constraints();
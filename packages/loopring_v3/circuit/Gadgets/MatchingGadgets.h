@@ -433,6 +433,7 @@ class OrderMatchingGadget : public GadgetT
 
     void generate_r1cs_witness()
     {
+        ProfileWitness profile(annotation_prefix);
         // Check if the fills are valid for the orders
         requireOrderFillsA.generate_r1cs_witness();
         requireOrderFillsB.generate_r1cs_witness();
@@ -452,6 +453,7 @@ class OrderMatchingGadget : public GadgetT
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         // Check if the fills are valid for the orders
         requireOrderFillsA.generate_r1cs_constraints();
         requireOrderFillsB.generate_r1cs_constraints();
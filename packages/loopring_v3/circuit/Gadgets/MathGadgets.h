@@ -4,8 +4,10 @@
 #ifndef _MATHGADGETS_H_
 #define _MATHGADGETS_H_
 
+#include "../Utils/Annotations.h"
 #include "../Utils/Constants.h"
 #include "../Utils/Data.h"
+#include "../Utils/Profiler.h"
 
 #include "ethsnarks.hpp"
 #include "utils.hpp"
@@ -51,7 +53,27 @@ static void requireEqual( //
       FMT(annotation_prefix, ".requireEqual"));
 }
 
-// Constants stored in a VariableT for ease of use
+// A constant as a linear term of the constant one variable, needs no variable or constraint
+static libsnark::linear_term<FieldT> constantTerm(const FieldT &value)
+{
+    return libsnark::linear_term<FieldT>(VariableT(0), value);
+}
+
+// The value of a variable or constant linear term
+static FieldT termValue(const ProtoboardT &pb, const libsnark::linear_term<FieldT> &term)
+{
+    const FieldT value = pb.val(VariableT(term.index));
+    return (term.coeff == FieldT::one()) ? value : term.coeff * value;
+}
+
+// Constants stored in a VariableT for ease of use.
+// _1 is the constant term of the protoboard (variable 0), so it is free. The other constants need to be
+// allocated and constrained because most gadgets take their inputs as variables. TernaryGadget and the select
+// gadgets also take constants directly (see constantTerm).
+// _0 and the small integers stay variables for now: they are passed as VariableT/VariableArrayT to the packing,
+// Merkle, Poseidon and padding code, which can't take a constant. Each one is a single variable and constraint
+// per circuit (not per slot), and with layout.optimizeConstraints the ConstraintSystemOptimizer substitutes
+// them in all constraints.
 class Constants : public GadgetT
 {
   public:
@@ -74,23 +96,16 @@ class Constants : public GadgetT
     const VariableT _16;
     const VariableT _17;
 
-    const VariableT _100;
     const VariableT _1000;
     const VariableT _1001;
     const VariableT _10000;
-    const VariableT _100000;
     const VariableT _2Pow30;
-    const VariableT fixedBase;
-    const VariableT emptyStorage;
-    const VariableT maxAmount;
-    const VariableT numStorageSlots;
     const VariableT txTypeSpotTrade;
     const VariableT txTypeBatchSpotTrade;
     const VariableT txTypeTransfer;
     const VariableT txTypeWithdrawal;
     const VariableT txTypeOrderCancel;
     const VariableT txTypeAppKeyUpdate;
-    const VariableT feeMultiplier;
 
     const VariableT depositType;
     const VariableT accountUpdateType;
@@ -106,7 +121,7 @@ class Constants : public GadgetT
         : GadgetT(pb, prefix),
 
           _0(make_variable(pb, FieldT::zero(), FMT(prefix, ".zero"))),
-          _1(make_variable(pb, FieldT::one(), FMT(prefix, ".one"))),
+          _1(VariableT(0)),
           _2(make_variable(pb, ethsnarks::FieldT(2), FMT(prefix, ".two"))),
           _3(make_variable(pb, ethsnarks::FieldT(3), FMT(prefix, ".three"))),
           _4(make_variable(pb, ethsnarks::FieldT(4), FMT(prefix, ".four"))),
@@ -124,16 +139,10 @@ class Constants : public GadgetT
           _16(make_variable(pb, ethsnarks::FieldT(16), FMT(prefix, ".16"))),
           _17(make_variable(pb, ethsnarks::FieldT(17), FMT(prefix, ".17"))),
 
-          _100(make_variable(pb, ethsnarks::FieldT(100), FMT(prefix, "._100"))),
           _1000(make_variable(pb, ethsnarks::FieldT(1000), FMT(prefix, "._1000"))),
           _1001(make_variable(pb, ethsnarks::FieldT(1001), FMT(prefix, "._1001"))),
           _10000(make_variable(pb, ethsnarks::FieldT(10000), FMT(prefix, "._10000"))),
-          _100000(make_variable(pb, ethsnarks::FieldT(100000), FMT(prefix, "._100000"))),
           _2Pow30(make_variable(pb, ethsnarks::FieldT(1073741824), FMT(prefix, "._2Pow30"))),
-          fixedBase(make_variable(pb, ethsnarks::FieldT(FIXED_BASE), FMT(prefix, ".fixedBase"))),
-          emptyStorage(make_variable(pb, ethsnarks::FieldT(EMPTY_TRADE_HISTORY), FMT(prefix, ".emptyStorage"))),
-          maxAmount(make_variable(pb, ethsnarks::FieldT(MAX_AMOUNT), FMT(prefix, ".maxAmount"))),
-          numStorageSlots(make_variable(pb, ethsnarks::FieldT(NUM_STORAGE_SLOTS), FMT(prefix, ".numStorageSlots"))),
           txTypeSpotTrade(
             make_variable(pb, ethsnarks::FieldT(int(TransactionType::SpotTrade)), FMT(prefix, ".txTypeSpotTrade"))),
           txTypeBatchSpotTrade(
@@ -147,7 +156,6 @@ class Constants : public GadgetT
             make_variable(pb, ethsnarks::FieldT(int(TransactionType::OrderCancel)), FMT(prefix, ".txTypeOrderCancel"))),
           txTypeAppKeyUpdate(
             make_variable(pb, ethsnarks::FieldT(int(TransactionType::AppKeyUpdate)), FMT(prefix, ".txTypeAppKeyUpdate"))),
-          feeMultiplier(make_variable(pb, ethsnarks::FieldT(FEE_MULTIPLIER), FMT(prefix, ".feeMultiplier"))),
 
           depositType(make_variable(pb, ethsnarks::FieldT(6), FMT(prefix, ".depositType"))),
           accountUpdateType(make_variable(pb, ethsnarks::FieldT(7), FMT(prefix, ".accountUpdateType"))),
@@ -185,7 +193,6 @@ class Constants : public GadgetT
     void generate_r1cs_constraints()
     {
         pb.add_r1cs_constraint(ConstraintT(_0, FieldT::one(), FieldT::zero()), ".zero");
-        pb.add_r1cs_constraint(ConstraintT(_1, FieldT::one(), FieldT::one()), ".one");
         pb.add_r1cs_constraint(ConstraintT(_2, FieldT::one(), FieldT(2)), ".two");
         pb.add_r1cs_constraint(ConstraintT(_3, FieldT::one(), FieldT(3)), ".three");
         pb.add_r1cs_constraint(ConstraintT(_4, FieldT::one(), FieldT(4)), ".four");
@@ -203,18 +210,10 @@ class Constants : public GadgetT
         pb.add_r1cs_constraint(ConstraintT(_16, FieldT::one(), FieldT(16)), ".16");
         pb.add_r1cs_constraint(ConstraintT(_17, FieldT::one(), FieldT(17)), ".17");
 
-        pb.add_r1cs_constraint(ConstraintT(_100, FieldT::one(), ethsnarks::FieldT(100)), "._100");
         pb.add_r1cs_constraint(ConstraintT(_1000, FieldT::one(), ethsnarks::FieldT(1000)), "._1000");
         pb.add_r1cs_constraint(ConstraintT(_1001, FieldT::one(), ethsnarks::FieldT(1001)), "._1001");
         pb.add_r1cs_constraint(ConstraintT(_10000, FieldT::one(), ethsnarks::FieldT(10000)), "._10000");
-        pb.add_r1cs_constraint(ConstraintT(_100000, FieldT::one(), ethsnarks::FieldT(100000)), "._100000");
         pb.add_r1cs_constraint(ConstraintT(_2Pow30, FieldT::one(), ethsnarks::FieldT(1073741824)), "._2Pow30");
-        pb.add_r1cs_constraint(ConstraintT(fixedBase, FieldT::one(), ethsnarks::FieldT(FIXED_BASE)), ".fixedBase");
-        pb.add_r1cs_constraint(
-          ConstraintT(emptyStorage, FieldT::one(), ethsnarks::FieldT(EMPTY_TRADE_HISTORY)), ".emptyStorage");
-        pb.add_r1cs_constraint(ConstraintT(maxAmount, FieldT::one(), ethsnarks::FieldT(MAX_AMOUNT)), ".maxAmount");
-        pb.add_r1cs_constraint(
-          ConstraintT(numStorageSlots, FieldT::one(), ethsnarks::FieldT(NUM_STORAGE_SLOTS)), ".numStorageSlots");
         pb.add_r1cs_constraint(
           ConstraintT(txTypeSpotTrade, FieldT::one(), ethsnarks::FieldT(int(TransactionType::SpotTrade))),
           ".txTypeSpotTrade");
@@ -231,9 +230,6 @@ class Constants : public GadgetT
         pb.add_r1cs_constraint(
           ConstraintT(txTypeAppKeyUpdate, FieldT::one(), ethsnarks::FieldT(int(TransactionType::AppKeyUpdate))),
           ".txTypeAppKeyUpdate");
-          
-        pb.add_r1cs_constraint(
-          ConstraintT(feeMultiplier, FieldT::one(), ethsnarks::FieldT(FEE_MULTIPLIER)), ".feeMultiplier");
 
         pb.add_r1cs_constraint(ConstraintT(depositType, FieldT::one(), FieldT(6)), ".depositType");
         pb.add_r1cs_constraint(ConstraintT(accountUpdateType, FieldT::one(), FieldT(7)), ".accountUpdateType");
@@ -730,20 +726,21 @@ class BalanceIncreaseGadget : public GadgetT
     }
 };
 // b ? A : B
+// A and B are variables or constants (constantTerm), a constant is not added to the constraint when it is 0.
 class TernaryGadget : public GadgetT
 {
   public:
     VariableT b;
-    VariableT x;
-    VariableT y;
+    libsnark::linear_term<FieldT> x;
+    libsnark::linear_term<FieldT> y;
 
     VariableT selected;
 
     TernaryGadget(
       ProtoboardT &pb,
       const VariableT &_b,
-      const VariableT &_x,
-      const VariableT &_y,
+      const libsnark::linear_term<FieldT> &_x,
+      const libsnark::linear_term<FieldT> &_y,
       const std::string &prefix)
         : GadgetT(pb, prefix),
 
@@ -762,7 +759,7 @@ class TernaryGadget : public GadgetT
 
     void generate_r1cs_witness()
     {
-        pb.val(selected) = (pb.val(b) == FieldT::one()) ? pb.val(x) : pb.val(y);
+        pb.val(selected) = (pb.val(b) == FieldT::one()) ? termValue(pb, x) : termValue(pb, y);
     }
 
     void generate_r1cs_constraints(bool enforceBitness = true)
@@ -772,7 +769,22 @@ class TernaryGadget : public GadgetT
             libsnark::generate_boolean_r1cs_constraint<ethsnarks::FieldT>(pb, b, FMT(annotation_prefix, ".bitness"));
         }
         pb.add_r1cs_constraint(
-          ConstraintT(b, y - x, y - selected), FMT(annotation_prefix, ".b * (y - x) == (y - selected)"));
+          ConstraintT(b, withoutZeroTerms(y - x), withoutZeroTerms(y - selected)),
+          FMT(annotation_prefix, ".b * (y - x) == (y - selected)"));
+    }
+
+  private:
+    static libsnark::linear_combination<FieldT> withoutZeroTerms(const libsnark::linear_combination<FieldT> &lc)
+    {
+        libsnark::linear_combination<FieldT> result;
+        for (const auto &term : lc.getTerms())
+        {
+            if (term.coeff != FieldT::zero())
+            {
+                result.add_term(VariableT(term.index), term.coeff);
+            }
+        }
+        return result;
     }
 };
 
@@ -801,6 +813,23 @@ class ArrayTernaryGadget : public GadgetT
         }
     }
 
+    // b ? A[] : [c, c, ...]
+    ArrayTernaryGadget(
+      ProtoboardT &pb,
+      const VariableT &_b,
+      const VariableArrayT &x,
+      const libsnark::linear_term<FieldT> &y,
+      const std::string &prefix)
+        : GadgetT(pb, prefix), b(_b)
+    {
+        results.reserve(x.size());
+        for (unsigned int i = 0; i < x.size(); i++)
+        {
+            results.emplace_back(pb, b, x[i], y, FMT(prefix, ".results"));
+            res.emplace_back(results.back().result());
+        }
+    }
+
     void generate_r1cs_witness()
     {
         for (unsigned int i = 0; i < results.size(); i++)
@@ -852,6 +881,23 @@ class VectorArrayTernaryGadget : public GadgetT
         }
     }
 
+    // b ? A[][] : [[c, c, ...], ...]
+    VectorArrayTernaryGadget(
+      ProtoboardT &pb,
+      const VariableT &_b,
+      const std::vector<VariableArrayT> &x,
+      const libsnark::linear_term<FieldT> &y,
+      const std::string &prefix)
+        : GadgetT(pb, prefix), b(_b)
+    {
+        results.reserve(x.size());
+        for (unsigned int i = 0; i < x.size(); i++)
+        {
+            results.emplace_back(pb, b, x[i], y, FMT(prefix, ".results"));
+            res.emplace_back(results.back().result());
+        }
+    }
+
     void generate_r1cs_witness()
     {
         for (unsigned int i = 0; i < results.size(); i++)
@@ -2457,6 +2503,7 @@ class PublicDataGadget : public GadgetT
 
     void generate_r1cs_witness()
     {
+        ProfileWitness profile(annotation_prefix);
         // Calculate the hash
         hasher->generate_r1cs_witness();
 
@@ -2471,6 +2518,7 @@ class PublicDataGadget : public GadgetT
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         // Calculate the hash
         hasher.reset(new sha256_many(pb, publicDataBits, ".hasher"));
         hasher->generate_r1cs_constraints();
@@ -2488,44 +2536,54 @@ class OnChainDataHashGadget : public GadgetT
   public:
     VariableArrayT publicDataBits;
 
-    std::unique_ptr<sha256_many> hasher;
-    std::unique_ptr<FromBitsGadget> calculatedHash;
+    sha256_many hasher;
+    FromBitsGadget calculatedHash;
+
+    // The bits of every part are hashed in reverse order
     OnChainDataHashGadget( //
       ProtoboardT &pb,
+      const std::vector<VariableArrayT> &parts,
       const std::string &prefix)
-        : GadgetT(pb, prefix)
-    {
-    }
+        : GadgetT(pb, prefix),
 
-    void add(const VariableArrayT &bits)
+          publicDataBits(reverseParts(parts)),
+          hasher(pb, publicDataBits, ".hasher"),
+          // Check that the hash matches the public input, take the top 40 hex
+          calculatedHash(pb, reverse(subArray(hasher.result().bits, 0, NUM_BITS_HASH)), ".packCalculatedHash")
     {
-        publicDataBits.insert(publicDataBits.end(), bits.rbegin(), bits.rend());
     }
 
     void generate_r1cs_witness() 
     {
       // Calculate the hash
-      hasher->generate_r1cs_witness();
+      hasher.generate_r1cs_witness();
 
       // Calculate the expected public input
-      calculatedHash->generate_r1cs_witness_from_bits();
+      calculatedHash.generate_r1cs_witness_from_bits();
     }
 
     void generate_r1cs_constraints() 
     {
       // Calculate the hash
-      hasher.reset(new sha256_many(pb, publicDataBits, ".hasher"));
-      hasher->generate_r1cs_constraints();
+      hasher.generate_r1cs_constraints();
 
-      // Check that the hash matches the public input, take the top 40 hex
-      calculatedHash.reset(new FromBitsGadget(
-        pb, reverse(subArray(hasher->result().bits, 0, NUM_BITS_HASH)), ".packCalculatedHash"));
-      calculatedHash->generate_r1cs_constraints(false);
+      calculatedHash.generate_r1cs_constraints(false);
     }
 
     const VariableT &result() const
     {
-        return calculatedHash->packed;
+        return calculatedHash.packed;
+    }
+
+  private:
+    static VariableArrayT reverseParts(const std::vector<VariableArrayT> &parts)
+    {
+        VariableArrayT bits;
+        for (const VariableArrayT &part : parts)
+        {
+            bits.insert(bits.end(), part.rbegin(), part.rend());
+        }
+        return bits;
     }
 };
 
@@ -2573,6 +2631,7 @@ class FloatGadget : public GadgetT
 
     void generate_r1cs_witness(const ethsnarks::FieldT &floatValue)
     {
+        ProfileWitness profile(annotation_prefix);
         f.fill_with_bits_of_field_element(pb, floatValue);
 
         // Decodes the mantissa
@@ -2599,6 +2658,7 @@ class FloatGadget : public GadgetT
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         // Make sure all the bits of the float or 0s and 1s
         for (unsigned int i = 0; i < f.size(); i++)
         {
@@ -2613,13 +2673,13 @@ class FloatGadget : public GadgetT
             {
                 pb.add_r1cs_constraint(
                   ConstraintT(f[j], FieldT::one(), values[i]),
-                  FMT(annotation_prefix, (std::string(".value_") + std::to_string(i)).c_str()));
+                  FMT(annotation_prefix, ".value_%u", i));
             }
             else
             {
                 pb.add_r1cs_constraint(
                   ConstraintT(values[i - 1] * 2 + f[j], FieldT::one(), values[i]),
-                  FMT(annotation_prefix, (std::string(".value_") + std::to_string(i)).c_str()));
+                  FMT(annotation_prefix, ".value_%u", i));
             }
         }
 
@@ -2702,6 +2762,7 @@ class FloatFromBitsGadget : public GadgetT
 
     void generate_r1cs_witness()
     {
+        ProfileWitness profile(annotation_prefix);
         // Decodes the mantissa
         for (unsigned int i = 0; i < floatEncoding.numBitsMantissa; i++)
         {
@@ -2725,6 +2786,7 @@ class FloatFromBitsGadget : public GadgetT
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         // Make sure all the bits of the float or 0s and 1s
         for (unsigned int i = 0; i < f.size(); i++)
         {
@@ -2739,13 +2801,13 @@ class FloatFromBitsGadget : public GadgetT
             {
                 pb.add_r1cs_constraint(
                   ConstraintT(f[j], FieldT::one(), values[i]),
-                  FMT(annotation_prefix, (std::string(".value_") + std::to_string(i)).c_str()));
+                  FMT(annotation_prefix, ".value_%u", i));
             }
             else
             {
                 pb.add_r1cs_constraint(
                   ConstraintT(values[i - 1] * 2 + f[j], FieldT::one(), values[i]),
-                  FMT(annotation_prefix, (std::string(".value_") + std::to_string(i)).c_str()));
+                  FMT(annotation_prefix, ".value_%u", i));
             }
         }
 
@@ -2860,10 +2922,15 @@ class SelectGadget : public GadgetT
         : GadgetT(pb, prefix)
     {
         assert(values.size() == selector.size());
+        results.reserve(values.size());
         for (unsigned int i = 0; i < values.size(); i++)
         {
             results.emplace_back(
-              pb, selector[i], values[i], (i == 0) ? _constants._0 : results.back().result(), FMT(prefix, ".results"));
+              pb,
+              selector[i],
+              values[i],
+              (i == 0) ? constantTerm(FieldT::zero()) : libsnark::linear_term<FieldT>(results.back().result()),
+              FMT(prefix, ".results"));
         }
     }
 
@@ -2905,14 +2972,17 @@ class ArraySelectGadget : public GadgetT
         : GadgetT(pb, prefix)
     {
         assert(values.size() == selector.size());
+        results.reserve(values.size());
         for (unsigned int i = 0; i < values.size(); i++)
         {
-            results.emplace_back(
-              pb,
-              selector[i],
-              values[i],
-              (i == 0) ? VariableArrayT(values[0].size(), _constants._0) : results.back().result(),
-              FMT(prefix, ".results"));
+            if (i == 0)
+            {
+                results.emplace_back(pb, selector[i], values[i], constantTerm(FieldT::zero()), FMT(prefix, ".results"));
+            }
+            else
+            {
+                results.emplace_back(pb, selector[i], values[i], results.back().result(), FMT(prefix, ".results"));
+            }
         }
     }
 
@@ -2952,20 +3022,17 @@ class VectorArraySelectGadget : public GadgetT
         : GadgetT(pb, prefix)
     {
         assert(values.size() == selector.size());
-        std::vector<VariableArrayT> first;
-        for (unsigned int i = 0; i < values[0].size(); i++) 
-        {
-            first.emplace_back(VariableArrayT(values[0][0].size(), _constants._0));
-        }
-        
+        results.reserve(values.size());
         for (unsigned int i = 0; i < values.size(); i++)
         {
-            results.emplace_back(
-              pb,
-              selector[i],
-              values[i],
-              (i == 0) ? first : results.back().result(),
-              FMT(prefix, ".results"));
+            if (i == 0)
+            {
+                results.emplace_back(pb, selector[i], values[i], constantTerm(FieldT::zero()), FMT(prefix, ".results"));
+            }
+            else
+            {
+                results.emplace_back(pb, selector[i], values[i], results.back().result(), FMT(prefix, ".results"));
+            }
         }
     }
 
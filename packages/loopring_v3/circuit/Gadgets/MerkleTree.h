@@ -206,6 +206,540 @@ template <typename HashT> class merkle_path_authenticator_4 : public merkle_path
     }
 };
 
+// Same as merkle_path_selector_4, but selects the children for the old and the new node of a leaf update at
+// the same time. Both use the same address bits and siblings, so everything that only depends on these is
+// calculated once. With is0..is3 the position of x:
+// child0 = y0 + is0 * (x - y0)
+// child1 = y1 + (1 - bit1) * (y0 - y1) + is1 * (x - y0)
+// child2 = y1 + bit1 * (y2 - y1) + is2 * (x - y2)
+// child3 = y2 + is3 * (x - y2)
+class merkle_path_update_selector_4 : public GadgetT
+{
+  public:
+    const VariableT inputBefore;
+    const VariableT inputAfter;
+    const std::vector<VariableT> sideNodes;
+    const VariableT bit0;
+    const VariableT bit1;
+    // bit0_and_bit1 is constrained by another selector at the same address
+    const bool sharedPosition;
+
+    // Shared
+    VariableT bit0_and_bit1;
+    VariableT sideNodes01;
+    VariableT sideNodes21;
+
+    VariableArrayT childrenBefore;
+    VariableArrayT childrenAfter;
+
+    merkle_path_update_selector_4(
+      ProtoboardT &pb,
+      const VariableT &_inputBefore,
+      const VariableT &_inputAfter,
+      std::vector<VariableT> _sideNodes,
+      const VariableT &_bit0,
+      const VariableT &_bit1,
+      const std::string &prefix)
+        : GadgetT(pb, prefix),
+
+          inputBefore(_inputBefore),
+          inputAfter(_inputAfter),
+          sideNodes(_sideNodes),
+          bit0(_bit0),
+          bit1(_bit1),
+          sharedPosition(false),
+
+          bit0_and_bit1(make_variable(pb, FMT(prefix, ".bit0_and_bit1"))),
+          sideNodes01(make_variable(pb, FMT(prefix, ".sideNodes01"))),
+          sideNodes21(make_variable(pb, FMT(prefix, ".sideNodes21"))),
+
+          childrenBefore(make_var_array(pb, 4, FMT(prefix, ".childrenBefore"))),
+          childrenAfter(make_var_array(pb, 4, FMT(prefix, ".childrenAfter")))
+    {
+        assert(sideNodes.size() == 3);
+    }
+
+    // Selects the children of a node in another tree at the same address as `position`. Reuses its bit0_and_bit1,
+    // which saves the bit0 * bit1 constraint and variable: 10 instead of 11 constraints per level.
+    merkle_path_update_selector_4(
+      ProtoboardT &pb,
+      const VariableT &_inputBefore,
+      const VariableT &_inputAfter,
+      std::vector<VariableT> _sideNodes,
+      const merkle_path_update_selector_4 &position,
+      const std::string &prefix)
+        : GadgetT(pb, prefix),
+
+          inputBefore(_inputBefore),
+          inputAfter(_inputAfter),
+          sideNodes(_sideNodes),
+          bit0(position.bit0),
+          bit1(position.bit1),
+          sharedPosition(true),
+
+          bit0_and_bit1(position.bit0_and_bit1),
+          sideNodes01(make_variable(pb, FMT(prefix, ".sideNodes01"))),
+          sideNodes21(make_variable(pb, FMT(prefix, ".sideNodes21"))),
+
+          childrenBefore(make_var_array(pb, 4, FMT(prefix, ".childrenBefore"))),
+          childrenAfter(make_var_array(pb, 4, FMT(prefix, ".childrenAfter")))
+    {
+        assert(sideNodes.size() == 3);
+    }
+
+    void generate_r1cs_constraints()
+    {
+        if (!sharedPosition)
+        {
+            pb.add_r1cs_constraint(ConstraintT(bit0, bit1, bit0_and_bit1), FMT(annotation_prefix, ".bit0_and_bit1"));
+        }
+        pb.add_r1cs_constraint(
+          ConstraintT(FieldT::one() - bit1, sideNodes[0] - sideNodes[1], sideNodes01),
+          FMT(annotation_prefix, ".sideNodes01"));
+        pb.add_r1cs_constraint(
+          ConstraintT(bit1, sideNodes[2] - sideNodes[1], sideNodes21), FMT(annotation_prefix, ".sideNodes21"));
+
+        generateChildrenConstraints(inputBefore, childrenBefore, FMT(annotation_prefix, ".before"));
+        generateChildrenConstraints(inputAfter, childrenAfter, FMT(annotation_prefix, ".after"));
+    }
+
+    void generate_r1cs_witness()
+    {
+        pb.val(bit0_and_bit1) = pb.val(bit0) * pb.val(bit1);
+        pb.val(sideNodes01) = (FieldT::one() - pb.val(bit1)) * (pb.val(sideNodes[0]) - pb.val(sideNodes[1]));
+        pb.val(sideNodes21) = pb.val(bit1) * (pb.val(sideNodes[2]) - pb.val(sideNodes[1]));
+
+        generateChildrenWitness(inputBefore, childrenBefore);
+        generateChildrenWitness(inputAfter, childrenAfter);
+    }
+
+    std::vector<VariableT> getChildrenBefore() const
+    {
+        return {childrenBefore[0], childrenBefore[1], childrenBefore[2], childrenBefore[3]};
+    }
+
+    std::vector<VariableT> getChildrenAfter() const
+    {
+        return {childrenAfter[0], childrenAfter[1], childrenAfter[2], childrenAfter[3]};
+    }
+
+  private:
+    void generateChildrenConstraints(const VariableT &x, const VariableArrayT &children, const std::string &prefix)
+    {
+        const VariableT &y0 = sideNodes[0];
+        const VariableT &y1 = sideNodes[1];
+        const VariableT &y2 = sideNodes[2];
+        pb.add_r1cs_constraint(
+          ConstraintT(FieldT::one() - bit0 - bit1 + bit0_and_bit1, x - y0, children[0] - y0), FMT(prefix, ".child0"));
+        pb.add_r1cs_constraint(
+          ConstraintT(bit0 - bit0_and_bit1, x - y0, children[1] - y1 - sideNodes01), FMT(prefix, ".child1"));
+        pb.add_r1cs_constraint(
+          ConstraintT(bit1 - bit0_and_bit1, x - y2, children[2] - y1 - sideNodes21), FMT(prefix, ".child2"));
+        pb.add_r1cs_constraint(ConstraintT(bit0_and_bit1, x - y2, children[3] - y2), FMT(prefix, ".child3"));
+    }
+
+    void generateChildrenWitness(const VariableT &x, const VariableArrayT &children)
+    {
+        const FieldT y0 = pb.val(sideNodes[0]);
+        const FieldT y1 = pb.val(sideNodes[1]);
+        const FieldT y2 = pb.val(sideNodes[2]);
+        const FieldT b0b1 = pb.val(bit0_and_bit1);
+        const FieldT is0 = FieldT::one() - pb.val(bit0) - pb.val(bit1) + b0b1;
+        const FieldT is1 = pb.val(bit0) - b0b1;
+        const FieldT is2 = pb.val(bit1) - b0b1;
+        pb.val(children[0]) = y0 + is0 * (pb.val(x) - y0);
+        pb.val(children[1]) = y1 + pb.val(sideNodes01) + is1 * (pb.val(x) - y0);
+        pb.val(children[2]) = y1 + pb.val(sideNodes21) + is2 * (pb.val(x) - y2);
+        pb.val(children[3]) = y2 + b0b1 * (pb.val(x) - y2);
+    }
+};
+
+// Updates a leaf: verifies the old leaf against the root before and calculates the root after with the new
+// leaf. Equivalent to a merkle_path_authenticator_4 and a merkle_path_compute_4 over the same address and
+// proof, but the selection of the children is shared between both paths.
+template <typename HashT> class merkle_path_update_4 : public GadgetT
+{
+  public:
+    const VariableT m_expected_root;
+
+    std::vector<merkle_path_update_selector_4> m_selectors;
+    std::vector<HashT> m_hashersBefore;
+    std::vector<HashT> m_hashersAfter;
+
+    // in_address_bits: {0..2}[in_depth*2]
+    // in_leaf_before/in_leaf_after: The hashed leaf data before and after the update
+    // in_expected_root: The Merkle root before the update
+    // in_path: The Merkle inclusion proof values
+    merkle_path_update_4(
+      ProtoboardT &in_pb,
+      const size_t in_depth,
+      const VariableArrayT &in_address_bits,
+      const VariableT in_leaf_before,
+      const VariableT in_leaf_after,
+      const VariableT in_expected_root,
+      const VariableArrayT &in_path,
+      const std::string &in_annotation_prefix)
+        : GadgetT(in_pb, in_annotation_prefix), m_expected_root(in_expected_root)
+    {
+        assert(in_depth > 0);
+        assert(in_address_bits.size() == in_depth * 2);
+
+        m_selectors.reserve(in_depth);
+        m_hashersBefore.reserve(in_depth);
+        m_hashersAfter.reserve(in_depth);
+        for (size_t i = 0; i < in_depth; i++)
+        {
+            m_selectors.push_back(merkle_path_update_selector_4(
+              in_pb,
+              (i == 0) ? in_leaf_before : m_hashersBefore[i - 1].result(),
+              (i == 0) ? in_leaf_after : m_hashersAfter[i - 1].result(),
+              {in_path[i * 3 + 0], in_path[i * 3 + 1], in_path[i * 3 + 2]},
+              in_address_bits[i * 2 + 0],
+              in_address_bits[i * 2 + 1],
+              FMT(this->annotation_prefix, ".selector[%zu]", i)));
+
+            m_hashersBefore.emplace_back(
+              in_pb,
+              var_array(m_selectors[i].getChildrenBefore()),
+              FMT(this->annotation_prefix, ".hasherBefore[%zu]", i));
+            m_hashersAfter.emplace_back(
+              in_pb,
+              var_array(m_selectors[i].getChildrenAfter()),
+              FMT(this->annotation_prefix, ".hasherAfter[%zu]", i));
+        }
+    }
+
+    const VariableT &rootBefore() const
+    {
+        return m_hashersBefore.back().result();
+    }
+
+    const VariableT &result() const
+    {
+        return m_hashersAfter.back().result();
+    }
+
+    bool is_valid() const
+    {
+        return this->pb.val(rootBefore()) == this->pb.val(m_expected_root);
+    }
+
+    void generate_r1cs_constraints()
+    {
+        for (size_t i = 0; i < m_selectors.size(); i++)
+        {
+            m_selectors[i].generate_r1cs_constraints();
+            m_hashersBefore[i].generate_r1cs_constraints();
+            m_hashersAfter[i].generate_r1cs_constraints();
+        }
+
+        // Ensure root matches calculated path hash
+        this->pb.add_r1cs_constraint(
+          ConstraintT(rootBefore(), 1, m_expected_root), FMT(this->annotation_prefix, ".expected_root authenticator"));
+    }
+
+    void generate_r1cs_witness()
+    {
+        for (size_t i = 0; i < m_selectors.size(); i++)
+        {
+            m_selectors[i].generate_r1cs_witness();
+            m_hashersBefore[i].generate_r1cs_witness();
+            m_hashersAfter[i].generate_r1cs_witness();
+        }
+    }
+};
+
+// Updates the leaf at the same address in two trees with the same depth, e.g. the account tree and the
+// asset tree. Equivalent to two merkle_path_update_4s, but the position of the nodes at each level is only
+// calculated once for both trees. That saves one constraint per level, so TREE_DEPTH_ACCOUNTS (16) constraints
+// per UpdateAccountGadget. Everything else depends on the siblings, which differ between the trees.
+template <typename HashT> class merkle_dual_path_update_4 : public GadgetT
+{
+  public:
+    const VariableT m_expected_root;
+    const VariableT m_expected_second_root;
+
+    std::vector<merkle_path_update_selector_4> m_selectors;
+    std::vector<merkle_path_update_selector_4> m_secondSelectors;
+    std::vector<HashT> m_hashersBefore;
+    std::vector<HashT> m_hashersAfter;
+    std::vector<HashT> m_secondHashersBefore;
+    std::vector<HashT> m_secondHashersAfter;
+
+    // in_address_bits: {0..2}[in_depth*2], the address of the leaf in both trees
+    // in_leaf_before/in_leaf_after: The hashed leaf data of the first tree before and after the update
+    // in_expected_root: The Merkle root of the first tree before the update
+    // in_path: The Merkle inclusion proof values of the first tree
+    // in_second_*: The same for the second tree
+    merkle_dual_path_update_4(
+      ProtoboardT &in_pb,
+      const size_t in_depth,
+      const VariableArrayT &in_address_bits,
+      const VariableT in_leaf_before,
+      const VariableT in_leaf_after,
+      const VariableT in_expected_root,
+      const VariableArrayT &in_path,
+      const VariableT in_second_leaf_before,
+      const VariableT in_second_leaf_after,
+      const VariableT in_expected_second_root,
+      const VariableArrayT &in_second_path,
+      const std::string &in_annotation_prefix)
+        : GadgetT(in_pb, in_annotation_prefix),
+          m_expected_root(in_expected_root),
+          m_expected_second_root(in_expected_second_root)
+    {
+        assert(in_depth > 0);
+        assert(in_address_bits.size() == in_depth * 2);
+
+        m_selectors.reserve(in_depth);
+        m_secondSelectors.reserve(in_depth);
+        m_hashersBefore.reserve(in_depth);
+        m_hashersAfter.reserve(in_depth);
+        m_secondHashersBefore.reserve(in_depth);
+        m_secondHashersAfter.reserve(in_depth);
+        for (size_t i = 0; i < in_depth; i++)
+        {
+            m_selectors.push_back(merkle_path_update_selector_4(
+              in_pb,
+              (i == 0) ? in_leaf_before : m_hashersBefore[i - 1].result(),
+              (i == 0) ? in_leaf_after : m_hashersAfter[i - 1].result(),
+              {in_path[i * 3 + 0], in_path[i * 3 + 1], in_path[i * 3 + 2]},
+              in_address_bits[i * 2 + 0],
+              in_address_bits[i * 2 + 1],
+              FMT(this->annotation_prefix, ".selector[%zu]", i)));
+            m_secondSelectors.push_back(merkle_path_update_selector_4(
+              in_pb,
+              (i == 0) ? in_second_leaf_before : m_secondHashersBefore[i - 1].result(),
+              (i == 0) ? in_second_leaf_after : m_secondHashersAfter[i - 1].result(),
+              {in_second_path[i * 3 + 0], in_second_path[i * 3 + 1], in_second_path[i * 3 + 2]},
+              m_selectors[i],
+              FMT(this->annotation_prefix, ".secondSelector[%zu]", i)));
+
+            m_hashersBefore.emplace_back(
+              in_pb,
+              var_array(m_selectors[i].getChildrenBefore()),
+              FMT(this->annotation_prefix, ".hasherBefore[%zu]", i));
+            m_hashersAfter.emplace_back(
+              in_pb,
+              var_array(m_selectors[i].getChildrenAfter()),
+              FMT(this->annotation_prefix, ".hasherAfter[%zu]", i));
+            m_secondHashersBefore.emplace_back(
+              in_pb,
+              var_array(m_secondSelectors[i].getChildrenBefore()),
+              FMT(this->annotation_prefix, ".secondHasherBefore[%zu]", i));
+            m_secondHashersAfter.emplace_back(
+              in_pb,
+              var_array(m_secondSelectors[i].getChildrenAfter()),
+              FMT(this->annotation_prefix, ".secondHasherAfter[%zu]", i));
+        }
+    }
+
+    const VariableT &rootBefore() const
+    {
+        return m_hashersBefore.back().result();
+    }
+
+    const VariableT &result() const
+    {
+        return m_hashersAfter.back().result();
+    }
+
+    const VariableT &secondRootBefore() const
+    {
+        return m_secondHashersBefore.back().result();
+    }
+
+    const VariableT &secondResult() const
+    {
+        return m_secondHashersAfter.back().result();
+    }
+
+    void generate_r1cs_constraints()
+    {
+        for (size_t i = 0; i < m_selectors.size(); i++)
+        {
+            m_selectors[i].generate_r1cs_constraints();
+            m_secondSelectors[i].generate_r1cs_constraints();
+            m_hashersBefore[i].generate_r1cs_constraints();
+            m_hashersAfter[i].generate_r1cs_constraints();
+            m_secondHashersBefore[i].generate_r1cs_constraints();
+            m_secondHashersAfter[i].generate_r1cs_constraints();
+        }
+
+        // Ensure the roots match the calculated path hashes
+        this->pb.add_r1cs_constraint(
+          ConstraintT(rootBefore(), 1, m_expected_root), FMT(this->annotation_prefix, ".expected_root authenticator"));
+        this->pb.add_r1cs_constraint(
+          ConstraintT(secondRootBefore(), 1, m_expected_second_root),
+          FMT(this->annotation_prefix, ".expected_second_root authenticator"));
+    }
+
+    void generate_r1cs_witness()
+    {
+        for (size_t i = 0; i < m_selectors.size(); i++)
+        {
+            m_selectors[i].generate_r1cs_witness();
+            m_secondSelectors[i].generate_r1cs_witness();
+            m_hashersBefore[i].generate_r1cs_witness();
+            m_hashersAfter[i].generate_r1cs_witness();
+            m_secondHashersBefore[i].generate_r1cs_witness();
+            m_secondHashersAfter[i].generate_r1cs_witness();
+        }
+    }
+};
+
+// Updates k leaves of the same tree one after the other, with the same proofs as k merkle_path_update_4s.
+// The root is the only node that is shared by the paths of all leaves, so the roots in between the updates
+// are not hashed. Instead the children of the root after an update need to match the children of the root
+// before the next update (equal children give equal roots, different children can only give equal roots
+// with a hash collision).
+template <typename HashT> class merkle_multi_update_4 : public GadgetT
+{
+  public:
+    const VariableT m_expected_root;
+
+    std::vector<std::vector<merkle_path_update_selector_4>> m_selectors;
+    // All levels except the root
+    std::vector<std::vector<HashT>> m_hashersBefore;
+    std::vector<std::vector<HashT>> m_hashersAfter;
+    // The root before the first update and the root after the last update
+    std::vector<HashT> m_rootHashers;
+
+    // in_address_bits: {0..2}[in_depth*2] for every leaf
+    // in_leaves_before/in_leaves_after: The hashed leaf data before and after the updates
+    // in_expected_root: The Merkle root before the first update
+    // in_paths: The Merkle inclusion proof values of every leaf, in the tree before its update
+    merkle_multi_update_4(
+      ProtoboardT &in_pb,
+      const size_t in_depth,
+      const std::vector<VariableArrayT> &in_address_bits,
+      const std::vector<VariableT> &in_leaves_before,
+      const std::vector<VariableT> &in_leaves_after,
+      const VariableT in_expected_root,
+      const std::vector<VariableArrayT> &in_paths,
+      const std::string &in_annotation_prefix)
+        : GadgetT(in_pb, in_annotation_prefix), m_expected_root(in_expected_root)
+    {
+        const size_t numLeaves = in_leaves_before.size();
+        assert(in_depth > 0);
+        assert(numLeaves > 0);
+        assert(in_leaves_after.size() == numLeaves);
+        assert(in_address_bits.size() == numLeaves);
+        assert(in_paths.size() == numLeaves);
+
+        m_selectors.resize(numLeaves);
+        m_hashersBefore.resize(numLeaves);
+        m_hashersAfter.resize(numLeaves);
+        for (size_t j = 0; j < numLeaves; j++)
+        {
+            assert(in_address_bits[j].size() == in_depth * 2);
+            m_selectors[j].reserve(in_depth);
+            m_hashersBefore[j].reserve(in_depth - 1);
+            m_hashersAfter[j].reserve(in_depth - 1);
+            for (size_t i = 0; i < in_depth; i++)
+            {
+                m_selectors[j].push_back(merkle_path_update_selector_4(
+                  in_pb,
+                  (i == 0) ? in_leaves_before[j] : m_hashersBefore[j][i - 1].result(),
+                  (i == 0) ? in_leaves_after[j] : m_hashersAfter[j][i - 1].result(),
+                  {in_paths[j][i * 3 + 0], in_paths[j][i * 3 + 1], in_paths[j][i * 3 + 2]},
+                  in_address_bits[j][i * 2 + 0],
+                  in_address_bits[j][i * 2 + 1],
+                  FMT(this->annotation_prefix, ".selector[%zu][%zu]", j, i)));
+
+                if (i + 1 < in_depth)
+                {
+                    m_hashersBefore[j].emplace_back(
+                      in_pb,
+                      var_array(m_selectors[j][i].getChildrenBefore()),
+                      FMT(this->annotation_prefix, ".hasherBefore[%zu][%zu]", j, i));
+                    m_hashersAfter[j].emplace_back(
+                      in_pb,
+                      var_array(m_selectors[j][i].getChildrenAfter()),
+                      FMT(this->annotation_prefix, ".hasherAfter[%zu][%zu]", j, i));
+                }
+            }
+        }
+
+        m_rootHashers.reserve(2);
+        m_rootHashers.emplace_back(
+          in_pb,
+          var_array(m_selectors.front().back().getChildrenBefore()),
+          FMT(this->annotation_prefix, ".rootHasherBefore"));
+        m_rootHashers.emplace_back(
+          in_pb,
+          var_array(m_selectors.back().back().getChildrenAfter()),
+          FMT(this->annotation_prefix, ".rootHasherAfter"));
+    }
+
+    const VariableT &rootBefore() const
+    {
+        return m_rootHashers.front().result();
+    }
+
+    const VariableT &result() const
+    {
+        return m_rootHashers.back().result();
+    }
+
+    void generate_r1cs_constraints()
+    {
+        for (size_t j = 0; j < m_selectors.size(); j++)
+        {
+            for (size_t i = 0; i < m_selectors[j].size(); i++)
+            {
+                m_selectors[j][i].generate_r1cs_constraints();
+                if (i < m_hashersBefore[j].size())
+                {
+                    m_hashersBefore[j][i].generate_r1cs_constraints();
+                    m_hashersAfter[j][i].generate_r1cs_constraints();
+                }
+            }
+        }
+        for (size_t i = 0; i < m_rootHashers.size(); i++)
+        {
+            m_rootHashers[i].generate_r1cs_constraints();
+        }
+
+        // Ensure root matches calculated path hash
+        this->pb.add_r1cs_constraint(
+          ConstraintT(rootBefore(), 1, m_expected_root), FMT(this->annotation_prefix, ".expected_root authenticator"));
+
+        // Chain the updates
+        for (size_t j = 0; j + 1 < m_selectors.size(); j++)
+        {
+            const VariableArrayT &childrenAfter = m_selectors[j].back().childrenAfter;
+            const VariableArrayT &childrenBefore = m_selectors[j + 1].back().childrenBefore;
+            for (size_t c = 0; c < childrenAfter.size(); c++)
+            {
+                this->pb.add_r1cs_constraint(
+                  ConstraintT(childrenAfter[c], 1, childrenBefore[c]),
+                  FMT(this->annotation_prefix, ".rootChildren[%zu][%zu]", j, c));
+            }
+        }
+    }
+
+    void generate_r1cs_witness()
+    {
+        for (size_t j = 0; j < m_selectors.size(); j++)
+        {
+            for (size_t i = 0; i < m_selectors[j].size(); i++)
+            {
+                m_selectors[j][i].generate_r1cs_witness();
+                if (i < m_hashersBefore[j].size())
+                {
+                    m_hashersBefore[j][i].generate_r1cs_witness();
+                    m_hashersAfter[j][i].generate_r1cs_witness();
+                }
+            }
+        }
+        for (size_t i = 0; i < m_rootHashers.size(); i++)
+        {
+            m_rootHashers[i].generate_r1cs_witness();
+        }
+    }
+};
+
 // Same parameters for ease of implementation in EVM
 using HashMerkleTree = Poseidon_4;
 using HashAccountLeaf = Poseidon_11;
@@ -217,6 +751,9 @@ using HashAutoMarketStorageLeaf = Poseidon_4_<4>;
 
 using MerklePathCheckT = merkle_path_authenticator_4<HashMerkleTree>;
 using MerklePathT = merkle_path_compute_4<HashMerkleTree>;
+using MerklePathUpdateT = merkle_path_update_4<HashMerkleTree>;
+using MerkleMultiUpdateT = merkle_multi_update_4<HashMerkleTree>;
+using MerkleDualPathUpdateT = merkle_dual_path_update_4<HashMerkleTree>;
 
 } // namespace Loopring
 
@@ -129,6 +129,7 @@ class OrderGadget : public GadgetT
 
     void generate_r1cs_witness(const Order &order)
     {
+        ProfileWitness profile(annotation_prefix);
         LOG(LogDebug, "in OrderGadgets", "generate_r1cs_witness");
         // Inputs
         storageID.generate_r1cs_witness(pb, order.storageID);
@@ -172,6 +173,7 @@ class OrderGadget : public GadgetT
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         LOG(LogDebug, "in OrderGadgets", "generate_r1cs_constraints");
         // Inputs
         storageID.generate_r1cs_constraints(true);
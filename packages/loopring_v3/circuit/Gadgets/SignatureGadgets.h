@@ -4,7 +4,9 @@
 #ifndef _SIGNATUREGADGETS_H_
 #define _SIGNATUREGADGETS_H_
 
+#include "../Utils/Annotations.h"
 #include "../Utils/Constants.h"
+#include "../Utils/Profiler.h"
 
 #include "ethsnarks.hpp"
 #include "utils.hpp"
@@ -13,6 +15,9 @@
 #include "gadgets/subadd.hpp"
 #include "gadgets/poseidon.hpp"
 
+#include <list>
+#include <mutex>
+
 using namespace ethsnarks;
 using namespace jubjub;
 
@@ -227,11 +232,230 @@ class EdDSA_HashRAM_Poseidon_gadget : public GadgetT
     }
 };
 
+// Multiplies a fixed base point with a scalar (little-endian bits) using windows of 3 bits.
+// All multiples of the base that can be selected in a window are constant, so every window is a lookup in a
+// precomputed table of 8 points (3 constraints) followed by a single point addition, instead of a point
+// addition for every 2 bits.
+class FixedBaseMulWindowed : public GadgetT
+{
+  public:
+    static const unsigned int WINDOW_SIZE = 3;
+    // tables[w][j] = j * 2^(WINDOW_SIZE * w) * base
+    typedef std::vector<std::vector<EdwardsPoint>> Tables;
+
+    const VariableArrayT scalar;
+    const Tables &tables;
+
+    // bit0 * bit1 of every full window
+    std::vector<VariableT> products;
+    std::vector<VariablePointT> lookups;
+    std::vector<PointAdder> adders;
+
+    FixedBaseMulWindowed(
+      ProtoboardT &pb,
+      const Params &params,
+      const FieldT &base_x,
+      const FieldT &base_y,
+      const VariableArrayT &_scalar,
+      const std::string &prefix)
+        : GadgetT(pb, prefix),
+
+          scalar(_scalar),
+          tables(getTables(params, base_x, base_y, (_scalar.size() + WINDOW_SIZE - 1) / WINDOW_SIZE))
+    {
+        assert(scalar.size() > 0);
+        for (unsigned int w = 0; w < tables.size(); w++)
+        {
+            if (getWindowSize(w) == WINDOW_SIZE)
+            {
+                products.emplace_back(make_variable(pb, FMT(prefix, ".product")));
+            }
+            lookups.emplace_back(pb, FMT(prefix, ".lookup"));
+        }
+        adders.reserve(tables.size() - 1);
+        for (unsigned int w = 1; w < tables.size(); w++)
+        {
+            adders.emplace_back(
+              pb,
+              params,
+              (w == 1) ? lookups[0].x : adders.back().result_x(),
+              (w == 1) ? lookups[0].y : adders.back().result_y(),
+              lookups[w].x,
+              lookups[w].y,
+              FMT(prefix, ".adder"));
+        }
+    }
+
+    void generate_r1cs_witness()
+    {
+        for (unsigned int w = 0; w < tables.size(); w++)
+        {
+            unsigned int index = 0;
+            for (unsigned int i = 0; i < getWindowSize(w); i++)
+            {
+                index += (pb.val(scalar[w * WINDOW_SIZE + i]) == FieldT::one()) ? (1u << i) : 0;
+            }
+            if (w < products.size())
+            {
+                pb.val(products[w]) = pb.val(scalar[w * WINDOW_SIZE]) * pb.val(scalar[w * WINDOW_SIZE + 1]);
+            }
+            pb.val(lookups[w].x) = tables[w][index].x;
+            pb.val(lookups[w].y) = tables[w][index].y;
+        }
+        for (unsigned int i = 0; i < adders.size(); i++)
+        {
+            adders[i].generate_r1cs_witness();
+        }
+    }
+
+    void generate_r1cs_constraints()
+    {
+        for (unsigned int w = 0; w < tables.size(); w++)
+        {
+            std::vector<FieldT> xs;
+            std::vector<FieldT> ys;
+            for (const EdwardsPoint &point : tables[w])
+            {
+                xs.push_back(point.x);
+                ys.push_back(point.y);
+            }
+            if (w < products.size())
+            {
+                pb.add_r1cs_constraint(
+                  ConstraintT(scalar[w * WINDOW_SIZE], scalar[w * WINDOW_SIZE + 1], products[w]),
+                  FMT(annotation_prefix, ".product"));
+            }
+            addLookupConstraint(w, xs, lookups[w].x);
+            addLookupConstraint(w, ys, lookups[w].y);
+        }
+        for (unsigned int i = 0; i < adders.size(); i++)
+        {
+            adders[i].generate_r1cs_constraints();
+        }
+    }
+
+    const VariableT &result_x() const
+    {
+        return adders.empty() ? lookups[0].x : adders.back().result_x();
+    }
+
+    const VariableT &result_y() const
+    {
+        return adders.empty() ? lookups[0].y : adders.back().result_y();
+    }
+
+  private:
+    unsigned int getWindowSize(unsigned int w) const
+    {
+        return std::min(WINDOW_SIZE, (unsigned int)scalar.size() - w * WINDOW_SIZE);
+    }
+
+    // Multilinear interpolation of the table values c[offset..offset+3] in bit0, bit1 and bit0 * bit1
+    libsnark::linear_combination<FieldT> interpolate(unsigned int w, const std::vector<FieldT> &c, unsigned int offset)
+      const
+    {
+        const VariableT &b0 = scalar[w * WINDOW_SIZE];
+        const VariableT &b1 = scalar[w * WINDOW_SIZE + 1];
+        return libsnark::linear_combination<FieldT>(c[offset]) + b0 * (c[offset + 1] - c[offset]) +
+               b1 * (c[offset + 2] - c[offset]) +
+               products[w] * (c[offset + 3] - c[offset + 2] - c[offset + 1] + c[offset]);
+    }
+
+    // result = c[bits of window w]
+    void addLookupConstraint(unsigned int w, const std::vector<FieldT> &c, const VariableT &result)
+    {
+        const VariableT &b0 = scalar[w * WINDOW_SIZE];
+        switch (getWindowSize(w))
+        {
+            case 3:
+            {
+                // result = lo + b2 * (hi - lo)
+                const VariableT &b2 = scalar[w * WINDOW_SIZE + 2];
+                libsnark::linear_combination<FieldT> lo = interpolate(w, c, 0);
+                libsnark::linear_combination<FieldT> hi = interpolate(w, c, 4);
+                pb.add_r1cs_constraint(ConstraintT(b2, hi - lo, result - lo), FMT(annotation_prefix, ".lookup"));
+                break;
+            }
+            case 2:
+            {
+                // result = c0 + b0 * (c1 - c0) + b1 * ((c2 - c0) + b0 * (c3 - c2 - c1 + c0))
+                const VariableT &b1 = scalar[w * WINDOW_SIZE + 1];
+                pb.add_r1cs_constraint(
+                  ConstraintT(
+                    b1,
+                    libsnark::linear_combination<FieldT>(c[2] - c[0]) + b0 * (c[3] - c[2] - c[1] + c[0]),
+                    result - (libsnark::linear_combination<FieldT>(c[0]) + b0 * (c[1] - c[0]))),
+                  FMT(annotation_prefix, ".lookup"));
+                break;
+            }
+            default:
+            {
+                // result = c0 + b0 * (c1 - c0)
+                pb.add_r1cs_constraint(
+                  ConstraintT(b0, c[1] - c[0], result - c[0]), FMT(annotation_prefix, ".lookup"));
+                break;
+            }
+        }
+    }
+
+    // Twisted Edwards addition on constants
+    static EdwardsPoint addPoints(const Params &params, const EdwardsPoint &p, const EdwardsPoint &q)
+    {
+        FieldT x1y2 = p.x * q.y;
+        FieldT y1x2 = p.y * q.x;
+        FieldT x1x2 = p.x * q.x;
+        FieldT y1y2 = p.y * q.y;
+        FieldT dxy = params.d * x1x2 * y1y2;
+        return EdwardsPoint(
+          (x1y2 + y1x2) * (FieldT::one() + dxy).inverse(), (y1y2 - params.a * x1x2) * (FieldT::one() - dxy).inverse());
+    }
+
+    // The tables only depend on the base, they are computed once and shared by all instances
+    static const Tables &getTables(const Params &params, const FieldT &x, const FieldT &y, unsigned int numWindows)
+    {
+        struct Entry
+        {
+            FieldT x;
+            FieldT y;
+            Tables tables;
+        };
+        static std::mutex mtx;
+        static std::list<Entry> cache;
+
+        const std::lock_guard<std::mutex> lock(mtx);
+        for (const Entry &entry : cache)
+        {
+            if (entry.x == x && entry.y == y && entry.tables.size() == numWindows)
+            {
+                return entry.tables;
+            }
+        }
+
+        Entry entry;
+        entry.x = x;
+        entry.y = y;
+        EdwardsPoint windowBase(x, y);
+        for (unsigned int w = 0; w < numWindows; w++)
+        {
+            std::vector<EdwardsPoint> table;
+            table.emplace_back(FieldT::zero(), FieldT::one());
+            for (unsigned int j = 1; j < (1u << WINDOW_SIZE); j++)
+            {
+                table.push_back(addPoints(params, table.back(), windowBase));
+            }
+            windowBase = addPoints(params, table.back(), windowBase);
+            entry.tables.push_back(table);
+        }
+        cache.push_back(entry);
+        return cache.back().tables;
+    }
+};
+
 class EdDSA_Poseidon : public GadgetT
 {
   public:
     PointValidator m_validator_R;             // IsValid(R)
-    fixed_base_mul m_lhs;                     // lhs = B*s
+    FixedBaseMulWindowed m_lhs;               // lhs = B*s
     EdDSA_HashRAM_Poseidon_gadget m_hash_RAM; // hash_RAM = H(R,A,M)
     ScalarMult m_At;                          // A*hash_RAM
     PointAdder m_rhs;                         // rhs = R + (A*hash_RAM)
@@ -288,6 +512,7 @@ class EdDSA_Poseidon : public GadgetT
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         m_validator_R.generate_r1cs_constraints();
         m_lhs.generate_r1cs_constraints();
         m_hash_RAM.generate_r1cs_constraints();
@@ -302,6 +527,7 @@ class EdDSA_Poseidon : public GadgetT
 
     void generate_r1cs_witness()
     {
+        ProfileWitness profile(annotation_prefix);
         m_validator_R.generate_r1cs_witness();
         m_lhs.generate_r1cs_witness();
         m_hash_RAM.generate_r1cs_witness();
@@ -362,6 +588,7 @@ class SignatureVerifier : public GadgetT
 
     void generate_r1cs_witness(Signature sig)
     {
+        ProfileWitness profile(annotation_prefix);
         pb.val(sig_R.x) = sig.R.x;
         pb.val(sig_R.y) = sig.R.y;
         sig_s.fill_with_bits_of_field_element(pb, sig.s);
@@ -371,6 +598,7 @@ class SignatureVerifier : public GadgetT
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         for (unsigned int i = 0; i < sig_s.size(); i++)
         {
             libsnark::generate_boolean_r1cs_constraint<ethsnarks::FieldT>(
@@ -415,6 +643,7 @@ class BatchSignatureVerifier : public GadgetT
       }
     }
     void generate_r1cs_witness(const std::vector<Signature> &signatures) {
+      ProfileWitness profile(annotation_prefix);
       for (unsigned int i = 0; i < signatureVerifierArray.size(); i++) 
       {
         signatureVerifierArray[i].generate_r1cs_witness(signatures[i]);
@@ -422,6 +651,7 @@ class BatchSignatureVerifier : public GadgetT
     }
     void generate_r1cs_constraints() 
     {
+      ProfileConstraints profile(pb, annotation_prefix);
       for (unsigned int i = 0; i < signatureVerifierArray.size(); i++) 
       {
         signatureVerifierArray[i].generate_r1cs_constraints();
@@ -86,8 +86,7 @@ class UpdateStorageGadget : public GadgetT
     StorageState valuesAfter;
 
     const VariableArrayT proof;
-    MerklePathCheckT proofVerifierBefore;
-    MerklePathT rootCalculatorAfter;
+    MerklePathUpdateT pathUpdate;
 
     UpdateStorageGadget(
       ProtoboardT &pb,
@@ -109,48 +108,159 @@ class UpdateStorageGadget : public GadgetT
           FMT(prefix, ".leafAfter")),
 
           proof(make_var_array(pb, TREE_DEPTH_STORAGE * 3, FMT(prefix, ".proof"))),
-          proofVerifierBefore(
+          pathUpdate(
             pb,
             TREE_DEPTH_STORAGE,
             slotID,
             leafBefore.result(),
+            leafAfter.result(),
             merkleRoot,
             proof,
-            FMT(prefix, ".pathBefore")),
-          rootCalculatorAfter(pb, TREE_DEPTH_STORAGE, slotID, leafAfter.result(), proof, FMT(prefix, ".pathAfter"))
+            FMT(prefix, ".pathUpdate"))
     {
     }
 
     void generate_r1cs_witness(const StorageUpdate &update)
     {
+        ProfileWitness profile(annotation_prefix);
         leafBefore.generate_r1cs_witness();
         leafAfter.generate_r1cs_witness();
 
         proof.fill_with_field_elements(pb, update.proof.data);
-        proofVerifierBefore.generate_r1cs_witness();
-        rootCalculatorAfter.generate_r1cs_witness();
+        pathUpdate.generate_r1cs_witness();
 
-        ASSERT(pb.val(proofVerifierBefore.m_expected_root) == update.rootBefore, annotation_prefix);
-        if (pb.val(rootCalculatorAfter.result()) != update.rootAfter)
+        ASSERT(pb.val(pathUpdate.m_expected_root) == update.rootBefore, annotation_prefix);
+        if (pb.val(pathUpdate.result()) != update.rootAfter)
         {
             printStorage(pb, valuesBefore);
             printStorage(pb, valuesAfter);
-            ASSERT(pb.val(rootCalculatorAfter.result()) == update.rootAfter, annotation_prefix);
+            ASSERT(pb.val(pathUpdate.result()) == update.rootAfter, annotation_prefix);
         }
     }
 
     void generate_r1cs_constraints()
     {
+        ProfileConstraints profile(pb, annotation_prefix);
         leafBefore.generate_r1cs_constraints();
         leafAfter.generate_r1cs_constraints();
 
-        proofVerifierBefore.generate_r1cs_constraints();
-        rootCalculatorAfter.generate_r1cs_constraints();
+        pathUpdate.generate_r1cs_constraints();
     }
 
     const VariableT &result() const
     {
-        return rootCalculatorAfter.result();
+        return pathUpdate.result();
+    }
+};
+
+// Updates multiple storage slots of the same storage tree one after the other.
+// Uses the same proofs as a chain of UpdateStorageGadgets, but the intermediate roots are not hashed.
+class MultiUpdateStorageGadget : public GadgetT
+{
+  public:
+    std::vector<StorageState> valuesBefore;
+    std::vector<StorageState> valuesAfter;
+
+    std::vector<HashStorageLeaf> leavesBefore;
+    std::vector<HashStorageLeaf> leavesAfter;
+
+    std::vector<VariableArrayT> proofs;
+    std::unique_ptr<MerkleMultiUpdateT> multiUpdate;
+
+    MultiUpdateStorageGadget(
+      ProtoboardT &pb,
+      const VariableT &merkleRoot,
+      const std::vector<VariableArrayT> &slotIDs,
+      const std::vector<StorageState> &before,
+      const std::vector<StorageState> &after,
+      const std::string &prefix)
+        : GadgetT(pb, prefix), valuesBefore(before), valuesAfter(after)
+    {
+        assert(slotIDs.size() == before.size());
+        assert(slotIDs.size() == after.size());
+
+        leavesBefore.reserve(before.size());
+        leavesAfter.reserve(after.size());
+        std::vector<VariableT> leafHashesBefore;
+        std::vector<VariableT> leafHashesAfter;
+        for (size_t i = 0; i < slotIDs.size(); i++)
+        {
+            leavesBefore.emplace_back(
+              pb,
+              var_array(
+                {before[i].tokenSID,
+                 before[i].tokenBID,
+                 before[i].data,
+                 before[i].storageID,
+                 before[i].gasFee,
+                 before[i].cancelled,
+                 before[i].forward}),
+              FMT(prefix, ".leafBefore[%zu]", i));
+            leavesAfter.emplace_back(
+              pb,
+              var_array(
+                {after[i].tokenSID,
+                 after[i].tokenBID,
+                 after[i].data,
+                 after[i].storageID,
+                 after[i].gasFee,
+                 after[i].cancelled,
+                 after[i].forward}),
+              FMT(prefix, ".leafAfter[%zu]", i));
+            leafHashesBefore.push_back(leavesBefore.back().result());
+            leafHashesAfter.push_back(leavesAfter.back().result());
+            proofs.push_back(make_var_array(pb, TREE_DEPTH_STORAGE * 3, FMT(prefix, ".proof[%zu]", i)));
+        }
+
+        multiUpdate.reset(new MerkleMultiUpdateT(
+          pb,
+          TREE_DEPTH_STORAGE,
+          slotIDs,
+          leafHashesBefore,
+          leafHashesAfter,
+          merkleRoot,
+          proofs,
+          FMT(prefix, ".multiUpdate")));
+    }
+
+    void generate_r1cs_witness(const std::vector<StorageUpdate> &updates)
+    {
+        ProfileWitness profile(annotation_prefix);
+        assert(updates.size() == proofs.size());
+        for (size_t i = 0; i < proofs.size(); i++)
+        {
+            leavesBefore[i].generate_r1cs_witness();
+            leavesAfter[i].generate_r1cs_witness();
+            proofs[i].fill_with_field_elements(pb, updates[i].proof.data);
+        }
+        multiUpdate->generate_r1cs_witness();
+
+        ASSERT(pb.val(multiUpdate->m_expected_root) == updates.front().rootBefore, annotation_prefix);
+        if (pb.val(multiUpdate->result()) != updates.back().rootAfter)
+        {
+            for (size_t i = 0; i < proofs.size(); i++)
+            {
+                printStorage(pb, valuesBefore[i]);
+                printStorage(pb, valuesAfter[i]);
+            }
+            ASSERT(pb.val(multiUpdate->result()) == updates.back().rootAfter, annotation_prefix);
+        }
+    }
+
+    void generate_r1cs_constraints()
+    {
+        ProfileConstraints profile(pb, annotation_prefix);
+        for (size_t i = 0; i < proofs.size(); i++)
+        {
+            leavesBefore[i].generate_r1cs_constraints();
+            leavesAfter[i].generate_r1cs_constraints();
+        }
+        multiUpdate->generate_r1cs_constraints();
+    }
+
+    const VariableT &result() const
+    {
+        return multiUpdate->result();
     }
 };
 
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+// Modified by DeGate DAO, 2022
+#ifndef _ANNOTATIONS_H_
+#define _ANNOTATIONS_H_
+
+#include "ethsnarks.hpp"
+#include "utils.hpp"
+
+#include <string>
+
+using namespace ethsnarks;
+
+namespace Loopring
+{
+
+#ifdef CIRCUIT_NO_ANNOTATIONS
+
+// Build without annotations (cmake -DCIRCUIT_ANNOTATIONS=OFF).
+// The gadgets are created with an empty annotation prefix and all annotations of the gadgets, variables and
+// constraints are the same empty string. This hides ethsnarks::FMT for all code in the Loopring namespace,
+// so creating the circuit doesn't allocate a string for every annotation.
+// The annotations are only used to debug the circuit and by -profile, the constraint system is the same.
+template <typename... Args>
+inline const std::string &FMT(const std::string &, const char *, Args &&...)
+{
+    static const std::string annotation;
+    return annotation;
+}
+
+static const bool CIRCUIT_ANNOTATIONS = false;
+
+#else
+
+static const bool CIRCUIT_ANNOTATIONS = true;
+
+#endif
+
+} // namespace Loopring
+
+#endif
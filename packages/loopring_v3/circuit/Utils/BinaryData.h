@@ -0,0 +1,522 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+// Modified by DeGate DAO, 2022
+#ifndef _BINARYDATA_H_
+#define _BINARYDATA_H_
+
+#include "Data.h"
+
+#include <cstring>
+#include <ostream>
+
+namespace Loopring
+{
+
+// Binary block format, written by -convertblock and read directly from a memory mapped file:
+// - BinaryBlockHeader
+// - the Block, every member in declaration order:
+//   - field elements as FieldT::num_limbs little-endian 64-bit limbs in Montgomery form
+//   - vectors as a uint32_t element count followed by the elements
+// Field elements are copied as is, no decimal parsing or Montgomery conversion is needed.
+struct BinaryBlockHeader
+{
+    static constexpr const char *MAGIC = "DGBLOCK1";
+    static const uint32_t VERSION = 4;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t limbSize;
+    uint32_t numLimbs;
+    uint32_t blockType;
+    uint32_t blockSize;
+    uint32_t numTransactions;
+    // BlockLayout
+    uint32_t layoutUniversal;
+    uint32_t layoutDeposits;
+    uint32_t layoutAccountUpdates;
+    uint32_t layoutWithdrawals;
+    uint32_t layoutOperatorFeeTokens;
+    uint32_t layoutOptimizeConstraints;
+
+    BlockLayout getLayout() const
+    {
+        BlockLayout layout;
+        layout.universal = (layoutUniversal != 0);
+        layout.numDeposits = layoutDeposits;
+        layout.numAccountUpdates = layoutAccountUpdates;
+        layout.numWithdrawals = layoutWithdrawals;
+        layout.numOperatorFeeTokens = layoutOperatorFeeTokens;
+        layout.optimizeConstraints = (layoutOptimizeConstraints != 0);
+        return layout;
+    }
+};
+
+class BinaryBlockWriter
+{
+  public:
+    BinaryBlockWriter(std::ostream &_out) : out(_out)
+    {
+    }
+
+    void field(ethsnarks::FieldT &value)
+    {
+        out.write(reinterpret_cast<const char *>(value.mont_repr.data), sizeof(value.mont_repr.data));
+    }
+
+    void size(uint32_t &value)
+    {
+        out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+  private:
+    std::ostream &out;
+};
+
+class BinaryBlockReader
+{
+  public:
+    BinaryBlockReader(const char *_data, size_t _length) : data(_data), length(_length), offset(0)
+    {
+    }
+
+    void field(ethsnarks::FieldT &value)
+    {
+        read(value.mont_repr.data, sizeof(value.mont_repr.data));
+    }
+
+    void size(uint32_t &value)
+    {
+        read(&value, sizeof(value));
+        // Every element takes at least a byte, reject sizes that cannot fit in the remaining data
+        if (value > length - offset)
+        {
+            throw std::runtime_error("Invalid binary block: invalid vector size");
+        }
+    }
+
+    void read(void *dst, size_t numBytes)
+    {
+        if (numBytes > length - offset)
+        {
+            throw std::runtime_error("Invalid binary block: unexpected end of data");
+        }
+        memcpy(dst, data + offset, numBytes);
+        offset += numBytes;
+    }
+
+    size_t getOffset() const
+    {
+        return offset;
+    }
+
+  private:
+    const char *data;
+    size_t length;
+    size_t offset;
+};
+
+// The same function is used to write and read every type so both always use the same layout
+
+template <typename Archive> void serialize(Archive &ar, ethsnarks::FieldT &value)
+{
+    ar.field(value);
+}
+
+template <typename Archive> void serialize(Archive &ar, ethsnarks::jubjub::EdwardsPoint &point)
+{
+    ar.field(point.x);
+    ar.field(point.y);
+}
+
+template <typename Archive, typename T> void serialize(Archive &ar, std::vector<T> &values)
+{
+    uint32_t size = values.size();
+    ar.size(size);
+    values.resize(size);
+    for (T &value : values)
+    {
+        serialize(ar, value);
+    }
+}
+
+template <typename Archive> void serialize(Archive &ar, Proof &proof)
+{
+    serialize(ar, proof.data);
+}
+
+template <typename Archive> void serialize(Archive &ar, StorageLeaf &leaf)
+{
+    serialize(ar, leaf.tokenSID);
+    serialize(ar, leaf.tokenBID);
+    serialize(ar, leaf.data);
+    serialize(ar, leaf.storageID);
+    serialize(ar, leaf.gasFee);
+    serialize(ar, leaf.cancelled);
+    serialize(ar, leaf.forward);
+}
+
+template <typename Archive> void serialize(Archive &ar, BalanceLeaf &leaf)
+{
+    serialize(ar, leaf.balance);
+}
+
+template <typename Archive> void serialize(Archive &ar, AccountLeaf &account)
+{
+    serialize(ar, account.owner);
+    serialize(ar, account.publicKey);
+    serialize(ar, account.appKeyPublicKey);
+    serialize(ar, account.nonce);
+    serialize(ar, account.disableAppKeySpotTrade);
+    serialize(ar, account.disableAppKeyWithdraw);
+    serialize(ar, account.disableAppKeyTransferToOther);
+    serialize(ar, account.balancesRoot);
+    serialize(ar, account.storageRoot);
+}
+
+template <typename Archive> void serialize(Archive &ar, BalanceUpdate &balanceUpdate)
+{
+    serialize(ar, balanceUpdate.tokenID);
+    serialize(ar, balanceUpdate.proof);
+    serialize(ar, balanceUpdate.rootBefore);
+    serialize(ar, balanceUpdate.rootAfter);
+    serialize(ar, balanceUpdate.before);
+    serialize(ar, balanceUpdate.after);
+}
+
+template <typename Archive> void serialize(Archive &ar, StorageUpdate &storageUpdate)
+{
+    serialize(ar, storageUpdate.storageID);
+    serialize(ar, storageUpdate.proof);
+    serialize(ar, storageUpdate.rootBefore);
+    serialize(ar, storageUpdate.rootAfter);
+    serialize(ar, storageUpdate.before);
+    serialize(ar, storageUpdate.after);
+}
+
+template <typename Archive> void serialize(Archive &ar, AccountUpdate &accountUpdate)
+{
+    serialize(ar, accountUpdate.accountID);
+    serialize(ar, accountUpdate.proof);
+    serialize(ar, accountUpdate.assetProof);
+    serialize(ar, accountUpdate.rootBefore);
+    serialize(ar, accountUpdate.rootAfter);
+    serialize(ar, accountUpdate.assetRootBefore);
+    serialize(ar, accountUpdate.assetRootAfter);
+    serialize(ar, accountUpdate.before);
+    serialize(ar, accountUpdate.after);
+}
+
+template <typename Archive> void serialize(Archive &ar, Signature &signature)
+{
+    serialize(ar, signature.R);
+    serialize(ar, signature.s);
+}
+
+template <typename Archive> void serialize(Archive &ar, AutoMarketOrder &order)
+{
+    serialize(ar, order.storageID);
+    serialize(ar, order.accountID);
+    serialize(ar, order.tokenS);
+    serialize(ar, order.tokenB);
+    serialize(ar, order.amountS);
+    serialize(ar, order.amountB);
+    serialize(ar, order.validUntil);
+    serialize(ar, order.fillAmountBorS);
+    serialize(ar, order.taker);
+    serialize(ar, order.feeBips);
+    serialize(ar, order.tradingFee);
+    serialize(ar, order.feeTokenID);
+    serialize(ar, order.maxFee);
+    serialize(ar, order.type);
+    serialize(ar, order.gridOffset);
+    serialize(ar, order.orderOffset);
+    serialize(ar, order.maxLevel);
+    serialize(ar, order.useAppKey);
+}
+
+template <typename Archive> void serialize(Archive &ar, Order &order)
+{
+    serialize(ar, order.storageID);
+    serialize(ar, order.accountID);
+    serialize(ar, order.tokenS);
+    serialize(ar, order.tokenB);
+    serialize(ar, order.amountS);
+    serialize(ar, order.amountB);
+    serialize(ar, order.deltaFilledS);
+    serialize(ar, order.deltaFilledB);
+    serialize(ar, order.validUntil);
+    serialize(ar, order.fillAmountBorS);
+    serialize(ar, order.taker);
+    serialize(ar, order.feeBips);
+    serialize(ar, order.tradingFee);
+    serialize(ar, order.feeTokenID);
+    serialize(ar, order.fee);
+    serialize(ar, order.maxFee);
+    serialize(ar, order.type);
+    serialize(ar, order.level);
+    serialize(ar, order.startOrder);
+    serialize(ar, order.gridOffset);
+    serialize(ar, order.orderOffset);
+    serialize(ar, order.maxLevel);
+    serialize(ar, order.useAppKey);
+    serialize(ar, order.isNoop);
+}
+
+template <typename Archive> void serialize(Archive &ar, SpotTrade &spotTrade)
+{
+    serialize(ar, spotTrade.orderA);
+    serialize(ar, spotTrade.orderB);
+    serialize(ar, spotTrade.fillS_A);
+    serialize(ar, spotTrade.fillS_B);
+}
+
+template <typename Archive> void serialize(Archive &ar, BatchSpotTradeUser &batchSpotTradeUser)
+{
+    serialize(ar, batchSpotTradeUser.accountID);
+    serialize(ar, batchSpotTradeUser.isNoop);
+    serialize(ar, batchSpotTradeUser.orders);
+}
+
+template <typename Archive> void serialize(Archive &ar, BatchSpotTrade &batchSpotTrade)
+{
+    serialize(ar, batchSpotTrade.users);
+    serialize(ar, batchSpotTrade.tokens);
+    serialize(ar, batchSpotTrade.bindTokenID);
+}
+
+template <typename Archive> void serialize(Archive &ar, Deposit &deposit)
+{
+    serialize(ar, deposit.owner);
+    serialize(ar, deposit.accountID);
+    serialize(ar, deposit.tokenID);
+    serialize(ar, deposit.amount);
+    serialize(ar, deposit.type);
+}
+
+template <typename Archive> void serialize(Archive &ar, Withdrawal &withdrawal)
+{
+    serialize(ar, withdrawal.accountID);
+    serialize(ar, withdrawal.tokenID);
+    serialize(ar, withdrawal.amount);
+    serialize(ar, withdrawal.feeTokenID);
+    serialize(ar, withdrawal.fee);
+    serialize(ar, withdrawal.onchainDataHash);
+    serialize(ar, withdrawal.storageID);
+    serialize(ar, withdrawal.validUntil);
+    serialize(ar, withdrawal.maxFee);
+    serialize(ar, withdrawal.type);
+    serialize(ar, withdrawal.useAppKey);
+    serialize(ar, withdrawal.minGas);
+    serialize(ar, withdrawal.to);
+}
+
+template <typename Archive> void serialize(Archive &ar, AccountUpdateTx &update)
+{
+    serialize(ar, update.owner);
+    serialize(ar, update.accountID);
+    serialize(ar, update.publicKeyX);
+    serialize(ar, update.publicKeyY);
+    serialize(ar, update.feeTokenID);
+    serialize(ar, update.fee);
+    serialize(ar, update.maxFee);
+    serialize(ar, update.validUntil);
+    serialize(ar, update.type);
+}
+
+template <typename Archive> void serialize(Archive &ar, AppKeyUpdate &update)
+{
+    serialize(ar, update.accountID);
+    serialize(ar, update.appKeyPublicKeyX);
+    serialize(ar, update.appKeyPublicKeyY);
+    serialize(ar, update.feeTokenID);
+    serialize(ar, update.fee);
+    serialize(ar, update.maxFee);
+    serialize(ar, update.validUntil);
+    serialize(ar, update.disableAppKeySpotTrade);
+    serialize(ar, update.disableAppKeyWithdraw);
+    serialize(ar, update.disableAppKeyTransferToOther);
+}
+
+template <typename Archive> void serialize(Archive &ar, OrderCancel &update)
+{
+    serialize(ar, update.accountID);
+    serialize(ar, update.storageID);
+    serialize(ar, update.fee);
+    serialize(ar, update.maxFee);
+    serialize(ar, update.feeTokenID);
+    serialize(ar, update.useAppKey);
+}
+
+template <typename Archive> void serialize(Archive &ar, Transfer &transfer)
+{
+    serialize(ar, transfer.fromAccountID);
+    serialize(ar, transfer.toAccountID);
+    serialize(ar, transfer.tokenID);
+    serialize(ar, transfer.amount);
+    serialize(ar, transfer.feeTokenID);
+    serialize(ar, transfer.fee);
+    serialize(ar, transfer.validUntil);
+    serialize(ar, transfer.to);
+    serialize(ar, transfer.dualAuthorX);
+    serialize(ar, transfer.dualAuthorY);
+    serialize(ar, transfer.storageID);
+    serialize(ar, transfer.payerToAccountID);
+    serialize(ar, transfer.payerTo);
+    serialize(ar, transfer.payeeToAccountID);
+    serialize(ar, transfer.maxFee);
+    serialize(ar, transfer.putAddressesInDA);
+    serialize(ar, transfer.type);
+    serialize(ar, transfer.useAppKey);
+}
+
+template <typename Archive> void serialize(Archive &ar, Witness &state)
+{
+    serialize(ar, state.storageUpdate_A);
+    serialize(ar, state.storageUpdate_A_array);
+    serialize(ar, state.storageUpdate_B);
+    serialize(ar, state.storageUpdate_B_array);
+
+    serialize(ar, state.balanceUpdateS_A);
+    serialize(ar, state.balanceUpdateB_A);
+    serialize(ar, state.balanceUpdateFee_A);
+    serialize(ar, state.accountUpdate_A);
+
+    serialize(ar, state.balanceUpdateS_B);
+    serialize(ar, state.balanceUpdateB_B);
+    serialize(ar, state.balanceUpdateFee_B);
+    serialize(ar, state.accountUpdate_B);
+
+    serialize(ar, state.storageUpdate_C_array);
+    serialize(ar, state.balanceUpdateS_C);
+    serialize(ar, state.balanceUpdateB_C);
+    serialize(ar, state.balanceUpdateFee_C);
+    serialize(ar, state.accountUpdate_C);
+
+    serialize(ar, state.storageUpdate_D_array);
+    serialize(ar, state.balanceUpdateS_D);
+    serialize(ar, state.balanceUpdateB_D);
+    serialize(ar, state.balanceUpdateFee_D);
+    serialize(ar, state.accountUpdate_D);
+
+    serialize(ar, state.storageUpdate_E_array);
+    serialize(ar, state.balanceUpdateS_E);
+    serialize(ar, state.balanceUpdateB_E);
+    serialize(ar, state.balanceUpdateFee_E);
+    serialize(ar, state.accountUpdate_E);
+
+    serialize(ar, state.storageUpdate_F_array);
+    serialize(ar, state.balanceUpdateS_F);
+    serialize(ar, state.balanceUpdateB_F);
+    serialize(ar, state.balanceUpdateFee_F);
+    serialize(ar, state.accountUpdate_F);
+
+    serialize(ar, state.balanceUpdateA_O);
+    serialize(ar, state.balanceUpdateB_O);
+    serialize(ar, state.balanceUpdateC_O);
+    serialize(ar, state.balanceUpdateD_O);
+    serialize(ar, state.accountUpdate_O);
+
+    serialize(ar, state.signatureA);
+    serialize(ar, state.signatureB);
+    serialize(ar, state.signatureArray);
+
+    serialize(ar, state.numConditionalTransactionsAfter);
+}
+
+template <typename Archive> void serialize(Archive &ar, UniversalTransaction &transaction)
+{
+    serialize(ar, transaction.witness);
+    serialize(ar, transaction.type);
+    serialize(ar, transaction.spotTrade);
+    serialize(ar, transaction.batchSpotTrade);
+    serialize(ar, transaction.transfer);
+    serialize(ar, transaction.withdraw);
+    serialize(ar, transaction.deposit);
+    serialize(ar, transaction.accountUpdate);
+    serialize(ar, transaction.appKeyUpdate);
+    serialize(ar, transaction.orderCancel);
+}
+
+template <typename Archive> void serialize(Archive &ar, Block &block)
+{
+    serialize(ar, block.exchange);
+    serialize(ar, block.merkleRootBefore);
+    serialize(ar, block.merkleRootAfter);
+    serialize(ar, block.merkleAssetRootBefore);
+    serialize(ar, block.merkleAssetRootAfter);
+    serialize(ar, block.timestamp);
+    serialize(ar, block.protocolFeeBips);
+    serialize(ar, block.signature);
+    serialize(ar, block.accountUpdate_P);
+    serialize(ar, block.operatorAccountID);
+    serialize(ar, block.accountUpdate_O);
+    serialize(ar, block.operatorFeeUpdates);
+    serialize(ar, block.transactions);
+}
+
+static bool isBinaryBlock(const char *data, size_t length)
+{
+    return length >= sizeof(BinaryBlockHeader) && memcmp(data, BinaryBlockHeader::MAGIC, 8) == 0;
+}
+
+static void writeBinaryBlock(
+  std::ostream &out,
+  unsigned int blockType,
+  unsigned int blockSize,
+  const BlockLayout &layout,
+  Block &block)
+{
+    BinaryBlockHeader header;
+    memcpy(header.magic, BinaryBlockHeader::MAGIC, sizeof(header.magic));
+    header.version = BinaryBlockHeader::VERSION;
+    header.limbSize = sizeof(mp_limb_t);
+    header.numLimbs = ethsnarks::FieldT::num_limbs;
+    header.blockType = blockType;
+    header.blockSize = blockSize;
+    header.numTransactions = block.transactions.size();
+    header.layoutUniversal = layout.universal ? 1 : 0;
+    header.layoutDeposits = layout.numDeposits;
+    header.layoutAccountUpdates = layout.numAccountUpdates;
+    header.layoutWithdrawals = layout.numWithdrawals;
+    header.layoutOperatorFeeTokens = layout.numOperatorFeeTokens;
+    header.layoutOptimizeConstraints = layout.optimizeConstraints ? 1 : 0;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    BinaryBlockWriter writer(out);
+    serialize(writer, block);
+}
+
+// Only reads the header, returns false if the data is not a binary block of this version/field.
+// Layouts with an operator fee table are not supported yet (see getBlockLayout).
+static bool readBinaryBlockHeader(const char *data, size_t length, BinaryBlockHeader &header)
+{
+    if (!isBinaryBlock(data, length))
+    {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    return header.version == BinaryBlockHeader::VERSION &&
+           header.limbSize == sizeof(mp_limb_t) &&
+           header.numLimbs == ethsnarks::FieldT::num_limbs &&
+           header.layoutOperatorFeeTokens == 0;
+}
+
+// Throws std::runtime_error on invalid data
+static void readBinaryBlock(const char *data, size_t length, Block &block)
+{
+    BinaryBlockHeader header;
+    if (!readBinaryBlockHeader(data, length, header))
+    {
+        throw std::runtime_error("Invalid binary block: unsupported header");
+    }
+    BinaryBlockReader reader(data + sizeof(header), length - sizeof(header));
+    serialize(reader, block);
+    if (block.transactions.size() != header.numTransactions)
+    {
+        throw std::runtime_error("Invalid binary block: invalid number of transactions");
+    }
+}
+
+} // namespace Loopring
+
+#endif
@@ -0,0 +1,238 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+// Modified by DeGate DAO, 2022
+#ifndef _CONSTRAINTSYSTEMCACHE_H_
+#define _CONSTRAINTSYSTEMCACHE_H_
+
+#include "ethsnarks.hpp"
+#include "Data.h"
+
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace ethsnarks;
+
+#ifndef CIRCUIT_SOURCE_HASH
+#define CIRCUIT_SOURCE_HASH ""
+#endif
+
+namespace Loopring
+{
+
+// Binary cache of the constraints of a circuit (see -buildcache in main.cpp). The cache only stores the
+// constraints, the gadgets and their variables are still created (the witness needs them), only the
+// generate_r1cs_constraints calls of the transactions are skipped (see Circuit::transactionConstraints).
+//
+// Layout, everything in native byte order:
+// - ConstraintSystemCacheHeader
+// - numCoefficients coefficients, the limbs of the bigint representation
+// - numConstraints * 3 uint32 term counts (A, B, C), padded to 8 bytes
+// - numTerms * 2 uint32 (variable index, coefficient index)
+struct ConstraintSystemCacheHeader
+{
+    static constexpr const char *MAGIC = "DGCSCACH";
+    static const uint32_t VERSION = 2;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t coefficientSize;
+    // Circuit sources, block type, block size and layout the cache was built for
+    char key[256];
+    uint64_t numInputs;
+    uint64_t numVariables;
+    uint64_t numConstraints;
+    uint64_t numCoefficients;
+    uint64_t numTerms;
+    // FNV-1a over the 64-bit words after the header
+    uint64_t checksum;
+};
+static_assert(sizeof(ConstraintSystemCacheHeader) % 8 == 0, "header needs to keep the data aligned");
+
+typedef libff::bigint<FieldT::num_limbs> CoefficientT;
+
+// Empty when the build has no hash of the circuit sources, the cache can't be used then
+static std::string getConstraintSystemCacheKey(
+  unsigned int blockType,
+  unsigned int blockSize,
+  const BlockLayout &layout)
+{
+    const std::string sourceHash = CIRCUIT_SOURCE_HASH;
+    if (sourceHash.empty())
+    {
+        return "";
+    }
+    return sourceHash + "_" + std::to_string(blockType) + "_" + std::to_string(blockSize) + layout.getName();
+}
+
+static uint64_t getConstraintSystemCacheChecksum(const char *data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool writeConstraintSystemCache(std::ostream &out, const std::string &key, const ProtoboardT &pb)
+{
+    ConstraintSystemCacheHeader header;
+    if (key.empty() || key.length() >= sizeof(header.key) || pb.num_variables() > UINT32_MAX)
+    {
+        return false;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ConstraintSystemCacheHeader::MAGIC, sizeof(header.magic));
+    header.version = ConstraintSystemCacheHeader::VERSION;
+    header.coefficientSize = sizeof(CoefficientT::data);
+    memcpy(header.key, key.data(), key.length());
+    header.numInputs = pb.num_inputs();
+    header.numVariables = pb.num_variables();
+    header.numConstraints = pb.num_constraints();
+
+    // Most constraints only use a handful of different coefficients (1, -1, powers of 2)
+    std::string coefficients;
+    std::unordered_map<std::string, uint32_t> coefficientIndices;
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> terms;
+    counts.reserve(pb.num_constraints() * 3 + 1);
+    auto addTerms = [&](const libsnark::linear_combination<FieldT> &lc) {
+        counts.push_back(lc.getTerms().size());
+        for (const auto &term : lc.getTerms())
+        {
+            const FieldT coeff = term.coeff;
+            const CoefficientT value = coeff.as_bigint();
+            const std::string bytes(reinterpret_cast<const char *>(value.data), sizeof(value.data));
+            auto it = coefficientIndices.find(bytes);
+            if (it == coefficientIndices.end())
+            {
+                it = coefficientIndices.emplace(bytes, coefficientIndices.size()).first;
+                coefficients += bytes;
+            }
+            terms.push_back(term.index);
+            terms.push_back(it->second);
+        }
+    };
+    for (const auto &constraint : pb.constraint_system.constraints)
+    {
+        addTerms(constraint->getA());
+        addTerms(constraint->getB());
+        addTerms(constraint->getC());
+    }
+    if (counts.size() % 2 != 0)
+    {
+        counts.push_back(0);
+    }
+    header.numCoefficients = coefficientIndices.size();
+    header.numTerms = terms.size() / 2;
+
+    std::string body = coefficients;
+    body.append(reinterpret_cast<const char *>(counts.data()), counts.size() * sizeof(uint32_t));
+    body.append(reinterpret_cast<const char *>(terms.data()), terms.size() * sizeof(uint32_t));
+    header.checksum = getConstraintSystemCacheChecksum(body.data(), body.size());
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(body.data(), body.size());
+    return !out.fail();
+}
+
+// Checks the cache was built for this key and is complete
+static bool checkConstraintSystemCache(
+  const char *data,
+  size_t size,
+  const std::string &key,
+  ConstraintSystemCacheHeader &header)
+{
+    if (key.empty() || size < sizeof(header))
+    {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (
+      memcmp(header.magic, ConstraintSystemCacheHeader::MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != ConstraintSystemCacheHeader::VERSION ||
+      header.coefficientSize != sizeof(CoefficientT::data) || header.key[sizeof(header.key) - 1] != 0 ||
+      key != header.key)
+    {
+        return false;
+    }
+    const uint64_t numCounts = (header.numConstraints * 3 + 1) / 2 * 2;
+    const uint64_t expectedSize = sizeof(header) + header.numCoefficients * header.coefficientSize +
+                                  numCounts * sizeof(uint32_t) + header.numTerms * 2 * sizeof(uint32_t);
+    return size == expectedSize &&
+           getConstraintSystemCacheChecksum(data + sizeof(header), size - sizeof(header)) == header.checksum;
+}
+
+// Replaces the constraints of the protoboard with the cached constraints. The protoboard needs to have the
+// variables of the circuit the cache was built for, the cache needs to be checked first.
+static bool loadConstraintSystemCache(
+  const char *data,
+  const ConstraintSystemCacheHeader &header,
+  ProtoboardT &pb)
+{
+    if (pb.num_variables() != header.numVariables || pb.num_inputs() != header.numInputs)
+    {
+        return false;
+    }
+    const char *ptr = data + sizeof(header);
+    std::vector<FieldT> coefficients;
+    coefficients.reserve(header.numCoefficients);
+    for (uint64_t i = 0; i < header.numCoefficients; i++)
+    {
+        CoefficientT value;
+        memcpy(value.data, ptr, sizeof(value.data));
+        ptr += sizeof(value.data);
+        coefficients.emplace_back(value);
+    }
+    const uint64_t numCounts = (header.numConstraints * 3 + 1) / 2 * 2;
+    const char *countsPtr = ptr;
+    const char *termsPtr = ptr + numCounts * sizeof(uint32_t);
+    const char *termsEnd = termsPtr + header.numTerms * 2 * sizeof(uint32_t);
+    auto readTerms = [&](libsnark::linear_combination<FieldT> &lc) {
+        uint32_t count;
+        memcpy(&count, countsPtr, sizeof(count));
+        countsPtr += sizeof(count);
+        if (termsPtr + size_t(count) * 2 * sizeof(uint32_t) > termsEnd)
+        {
+            return false;
+        }
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t term[2];
+            memcpy(term, termsPtr, sizeof(term));
+            termsPtr += sizeof(term);
+            if (term[0] >= header.numVariables + 1 || term[1] >= header.numCoefficients)
+            {
+                return false;
+            }
+            lc.add_term(VariableT(term[0]), coefficients[term[1]]);
+        }
+        return true;
+    };
+
+    pb.constraint_system.constraints.clear();
+#ifdef DEBUG
+    pb.constraint_system.constraint_annotations.clear();
+#endif
+    pb.constraint_system.constraints.reserve(header.numConstraints);
+    for (uint64_t i = 0; i < header.numConstraints; i++)
+    {
+        libsnark::linear_combination<FieldT> a, b, c;
+        if (!readTerms(a) || !readTerms(b) || !readTerms(c))
+        {
+            pb.constraint_system.constraints.clear();
+            return false;
+        }
+        pb.add_r1cs_constraint(ConstraintT(a, b, c), "");
+    }
+    return termsPtr == termsEnd;
+}
+
+} // namespace Loopring
+
+#endif
@@ -0,0 +1,333 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+// Modified by DeGate DAO, 2022
+#ifndef _CONSTRAINTSYSTEMOPTIMIZER_H_
+#define _CONSTRAINTSYSTEMOPTIMIZER_H_
+
+#include "ethsnarks.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+using namespace ethsnarks;
+
+namespace Loopring
+{
+
+// Creates a simplified copy of the constraint system of a protoboard:
+// - Constraints that are linear (A or B is a constant) are removed by substituting one of their variables
+//   in all other constraints. This merges variables that are required to be equal (requireEqual),
+//   replaces variables that are constant (Constants, padding with _0) and removes the additions of
+//   UnsafeAddGadget etc. Constraints that only become linear after a substitution (e.g. a TernaryGadget
+//   with a constant condition) are removed as well.
+// - Variables that are not used in any constraint anymore are dropped.
+// Only equations with a small number of variables are substituted so the linear combinations in the other
+// constraints don't grow. Primary inputs are never removed.
+//
+// The gadgets still generate the witness on the original protoboard, mapWitness copies the values of the
+// variables that are left to the optimized protoboard. The removed variables are fully determined by the
+// removed constraints, so a witness for the optimized system exists if and only if one exists for the
+// original system.
+class ConstraintSystemOptimizer
+{
+  public:
+    struct Term
+    {
+        size_t index;
+        FieldT coeff;
+    };
+    // Sorted on the variable index, without zero coefficients. Index 0 is the constant term.
+    typedef std::vector<Term> LinearCombination;
+
+    struct Constraint
+    {
+        LinearCombination a;
+        LinearCombination b;
+        LinearCombination c;
+        bool removed;
+    };
+
+    // The optimized constraint system and its variables
+    ProtoboardT pb;
+    // The variable on the original protoboard of every variable of the optimized protoboard (variable i + 1)
+    std::vector<size_t> variableMap;
+
+    size_t numVariablesBefore;
+    size_t numConstraintsBefore;
+    size_t numSubstitutions;
+
+    ConstraintSystemOptimizer(const ProtoboardT &original, unsigned int maxSubstitutionTerms = 3)
+        : numVariablesBefore(original.num_variables()),
+          numConstraintsBefore(original.num_constraints()),
+          numSubstitutions(0)
+    {
+        const size_t numInputs = original.num_inputs();
+
+        std::vector<Constraint> constraints;
+        constraints.reserve(original.constraint_system.constraints.size());
+        for (const auto &constraint : original.constraint_system.constraints)
+        {
+            constraints.push_back(Constraint{
+              read(constraint->getA()), read(constraint->getB()), read(constraint->getC()), false});
+        }
+
+        // The constraints every variable is used in
+        std::vector<std::vector<size_t>> occurrences(numVariablesBefore + 1);
+        for (size_t i = 0; i < constraints.size(); i++)
+        {
+            for (const LinearCombination *lc : {&constraints[i].a, &constraints[i].b, &constraints[i].c})
+            {
+                for (const Term &term : *lc)
+                {
+                    occurrences[term.index].push_back(i);
+                }
+            }
+        }
+
+        std::deque<size_t> queue;
+        std::vector<bool> queued(constraints.size(), true);
+        for (size_t i = 0; i < constraints.size(); i++)
+        {
+            queue.push_back(i);
+        }
+        while (!queue.empty())
+        {
+            const size_t i = queue.front();
+            queue.pop_front();
+            queued[i] = false;
+            Constraint &constraint = constraints[i];
+            if (constraint.removed)
+            {
+                continue;
+            }
+
+            // A * B = C is linear when A or B is a constant: equation == 0
+            LinearCombination equation;
+            if (isConstant(constraint.a))
+            {
+                equation = add(scale(constraint.b, constantValue(constraint.a)), scale(constraint.c, -FieldT::one()));
+            }
+            else if (isConstant(constraint.b))
+            {
+                equation = add(scale(constraint.a, constantValue(constraint.b)), scale(constraint.c, -FieldT::one()));
+            }
+            else
+            {
+                continue;
+            }
+
+            // Pick the last allocated variable that is not a primary input, normally the output of the gadget
+            size_t numVariables = 0;
+            const Term *pivot = nullptr;
+            for (const Term &term : equation)
+            {
+                if (term.index != 0)
+                {
+                    numVariables++;
+                }
+                if (term.index > numInputs)
+                {
+                    pivot = &term;
+                }
+            }
+            if (numVariables == 0)
+            {
+                // Always true (or never, in which case the constraint is kept so the system stays unsatisfiable)
+                constraint.removed = equation.empty();
+                continue;
+            }
+            if (pivot == nullptr || numVariables > maxSubstitutionTerms)
+            {
+                continue;
+            }
+
+            // pivot = -(equation - coeff * pivot) / coeff
+            const size_t index = pivot->index;
+            LinearCombination value;
+            const FieldT factor = -pivot->coeff.inverse();
+            for (const Term &term : equation)
+            {
+                if (term.index != index)
+                {
+                    value.push_back(Term{term.index, term.coeff * factor});
+                }
+            }
+
+            constraint.removed = true;
+            for (size_t j : occurrences[index])
+            {
+                Constraint &other = constraints[j];
+                if (other.removed)
+                {
+                    continue;
+                }
+                bool changed = substitute(other.a, index, value);
+                changed = substitute(other.b, index, value) || changed;
+                changed = substitute(other.c, index, value) || changed;
+                if (!changed)
+                {
+                    continue;
+                }
+                for (const Term &term : value)
+                {
+                    occurrences[term.index].push_back(j);
+                }
+                if (!queued[j])
+                {
+                    queued[j] = true;
+                    queue.push_back(j);
+                }
+            }
+            std::vector<size_t>().swap(occurrences[index]);
+            numSubstitutions++;
+        }
+        std::vector<std::vector<size_t>>().swap(occurrences);
+
+        // Only keep the primary inputs and the variables that are still used
+        std::vector<size_t> newIndices(numVariablesBefore + 1, 0);
+        for (size_t i = 1; i <= numInputs; i++)
+        {
+            newIndices[i] = 1;
+        }
+        for (const Constraint &constraint : constraints)
+        {
+            if (!constraint.removed)
+            {
+                for (const LinearCombination *lc : {&constraint.a, &constraint.b, &constraint.c})
+                {
+                    for (const Term &term : *lc)
+                    {
+                        newIndices[term.index] = 1;
+                    }
+                }
+            }
+        }
+        for (size_t i = 1; i <= numVariablesBefore; i++)
+        {
+            if (newIndices[i] != 0)
+            {
+                variableMap.push_back(i);
+                newIndices[i] = variableMap.size();
+            }
+        }
+
+        make_var_array(pb, variableMap.size(), ".optimized");
+        pb.set_input_sizes(numInputs);
+        for (Constraint &constraint : constraints)
+        {
+            if (!constraint.removed)
+            {
+                pb.add_r1cs_constraint(
+                  ConstraintT(
+                    write(constraint.a, newIndices), write(constraint.b, newIndices), write(constraint.c, newIndices)),
+                  "");
+            }
+            LinearCombination().swap(constraint.a);
+            LinearCombination().swap(constraint.b);
+            LinearCombination().swap(constraint.c);
+        }
+    }
+
+    // Copies the witness generated on the original protoboard
+    void mapWitness(const ProtoboardT &original)
+    {
+        for (size_t i = 0; i < variableMap.size(); i++)
+        {
+            pb.val(VariableT(i + 1)) = original.val(VariableT(variableMap[i]));
+        }
+    }
+
+  private:
+    static LinearCombination read(const libsnark::linear_combination<FieldT> &lc)
+    {
+        LinearCombination result;
+        for (const auto &term : lc.getTerms())
+        {
+            result.push_back(Term{term.index, term.coeff});
+        }
+        return normalize(result);
+    }
+
+    static libsnark::linear_combination<FieldT> write(
+      const LinearCombination &lc,
+      const std::vector<size_t> &newIndices)
+    {
+        libsnark::linear_combination<FieldT> result;
+        for (const Term &term : lc)
+        {
+            result = result + term.coeff * VariableT(term.index == 0 ? 0 : newIndices[term.index]);
+        }
+        return result;
+    }
+
+    static LinearCombination normalize(LinearCombination lc)
+    {
+        std::sort(lc.begin(), lc.end(), [](const Term &x, const Term &y) { return x.index < y.index; });
+        LinearCombination result;
+        for (const Term &term : lc)
+        {
+            if (!result.empty() && result.back().index == term.index)
+            {
+                result.back().coeff += term.coeff;
+            }
+            else
+            {
+                result.push_back(term);
+            }
+            if (result.back().coeff == FieldT::zero())
+            {
+                result.pop_back();
+            }
+        }
+        return result;
+    }
+
+    static bool isConstant(const LinearCombination &lc)
+    {
+        return lc.empty() || (lc.size() == 1 && lc[0].index == 0);
+    }
+
+    static FieldT constantValue(const LinearCombination &lc)
+    {
+        return lc.empty() ? FieldT::zero() : lc[0].coeff;
+    }
+
+    static LinearCombination scale(const LinearCombination &lc, const FieldT &factor)
+    {
+        LinearCombination result;
+        if (factor != FieldT::zero())
+        {
+            for (const Term &term : lc)
+            {
+                result.push_back(Term{term.index, term.coeff * factor});
+            }
+        }
+        return result;
+    }
+
+    static LinearCombination add(const LinearCombination &x, const LinearCombination &y)
+    {
+        LinearCombination result(x);
+        result.insert(result.end(), y.begin(), y.end());
+        return normalize(result);
+    }
+
+    // Replaces the variable `index` in `lc` with `value`, returns false if `lc` doesn't use the variable
+    static bool substitute(LinearCombination &lc, size_t index, const LinearCombination &value)
+    {
+        auto it = std::find_if(lc.begin(), lc.end(), [index](const Term &term) { return term.index == index; });
+        if (it == lc.end())
+        {
+            return false;
+        }
+        const FieldT coeff = it->coeff;
+        lc.erase(it);
+        lc = add(lc, scale(value, coeff));
+        return true;
+    }
+};
+
+} // namespace Loopring
+
+#endif
@@ -11,6 +11,10 @@
 #include "jubjub/eddsa.hpp"
 #include "jubjub/point.hpp"
 
+#include <memory>
+#include <stdexcept>
+#include <string>
+
 using json = nlohmann::json;
 
 namespace Loopring
@@ -799,6 +803,146 @@ enum class TransactionType
     COUNT
 };
 
+static unsigned int getTransactionTypeBit(TransactionType type)
+{
+    return 1u << (unsigned int)type;
+}
+
+static const unsigned int ALL_TRANSACTION_TYPES = (1u << (unsigned int)TransactionType::COUNT) - 1;
+
+// Transactions are sorted as Deposit(s), AccountUpdate(s), Other(s), Withdrawal(s) in a block.
+// A layout fixes the maximum size of the deposit, account update and withdrawal regions so every slot
+// only has to support the transaction types that can be in its region, the other region gets the
+// remaining slots. Noops are allowed in all slots so blocks that don't fill a region can be padded.
+// The deposit region also allows account updates because account updates directly follow the deposits.
+// The universal layout allows all transaction types in all slots.
+class BlockLayout
+{
+  public:
+    bool universal = true;
+    unsigned int numDeposits = 0;
+    unsigned int numAccountUpdates = 0;
+    unsigned int numWithdrawals = 0;
+    // When non-zero the operator balances are not updated in the Merkle tree by every transaction, the changes
+    // are collected in a table with this many tokens and the tree is only updated once per token at the end of
+    // the block
+    unsigned int numOperatorFeeTokens = 0;
+    // Prove with a simplified copy of the constraint system, see Utils/ConstraintSystemOptimizer.h
+    bool optimizeConstraints = false;
+
+    bool deferOperatorFees() const
+    {
+        return numOperatorFeeTokens > 0;
+    }
+
+    bool isValid(unsigned int blockSize) const
+    {
+        return universal || numDeposits + numAccountUpdates + numWithdrawals <= blockSize;
+    }
+
+    // Postfix used in the key filenames, empty for the universal layout
+    std::string getName() const
+    {
+        std::string name;
+        if (!universal)
+        {
+            name += "_" + std::to_string(numDeposits) + "_" + std::to_string(numAccountUpdates) + "_" +
+                    std::to_string(numWithdrawals);
+        }
+        if (deferOperatorFees())
+        {
+            name += "_f" + std::to_string(numOperatorFeeTokens);
+        }
+        if (optimizeConstraints)
+        {
+            name += "_o";
+        }
+        return name;
+    }
+
+    unsigned int getAllowedTransactionTypes(unsigned int slot, unsigned int blockSize) const
+    {
+        if (universal)
+        {
+            return ALL_TRANSACTION_TYPES;
+        }
+        unsigned int allowed = getTransactionTypeBit(TransactionType::Noop);
+        if (slot < numDeposits)
+        {
+            allowed |= getTransactionTypeBit(TransactionType::Deposit);
+            allowed |= getTransactionTypeBit(TransactionType::AccountUpdate);
+        }
+        else if (slot < numDeposits + numAccountUpdates)
+        {
+            allowed |= getTransactionTypeBit(TransactionType::AccountUpdate);
+        }
+        else if (slot >= blockSize - numWithdrawals)
+        {
+            allowed |= getTransactionTypeBit(TransactionType::Withdrawal);
+        }
+        else
+        {
+            allowed |= getTransactionTypeBit(TransactionType::Transfer);
+            allowed |= getTransactionTypeBit(TransactionType::SpotTrade);
+            allowed |= getTransactionTypeBit(TransactionType::OrderCancel);
+            allowed |= getTransactionTypeBit(TransactionType::AppKeyUpdate);
+            allowed |= getTransactionTypeBit(TransactionType::BatchSpotTrade);
+        }
+        return allowed;
+    }
+
+    bool operator==(const BlockLayout &other) const
+    {
+        return universal == other.universal && numDeposits == other.numDeposits &&
+               numAccountUpdates == other.numAccountUpdates && numWithdrawals == other.numWithdrawals &&
+               numOperatorFeeTokens == other.numOperatorFeeTokens &&
+               optimizeConstraints == other.optimizeConstraints;
+    }
+
+    bool operator!=(const BlockLayout &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+// {"deposits": 4, "accountUpdates": 2, "withdrawals": 8, "operatorFeeTokens": 4}
+// The regions and the operator fee table are both optional
+static void from_json(const json &j, BlockLayout &layout)
+{
+    layout.universal = (j.find("deposits") == j.end());
+    if (!layout.universal)
+    {
+        layout.numDeposits = j.at("deposits").get<unsigned int>();
+        layout.numAccountUpdates = j.at("accountUpdates").get<unsigned int>();
+        layout.numWithdrawals = j.at("withdrawals").get<unsigned int>();
+    }
+    if (j.find("operatorFeeTokens") != j.end())
+    {
+        layout.numOperatorFeeTokens = j["operatorFeeTokens"].get<unsigned int>();
+    }
+    if (j.find("optimize") != j.end())
+    {
+        layout.optimizeConstraints = j["optimize"].get<bool>();
+    }
+}
+
+// The layout is optional in the block data, blocks without a layout use the universal layout.
+// Throws std::runtime_error for a layout with an operator fee table: the operator doesn't produce the
+// operatorFeeUpdates of a block yet, so no block can be proven with such a layout.
+static BlockLayout getBlockLayout(const json &input)
+{
+    if (input.find("layout") == input.end())
+    {
+        return BlockLayout();
+    }
+    BlockLayout layout = input["layout"].get<BlockLayout>();
+    if (layout.deferOperatorFees())
+    {
+        throw std::runtime_error("Invalid block layout: operatorFeeTokens is not supported yet");
+    }
+    return layout;
+}
+
 class Proof
 {
   public:
@@ -967,6 +1111,21 @@ static void from_json(const json &j, Signature &signature)
     signature.s = ethsnarks::FieldT(j.at("s").get<std::string>().c_str());
 }
 
+// Only used by -benchmark to compare with the decoding before the prototypes: the dummy templates are parsed
+// again for every use. Needs to be set while no block is decoded.
+static bool &parseDummiesEveryTime()
+{
+    static bool value = false;
+    return value;
+}
+
+// The dummy templates are only parsed a single time, afterwards copies of the parsed prototype are used
+static Signature getDummySignature()
+{
+    static const Signature signature = dummySignature.get<Signature>();
+    return parseDummiesEveryTime() ? dummySignature.get<Signature>() : signature;
+}
+
 class AutoMarketOrder
 {
   public:
@@ -1087,6 +1246,12 @@ static void from_json(const json &j, Order &order)
     }
 }
 
+static Order getDummyBatchSpotTradeOrder()
+{
+    static const Order order = dummyBatchSpotTradeOrder.get<Order>();
+    return parseDummiesEveryTime() ? dummyBatchSpotTradeOrder.get<Order>() : order;
+}
+
 class SpotTrade
 {
   public:
@@ -1131,10 +1296,16 @@ static void from_json(const json &j, BatchSpotTradeUser &batchSpotTradeUser)
     }
     for (unsigned int i = 0; i < size - jOrders.size(); i++) 
     {
-        batchSpotTradeUser.orders.emplace_back(dummyBatchSpotTradeOrder.get<Loopring::Order>());
+        batchSpotTradeUser.orders.emplace_back(getDummyBatchSpotTradeOrder());
     }
 }
 
+static BatchSpotTradeUser getDummyBatchSpotTradeUser()
+{
+    static const BatchSpotTradeUser user = dummyBatchSpotTradeUser.get<BatchSpotTradeUser>();
+    return parseDummiesEveryTime() ? dummyBatchSpotTradeUser.get<BatchSpotTradeUser>() : user;
+}
+
 class BatchSpotTrade
 {
   public:
@@ -1168,7 +1339,7 @@ static void from_json(const json &j, BatchSpotTrade &batchSpotTrade)
     }
     for (unsigned int i = jUsers.size(); i < BATCH_SPOT_TRADE_MAX_USER; i++) 
     {
-        batchSpotTrade.users.emplace_back(dummyBatchSpotTradeUser.get<Loopring::BatchSpotTradeUser>());
+        batchSpotTrade.users.emplace_back(getDummyBatchSpotTradeUser());
     }
     json jTokens = j["tokens"];
     for (unsigned int i = 0; i < BATCH_SPOT_TRADE_MAX_TOKENS; i++)
@@ -1515,8 +1686,8 @@ static void from_json(const json &j, Witness &state)
     state.balanceUpdateA_O = j.at("balanceUpdateA_O").get<BalanceUpdate>();
     state.accountUpdate_O = j.at("accountUpdate_O").get<AccountUpdate>();
 
-    state.signatureA = dummySignature.get<Signature>();
-    state.signatureB = dummySignature.get<Signature>();
+    state.signatureA = getDummySignature();
+    state.signatureB = getDummySignature();
 
 
     for (unsigned int i = 0; i < BATCH_SPOT_TRADE_MAX_USER; i++)
@@ -1525,7 +1696,7 @@ static void from_json(const json &j, Witness &state)
         state.signatureArray.emplace_back(userSignatureArray);
         for (unsigned int j = 0; j < ORDER_SIZE_USER_MAX; j++) 
         {
-            state.signatureArray[i].emplace_back(dummySignature.get<Signature>());
+            state.signatureArray[i].emplace_back(getDummySignature());
         }
     }
 
@@ -1575,19 +1746,60 @@ class UniversalTransaction
     OrderCancel orderCancel;
 };
 
+// Dummy data for all tx types, parsed from the dummy templates
+class DummyTransactions
+{
+  public:
+    SpotTrade spotTrade;
+    BatchSpotTrade batchSpotTrade;
+    Transfer transfer;
+    Withdrawal withdraw;
+    Deposit deposit;
+    AccountUpdateTx accountUpdate;
+    OrderCancel orderCancel;
+    AppKeyUpdate appKeyUpdate;
+
+    static DummyTransactions parse()
+    {
+        DummyTransactions dummies;
+        dummies.spotTrade = dummySpotTrade.get<Loopring::SpotTrade>();
+        dummies.batchSpotTrade = dummyBatchSpotTrade.get<Loopring::BatchSpotTrade>();
+        dummies.transfer = dummyTransfer.get<Loopring::Transfer>();
+        dummies.withdraw = dummyWithdraw.get<Loopring::Withdrawal>();
+        dummies.deposit = dummyDeposit.get<Loopring::Deposit>();
+        dummies.accountUpdate = dummyAccountUpdate.get<Loopring::AccountUpdateTx>();
+        dummies.orderCancel = dummyOrderCancel.get<Loopring::OrderCancel>();
+        dummies.appKeyUpdate = dummyAppKeyUpdate.get<Loopring::AppKeyUpdate>();
+        return dummies;
+    }
+
+    // Parsed a single time, shared by all transactions
+    static const DummyTransactions &get()
+    {
+        static const DummyTransactions dummies = parse();
+        return dummies;
+    }
+};
+
 static void from_json(const json &j, UniversalTransaction &transaction)
 {
     transaction.witness = j.at("witness").get<Witness>();
 
     // Fill in dummy data for all tx types
-    transaction.spotTrade = dummySpotTrade.get<Loopring::SpotTrade>();
-    transaction.batchSpotTrade = dummyBatchSpotTrade.get<Loopring::BatchSpotTrade>();
-    transaction.transfer = dummyTransfer.get<Loopring::Transfer>();
-    transaction.withdraw = dummyWithdraw.get<Loopring::Withdrawal>();
-    transaction.deposit = dummyDeposit.get<Loopring::Deposit>();
-    transaction.accountUpdate = dummyAccountUpdate.get<Loopring::AccountUpdateTx>();
-    transaction.orderCancel = dummyOrderCancel.get<Loopring::OrderCancel>();
-    transaction.appKeyUpdate = dummyAppKeyUpdate.get<Loopring::AppKeyUpdate>();
+    std::unique_ptr<DummyTransactions> parsedDummies;
+    if (parseDummiesEveryTime())
+    {
+        parsedDummies.reset(new DummyTransactions(DummyTransactions::parse()));
+    }
+    const DummyTransactions &dummies = parsedDummies ? *parsedDummies : DummyTransactions::get();
+    transaction.spotTrade = dummies.spotTrade;
+    transaction.batchSpotTrade = dummies.batchSpotTrade;
+    transaction.transfer = dummies.transfer;
+    transaction.withdraw = dummies.withdraw;
+    transaction.deposit = dummies.deposit;
+    transaction.accountUpdate = dummies.accountUpdate;
+    transaction.orderCancel = dummies.orderCancel;
+    transaction.appKeyUpdate = dummies.appKeyUpdate;
 
     // Patch some of the dummy tx's so they are valid against the current state
     // Deposit
@@ -1670,6 +1882,9 @@ class Block
 
     ethsnarks::FieldT operatorAccountID;
     AccountUpdate accountUpdate_O;
+    // Operator balance updates applied at the end of the block, only used when the layout defers the
+    // operator fees (one update for every token in the table)
+    std::vector<BalanceUpdate> operatorFeeUpdates;
 
     std::vector<Loopring::UniversalTransaction> transactions;
 };
@@ -1693,12 +1908,50 @@ static void from_json(const json &j, Block &block)
 
     block.operatorAccountID = ethsnarks::FieldT(j.at("operatorAccountID"));
     block.accountUpdate_O = j.at("accountUpdate_O").get<AccountUpdate>();
+    block.operatorFeeUpdates.clear();
+    if (j.find("operatorFeeUpdates") != j.end())
+    {
+        json jOperatorFeeUpdates = j["operatorFeeUpdates"];
+        for (unsigned int i = 0; i < jOperatorFeeUpdates.size(); i++)
+        {
+            block.operatorFeeUpdates.emplace_back(jOperatorFeeUpdates[i].get<BalanceUpdate>());
+        }
+    }
 
-    // Read transactions
-    json jTransactions = j["transactions"];
-    for (unsigned int i = 0; i < jTransactions.size(); i++)
+    // Read transactions. Every transaction is decoded independently into its own slot,
+    // errors are reported for the first invalid transaction independent of the thread scheduling.
+    const json &jTransactions = j.at("transactions");
+    const int numTransactions = jTransactions.size();
+    block.transactions.clear();
+    block.transactions.resize(numTransactions);
+    int firstInvalid = numTransactions;
+    std::string error;
+#ifdef MULTICORE
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < numTransactions; i++)
+    {
+        try
+        {
+            from_json(jTransactions[i], block.transactions[i]);
+        }
+        catch (const std::exception &e)
+        {
+#ifdef MULTICORE
+#pragma omp critical(block_from_json)
+#endif
+            {
+                if (i < firstInvalid)
+                {
+                    firstInvalid = i;
+                    error = e.what();
+                }
+            }
+        }
+    }
+    if (firstInvalid < numTransactions)
     {
-        block.transactions.emplace_back(jTransactions[i].get<Loopring::UniversalTransaction>());
+        throw std::runtime_error("Invalid transaction " + std::to_string(firstInvalid) + ": " + error);
     }
 }
 
@@ -0,0 +1,343 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+// Modified by DeGate DAO, 2022
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include "ethsnarks.hpp"
+#include "Annotations.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <vector>
+
+using namespace ethsnarks;
+
+namespace Loopring
+{
+
+// Aggregates the cost of the circuit by the annotation prefix of the gadgets
+// (e.g. tx_0.batchSpotTrade.users[2].updateBalanceS), only used with -profile.
+// The gadgets mark their generate_r1cs_constraints and generate_r1cs_witness with ProfileConstraints and
+// ProfileWitness. Everything done inside a scope, but not inside a nested scope, is charged to that scope:
+// - the constraints that are added and the number of nonzero coefficients of those constraints
+// - the variables that are first used by those constraints (the variables are allocated in the constructors
+//   of the gadgets, which are not profiled)
+// - the time spent generating the witness
+class Profiler
+{
+  public:
+    struct Cost
+    {
+        size_t constraints = 0;
+        size_t variables = 0;
+        size_t nonzeroCoefficients = 0;
+        // In seconds
+        double witnessTime = 0.0;
+
+        Cost &operator+=(const Cost &other)
+        {
+            constraints += other.constraints;
+            variables += other.variables;
+            nonzeroCoefficients += other.nonzeroCoefficients;
+            witnessTime += other.witnessTime;
+            return *this;
+        }
+    };
+    typedef std::map<std::string, Cost> Costs;
+
+    // The scopes are named by the annotation prefixes of the gadgets, in a build without annotations
+    // (CIRCUIT_NO_ANNOTATIONS) all of them are empty and every cost would be reported under the same name
+    static bool isAvailable()
+    {
+        return CIRCUIT_ANNOTATIONS;
+    }
+
+    // The profiler the scopes report to, nullptr when not profiling
+    static Profiler *&active()
+    {
+        static Profiler *profiler = nullptr;
+        return profiler;
+    }
+
+    // Constraint generation needs to be single threaded while profiling
+    void enterConstraints(const ProtoboardT &pb, const std::string &name)
+    {
+        addSegment(pb);
+        constraintScopes.push_back(name);
+    }
+
+    void leaveConstraints(const ProtoboardT &pb)
+    {
+        addSegment(pb);
+        constraintScopes.pop_back();
+    }
+
+    // Witness generation can be done by multiple threads, every thread has its own stack of scopes
+    void enterWitness(const std::string &name)
+    {
+        getWitnessScopes().push_back(WitnessScope{name, std::chrono::steady_clock::now(), 0.0});
+    }
+
+    void leaveWitness()
+    {
+        std::vector<WitnessScope> &scopes = getWitnessScopes();
+        const WitnessScope &scope = scopes.back();
+        const double elapsed =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - scope.start).count();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            costs[scope.name].witnessTime += elapsed - scope.childTime;
+        }
+        scopes.pop_back();
+        if (!scopes.empty())
+        {
+            scopes.back().childTime += elapsed;
+        }
+    }
+
+    // Charges the constraints, the coefficients and the variables to the scopes.
+    // Needs to be called after the constraints are generated, while they are still on the protoboard.
+    void analyzeConstraints(const ProtoboardT &pb)
+    {
+        addSegment(pb);
+        std::vector<bool> used(pb.num_variables() + 1, false);
+        auto countTerms = [&](Cost &cost, const libsnark::linear_combination<FieldT> &lc) {
+            for (const auto &term : lc.getTerms())
+            {
+                cost.nonzeroCoefficients++;
+                if (term.index != 0 && !used[term.index])
+                {
+                    used[term.index] = true;
+                    cost.variables++;
+                }
+            }
+        };
+        for (const Segment &segment : segments)
+        {
+            Cost &cost = costs[segment.name];
+            cost.constraints += segment.end - segment.begin;
+            for (size_t i = segment.begin; i < segment.end; i++)
+            {
+                const auto &constraint = pb.constraint_system.constraints[i];
+                countTerms(cost, constraint->getA());
+                countTerms(cost, constraint->getB());
+                countTerms(cost, constraint->getC());
+            }
+        }
+        segments.clear();
+        costs[std::string(UNCONSTRAINED)].variables += std::count(used.begin() + 1, used.end(), false);
+    }
+
+    // The cost of every scope, without the cost of the nested scopes
+    const Costs &getCosts() const
+    {
+        return costs;
+    }
+
+    // Only the scopes of a single transaction slot
+    Costs getSlotCosts(unsigned int slot) const
+    {
+        const std::string prefix = getSlotName(slot);
+        Costs result;
+        for (const auto &it : costs)
+        {
+            if (isScopeOf(it.first, prefix))
+            {
+                result[it.first] += it.second;
+            }
+        }
+        return result;
+    }
+
+    // The scopes of all transaction slots are summed up in tx_*
+    Costs getCollapsedCosts() const
+    {
+        const std::regex slot("^tx_[0-9]+");
+        Costs result;
+        for (const auto &it : costs)
+        {
+            result[std::regex_replace(it.first, slot, "tx_*")] += it.second;
+        }
+        return result;
+    }
+
+    // Prints the total cost (including the nested scopes) and the own cost of every scope
+    static void print(std::ostream &out, const Costs &costs)
+    {
+        Cost total;
+        for (const auto &it : costs)
+        {
+            total += it.second;
+        }
+        out << std::left << std::setw(80) << "scope" << std::right << std::setw(12) << "constraints"
+            << std::setw(8) << "%" << std::setw(12) << "own" << std::setw(12) << "variables" << std::setw(14)
+            << "coefficients" << std::setw(14) << "witness (ms)" << std::endl;
+        for (auto it = costs.begin(); it != costs.end(); ++it)
+        {
+            // The nested scopes of `scope` are sorted between `scope.` and `scope/`
+            Cost cost = it->second;
+            auto end = costs.lower_bound(it->first + "/");
+            for (auto child = costs.lower_bound(it->first + "."); child != end; ++child)
+            {
+                cost += child->second;
+            }
+            const double share = total.constraints ? (100.0 * cost.constraints) / total.constraints : 0.0;
+            out << std::left << std::setw(80) << it->first << std::right << std::setw(12) << cost.constraints
+                << std::setw(8) << std::fixed << std::setprecision(2) << share << std::setw(12)
+                << it->second.constraints << std::setw(12) << cost.variables << std::setw(14)
+                << cost.nonzeroCoefficients << std::setw(14) << std::setprecision(3) << cost.witnessTime * 1000.0
+                << std::endl;
+        }
+        out << std::left << std::setw(80) << "total" << std::right << std::setw(12) << total.constraints
+            << std::setw(8) << "100.00" << std::setw(12) << "" << std::setw(12) << total.variables << std::setw(14)
+            << total.nonzeroCoefficients << std::setw(14) << std::setprecision(3) << total.witnessTime * 1000.0
+            << std::endl;
+    }
+
+    // Writes the costs in the folded stack format used by flamegraph.pl/speedscope, one line per scope:
+    // tx_0;batchSpotTrade;users[2] <own constraints>
+    // The witness generation times (in microseconds) are written to filename.witness.
+    bool writeFlameGraph(const std::string &filename) const
+    {
+        std::ofstream constraintsFile(filename);
+        std::ofstream witnessFile(filename + ".witness");
+        if (!constraintsFile.is_open() || !witnessFile.is_open())
+        {
+            std::cerr << "Cannot create flamegraph file: " << filename << std::endl;
+            return false;
+        }
+        for (const auto &it : costs)
+        {
+            std::string stack = it.first;
+            std::replace(stack.begin(), stack.end(), '.', ';');
+            std::replace(stack.begin(), stack.end(), ' ', '_');
+            if (it.second.constraints > 0)
+            {
+                constraintsFile << stack << " " << it.second.constraints << "\n";
+            }
+            const size_t witnessTime = size_t(it.second.witnessTime * 1000000.0);
+            if (witnessTime > 0)
+            {
+                witnessFile << stack << " " << witnessTime << "\n";
+            }
+        }
+        return constraintsFile.good() && witnessFile.good();
+    }
+
+    static std::string getSlotName(unsigned int slot)
+    {
+        return std::string("tx_") + std::to_string(slot);
+    }
+
+    // The scope that is charged for the work done outside all scopes
+    static constexpr const char *UNPROFILED = "(unprofiled)";
+    // The scope that is charged for the variables not used in any constraint
+    static constexpr const char *UNCONSTRAINED = "(unconstrained)";
+
+  private:
+    // The constraints [begin, end) were added while `name` was the innermost scope
+    struct Segment
+    {
+        std::string name;
+        size_t begin;
+        size_t end;
+    };
+
+    struct WitnessScope
+    {
+        std::string name;
+        std::chrono::steady_clock::time_point start;
+        // Time spent in the nested scopes
+        double childTime;
+    };
+
+    Costs costs;
+    std::mutex mutex;
+    std::vector<std::string> constraintScopes;
+    std::vector<Segment> segments;
+    size_t numConstraints = 0;
+
+    static std::vector<WitnessScope> &getWitnessScopes()
+    {
+        static thread_local std::vector<WitnessScope> scopes;
+        return scopes;
+    }
+
+    static bool isScopeOf(const std::string &name, const std::string &scope)
+    {
+        return name.compare(0, scope.size(), scope) == 0 &&
+               (name.size() == scope.size() || name[scope.size()] == '.');
+    }
+
+    void addSegment(const ProtoboardT &pb)
+    {
+        const size_t current = pb.num_constraints();
+        if (current > numConstraints)
+        {
+            const std::string name = constraintScopes.empty() ? std::string(UNPROFILED) : constraintScopes.back();
+            segments.push_back(Segment{name, numConstraints, current});
+        }
+        numConstraints = current;
+    }
+};
+
+// Profiles the constraints generated during the lifetime of the object
+class ProfileConstraints
+{
+  public:
+    ProfileConstraints(const ProtoboardT &_pb, const std::string &name) : pb(_pb), profiler(Profiler::active())
+    {
+        if (profiler)
+        {
+            profiler->enterConstraints(pb, name);
+        }
+    }
+
+    ~ProfileConstraints()
+    {
+        if (profiler)
+        {
+            profiler->leaveConstraints(pb);
+        }
+    }
+
+  private:
+    const ProtoboardT &pb;
+    Profiler *profiler;
+};
+
+// Profiles the witness generated during the lifetime of the object
+class ProfileWitness
+{
+  public:
+    ProfileWitness(const std::string &name) : profiler(Profiler::active())
+    {
+        if (profiler)
+        {
+            profiler->enterWitness(name);
+        }
+    }
+
+    ~ProfileWitness()
+    {
+        if (profiler)
+        {
+            profiler->leaveWitness();
+        }
+    }
+
+  private:
+    Profiler *profiler;
+};
+
+} // namespace Loopring
+
+#endif
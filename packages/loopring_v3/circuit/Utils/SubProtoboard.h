@@ -0,0 +1,231 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+// Modified by DeGate DAO, 2022
+#ifndef _SUBPROTOBOARD_H_
+#define _SUBPROTOBOARD_H_
+
+#include "Utils.h"
+
+#include "ethsnarks.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace ethsnarks;
+
+namespace Loopring
+{
+
+// A protoboard for a group of gadgets that is created separately from the main protoboard (e.g. on another
+// thread), and that is spliced into the main protoboard afterwards.
+// - The variables of the main protoboard the gadgets use are allocated first on this protoboard as
+//   placeholders (imports). endImports() marks the end of the placeholders, bind() sets the variable of the
+//   main protoboard of every placeholder, which can be done at any time before splice().
+// - splice() allocates the other variables on the main protoboard and appends the constraints with the
+//   variables renumbered. The variables and constraints end up in the order they were created on this
+//   protoboard, so the constraint system is the same as when the gadgets would have been created on the main
+//   protoboard at that point.
+// - The gadgets keep using this protoboard for the witness: pullWitness copies the values of the placeholders
+//   from the main protoboard, pushWitness copies the values of the other variables to the main protoboard.
+// - stamp() is splice() without removing the constraints from this protoboard, so the same gadgets can be
+//   copied multiple times into the main protoboard (the placeholders are bound again before every copy).
+//   The witness of a copy is generated by setting the relocation to the one of the copy, on this
+//   SubProtoboard or on another one with the same variables. The import values of a copy can be read
+//   beforehand (Relocation::importValues), e.g. before the witness of other copies is pushed on other threads.
+class SubProtoboard
+{
+  public:
+    static constexpr size_t UNBOUND = std::numeric_limits<size_t>::max();
+
+    // Where the variables are on the main protoboard
+    struct Relocation
+    {
+        // The variable on the main protoboard of every placeholder (variable i + 1)
+        std::vector<size_t> imports;
+        // The number of variables on the main protoboard before the splice
+        size_t begin = UNBOUND;
+
+        size_t toMain(size_t index) const
+        {
+            assert(begin != UNBOUND);
+            if (index == 0)
+            {
+                return 0;
+            }
+            return (index <= imports.size()) ? imports[index - 1] : begin + (index - imports.size());
+        }
+
+        VariableT toMain(const VariableT &var) const
+        {
+            return VariableT(toMain(var.index));
+        }
+
+        VariableArrayT toMain(const VariableArrayT &vars) const
+        {
+            VariableArrayT result;
+            result.reserve(vars.size());
+            for (const VariableT &var : vars)
+            {
+                result.emplace_back(toMain(var));
+            }
+            return result;
+        }
+
+        // The values of the placeholders on the main protoboard, see pullWitness
+        std::vector<FieldT> importValues(const ProtoboardT &main) const
+        {
+            std::vector<FieldT> values;
+            values.reserve(imports.size());
+            for (size_t index : imports)
+            {
+                values.emplace_back(main.val(VariableT(index)));
+            }
+            return values;
+        }
+    };
+
+    ProtoboardT pb;
+    Relocation relocation;
+
+    // All variables allocated until now are placeholders
+    void endImports()
+    {
+        relocation.imports.assign(pb.num_variables(), size_t(UNBOUND));
+    }
+
+    void bind(const VariableT &placeholder, const VariableT &var)
+    {
+        assert(placeholder.index > 0 && placeholder.index <= relocation.imports.size());
+        relocation.imports[placeholder.index - 1] = var.index;
+    }
+
+    void bind(const VariableArrayT &placeholders, const VariableArrayT &vars)
+    {
+        assert(placeholders.size() == vars.size());
+        for (size_t i = 0; i < placeholders.size(); i++)
+        {
+            bind(placeholders[i], vars[i]);
+        }
+    }
+
+    // Number of variables that are not placeholders
+    size_t numVariables() const
+    {
+        return pb.num_variables() - relocation.imports.size();
+    }
+
+    // Needs to be called in the order the gadgets would have been created on the main protoboard
+    void stamp(ProtoboardT &main, const std::string &annotation)
+    {
+        for (size_t i = 0; i < relocation.imports.size(); i++)
+        {
+            ASSERT(relocation.imports[i] != UNBOUND, annotation << ": placeholder " << (i + 1) << " is not bound");
+        }
+        relocation.begin = main.num_variables();
+        make_var_array(main, numVariables(), annotation);
+        for (const auto &constraint : pb.constraint_system.constraints)
+        {
+            main.add_r1cs_constraint(
+              ConstraintT(remap(constraint->getA()), remap(constraint->getB()), remap(constraint->getC())),
+              annotation);
+        }
+    }
+
+    void splice(ProtoboardT &main, const std::string &annotation)
+    {
+        stamp(main, annotation);
+        clearConstraints();
+    }
+
+    void clearConstraints()
+    {
+        pb.constraint_system.constraints.clear();
+        pb.constraint_system.constraints.shrink_to_fit();
+#ifdef DEBUG
+        pb.constraint_system.constraint_annotations.clear();
+#endif
+    }
+
+    // The variable on the main protoboard, only available after splice()
+    size_t toMain(size_t index) const
+    {
+        assert(index <= pb.num_variables());
+        return relocation.toMain(index);
+    }
+
+    VariableT toMain(const VariableT &var) const
+    {
+        return VariableT(toMain(var.index));
+    }
+
+    VariableArrayT toMain(const VariableArrayT &vars) const
+    {
+        return relocation.toMain(vars);
+    }
+
+    void pullWitness(const ProtoboardT &main)
+    {
+        pullWitness(relocation.importValues(main));
+    }
+
+    void pullWitness(const std::vector<FieldT> &importValues)
+    {
+        assert(importValues.size() == relocation.imports.size());
+        for (size_t i = 0; i < importValues.size(); i++)
+        {
+            pb.val(VariableT(i + 1)) = importValues[i];
+        }
+    }
+
+    // Sets the values of the other variables to zero, like on a new protoboard, before the gadgets generate the
+    // witness of another copy
+    void clearWitness()
+    {
+        for (size_t i = relocation.imports.size() + 1; i <= pb.num_variables(); i++)
+        {
+            pb.val(VariableT(i)) = FieldT::zero();
+        }
+    }
+
+    void pushWitness(ProtoboardT &main) const
+    {
+        for (size_t i = relocation.imports.size() + 1; i <= pb.num_variables(); i++)
+        {
+            main.val(VariableT(toMain(i))) = pb.val(VariableT(i));
+        }
+    }
+
+  private:
+    // The linear combinations created by the libsnark operators are sorted on the variable index, those stay
+    // sorted after the renumbering. All others keep the order of their terms.
+    libsnark::linear_combination<FieldT> remap(const libsnark::linear_combination<FieldT> &lc) const
+    {
+        typedef std::pair<size_t, FieldT> Term;
+        bool sorted = true;
+        size_t previous = 0;
+        std::vector<Term> mapped;
+        mapped.reserve(lc.getTerms().size());
+        for (const auto &term : lc.getTerms())
+        {
+            sorted = sorted && (mapped.empty() || previous < term.index);
+            previous = term.index;
+            mapped.emplace_back(relocation.toMain(term.index), term.coeff);
+        }
+        if (sorted)
+        {
+            std::sort(mapped.begin(), mapped.end(), [](const Term &x, const Term &y) { return x.first < y.first; });
+        }
+        libsnark::linear_combination<FieldT> result;
+        for (const auto &term : mapped)
+        {
+            result.add_term(VariableT(term.first), term.second);
+        }
+        return result;
+    }
+};
+
+} // namespace Loopring
+
+#endif
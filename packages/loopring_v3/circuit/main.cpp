@@ -4,7 +4,10 @@
 
 #include "ThirdParty/BigInt.hpp"
 #include "Utils/Data.h"
+#include "Utils/BinaryData.h"
+#include "Utils/ConstraintSystemCache.h"
 #include "Circuits/UniversalCircuit.h"
+#include "Circuits/BlockValidator.h"
 
 #include "ThirdParty/httplib.h"
 //#include "ThirdParty/json.hpp"
@@ -14,25 +17,34 @@
 #include <fstream>
 #include <chrono>
 #include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
 #include <exception>
 #include <pthread.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 
 #ifdef MULTICORE
 #include <omp.h>
 #endif
 
-#define WITH_MEMORY_STATS 0
-
-#if WITH_MEMORY_STATS
-#include <unistd.h>
 #include <ios>
 #include <string>
-
 #include <malloc.h>
 
+#define WITH_MEMORY_STATS 0
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // process_mem_usage(double &, double &) - takes two doubles by reference,
@@ -63,8 +75,8 @@ void process_mem_usage(double &vm_usage, double &resident_set)
 
     // the two fields we want
     //
-    unsigned long vsize;
-    long rss;
+    unsigned long vsize = 0;
+    long rss = 0;
 
     stat_stream >> pid >> comm >> state >> ppid >> pgrp >> session >> tty_nr >> tpgid >> flags >> minflt >> cminflt >>
       majflt >> cmajflt >> utime >> stime >> cutime >> cstime >> priority >> nice >> O >> itrealvalue >> starttime >>
@@ -77,6 +89,7 @@ void process_mem_usage(double &vm_usage, double &resident_set)
     resident_set = rss * page_size_kb;
 }
 
+#if WITH_MEMORY_STATS
 void printMemoryUsage()
 {
     malloc_trim(0);
@@ -100,9 +113,11 @@ enum class Mode
     Prove,
     ExportCircuit,
     ExportWitness,
+    BuildCache,
     Server,
     Benchmark,
-	Test
+	Test,
+    Profile
 };
 
 namespace libsnark
@@ -177,6 +192,70 @@ static void from_json(const nlohmann::json &j, BenchmarkConfig &config)
     config.multi_exp_look_ahead = j.at("multi_exp_look_ahead").get<std::vector<unsigned int>>();
 }
 
+// Read-only shared mapping of a file. The pages live in the page cache, so all
+// processes mapping the same file share a single copy.
+class MappedFile
+{
+  public:
+    MappedFile(const std::string &filename) : data(nullptr), size(0)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            std::cerr << "Cannot open file: " << filename << std::endl;
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            close(fd);
+            return;
+        }
+        void *ptr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (ptr == MAP_FAILED)
+        {
+            std::cerr << "Cannot map file: " << filename << std::endl;
+            return;
+        }
+        data = ptr;
+        size = st.st_size;
+
+        madvise(data, size, MADV_SEQUENTIAL);
+        madvise(data, size, MADV_WILLNEED);
+    }
+
+    ~MappedFile()
+    {
+        if (data != nullptr)
+        {
+            munmap(data, size);
+        }
+    }
+
+    bool isMapped() const
+    {
+        return data != nullptr;
+    }
+
+    size_t getSize() const
+    {
+        return size;
+    }
+
+    const char *getData() const
+    {
+        return static_cast<const char *>(data);
+    }
+
+  private:
+    void *data;
+    size_t size;
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+};
+
 static inline auto now() -> decltype(std::chrono::high_resolution_clock::now())
 {
     return std::chrono::high_resolution_clock::now();
@@ -255,6 +334,9 @@ libsnark::Config loadConfig(const std::string &filename)
     return loadJSON(filename).get<libsnark::Config>();
 }
 
+// The proving key is deserialized into heap memory by ethsnarks. Using the query vectors straight from a
+// mapping of the file (shared by all processes using the same key) needs a proving key layout that can be
+// mapped and a prover that reads the queries from it, both in the ethsnarks submodule.
 void loadProvingKey(const std::string &pk_file, ethsnarks::ProvingKeyT &proving_key)
 {
     std::cout << "Loading proving key " << pk_file << "..." << std::endl;
@@ -278,6 +360,24 @@ VerificationKeyT loadVerificationKey(const std::string &vk_file)
     return vk_from_json(loadJSON(vk_file));
 }
 
+typedef libsnark::r1cs_gg_ppzksnark_zok_processed_verification_key<ppT> ProcessedVerificationKeyT;
+
+// Precomputes the G2 pairing lines and the IC table so every verification only needs the online part
+ProcessedVerificationKeyT loadProcessedVerificationKey(const std::string &vk_file)
+{
+    VerificationKeyT vk = loadVerificationKey(vk_file);
+    std::cout << "Processing verification key..." << std::endl;
+    return libsnark::r1cs_gg_ppzksnark_zok_verifier_process_vk<ppT>(vk);
+}
+
+bool verifyProof(const ProcessedVerificationKeyT &pvk, const std::string &jProof)
+{
+    std::stringstream proof_stream;
+    proof_stream << jProof;
+    auto proof_pair = proof_from_json(proof_stream);
+    return libsnark::r1cs_gg_ppzksnark_zok_online_verifier_strong_IC<ppT>(pvk, proof_pair.first, proof_pair.second);
+}
+
 std::string proveCircuit(ProverContextT &context, Loopring::Circuit *circuit)
 {
     std::cout << "Generating proof..." << std::endl;
@@ -304,17 +404,104 @@ bool writeProof(const std::string &jProof, const std::string &proofFilename)
     return true;
 }
 
-Loopring::Circuit *newCircuit(unsigned int blockType, ethsnarks::ProtoboardT &outPb)
+Loopring::Circuit *newCircuit(
+  unsigned int blockType,
+  const Loopring::BlockLayout &layout,
+  ethsnarks::ProtoboardT &outPb)
 {
-    return new Loopring::UniversalCircuit(outPb, "circuit");
+    Loopring::Circuit *circuit = new Loopring::UniversalCircuit(outPb, "circuit");
+    circuit->layout = layout;
+    return circuit;
 }
 
-Loopring::Circuit *createCircuit(unsigned int blockType, unsigned int blockSize, ethsnarks::ProtoboardT &outPb)
+std::string getConstraintSystemCacheFilename(const std::string &baseFilename)
+{
+    return baseFilename + "_cs.bin";
+}
+
+bool buildConstraintSystemCache(
+  const std::string &cacheFilename,
+  unsigned int blockType,
+  unsigned int blockSize,
+  const Loopring::BlockLayout &layout,
+  const ethsnarks::ProtoboardT &pb)
+{
+    std::cout << "Writing constraint system cache " << cacheFilename << "..." << std::endl;
+    auto begin = now();
+    const std::string key = Loopring::getConstraintSystemCacheKey(blockType, blockSize, layout);
+    if (key.empty())
+    {
+        std::cerr << "No circuit source hash available, cannot build a cache" << std::endl;
+        return false;
+    }
+    std::ofstream file(cacheFilename, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Cannot create cache file: " << cacheFilename << std::endl;
+        return false;
+    }
+    if (!Loopring::writeConstraintSystemCache(file, key, pb))
+    {
+        std::cerr << "Failed to write cache file: " << cacheFilename << std::endl;
+        return false;
+    }
+    print_time(begin, "Constraint system cache written");
+    return true;
+}
+
+// The cache is only used when it was built for the same circuit sources, block type, block size and layout,
+// and when the circuit has exactly the variables the cache was built for. Otherwise the constraints are
+// generated.
+Loopring::Circuit *createCircuit(
+  unsigned int blockType,
+  unsigned int blockSize,
+  const Loopring::BlockLayout &layout,
+  ethsnarks::ProtoboardT &outPb,
+  const std::string &cacheFilename = "",
+  bool optimize = true)
 {
     std::cout << "Creating circuit... " << std::endl;
     auto begin = now();
-    Loopring::Circuit *circuit = newCircuit(blockType, outPb);
+    Loopring::ConstraintSystemCacheHeader header;
+    std::unique_ptr<MappedFile> cache;
+    if (cacheFilename.length() != 0 && fileExists(cacheFilename))
+    {
+        cache.reset(new MappedFile(cacheFilename));
+        const std::string key = Loopring::getConstraintSystemCacheKey(blockType, blockSize, layout);
+        if (
+          !cache->isMapped() ||
+          !Loopring::checkConstraintSystemCache(cache->getData(), cache->getSize(), key, header))
+        {
+            std::cout << "Constraint system cache " << cacheFilename << " is outdated, ignoring it" << std::endl;
+            cache.reset();
+        }
+    }
+    Loopring::Circuit *circuit = newCircuit(blockType, layout, outPb);
+    // With a valid cache the gadgets are still created (the witness needs them), but the constraints of the
+    // transactions are not generated
+    circuit->transactionConstraints = !cache;
     circuit->generateConstraints(blockSize);
+    if (cache)
+    {
+        if (Loopring::loadConstraintSystemCache(cache->getData(), header, outPb))
+        {
+            std::cout << "Constraints loaded from " << cacheFilename << std::endl;
+        }
+        else
+        {
+            std::cout << "Constraint system cache " << cacheFilename << " does not match, ignoring it" << std::endl;
+            delete circuit;
+            outPb = ethsnarks::ProtoboardT();
+            circuit = newCircuit(blockType, layout, outPb);
+            circuit->generateConstraints(blockSize);
+        }
+    }
+    if (layout.optimizeConstraints && optimize)
+    {
+        auto beginOptimize = now();
+        circuit->optimizeConstraints();
+        print_time(beginOptimize, "Constraints optimized");
+    }
     circuit->printInfo();
     print_time(begin, "Circuit created");
     return circuit;
@@ -329,199 +516,1116 @@ bool generateWitness(Loopring::Circuit *circuit, const json &input)
         std::cerr << "Could not generate witness!" << std::endl;
         return false;
     }
-    print_time(begin, "Witness generated");
-    return true;
-}
+    circuit->mapWitness();
+    print_time(begin, "Witness generated");
+    return true;
+}
+
+bool generateWitness(Loopring::Circuit *circuit, const Loopring::Block &block)
+{
+    std::cout << "Generating witness... " << std::endl;
+    auto begin = now();
+    if (!circuit->generateWitness(block))
+    {
+        std::cerr << "Could not generate witness!" << std::endl;
+        return false;
+    }
+    circuit->mapWitness();
+    print_time(begin, "Witness generated");
+    return true;
+}
+
+// Returns true if the file starts with the binary block magic (see Utils/BinaryData.h)
+bool isBinaryBlockFile(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    char magic[8] = {0};
+    file.read(magic, sizeof(magic));
+    return file.gcount() == sizeof(magic) && memcmp(magic, Loopring::BinaryBlockHeader::MAGIC, sizeof(magic)) == 0;
+}
+
+// Decodes a block stored in the binary format, returns an empty pointer on failure
+std::unique_ptr<Loopring::Block> loadBinaryBlock(const std::string &filename, Loopring::BinaryBlockHeader &header)
+{
+    std::unique_ptr<Loopring::Block> block;
+    MappedFile file(filename);
+    if (!file.isMapped())
+    {
+        std::cerr << "Cannot read binary block: " << filename << std::endl;
+        return block;
+    }
+    if (!Loopring::readBinaryBlockHeader(file.getData(), file.getSize(), header))
+    {
+        std::cerr << "Binary block " << filename << " was not created for this version/field/layout" << std::endl;
+        return block;
+    }
+    try
+    {
+        block.reset(new Loopring::Block());
+        Loopring::readBinaryBlock(file.getData(), file.getSize(), *block);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Failed to decode binary block " << filename << ": " << e.what() << std::endl;
+        block.reset();
+    }
+    return block;
+}
+
+bool convertBlock(const std::string &jsonFilename, const std::string &binaryFilename)
+{
+    json input = loadJSON(jsonFilename);
+    if (input == json())
+    {
+        return false;
+    }
+    unsigned int blockType = input["blockType"].get<int>();
+    unsigned int blockSize = input["blockSize"].get<int>();
+    Loopring::BlockLayout layout;
+    try
+    {
+        layout = Loopring::getBlockLayout(input);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return false;
+    }
+    auto begin = now();
+    Loopring::Block block = input.get<Loopring::Block>();
+    print_time(begin, "Block decoded");
+
+    std::ofstream file(binaryFilename, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Cannot create binary block file: " << binaryFilename << std::endl;
+        return false;
+    }
+    Loopring::writeBinaryBlock(file, blockType, blockSize, layout, block);
+    file.close();
+    if (file.fail())
+    {
+        std::cerr << "Failed to write binary block file: " << binaryFilename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool preValidateBlock(const Loopring::Block &block)
+{
+    std::cout << "Pre-validating block..." << std::endl;
+    auto begin = now();
+    std::string error = Loopring::BlockValidator().validate(block);
+    if (!error.empty())
+    {
+        std::cerr << "Block is invalid: " << error << std::endl;
+        return false;
+    }
+    print_time(begin, "Block pre-validated");
+    return true;
+}
+
+bool validateCircuit(Loopring::Circuit *circuit)
+{
+    std::cout << "Validating block..." << std::endl;
+    auto begin = now();
+    // Check if the inputs are valid for the circuit
+    #ifndef NDEBUG
+        circuit->printInfo();
+    #endif
+    if (!circuit->getPb().is_satisfied())
+    {
+        std::cerr << "Block is not valid!" << std::endl;
+        return false;
+    }
+    print_time(begin, "Block is valid");
+    return true;
+}
+
+std::string getBaseName(unsigned int blockType)
+{
+    switch (blockType)
+    {
+        default:
+            return "all";
+    }
+}
+
+std::string getProvingKeyFilename(const std::string &baseFilename)
+{
+    return baseFilename + "_pk.raw";
+}
+
+// Everything needed to prove blocks of a single block size
+struct ProverInstance
+{
+    unsigned int blockSize = 0;
+    Loopring::BlockLayout layout;
+    ethsnarks::ProtoboardT pb;
+    std::unique_ptr<Loopring::Circuit> circuit;
+    ProverContextT context;
+    ProcessedVerificationKeyT pvk;
+    // Increase of the RSS while loading the instance (in KB)
+    double memoryUsage = 0.0;
+    // Used to find the least recently used instance
+    unsigned long lastUsed = 0;
+};
+
+// Keeps a ProverInstance for each block size the server supports. Instances are created
+// when first needed and the least recently used idle ones are evicted when the
+// total memory used by the instances would exceed the memory budget.
+class ProverRegistry
+{
+  public:
+    ProverRegistry(
+      const std::string &_keysDirectory,
+      unsigned int _blockType,
+      const Loopring::BlockLayout &_layout,
+      const std::vector<unsigned int> &_blockSizes,
+      double _memoryBudget,
+      const libsnark::Config &_config)
+        : keysDirectory(_keysDirectory),
+          blockType(_blockType),
+          layout(_layout),
+          blockSizes(_blockSizes),
+          memoryBudget(_memoryBudget),
+          config(_config),
+          useCounter(0)
+    {
+    }
+
+    unsigned int getBlockType() const
+    {
+        return blockType;
+    }
+
+    const Loopring::BlockLayout &getLayout() const
+    {
+        return layout;
+    }
+
+    const std::vector<unsigned int> &getBlockSizes() const
+    {
+        return blockSizes;
+    }
+
+    bool isSupported(unsigned int blockSize) const
+    {
+        return layout.isValid(blockSize) &&
+               std::find(blockSizes.begin(), blockSizes.end(), blockSize) != blockSizes.end();
+    }
+
+    unsigned int getNumLoaded()
+    {
+        const std::lock_guard<std::mutex> lock(mtx);
+        return instances.size();
+    }
+
+    bool isLoaded(unsigned int blockSize)
+    {
+        const std::lock_guard<std::mutex> lock(mtx);
+        return instances.find(blockSize) != instances.end();
+    }
+
+    std::string getBaseFilename(unsigned int blockSize) const
+    {
+        return keysDirectory + getBaseName(blockType) + "_" + std::to_string(blockSize) + layout.getName();
+    }
+
+    // Returns the instance for the block size, creating it if necessary.
+    // Returns nullptr if the block size is not supported.
+    // Creating a circuit adds coefficients to the process-wide libsnark::ConstantStorage table, which the
+    // witness generation and the prover of every instance read from. So instances are only created while no
+    // witness or proof is generated: before the server starts, or on the prover thread of the ProverQueue
+    // between two jobs.
+    std::shared_ptr<ProverInstance> getInstance(unsigned int blockSize)
+    {
+        if (!isSupported(blockSize))
+        {
+            return nullptr;
+        }
+        {
+            const std::lock_guard<std::mutex> lock(mtx);
+            auto it = instances.find(blockSize);
+            if (it != instances.end())
+            {
+                it->second->lastUsed = ++useCounter;
+                return it->second;
+            }
+            // Make room using the size measured the last time this block size was loaded
+            auto itUsage = measuredUsage.find(blockSize);
+            evict((itUsage != measuredUsage.end()) ? itUsage->second : 0.0);
+        }
+
+        std::shared_ptr<ProverInstance> instance = loadInstance(blockSize);
+
+        const std::lock_guard<std::mutex> lock(mtx);
+        instance->lastUsed = ++useCounter;
+        instances[blockSize] = instance;
+        measuredUsage[blockSize] = instance->memoryUsage;
+        evict(0.0);
+        return instance;
+    }
+
+  private:
+    std::string keysDirectory;
+    unsigned int blockType;
+    // All circuits of the server use the same layout
+    Loopring::BlockLayout layout;
+    std::vector<unsigned int> blockSizes;
+    // Max memory used by all instances together (in KB), 0 for no limit
+    double memoryBudget;
+    libsnark::Config config;
+
+    std::mutex mtx;
+    unsigned long useCounter;
+    std::map<unsigned int, std::shared_ptr<ProverInstance>> instances;
+    std::map<unsigned int, double> measuredUsage;
+
+    std::shared_ptr<ProverInstance> loadInstance(unsigned int blockSize)
+    {
+        std::cout << "Loading prover for block size " << blockSize << "..." << std::endl;
+        auto begin = now();
+        double vmBefore, rssBefore;
+        process_mem_usage(vmBefore, rssBefore);
+
+        std::shared_ptr<ProverInstance> instance = std::make_shared<ProverInstance>();
+        instance->blockSize = blockSize;
+        std::string baseFilename = getBaseFilename(blockSize);
+        instance->circuit.reset(
+          createCircuit(blockType, blockSize, layout, instance->pb, getConstraintSystemCacheFilename(baseFilename)));
+        instance->pb.constraint_system.constraints.shrink_to_fit();
+        instance->pb.values.shrink_to_fit();
+
+        std::string provingKeyFilename = getProvingKeyFilename(baseFilename);
+        loadProvingKey(provingKeyFilename, instance->context.provingKey);
+        ethsnarks::ProtoboardT &provingPb = instance->circuit->getPb();
+        instance->context.constraint_system = &(provingPb.constraint_system);
+        instance->context.config = config;
+        instance->context.domain = get_domain(provingPb, instance->context.provingKey, config);
+        initProverContextBuffers(instance->context);
+
+        instance->pvk =
+          loadProcessedVerificationKey(provingKeyFilename.substr(0, provingKeyFilename.length() - 6) + "vk.json");
+
+        double vmAfter, rssAfter;
+        process_mem_usage(vmAfter, rssAfter);
+        instance->memoryUsage = std::max(rssAfter - rssBefore, 0.0);
+        std::cout << "Prover for block size " << blockSize << " uses " << unsigned(instance->memoryUsage * 0.001)
+                  << "MB" << std::endl;
+        print_time(begin, "Prover loaded");
+        return instance;
+    }
+
+    // Evicts the least recently used idle instances until `extra` more memory fits in the budget.
+    // mtx needs to be locked
+    void evict(double extra)
+    {
+        if (memoryBudget <= 0.0)
+        {
+            return;
+        }
+        while (true)
+        {
+            double total = extra;
+            for (const auto &it : instances)
+            {
+                total += it.second->memoryUsage;
+            }
+            if (total <= memoryBudget)
+            {
+                return;
+            }
+
+            // Only instances not referenced by any job can be evicted
+            auto lru = instances.end();
+            for (auto it = instances.begin(); it != instances.end(); ++it)
+            {
+                bool idle = (it->second.use_count() == 1);
+                if (idle && (lru == instances.end() || it->second->lastUsed < lru->second->lastUsed))
+                {
+                    lru = it;
+                }
+            }
+            if (lru == instances.end())
+            {
+                return;
+            }
+            std::cout << "Evicting prover for block size " << lru->first << std::endl;
+            instances.erase(lru);
+            malloc_trim(0);
+        }
+    }
+};
+
+// Prover server metrics, exported in the Prometheus text format on /metrics
+class ProverMetrics
+{
+  public:
+    // Stages of a job that are timed
+    enum Stage
+    {
+        LoadJSON = 0,
+        DecodeBlock,
+        PreValidate,
+        LoadProver,
+        GenerateWitness,
+        Validate,
+        Prove,
+        Verify,
+        COUNT
+    };
+
+    ProverMetrics() : proofsCompleted(0), proofsFailed(0), constraintsPerSecond(0.0)
+    {
+        for (unsigned int i = 0; i < Stage::COUNT; i++)
+        {
+            histograms[i].counts.resize(getBuckets().size(), 0);
+        }
+    }
+
+    void observe(Stage stage, unsigned int duration_ms)
+    {
+        double seconds = duration_ms / 1000.0;
+        const std::lock_guard<std::mutex> lock(mtx);
+        Histogram &histogram = histograms[stage];
+        const std::vector<double> &buckets = getBuckets();
+        for (unsigned int i = 0; i < buckets.size(); i++)
+        {
+            histogram.counts[i] += (seconds <= buckets[i]) ? 1 : 0;
+        }
+        histogram.count++;
+        histogram.sum += seconds;
+    }
+
+    void proofGenerated(size_t numConstraints, unsigned int duration_ms)
+    {
+        const std::lock_guard<std::mutex> lock(mtx);
+        constraintsPerSecond = (numConstraints * 1000.0) / std::max(duration_ms, 1u);
+    }
+
+    void jobFinished(bool success)
+    {
+        const std::lock_guard<std::mutex> lock(mtx);
+        (success ? proofsCompleted : proofsFailed)++;
+    }
+
+    std::string toPrometheus(unsigned int queueDepth, unsigned int numLoadedProvers)
+    {
+        std::stringstream ss;
+        const std::lock_guard<std::mutex> lock(mtx);
+
+        ss << "# HELP prover_stage_duration_seconds Duration of each stage of a job" << std::endl;
+        ss << "# TYPE prover_stage_duration_seconds histogram" << std::endl;
+        const std::vector<double> &buckets = getBuckets();
+        for (unsigned int i = 0; i < Stage::COUNT; i++)
+        {
+            const Histogram &histogram = histograms[i];
+            std::string label = std::string("stage=\"") + getStageName(Stage(i)) + "\"";
+            for (unsigned int b = 0; b < buckets.size(); b++)
+            {
+                ss << "prover_stage_duration_seconds_bucket{" << label << ",le=\"" << buckets[b] << "\"} "
+                   << histogram.counts[b] << std::endl;
+            }
+            ss << "prover_stage_duration_seconds_bucket{" << label << ",le=\"+Inf\"} " << histogram.count
+               << std::endl;
+            ss << "prover_stage_duration_seconds_sum{" << label << "} " << histogram.sum << std::endl;
+            ss << "prover_stage_duration_seconds_count{" << label << "} " << histogram.count << std::endl;
+        }
+
+        ss << "# HELP prover_queue_depth Number of jobs waiting to be proven" << std::endl;
+        ss << "# TYPE prover_queue_depth gauge" << std::endl;
+        ss << "prover_queue_depth " << queueDepth << std::endl;
+        ss << "# HELP prover_proofs_completed_total Number of jobs that were proven" << std::endl;
+        ss << "# TYPE prover_proofs_completed_total counter" << std::endl;
+        ss << "prover_proofs_completed_total " << proofsCompleted << std::endl;
+        ss << "# HELP prover_proofs_failed_total Number of jobs that failed" << std::endl;
+        ss << "# TYPE prover_proofs_failed_total counter" << std::endl;
+        ss << "prover_proofs_failed_total " << proofsFailed << std::endl;
+        ss << "# HELP prover_constraints_per_second Constraints per second of the last proof" << std::endl;
+        ss << "# TYPE prover_constraints_per_second gauge" << std::endl;
+        ss << "prover_constraints_per_second " << constraintsPerSecond << std::endl;
+        ss << "# HELP prover_loaded_provers Number of block sizes with a loaded prover" << std::endl;
+        ss << "# TYPE prover_loaded_provers gauge" << std::endl;
+        ss << "prover_loaded_provers " << numLoadedProvers << std::endl;
+
+        double vm, rss;
+        process_mem_usage(vm, rss);
+        ss << "# HELP process_resident_memory_bytes Resident memory size in bytes" << std::endl;
+        ss << "# TYPE process_resident_memory_bytes gauge" << std::endl;
+        ss << "process_resident_memory_bytes " << std::fixed << std::setprecision(0) << rss * 1024.0 << std::endl;
+        ss << "# HELP process_virtual_memory_bytes Virtual memory size in bytes" << std::endl;
+        ss << "# TYPE process_virtual_memory_bytes gauge" << std::endl;
+        ss << "process_virtual_memory_bytes " << vm * 1024.0 << std::endl;
+        return ss.str();
+    }
+
+  private:
+    struct Histogram
+    {
+        std::vector<uint64_t> counts;
+        uint64_t count = 0;
+        double sum = 0.0;
+    };
+
+    std::mutex mtx;
+    Histogram histograms[Stage::COUNT];
+    uint64_t proofsCompleted;
+    uint64_t proofsFailed;
+    double constraintsPerSecond;
+
+    // Upper bounds of the histogram buckets (in seconds)
+    static const std::vector<double> &getBuckets()
+    {
+        static const std::vector<double> buckets = {0.01, 0.1, 0.5, 1, 2, 5, 10, 30, 60, 120, 300, 600};
+        return buckets;
+    }
+
+    static const char *getStageName(Stage stage)
+    {
+        switch (stage)
+        {
+            case Stage::LoadJSON:
+                return "load_json";
+            case Stage::DecodeBlock:
+                return "decode_block";
+            case Stage::PreValidate:
+                return "pre_validate";
+            case Stage::LoadProver:
+                return "load_prover";
+            case Stage::GenerateWitness:
+                return "generate_witness";
+            case Stage::Validate:
+                return "validate";
+            case Stage::Prove:
+                return "prove";
+            default:
+                return "verify";
+        }
+    }
+};
+
+enum class JobStatus
+{
+    Queued = 0,
+    Loading,
+    Ready,
+    Proving,
+    Done,
+    Failed
+};
+
+static const char *jobStatusToString(JobStatus status)
+{
+    switch (status)
+    {
+        case JobStatus::Queued:
+            return "queued";
+        case JobStatus::Loading:
+            return "loading";
+        case JobStatus::Ready:
+            return "ready";
+        case JobStatus::Proving:
+            return "proving";
+        case JobStatus::Done:
+            return "done";
+        default:
+            return "failed";
+    }
+}
+
+struct ProveJob
+{
+    unsigned int id = 0;
+    std::string blockFilename;
+    std::string proofFilename;
+    bool validate = false;
+    bool delFileAfterSuccess = false;
+    // Verify the proof after the job is done instead of before
+    bool asyncVerify = false;
+
+    JobStatus status = JobStatus::Queued;
+    // The proof on success, the error message on failure
+    std::string result;
+    // The decoded block, only kept between loading and witness generation
+    std::unique_ptr<Loopring::Block> block;
+    unsigned int blockSize = 0;
+    // The prover for the block size, only kept while the job still needs it
+    std::shared_ptr<ProverInstance> instance;
+};
+
+// Proves blocks in the background using a two stage pipeline:
+// - the loader thread reads and decodes the block of the next job
+// - the prover thread generates the witness and the proof for the current job
+// The protoboard can only hold a single witness, so the witness generation stays on the
+// prover thread. At most MAX_LOADED_JOBS decoded blocks are kept in memory.
+// Proofs of jobs with asyncVerify set are verified on a separate verifier thread after the job is done.
+// The prover thread selects (and if needed loads) the prover instance for the block size before it generates
+// the witness, so a single proof is generated at a time whatever the block size, and no instance is loaded
+// while a proof is generated (see ProverRegistry::getInstance).
+class ProverQueue
+{
+  public:
+    static const unsigned int MAX_LOADED_JOBS = 1;
+    static const unsigned int MAX_FINISHED_JOBS = 256;
+
+    ProverQueue(ProverRegistry &_registry, ProverMetrics &_metrics)
+        : registry(_registry), metrics(_metrics), nextJobID(0), stopping(false), activeJob(nullptr)
+    {
+        loader = std::thread(&ProverQueue::loaderLoop, this);
+        prover = std::thread(&ProverQueue::proverLoop, this);
+        verifier = std::thread(&ProverQueue::verifierLoop, this);
+    }
+
+    ~ProverQueue()
+    {
+        stop();
+    }
+
+    std::shared_ptr<ProveJob> submit(
+      const std::string &blockFilename,
+      const std::string &proofFilename,
+      bool validate,
+      bool delFileAfterSuccess,
+      bool asyncVerify)
+    {
+        std::shared_ptr<ProveJob> job = std::make_shared<ProveJob>();
+        job->blockFilename = blockFilename;
+        job->proofFilename = proofFilename;
+        job->validate = validate;
+        job->delFileAfterSuccess = delFileAfterSuccess;
+        job->asyncVerify = asyncVerify;
+
+        const std::lock_guard<std::mutex> lock(mtx);
+        job->id = nextJobID++;
+        if (stopping)
+        {
+            job->status = JobStatus::Failed;
+            job->result = "Error: Server is stopping!\n";
+            return job;
+        }
+        jobs[job->id] = job;
+        queuedJobs.push_back(job);
+        pruneFinishedJobs();
+        cv.notify_all();
+        return job;
+    }
+
+    // Waits until the job is done or has failed and returns its result
+    std::string wait(const std::shared_ptr<ProveJob> &job)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&] { return isFinished(*job); });
+        return job->result;
+    }
+
+    // Returns a json object with the current state of the job, or an empty json if the job is unknown
+    json getJobInfo(unsigned int id)
+    {
+        const std::lock_guard<std::mutex> lock(mtx);
+        auto it = jobs.find(id);
+        if (it == jobs.end())
+        {
+            return json();
+        }
+        const ProveJob &job = *(it->second);
+        json info;
+        info["id"] = job.id;
+        info["status"] = jobStatusToString(job.status);
+        info["block_filename"] = job.blockFilename;
+        if (job.status == JobStatus::Done)
+        {
+            info["proof"] = json::parse(job.result);
+        }
+        else if (job.status == JobStatus::Failed)
+        {
+            info["error"] = job.result;
+        }
+        return info;
+    }
+
+    unsigned int getQueueDepth()
+    {
+        const std::lock_guard<std::mutex> lock(mtx);
+        return getNumPending();
+    }
+
+    std::string getStatus()
+    {
+        const std::lock_guard<std::mutex> lock(mtx);
+        std::string status = (activeJob != nullptr) ? std::string("Proving ") + activeJob->blockFilename : "Idle";
+        unsigned int numPending = getNumPending();
+        if (numPending > 0)
+        {
+            status += std::string(" (") + std::to_string(numPending) + " jobs pending)";
+        }
+        return status;
+    }
+
+    // Stops accepting jobs, finishes the proof that is being generated and fails all pending jobs
+    void stop()
+    {
+        {
+            const std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+            cv.notify_all();
+        }
+        if (loader.joinable())
+        {
+            loader.join();
+        }
+        if (prover.joinable())
+        {
+            prover.join();
+        }
+        if (verifier.joinable())
+        {
+            verifier.join();
+        }
+
+        const std::lock_guard<std::mutex> lock(mtx);
+        for (auto &job : queuedJobs)
+        {
+            finish(*job, false, "Error: Server stopped!\n");
+        }
+        for (auto &job : loadedJobs)
+        {
+            finish(*job, false, "Error: Server stopped!\n");
+        }
+        queuedJobs.clear();
+        loadedJobs.clear();
+        cv.notify_all();
+    }
+
+  private:
+    ProverRegistry &registry;
+    ProverMetrics &metrics;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    unsigned int nextJobID;
+    bool stopping;
+    std::map<unsigned int, std::shared_ptr<ProveJob>> jobs;
+    std::deque<std::shared_ptr<ProveJob>> queuedJobs;
+    std::deque<std::shared_ptr<ProveJob>> loadedJobs;
+    std::deque<std::shared_ptr<ProveJob>> unverifiedJobs;
+    std::shared_ptr<ProveJob> loadingJob;
+    std::shared_ptr<ProveJob> activeJob;
+
+    std::thread loader;
+    std::thread prover;
+    std::thread verifier;
+
+    // mtx needs to be locked
+    unsigned int getNumPending() const
+    {
+        return queuedJobs.size() + loadedJobs.size() + (loadingJob ? 1 : 0);
+    }
+
+    static bool isFinished(const ProveJob &job)
+    {
+        return job.status == JobStatus::Done || job.status == JobStatus::Failed;
+    }
+
+    // mtx needs to be locked
+    void finish(ProveJob &job, bool success, const std::string &result)
+    {
+        job.status = success ? JobStatus::Done : JobStatus::Failed;
+        job.result = result;
+        job.block.reset();
+        // Keep the prover instance alive for the verification key until the proof is verified
+        if (!(success && job.asyncVerify))
+        {
+            job.instance.reset();
+        }
+    }
+
+    // mtx needs to be locked
+    void pruneFinishedJobs()
+    {
+        unsigned int numFinished = 0;
+        for (auto it = jobs.rbegin(); it != jobs.rend(); ++it)
+        {
+            numFinished += isFinished(*(it->second)) ? 1 : 0;
+        }
+        for (auto it = jobs.begin(); it != jobs.end() && numFinished > MAX_FINISHED_JOBS;)
+        {
+            if (isFinished(*(it->second)))
+            {
+                it = jobs.erase(it);
+                numFinished--;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    void loaderLoop()
+    {
+        while (true)
+        {
+            std::shared_ptr<ProveJob> job;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [&] {
+                    return stopping || (queuedJobs.size() > 0 && loadedJobs.size() < MAX_LOADED_JOBS);
+                });
+                if (stopping)
+                {
+                    return;
+                }
+                job = queuedJobs.front();
+                queuedJobs.pop_front();
+                job->status = JobStatus::Loading;
+                loadingJob = job;
+            }
+
+            std::string error;
+            std::unique_ptr<Loopring::Block> block;
+            unsigned int blockSize = 0;
+            try
+            {
+                error = loadBlock(*job, block, blockSize);
+            }
+            catch (std::exception &e)
+            {
+                error = std::string("Prove error, exception:") + std::string(e.what());
+                std::cout << error << std::endl;
+            }
+
+            const std::lock_guard<std::mutex> lock(mtx);
+            loadingJob = nullptr;
+            if (error.length() != 0)
+            {
+                finish(*job, false, error);
+                metrics.jobFinished(false);
+            }
+            else
+            {
+                job->block = std::move(block);
+                job->blockSize = blockSize;
+                job->status = JobStatus::Ready;
+                loadedJobs.push_back(job);
+            }
+            cv.notify_all();
+        }
+    }
+
+    void proverLoop()
+    {
+        while (true)
+        {
+            std::shared_ptr<ProveJob> job;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [&] { return stopping || loadedJobs.size() > 0; });
+                if (stopping)
+                {
+                    return;
+                }
+                job = loadedJobs.front();
+                loadedJobs.pop_front();
+                job->status = JobStatus::Proving;
+                activeJob = job;
+                // Let the loader start on the next block
+                cv.notify_all();
+            }
+
+            std::string result;
+            bool success = false;
+            try
+            {
+                selectInstance(*job);
+                success = proveBlock(*job, result);
+            }
+            catch (std::exception &e)
+            {
+                result = std::string("Prove error, exception:") + std::string(e.what());
+                std::cout << result << std::endl;
+            }
+
+            const std::lock_guard<std::mutex> lock(mtx);
+            activeJob = nullptr;
+            finish(*job, success, result);
+            metrics.jobFinished(success);
+            if (success && job->asyncVerify)
+            {
+                unverifiedJobs.push_back(job);
+            }
+            cv.notify_all();
+        }
+    }
 
-bool validateCircuit(Loopring::Circuit *circuit)
-{
-    std::cout << "Validating block..." << std::endl;
-    auto begin = now();
-    // Check if the inputs are valid for the circuit
-    #ifndef NDEBUG
-        circuit->printInfo();
-    #endif
-    if (!circuit->getPb().is_satisfied())
+    void verifierLoop()
     {
-        std::cerr << "Block is not valid!" << std::endl;
-        return false;
+        while (true)
+        {
+            std::shared_ptr<ProveJob> job;
+            std::string result;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                // Pending verifications are still done when stopping
+                cv.wait(lock, [&] { return unverifiedJobs.size() > 0 || (stopping && activeJob == nullptr); });
+                if (unverifiedJobs.size() == 0)
+                {
+                    return;
+                }
+                job = unverifiedJobs.front();
+                unverifiedJobs.pop_front();
+                result = job->result;
+            }
+
+            json proofJson = json::parse(result);
+            bool verified = false;
+            try
+            {
+                auto begin = now();
+                verified = verifyProof(job->instance->pvk, proofJson.dump());
+                metrics.observe(ProverMetrics::Verify, elapsed_time_ms(begin));
+            }
+            catch (std::exception &e)
+            {
+                std::cout << "Verify error, exception:" << e.what() << std::endl;
+            }
+            std::cout << "verified (" << job->blockFilename << "):" << verified << std::endl;
+            proofJson["verified"] = verified;
+
+            const std::lock_guard<std::mutex> lock(mtx);
+            job->result = proofJson.dump() + "\n";
+            job->instance.reset();
+        }
     }
-    print_time(begin, "Block is valid");
-    return true;
-}
 
-std::string getBaseName(unsigned int blockType)
-{
-    switch (blockType)
+    // Returns an empty string on success, the error message otherwise
+    std::string loadBlock(const ProveJob &job, std::unique_ptr<Loopring::Block> &block, unsigned int &blockSize)
     {
-        default:
-            return "all";
-    }
-}
+        auto begin = now();
+        Loopring::BlockLayout layout;
+        if (isBinaryBlockFile(job.blockFilename))
+        {
+            // Binary blocks are decoded straight from the mapped file
+            std::cout << "Decoding binary block " << job.blockFilename << "..." << std::endl;
+            Loopring::BinaryBlockHeader header;
+            block = loadBinaryBlock(job.blockFilename, header);
+            if (!block)
+            {
+                return "Error: Failed to load block!\n";
+            }
+            blockSize = header.blockSize;
+            layout = header.getLayout();
+            print_time(begin, "Block decoded");
+            metrics.observe(ProverMetrics::DecodeBlock, elapsed_time_ms(begin));
+        }
+        else
+        {
+            json input = loadJSON(job.blockFilename);
+            metrics.observe(ProverMetrics::LoadJSON, elapsed_time_ms(begin));
+            if (input == json())
+            {
+                return "Error: Failed to load block!\n";
+            }
+            blockSize = input["blockSize"].get<int>();
+            layout = Loopring::getBlockLayout(input);
+            if (registry.isSupported(blockSize) && layout == registry.getLayout())
+            {
+                std::cout << "Decoding block " << job.blockFilename << "..." << std::endl;
+                begin = now();
+                block.reset(new Loopring::Block(input.get<Loopring::Block>()));
+                print_time(begin, "Block decoded");
+                metrics.observe(ProverMetrics::DecodeBlock, elapsed_time_ms(begin));
+            }
+        }
 
-std::string getProvingKeyFilename(const std::string &baseFilename)
-{
-    return baseFilename + "_pk.raw";
-}
+        // Check if this block is compatible with one of the supported circuits
+        if (!registry.isSupported(blockSize) || layout != registry.getLayout())
+        {
+            block.reset();
+            return "Error: Incompatible block requested! Use /info to check "
+                   "which blocks can be proven.\n";
+        }
 
-void runServer(
-  ProverContextT &context,
-  Loopring::Circuit *circuit,
-  const std::string &provingKeyFilename,
-  const libsnark::Config &config,
-  unsigned int port)
-{
-    using namespace httplib;
+        // Reject invalid blocks before they take up a witness pass and a proof slot
+        begin = now();
+        std::string invalidReason = Loopring::BlockValidator().validate(*block);
+        metrics.observe(ProverMetrics::PreValidate, elapsed_time_ms(begin));
+        if (!invalidReason.empty())
+        {
+            block.reset();
+            return "Error: Block is invalid: " + invalidReason + "\n";
+        }
+        return "";
+    }
 
-    struct ProverStatus
+    // Runs on the prover thread, see ProverRegistry::getInstance
+    void selectInstance(ProveJob &job)
     {
-        bool proving = false;
-        std::string blockFilename;
-        std::string proofFilename;
-    };
+        bool loaded = registry.isLoaded(job.blockSize);
+        auto begin = now();
+        std::shared_ptr<ProverInstance> instance = registry.getInstance(job.blockSize);
+        if (!loaded)
+        {
+            metrics.observe(ProverMetrics::LoadProver, elapsed_time_ms(begin));
+        }
+        const std::lock_guard<std::mutex> lock(mtx);
+        job.instance = instance;
+    }
 
-    struct ProverStatusRAII
+    bool proveBlock(ProveJob &job, std::string &result)
     {
-        ProverStatus &proverStatus;
-        ProverStatusRAII(
-          ProverStatus &_proverStatus,
-          const std::string &blockFilename,
-          const std::string &proofFilename)
-            : proverStatus(_proverStatus)
+        Loopring::Circuit *circuit = job.instance->circuit.get();
+        auto begin = now();
+        bool witnessGenerated = generateWitness(circuit, *job.block);
+        metrics.observe(ProverMetrics::GenerateWitness, elapsed_time_ms(begin));
+        job.block.reset();
+        if (!witnessGenerated)
+        {
+            result = "Error: Failed to generate witness for block!\n";
+            return false;
+        }
+        if (job.validate)
+        {
+            begin = now();
+            bool valid = validateCircuit(circuit);
+            metrics.observe(ProverMetrics::Validate, elapsed_time_ms(begin));
+            if (!valid)
+            {
+                result = "Error: Block is invalid!\n";
+                return false;
+            }
+        }
+        begin = now();
+        std::string jProof = proveCircuit(job.instance->context, circuit);
+        unsigned int prove_ms = elapsed_time_ms(begin);
+        metrics.observe(ProverMetrics::Prove, prove_ms);
+        metrics.proofGenerated(circuit->getPb().num_constraints(), prove_ms);
+        if (jProof.length() == 0)
+        {
+            result = "Error: Failed to prove block!\n";
+            return false;
+        }
+        if (job.proofFilename.length() != 0)
+        {
+            if (!writeProof(jProof, job.proofFilename))
+            {
+                result = "Error: Failed to write proof!\n";
+                return false;
+            }
+        }
+
+        std::cout << "proof:" << jProof;
+        json proofJson = json::parse(jProof);
+        // verify the proof, unless it is verified later on the verifier thread
+        if (!job.asyncVerify)
         {
-            proverStatus.proving = true;
-            proverStatus.blockFilename = blockFilename;
-            proverStatus.proofFilename = proofFilename;
+            begin = now();
+            bool verified = verifyProof(job.instance->pvk, jProof);
+            metrics.observe(ProverMetrics::Verify, elapsed_time_ms(begin));
+            std::cout << "verified:" << verified << std::endl;
+            proofJson["verified"] = verified;
         }
 
-        ~ProverStatusRAII()
+        result = proofJson.dump() + "\n";
+        if (job.delFileAfterSuccess)
         {
-            proverStatus.proving = false;
+            std::remove(job.blockFilename.c_str());
         }
-    };
+        return true;
+    }
+};
 
-    // Prover status info
-    ProverStatus proverStatus;
-    // Lock for the prover
-    std::mutex mtx;
+void runServer(ProverRegistry &registry, unsigned int port)
+{
+    using namespace httplib;
+
+    // Jobs are proven in the background, the HTTP handlers only submit and query them
+    ProverMetrics metrics;
+    ProverQueue queue(registry, metrics);
     // Setup the server
     Server svr;
-    // Called to prove blocks
-    svr.Get("/prove", [&](const Request &req, Response &res) {
-    		try
-    		{
-			const std::lock_guard<std::mutex> lock(mtx);
-
-			// Parse the parameters
-			std::string blockFilename = req.get_param_value("block_filename");
-			std::string proofFilename = req.get_param_value("proof_filename");
-			std::string strValidate = req.get_param_value("validate");
-			bool validate = (strValidate.compare("true") == 0) ? true : false;
-			if (blockFilename.length() == 0)
-			{
-				res.set_content("Error: block_filename missing!\n", "text/plain");
-				return;
-			}
-			std::string strDelFile = req.get_param_value("delFile");
-			bool delFileAfterSuccess = (strDelFile.compare("true") == 0) ? true : false;
-
-			// Set the prover status for this session
-			ProverStatusRAII statusRAII(proverStatus, blockFilename, proofFilename);
-
-			// Prove the block
-			json input = loadJSON(blockFilename);
-			if (input == json())
-			{
-				res.set_content("Error: Failed to load block!\n", "text/plain");
-				return;
-			}
-
-			// Check if this block is compatible with the loaded circuit
-			int iBlockType = input["blockType"].get<int>();
-			unsigned int blockSize = input["blockSize"].get<int>();
-			if (/*iBlockType & circuit->getBlockType() != 1 || */ blockSize != circuit->getBlockSize())
-			{
-				res.set_content(
-				  "Error: Incompatible block requested! Use /info to check "
-				  "which blocks can be proven.\n",
-				  "text/plain");
-				return;
-			}
-
-			if (!generateWitness(circuit, input))
-			{
-				res.set_content("Error: Failed to generate witness for block!\n", "text/plain");
-				return;
-			}
-			if (validate)
-			{
-				if (!validateCircuit(circuit))
-				{
-					res.set_content("Error: Block is invalid!\n", "text/plain");
-					return;
-				}
-			}
-			std::string jProof = proveCircuit(context, circuit);
-			if (jProof.length() == 0)
-			{
-				res.set_content("Error: Failed to prove block!\n", "text/plain");
-				return;
-			}
-			if (proofFilename.length() != 0)
-			{
-				if (!writeProof(jProof, proofFilename))
-				{
-					res.set_content("Error: Failed to write proof!\n", "text/plain");
-					return;
-				}
-			}
-
-			// verify the proof.
-			VerificationKeyT vk = loadVerificationKey(provingKeyFilename.substr(0, provingKeyFilename.length() - 6) + "vk.json");
-            std::stringstream proof_stream;
-            proof_stream << jProof;
-            auto proof_pair = proof_from_json(proof_stream);
-
-            std::cout << "proof:" << jProof;
-            bool verified = libsnark::r1cs_gg_ppzksnark_zok_verifier_strong_IC<ppT>(vk, proof_pair.first, proof_pair.second);
-            std::cout << "verified:" << verified << std::endl;
-            json proofJson = json::parse(jProof);
-            proofJson["verified"] = verified;
 
-			// Return the proof
-			res.set_content(proofJson.dump() + "\n", "text/plain");
-			if(delFileAfterSuccess){
-					std::remove(blockFilename.c_str());
-			}
-    		}catch(std::exception& e)
-    		{
-    			std::string message = std::string("Prove error, exception:") + std::string(e.what());
-    			std::cout << message << std::endl;
-    			res.set_content(message, "text/plain");
-    			return;
-    		}
+    // Parses the job parameters shared by /prove and /jobs
+    auto submitJob = [&](const Request &req, Response &res) -> std::shared_ptr<ProveJob> {
+        std::string blockFilename = req.get_param_value("block_filename");
+        std::string proofFilename = req.get_param_value("proof_filename");
+        std::string strValidate = req.get_param_value("validate");
+        bool validate = (strValidate.compare("true") == 0) ? true : false;
+        if (blockFilename.length() == 0)
+        {
+            res.set_content("Error: block_filename missing!\n", "text/plain");
+            return nullptr;
+        }
+        std::string strDelFile = req.get_param_value("delFile");
+        bool delFileAfterSuccess = (strDelFile.compare("true") == 0) ? true : false;
+        std::string strAsyncVerify = req.get_param_value("async_verify");
+        bool asyncVerify = (strAsyncVerify.compare("true") == 0) ? true : false;
+        return queue.submit(blockFilename, proofFilename, validate, delFileAfterSuccess, asyncVerify);
+    };
+
+    // Called to prove blocks, waits until the proof is generated
+    svr.Get("/prove", [&](const Request &req, Response &res) {
+        std::shared_ptr<ProveJob> job = submitJob(req, res);
+        if (!job)
+        {
+            return;
+        }
+        res.set_content(queue.wait(job), "text/plain");
     });
-    // Retun the status of the server
-    svr.Get("/status", [&](const Request &req, Response &res) {
-        if (proverStatus.proving)
+    // Called to queue blocks to be proven, returns the job id immediately
+    svr.Post("/jobs", [&](const Request &req, Response &res) {
+        std::shared_ptr<ProveJob> job = submitJob(req, res);
+        if (!job)
         {
-            std::string status = std::string("Proving ") + proverStatus.blockFilename;
-            res.set_content(status + "\n", "text/plain");
+            return;
         }
-        else
+        json info;
+        info["id"] = job->id;
+        info["status"] = jobStatusToString(job->status);
+        res.set_content(info.dump() + "\n", "text/plain");
+    });
+    // Returns the status of a job, and the proof once it is done
+    svr.Get(R"(/jobs/(\d+))", [&](const Request &req, Response &res) {
+        json info;
+        try
+        {
+            info = queue.getJobInfo(std::stoul(req.matches[1].str()));
+        }
+        catch (std::exception &e)
         {
-            res.set_content("Idle\n", "text/plain");
         }
+        if (info == json())
+        {
+            res.status = 404;
+            res.set_content("Error: Unknown job!\n", "text/plain");
+            return;
+        }
+        res.set_content(info.dump() + "\n", "text/plain");
+    });
+    // Retun the status of the server
+    svr.Get("/status", [&](const Request &req, Response &res) {
+        res.set_content(queue.getStatus() + "\n", "text/plain");
+    });
+    // Metrics of the prover server in the Prometheus text format
+    svr.Get("/metrics", [&](const Request &req, Response &res) {
+        res.set_content(
+          metrics.toPrometheus(queue.getQueueDepth(), registry.getNumLoaded()), "text/plain; version=0.0.4");
     });
     // Info of this prover server
     svr.Get("/info", [&](const Request &req, Response &res) {
-        std::string info = std::string("BlockType: ") + std::to_string(int(circuit->getBlockType())) +
-                           std::string("; BlockSize: ") + std::to_string(circuit->getBlockSize()) + "\n";
+        std::string info;
+        for (unsigned int blockSize : registry.getBlockSizes())
+        {
+            info += std::string("BlockType: ") + std::to_string(int(registry.getBlockType())) +
+                    std::string("; BlockSize: ") + std::to_string(blockSize) + std::string("; Layout: ") +
+                    (registry.getLayout().universal ? "universal" : registry.getLayout().getName().substr(1)) +
+                    std::string("; Loaded: ") + (registry.isLoaded(blockSize) ? "true" : "false") + "\n";
+        }
         res.set_content(info, "text/plain");
     });
     // Stops the prover server
     svr.Get("/stop", [&](const Request &req, Response &res) {
-        const std::lock_guard<std::mutex> lock(mtx);
+        queue.stop();
         svr.stop();
     });
     // Help info
@@ -530,9 +1634,16 @@ void runServer(
         content += "Prover server:\n";
         content += "- Prove a block: "
                    "/prove?block_filename=<block.json>&proof_filename=<proof.json>&"
-                   "validate=true (proof_filename and validate are optional)\n";
+                   "validate=true&async_verify=true (proof_filename, validate and async_verify are optional, "
+                   "with async_verify the proof is returned before it is verified)\n";
+        content += "- Queue a block to be proven: POST "
+                   "/jobs?block_filename=<block.json>&proof_filename=<proof.json>&"
+                   "validate=true (returns the job id)\n";
+        content += "- Status of a job: /jobs/<id> (contains the proof once done, \"verified\" is added "
+                   "once an async_verify proof is verified)\n";
         content += "- Status of the server: /status (busy proving a block or not)\n";
         content += "- Info of the server: /info (which blocks can be proven)\n";
+        content += "- Metrics of the server: /metrics (Prometheus format)\n";
         content += "- Shut down the server: /stop (will first finish generating "
                    "the proof if busy)\n";
         res.set_content(content, "text/plain");
@@ -540,6 +1651,7 @@ void runServer(
 
     std::cout << "Running server on 'localhost' on port " << port << std::endl;
     svr.listen("0.0.0.0", port);
+    queue.stop();
 }
 
 std::string& replace_all(std::string& str,const std::string& old_value,const std::string& new_value)
@@ -558,6 +1670,69 @@ std::string& replace_all(std::string& str,const std::string& old_value,const std
     return str;
 }
 
+// Decodes the block with the dummy templates parsed again for every transaction, like before the parsed
+// prototypes were used, and with the prototypes, and compares the times.
+void benchmarkBlockDecoding(const json &input, unsigned int numIterations = 3)
+{
+    const unsigned int numTransactions = input["transactions"].size();
+    auto decode = [&](bool parseDummiesEveryTime) {
+        Loopring::parseDummiesEveryTime() = parseDummiesEveryTime;
+        // Warm up, the prototypes are parsed by the first decoding
+        Loopring::Block warmUp = input.get<Loopring::Block>();
+        auto begin = now();
+        for (unsigned int i = 0; i < numIterations; i++)
+        {
+            Loopring::Block block = input.get<Loopring::Block>();
+        }
+        Loopring::parseDummiesEveryTime() = false;
+        return elapsed_time_ms(begin) / numIterations;
+    };
+    const unsigned int reparse_ms = decode(true);
+    const unsigned int prototype_ms = decode(false);
+
+    std::cout << "Block decoding (" << numTransactions << " transactions), dummy data parsed for every transaction: "
+              << reparse_ms << "ms" << std::endl;
+    std::cout << "Block decoding (" << numTransactions << " transactions), dummy data copied from the prototypes: "
+              << prototype_ms << "ms" << std::endl;
+    std::cout << "Decoding time saved by the dummy prototypes: "
+              << (reparse_ms > 0 ? (int(reparse_ms) - int(prototype_ms)) * 100 / int(reparse_ms) : 0) << "%"
+              << std::endl;
+}
+
+// Measures the time and the memory needed to create the gadgets and generate all constraints of the circuit
+void benchmarkCircuitCreation(
+  unsigned int blockType,
+  unsigned int blockSize,
+  const Loopring::BlockLayout &layout,
+  unsigned int numIterations = 3)
+{
+    unsigned int total_ms = 0;
+    double maxRssIncrease = 0.0;
+    for (unsigned int i = 0; i < numIterations; i++)
+    {
+        malloc_trim(0);
+        double vmBefore, rssBefore;
+        process_mem_usage(vmBefore, rssBefore);
+
+        ethsnarks::ProtoboardT pb;
+        auto begin = now();
+        Loopring::Circuit *circuit = newCircuit(blockType, layout, pb);
+        circuit->generateConstraints(blockSize);
+        total_ms += elapsed_time_ms(begin);
+
+        double vmAfter, rssAfter;
+        process_mem_usage(vmAfter, rssAfter);
+        maxRssIncrease = std::max(maxRssIncrease, rssAfter - rssBefore);
+        delete circuit;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::cout << "Circuit creation (" << blockSize << " transactions): " << (total_ms / numIterations) << "ms, "
+              << unsigned(maxRssIncrease * 0.001) << "MB RSS" << std::endl;
+    std::cout << "Peak RSS of the process: " << unsigned(usage.ru_maxrss * 0.001) << "MB" << std::endl;
+}
+
 bool runBenchmark(Loopring::Circuit *circuit, const std::string &provingKeyFilename)
 {
     // Load the proving key
@@ -565,8 +1740,8 @@ bool runBenchmark(Loopring::Circuit *circuit, const std::string &provingKeyFilen
     loadProvingKey(provingKeyFilename, context.provingKey);
     context.constraint_system = &(circuit->getPb().constraint_system);
 
-    VerificationKeyT vk =
-      loadVerificationKey(provingKeyFilename.substr(0, provingKeyFilename.length() - 6) + "vk.json");
+    ProcessedVerificationKeyT pvk =
+      loadProcessedVerificationKey(provingKeyFilename.substr(0, provingKeyFilename.length() - 6) + "vk.json");
 
     if (!validateCircuit(circuit))
     {
@@ -654,11 +1829,7 @@ bool runBenchmark(Loopring::Circuit *circuit, const std::string &provingKeyFilen
                 return false;
             }
 
-            std::stringstream proof_stream;
-            proof_stream << jProof;
-            auto proof_pair = proof_from_json(proof_stream);
-
-            if (!libsnark::r1cs_gg_ppzksnark_zok_verifier_strong_IC<ppT>(vk, proof_pair.first, proof_pair.second))
+            if (!verifyProof(pvk, jProof))
             {
                 std::cerr << "Invalid proof!" << std::endl;
                 return false;
@@ -683,6 +1854,41 @@ bool runBenchmark(Loopring::Circuit *circuit, const std::string &provingKeyFilen
     return true;
 }
 
+// Reports the constraints, variables, coefficients and witness generation time of the gadgets of the circuit.
+// The profiler needs to be active while the circuit is created (see Utils/Profiler.h).
+bool profileCircuit(
+  Loopring::Circuit *circuit,
+  const Loopring::Block &block,
+  const ethsnarks::ProtoboardT &pb,
+  Loopring::Profiler &profiler,
+  unsigned int slot,
+  const std::string &flameGraphFilename)
+{
+    profiler.analyzeConstraints(pb);
+#ifdef MULTICORE
+    // Measure the gadgets without the transactions competing for the cores
+    omp_set_num_threads(1);
+#endif
+    if (!generateWitness(circuit, block))
+    {
+        return false;
+    }
+
+    std::cout << "Profile of slot " << slot << ":" << std::endl;
+    Loopring::Profiler::print(std::cout, profiler.getSlotCosts(slot));
+    std::cout << std::endl;
+    std::cout << "Profile of the block (all slots combined in tx_*):" << std::endl;
+    Loopring::Profiler::print(std::cout, profiler.getCollapsedCosts());
+
+    if (!profiler.writeFlameGraph(flameGraphFilename))
+    {
+        return false;
+    }
+    std::cout << "Flamegraph written to: " << flameGraphFilename << " (constraints) and " << flameGraphFilename
+              << ".witness (witness generation time in us)" << std::endl;
+    return true;
+}
+
 int main(int argc, char **argv)
 {
     std::cout << "in main: " << std::endl;
@@ -713,6 +1919,13 @@ int main(int argc, char **argv)
         std::cerr << "-exportwitness <block.json> <witness.json>: Exports the "
                      "witness to json (circom)"
                   << std::endl;
+        std::cerr << "-buildcache <block.json>: Writes the constraints of the circuit to a cache that is used to "
+                     "create the circuit faster by -validate, -prove, -createkeys and the server"
+                  << std::endl;
+        std::cerr << "-convertblock <block.json> <block.bin>: Converts a block to the binary "
+                     "format, which can be used instead of the json file for -validate, -prove, "
+                     "-benchmark and the server"
+                  << std::endl;
         std::cerr << "-createpk <pk.json> <pk.raw>: Creates the "
                      "proving key using a bellman pk"
                   << std::endl;
@@ -722,17 +1935,28 @@ int main(int argc, char **argv)
         std::cerr << "-pk_mcl2nozk <pk_mlc.raw> <pk_nozk.raw>: Converts the "
                      "proving key from the mcl format to the nozk format"
                   << std::endl;
-        std::cerr << "-server <block.json> <port>: Keeps the program running as an "
-                     "HTTP server to prove blocks on demand"
+        std::cerr << "-server <block.json> <port> [<block_sizes> [<memory_budget_mb>]]: Keeps the program running "
+                     "as an HTTP server to prove blocks on demand. block_sizes is a comma separated list of extra "
+                     "block sizes that are loaded when first needed, least recently used ones are unloaded when "
+                     "memory_budget_mb is exceeded"
                   << std::endl;
         std::cerr << "-benchmark <block.json>: Try out multiple prover options to "
                      "find the fastest configuration on the system"
                   << std::endl;
+        std::cerr << "-profile <block.json> <out.folded> [<slot>]: Reports the constraints, variables, coefficients "
+                     "and witness generation time of the gadgets for a single slot (default 0) and for all slots, "
+                     "and writes them in the folded stack format of flamegraph.pl"
+                  << std::endl;
         return 1;
     }
 
     const char *proofFilename = NULL;
     Mode mode = Mode::Validate;
+    // Block sizes the server can prove, and the max memory used by the provers for them (in MB, 0 = no limit)
+    std::vector<unsigned int> serverBlockSizes;
+    double serverMemoryBudget = 0.0;
+    // The slot that is reported separately by -profile
+    unsigned int profileSlot = 0;
 
     #ifdef ZKP_WORKER_MODE
         std::string baseFilename = "/data/keys/";
@@ -801,6 +2025,31 @@ int main(int argc, char **argv)
         mode = Mode::ExportWitness;
         std::cout << "Exporting witness for " << argv[2] << "..." << std::endl;
     }
+    else if (strcmp(argv[1], "-buildcache") == 0)
+    {
+        if (argc != 3)
+        {
+            std::cout << "Invalid number of arguments!" << std::endl;
+            return 1;
+        }
+        mode = Mode::BuildCache;
+        std::cout << "Building constraint system cache for " << argv[2] << "..." << std::endl;
+    }
+    else if (strcmp(argv[1], "-convertblock") == 0)
+    {
+        if (argc != 4)
+        {
+            std::cout << "Invalid number of arguments!" << std::endl;
+            return 1;
+        }
+        std::cout << "Converting block " << argv[2] << " to " << argv[3] << " ..." << std::endl;
+        if (!convertBlock(argv[2], argv[3]))
+        {
+            return 1;
+        }
+        std::cout << "Successfully created binary block " << argv[3] << "." << std::endl;
+        return 0;
+    }
     else if (strcmp(argv[1], "-createpk") == 0)
     {
         if (argc != 4)
@@ -850,12 +2099,25 @@ int main(int argc, char **argv)
     }
     else if (strcmp(argv[1], "-server") == 0)
     {
-        if (argc != 4)
+        if (argc < 4 || argc > 6)
         {
             std::cout << "Invalid number of arguments!" << std::endl;
             return 1;
         }
         mode = Mode::Server;
+        if (argc > 4)
+        {
+            std::stringstream ss(argv[4]);
+            std::string strBlockSize;
+            while (std::getline(ss, strBlockSize, ','))
+            {
+                serverBlockSizes.push_back(std::stoi(strBlockSize));
+            }
+        }
+        if (argc > 5)
+        {
+            serverMemoryBudget = std::stod(argv[5]);
+        }
         std::cout << "Starting proving server for " << argv[2] << " on port " << argv[3] << "..." << std::endl;
     }
     else if (strcmp(argv[1], "-benchmark") == 0)
@@ -878,6 +2140,26 @@ int main(int argc, char **argv)
         mode = Mode::Test;
         std::cout << "Test ..." << std::endl;
     }
+    else if (strcmp(argv[1], "-profile") == 0)
+    {
+        if (argc < 4 || argc > 5)
+        {
+            std::cout << "Invalid number of arguments!" << std::endl;
+            return 1;
+        }
+        if (!Loopring::Profiler::isAvailable())
+        {
+            std::cerr << "Profiling is not available in a build without annotations (CIRCUIT_ANNOTATIONS=OFF)"
+                      << std::endl;
+            return 1;
+        }
+        mode = Mode::Profile;
+        if (argc > 4)
+        {
+            profileSlot = std::stoi(argv[4]);
+        }
+        std::cout << "Profiling " << argv[2] << "..." << std::endl;
+    }
     else
     {
         std::cerr << "Unknown option: " << argv[1] << std::endl;
@@ -885,18 +2167,52 @@ int main(int argc, char **argv)
     }
 
     // Read the block file
-    std::cout << "in main before loadJSON" << std::endl;
-    json input = loadJSON(argv[2]);
-    std::cout << "in main after loadJSON" << std::endl;
-    if (input == json())
+    json input;
+    std::unique_ptr<Loopring::Block> block;
+    int iBlockType = 0;
+    unsigned int blockSize = 0;
+    Loopring::BlockLayout layout;
+    if (isBinaryBlockFile(argv[2]))
     {
-        return 1;
+        Loopring::BinaryBlockHeader header;
+        block = loadBinaryBlock(argv[2], header);
+        if (!block)
+        {
+            return 1;
+        }
+        iBlockType = header.blockType;
+        blockSize = header.blockSize;
+        layout = header.getLayout();
     }
+    else
+    {
+        std::cout << "in main before loadJSON" << std::endl;
+        input = loadJSON(argv[2]);
+        std::cout << "in main after loadJSON" << std::endl;
+        if (input == json())
+        {
+            return 1;
+        }
 
-    // Read meta data
-    int iBlockType = input["blockType"].get<int>();
-    unsigned int blockSize = input["blockSize"].get<int>();
-    std::string postFix = "_" + std::to_string(blockSize);
+        // Read meta data
+        iBlockType = input["blockType"].get<int>();
+        blockSize = input["blockSize"].get<int>();
+        try
+        {
+            layout = Loopring::getBlockLayout(input);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+    if (!layout.isValid(blockSize))
+    {
+        std::cerr << "Invalid block layout for block size " << blockSize << std::endl;
+        return 1;
+    }
+    std::string postFix = "_" + std::to_string(blockSize) + layout.getName();
 
     /*if (iBlockType >= int(Loopring::BlockType::COUNT))
     {
@@ -904,9 +2220,26 @@ int main(int argc, char **argv)
         return 1;
     }*/
     unsigned int blockType = iBlockType;
+    std::string keysDirectory = baseFilename;
     baseFilename += getBaseName(blockType) + postFix;
     std::string provingKeyFilename = getProvingKeyFilename(baseFilename);
 
+    if (!block && (mode == Mode::Validate || mode == Mode::Prove || mode == Mode::Benchmark || mode == Mode::Profile))
+    {
+        auto begin = now();
+        block.reset(new Loopring::Block(input.get<Loopring::Block>()));
+        print_time(begin, "Block decoded");
+    }
+
+    // Reject invalid blocks before spending time on the circuit and the witness
+    if (mode == Mode::Validate || mode == Mode::Prove)
+    {
+        if (!preValidateBlock(*block))
+        {
+            return 1;
+        }
+    }
+
     if (mode == Mode::Prove || mode == Mode::Server)
     {
         if (!fileExists(provingKeyFilename))
@@ -916,8 +2249,44 @@ int main(int argc, char **argv)
         }
     }
 
+    if (mode == Mode::Server)
+    {
+#ifdef MULTICORE
+        omp_set_num_threads(config.num_threads);
+        std::cout << "Num threads used: " << omp_get_max_threads() << std::endl;
+#endif
+        if (std::find(serverBlockSizes.begin(), serverBlockSizes.end(), blockSize) == serverBlockSizes.end())
+        {
+            serverBlockSizes.insert(serverBlockSizes.begin(), blockSize);
+        }
+        ProverRegistry registry(
+          keysDirectory, blockType, layout, serverBlockSizes, serverMemoryBudget * 1024.0, config);
+        // Setup the prover for the block size of the block file a single time up front
+        registry.getInstance(blockSize);
+
+        runServer(registry, std::stoi(argv[3]));
+        pthread_exit(NULL);
+    }
+
+    if (mode == Mode::Profile && profileSlot >= blockSize)
+    {
+        std::cerr << "Invalid slot " << profileSlot << " for block size " << blockSize << std::endl;
+        return 1;
+    }
+    // The gadgets report to the profiler while the circuit and the witness are generated
+    Loopring::Profiler profiler;
+    if (mode == Mode::Profile)
+    {
+        Loopring::Profiler::active() = &profiler;
+    }
+
     ethsnarks::ProtoboardT pb;
-    Loopring::Circuit *circuit = createCircuit(blockType, blockSize, pb);
+    std::string cacheFilename = getConstraintSystemCacheFilename(baseFilename);
+    // The cache stores the constraints before they are optimized. The profiler needs the constraints of the
+    // gadgets as they are generated, so without cache or optimization.
+    const bool generateAll = (mode == Mode::BuildCache || mode == Mode::Profile);
+    Loopring::Circuit *circuit =
+      createCircuit(blockType, blockSize, layout, pb, generateAll ? "" : cacheFilename, !generateAll);
     if (config.swapAB)
     {
         // pb.constraint_system.swap_AB_if_beneficial();
@@ -942,7 +2311,12 @@ int main(int argc, char **argv)
 
     if (mode == Mode::Benchmark)
     {
-        if (!generateWitness(circuit, input))
+        if (input != json())
+        {
+            benchmarkBlockDecoding(input);
+        }
+        benchmarkCircuitCreation(blockType, blockSize, layout);
+        if (!generateWitness(circuit, *block))
         {
             return 1;
         }
@@ -954,24 +2328,17 @@ int main(int argc, char **argv)
     std::cout << "Num threads used: " << omp_get_max_threads() << std::endl;
 #endif
 
-    if (mode == Mode::Server)
+    if (mode == Mode::Validate || mode == Mode::Prove)
     {
-    	// Setup the context a single time
-    	ProverContextT context;
-    	loadProvingKey(provingKeyFilename, context.provingKey);
-    	context.constraint_system = &(circuit->getPb().constraint_system);
-    	context.config = config;
-    	context.domain = get_domain(circuit->getPb(), context.provingKey, config);
-    	initProverContextBuffers(context);
-
-//        pthread_t tid;
-
-        runServer(context, circuit, provingKeyFilename, config, std::stoi(argv[3]));
+        if (!generateWitness(circuit, *block))
+        {
+            return 1;
+        }
     }
 
-    if (mode == Mode::Validate || mode == Mode::Prove)
+    if (mode == Mode::Profile)
     {
-        if (!generateWitness(circuit, input))
+        if (!profileCircuit(circuit, *block, pb, profiler, profileSlot, argv[3]))
         {
             return 1;
         }
@@ -987,27 +2354,36 @@ int main(int argc, char **argv)
 
     if (mode == Mode::CreateKeys)
     {
-        if (!generateKeyPair(pb, baseFilename))
+        if (!generateKeyPair(circuit->getPb(), baseFilename))
         {
             std::cerr << "Failed to generate keys!" << std::endl;
             return 1;
         }
     }
 
+    if (mode == Mode::BuildCache)
+    {
+        if (!buildConstraintSystemCache(cacheFilename, blockType, blockSize, layout, pb))
+        {
+            std::cerr << "Failed to build cache!" << std::endl;
+            return 1;
+        }
+    }
+
     if (mode == Mode::Prove)
     {
 #ifdef GPU_PROVE
         std::cout << "GPU Prove: Generate inputsFile." << std::endl;
         std::string inputsFilename = baseFilename + "_inputs.raw";
         auto begin = now();
-        stub_write_input_from_pb(pb, provingKeyFilename.c_str(), inputsFilename.c_str());
+        stub_write_input_from_pb(circuit->getPb(), provingKeyFilename.c_str(), inputsFilename.c_str());
         print_time(begin, "write input");
 #else
         ProverContextT context;
         loadProvingKey(provingKeyFilename, context.provingKey);
-        context.constraint_system = &pb.constraint_system;
+        context.constraint_system = &(circuit->getPb().constraint_system);
         context.config = config;
-        context.domain = get_domain(pb, context.provingKey, config);
+        context.domain = get_domain(circuit->getPb(), context.provingKey, config);
         initProverContextBuffers(context);
         printMemoryUsage();
         std::string jProof = proveCircuit(context, circuit);
@@ -1033,7 +2409,7 @@ int main(int argc, char **argv)
 
     if (mode == Mode::ExportCircuit)
     {
-        if (!r1cs2json(pb, argv[3]))
+        if (!r1cs2json(circuit->getPb(), argv[3]))
         {
             std::cerr << "Failed to export circuit!" << std::endl;
             return 1;
@@ -1042,7 +2418,7 @@ int main(int argc, char **argv)
 
     if (mode == Mode::ExportWitness)
     {
-        if (!witness2json(pb, argv[3]))
+        if (!witness2json(circuit->getPb(), argv[3]))
         {
             std::cerr << "Failed to export witness!" << std::endl;
             return 1;
@@ -0,0 +1,134 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Gadgets/AccountGadgets.h"
+
+static bool isAllowed(const BlockLayout &layout, unsigned int slot, unsigned int blockSize, TransactionType type)
+{
+    return (layout.getAllowedTransactionTypes(slot, blockSize) & getTransactionTypeBit(type)) != 0;
+}
+
+TEST_CASE("BlockLayout", "[BlockLayout]")
+{
+    const unsigned int blockSize = 16;
+
+    SECTION("Universal")
+    {
+        BlockLayout layout;
+        REQUIRE(layout.universal);
+        REQUIRE(layout.getName() == "");
+        for (unsigned int slot = 0; slot < blockSize; slot++)
+        {
+            REQUIRE(layout.getAllowedTransactionTypes(slot, blockSize) == ALL_TRANSACTION_TYPES);
+        }
+    }
+
+    SECTION("Regions")
+    {
+        BlockLayout layout = json::parse(R"({"deposits": 2, "accountUpdates": 1, "withdrawals": 3})")
+                               .get<BlockLayout>();
+        REQUIRE(!layout.universal);
+        REQUIRE(layout.isValid(blockSize));
+        REQUIRE(!layout.isValid(5));
+        REQUIRE(layout.getName() == "_2_1_3");
+
+        for (unsigned int slot = 0; slot < blockSize; slot++)
+        {
+            // Every slot can be padded
+            REQUIRE(isAllowed(layout, slot, blockSize, TransactionType::Noop));
+
+            bool depositRegion = slot < 2;
+            bool accountUpdateRegion = slot < 3;
+            bool withdrawalRegion = slot >= blockSize - 3;
+            bool otherRegion = !accountUpdateRegion && !withdrawalRegion;
+            REQUIRE(isAllowed(layout, slot, blockSize, TransactionType::Deposit) == depositRegion);
+            REQUIRE(isAllowed(layout, slot, blockSize, TransactionType::AccountUpdate) == accountUpdateRegion);
+            REQUIRE(isAllowed(layout, slot, blockSize, TransactionType::Withdrawal) == withdrawalRegion);
+            REQUIRE(isAllowed(layout, slot, blockSize, TransactionType::Transfer) == otherRegion);
+            REQUIRE(isAllowed(layout, slot, blockSize, TransactionType::SpotTrade) == otherRegion);
+            REQUIRE(isAllowed(layout, slot, blockSize, TransactionType::BatchSpotTrade) == otherRegion);
+        }
+    }
+
+    SECTION("Operator fee table")
+    {
+        BlockLayout layout = json::parse(R"({"operatorFeeTokens": 4})").get<BlockLayout>();
+        REQUIRE(layout.universal);
+        REQUIRE(layout.deferOperatorFees());
+        REQUIRE(layout.getName() == "_f4");
+        REQUIRE(layout.getAllowedTransactionTypes(0, blockSize) == ALL_TRANSACTION_TYPES);
+
+        layout = json::parse(R"({"deposits": 2, "accountUpdates": 1, "withdrawals": 3, "operatorFeeTokens": 2})")
+                   .get<BlockLayout>();
+        REQUIRE(!layout.universal);
+        REQUIRE(layout.getName() == "_2_1_3_f2");
+        REQUIRE(!BlockLayout().deferOperatorFees());
+    }
+
+    SECTION("Optional in block data")
+    {
+        REQUIRE(getBlockLayout(json::parse(R"({"blockSize": 16})")) == BlockLayout());
+        REQUIRE(
+          getBlockLayout(json::parse(R"({"layout": {"deposits": 0, "accountUpdates": 0, "withdrawals": 0}})")) !=
+          BlockLayout());
+        // Blocks can't ask for the operator fee table until the operator produces it
+        REQUIRE_THROWS_AS(
+          getBlockLayout(json::parse(R"({"layout": {"operatorFeeTokens": 2}})")), std::runtime_error);
+    }
+}
+
+TEST_CASE("OperatorBalanceLookup", "[OperatorBalanceLookupGadget]")
+{
+    const std::vector<unsigned int> tokens = {0, 3, 7};
+    const std::vector<unsigned int> balances = {10, 20, 30};
+
+    auto lookupChecked = [&](unsigned int token, unsigned int before, unsigned int after, bool expectedSatisfied) {
+        protoboard<FieldT> pb;
+
+        VariableArrayT tableTokenIDs;
+        VariableArrayT tableBalances;
+        for (unsigned int i = 0; i < tokens.size(); i++)
+        {
+            tableTokenIDs.emplace_back(make_variable(pb, FieldT(tokens[i]), ".tableTokenID"));
+            tableBalances.emplace_back(make_variable(pb, FieldT(balances[i]), ".tableBalance"));
+        }
+        DualVariableGadget tokenID(pb, NUM_BITS_TOKEN, ".tokenID");
+        tokenID.generate_r1cs_witness(pb, FieldT(token));
+        VariableT balanceBefore = make_variable(pb, FieldT(before), ".balanceBefore");
+        VariableT balanceAfter = make_variable(pb, FieldT(after), ".balanceAfter");
+
+        OperatorBalanceLookupGadget lookup(
+          pb, tableTokenIDs, tableBalances, tokenID.bits, balanceBefore, balanceAfter, "lookup");
+        lookup.generate_r1cs_constraints();
+        lookup.generate_r1cs_witness();
+
+        REQUIRE(pb.is_satisfied() == expectedSatisfied);
+        if (expectedSatisfied)
+        {
+            for (unsigned int i = 0; i < tokens.size(); i++)
+            {
+                FieldT expectedBalance = (tokens[i] == token) ? FieldT(after) : FieldT(balances[i]);
+                REQUIRE((pb.val(lookup.result()[i]) == expectedBalance));
+            }
+        }
+    };
+
+    SECTION("Update")
+    {
+        lookupChecked(3, 20, 25, true);
+        lookupChecked(7, 30, 30, true);
+        lookupChecked(0, 10, 5, true);
+    }
+
+    SECTION("Wrong balance before")
+    {
+        lookupChecked(3, 21, 25, false);
+        lookupChecked(3, 0, 25, false);
+    }
+
+    SECTION("Token not in table")
+    {
+        lookupChecked(5, 0, 0, false);
+        lookupChecked(5, 0, 1, false);
+    }
+}
@@ -0,0 +1,137 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Circuits/BlockValidator.h"
+
+TEST_CASE("BlockValidator", "[BlockValidator]")
+{
+    Block block = getBlock();
+
+    auto findTransaction = [&](TransactionType type) {
+        unsigned int idx = block.transactions.size();
+        for (unsigned int i = 0; i < block.transactions.size(); i++)
+        {
+            if (block.transactions[i].type == FieldT(int(type)))
+            {
+                idx = i;
+                break;
+            }
+        }
+        REQUIRE(idx < block.transactions.size());
+        return idx;
+    };
+    const unsigned int transferIdx = findTransaction(TransactionType::Transfer);
+    const std::string transferPrefix = "tx " + std::to_string(transferIdx) + ": ";
+    const unsigned int accountUpdateIdx = findTransaction(TransactionType::AccountUpdate);
+    const std::string accountUpdatePrefix = "tx " + std::to_string(accountUpdateIdx) + ": ";
+
+    SECTION("Valid block")
+    {
+        REQUIRE(BlockValidator().validate(block) == "");
+    }
+
+    SECTION("Incorrect merkleRootAfter")
+    {
+        Block modifiedBlock = block;
+        modifiedBlock.merkleRootAfter += 1;
+        REQUIRE(BlockValidator().validate(modifiedBlock) != "");
+    }
+
+    SECTION("Broken root chain")
+    {
+        Block modifiedBlock = block;
+        modifiedBlock.transactions[1].witness.accountUpdate_A.rootBefore += 1;
+        std::string error = BlockValidator().validate(modifiedBlock);
+        REQUIRE(error.find("tx 1: ") == 0);
+    }
+
+    SECTION("Incorrect leaf after")
+    {
+        Block modifiedBlock = block;
+        for (unsigned int i = 0; i < modifiedBlock.transactions.size(); i++)
+        {
+            BalanceUpdate &balanceUpdate = modifiedBlock.transactions[i].witness.balanceUpdateS_A;
+            if (balanceUpdate.rootBefore != balanceUpdate.rootAfter)
+            {
+                balanceUpdate.after.balance += 1;
+                std::string error = BlockValidator().validate(modifiedBlock);
+                REQUIRE(error.find("tx " + std::to_string(i) + ": balanceUpdateS_A") == 0);
+                break;
+            }
+        }
+    }
+
+    SECTION("Invalid nonce update")
+    {
+        Block modifiedBlock = block;
+        modifiedBlock.transactions[1].witness.accountUpdate_A.after.nonce += 2;
+        std::string error = BlockValidator().validate(modifiedBlock);
+        REQUIRE(error.find("tx 1: accountUpdate_A") == 0);
+    }
+
+    SECTION("Transfer amount not conserved")
+    {
+        Block modifiedBlock = block;
+        modifiedBlock.transactions[transferIdx].witness.balanceUpdateB_B.after.balance += 1;
+        std::string error = BlockValidator().validate(modifiedBlock);
+        REQUIRE(error.find(transferPrefix + "balanceUpdateB_B.after.balance") == 0);
+    }
+
+    SECTION("Transfer fee not paid to the operator")
+    {
+        Block modifiedBlock = block;
+        modifiedBlock.transactions[transferIdx].witness.balanceUpdateA_O.after.balance += 1;
+        std::string error = BlockValidator().validate(modifiedBlock);
+        REQUIRE(error.find(transferPrefix + "balanceUpdateA_O.after.balance") == 0);
+    }
+
+    SECTION("Negative balance")
+    {
+        Block modifiedBlock = block;
+        BalanceUpdate &balanceUpdate = modifiedBlock.transactions[transferIdx].witness.balanceUpdateS_A;
+        balanceUpdate.after.balance = FieldT::zero() - FieldT::one();
+        std::string error = BlockValidator().validate(modifiedBlock);
+        REQUIRE(error.find(transferPrefix + "balanceUpdateS_A.after.balance is negative") == 0);
+    }
+
+    SECTION("Withdrawal exceeds the balance")
+    {
+        Block modifiedBlock = block;
+        UniversalTransaction &tx = modifiedBlock.transactions[transferIdx];
+        tx.type = FieldT(int(TransactionType::Withdrawal));
+        tx.withdraw.amount = tx.witness.balanceUpdateS_A.before.balance + 1;
+        std::string error = BlockValidator().validate(modifiedBlock);
+        REQUIRE(error.find(transferPrefix + "withdrawal amount") == 0);
+        REQUIRE(error.find("exceeds the balance") != std::string::npos);
+    }
+
+    SECTION("Account update without nonce increase")
+    {
+        Block modifiedBlock = block;
+        AccountUpdate &update = modifiedBlock.transactions[accountUpdateIdx].witness.accountUpdate_A;
+        update.after.nonce = update.before.nonce;
+        std::string error = BlockValidator().validate(modifiedBlock);
+        REQUIRE(error.find(accountUpdatePrefix + "accountUpdate_A.after.nonce") == 0);
+    }
+
+    SECTION("Account update fee not paid")
+    {
+        Block modifiedBlock = block;
+        modifiedBlock.transactions[accountUpdateIdx].accountUpdate.fee = FieldT(1000);
+        std::string error = BlockValidator().validate(modifiedBlock);
+        REQUIRE(error.find(accountUpdatePrefix + "balanceUpdateS_A.after.balance") == 0);
+    }
+
+    SECTION("Order cancellation does not cancel")
+    {
+        Block modifiedBlock = block;
+        UniversalTransaction &tx = modifiedBlock.transactions[accountUpdateIdx];
+        tx.type = FieldT(int(TransactionType::OrderCancel));
+        tx.orderCancel.feeTokenID = tx.accountUpdate.feeTokenID;
+        tx.orderCancel.fee = tx.accountUpdate.fee;
+        tx.orderCancel.storageID = tx.witness.storageUpdate_A.after.storageID;
+        tx.witness.storageUpdate_A.after.cancelled = FieldT::zero();
+        std::string error = BlockValidator().validate(modifiedBlock);
+        REQUIRE(error.find(accountUpdatePrefix + "storageUpdate_A.after.cancelled") == 0);
+    }
+}
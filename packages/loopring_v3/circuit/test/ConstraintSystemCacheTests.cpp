@@ -0,0 +1,63 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Circuits/UniversalCircuit.h"
+#include "../Utils/ConstraintSystemCache.h"
+
+#include <sstream>
+
+TEST_CASE("ConstraintSystemCache", "[ConstraintSystemCache]")
+{
+    const unsigned int blockSize = 4;
+    const BlockLayout layout =
+      json::parse(R"({"deposits": 1, "accountUpdates": 1, "withdrawals": 1})").get<BlockLayout>();
+    const std::string key = "test_0_4" + layout.getName();
+
+    // Reference: all constraints generated
+    protoboard<FieldT> expectedPb;
+    UniversalCircuit expectedCircuit(expectedPb, "circuit");
+    expectedCircuit.layout = layout;
+    expectedCircuit.generateConstraints(blockSize);
+
+    std::stringstream stream;
+    REQUIRE(writeConstraintSystemCache(stream, key, expectedPb));
+    const std::string cache = stream.str();
+
+    // The transactions are created without their constraints, the constraints come from the cache
+    protoboard<FieldT> pb;
+    UniversalCircuit circuit(pb, "circuit");
+    circuit.layout = layout;
+    circuit.transactionConstraints = false;
+    circuit.generateConstraints(blockSize);
+    REQUIRE(pb.num_variables() == expectedPb.num_variables());
+    REQUIRE(pb.num_constraints() < expectedPb.num_constraints());
+
+    ConstraintSystemCacheHeader header;
+    SECTION("Load")
+    {
+        REQUIRE(checkConstraintSystemCache(cache.data(), cache.size(), key, header));
+        REQUIRE(loadConstraintSystemCache(cache.data(), header, pb));
+        requireSameConstraints(pb, expectedPb);
+    }
+
+    SECTION("Other key")
+    {
+        REQUIRE(!checkConstraintSystemCache(cache.data(), cache.size(), key + "_o", header));
+        REQUIRE(!checkConstraintSystemCache(cache.data(), cache.size(), "", header));
+    }
+
+    SECTION("Damaged")
+    {
+        REQUIRE(!checkConstraintSystemCache(cache.data(), cache.size() - 8, key, header));
+        std::string damaged = cache;
+        damaged[damaged.size() - 1] ^= 1;
+        REQUIRE(!checkConstraintSystemCache(damaged.data(), damaged.size(), key, header));
+    }
+
+    SECTION("Other variables")
+    {
+        REQUIRE(checkConstraintSystemCache(cache.data(), cache.size(), key, header));
+        make_variable(pb, ".extra");
+        REQUIRE(!loadConstraintSystemCache(cache.data(), header, pb));
+    }
+}
@@ -0,0 +1,65 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Gadgets/MathGadgets.h"
+#include "../Utils/ConstraintSystemOptimizer.h"
+
+TEST_CASE("ConstraintSystemOptimizer", "[ConstraintSystemOptimizer]")
+{
+    auto optimizeChecked = [](unsigned int _input, unsigned int _A, unsigned int _B, bool expectedSatisfied) {
+        protoboard<FieldT> pb;
+
+        VariableT input = make_variable(pb, FieldT(_input), ".input");
+        pb.set_input_sizes(1);
+        VariableT A = make_variable(pb, FieldT(_A), ".A");
+        VariableT B = make_variable(pb, FieldT(_B), ".B");
+        VariableT C = make_variable(pb, FieldT(_A), ".C");
+        VariableT unused = make_variable(pb, FieldT(7), ".unused");
+
+        Constants constants(pb, "constants");
+        // Ternary with a constant condition: result == C
+        TernaryGadget ternary(pb, constants._0, A, C, "ternary");
+        // Linear: sum == A + C
+        UnsafeAddGadget sum(pb, A, ternary.result(), "sum");
+        // Quadratic: A * B == input
+        UnsafeMulGadget mul(pb, A, B, "mul");
+
+        constants.generate_r1cs_constraints();
+        ternary.generate_r1cs_constraints(false);
+        sum.generate_r1cs_constraints();
+        mul.generate_r1cs_constraints();
+        requireEqual(pb, mul.result(), input, "mul == input");
+        requireEqual(pb, C, A, "C == A");
+
+        constants.generate_r1cs_witness();
+        ternary.generate_r1cs_witness();
+        sum.generate_r1cs_witness();
+        mul.generate_r1cs_witness();
+
+        ConstraintSystemOptimizer optimizer(pb);
+        optimizer.mapWitness(pb);
+
+        REQUIRE(pb.is_satisfied() == expectedSatisfied);
+        REQUIRE(optimizer.pb.is_satisfied() == expectedSatisfied);
+
+        // Only input * 1 = A * B is left, with the input and A and B as variables
+        REQUIRE(optimizer.numConstraintsBefore == pb.num_constraints());
+        REQUIRE(optimizer.pb.num_constraints() == 1);
+        REQUIRE(optimizer.pb.num_inputs() == 1);
+        REQUIRE(optimizer.pb.num_variables() == 3);
+        REQUIRE(optimizer.variableMap[0] == input.index);
+        REQUIRE(std::find(optimizer.variableMap.begin(), optimizer.variableMap.end(), unused.index) ==
+                optimizer.variableMap.end());
+    };
+
+    SECTION("Satisfied")
+    {
+        optimizeChecked(15, 3, 5, true);
+        optimizeChecked(0, 0, 5, true);
+    }
+
+    SECTION("Not satisfied")
+    {
+        optimizeChecked(16, 3, 5, false);
+    }
+}
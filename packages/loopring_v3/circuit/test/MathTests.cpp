@@ -47,6 +47,45 @@ TEST_CASE("ternary variable", "[TernaryGadget]")
     }
 }
 
+TEST_CASE("ternary constant", "[TernaryGadget]")
+{
+    protoboard<FieldT> pb;
+
+    VariableT b = make_variable(pb, ".b");
+    VariableT A = make_variable(pb, FieldT(3), ".A");
+
+    // b ? A : 7 and b ? 0 : A
+    TernaryGadget constantGadget(pb, b, A, constantTerm(FieldT(7)), "constantGadget");
+    TernaryGadget zeroGadget(pb, b, constantTerm(FieldT::zero()), A, "zeroGadget");
+    constantGadget.generate_r1cs_constraints();
+    zeroGadget.generate_r1cs_constraints();
+
+    // Only the results are allocated, the zero constant is not in the constraint
+    REQUIRE(pb.num_variables() == 4);
+    for (size_t i = 0; i < pb.num_constraints(); i++)
+    {
+        const libsnark::linear_combination<FieldT> lc = pb.constraint_system.constraints[i]->getB();
+        for (const auto &term : lc.getTerms())
+        {
+            REQUIRE(term.coeff != FieldT::zero());
+        }
+    }
+
+    for (unsigned int value = 0; value < 2; value++)
+    {
+        pb.val(b) = FieldT(value);
+        constantGadget.generate_r1cs_witness();
+        zeroGadget.generate_r1cs_witness();
+
+        REQUIRE(pb.is_satisfied());
+        REQUIRE((pb.val(constantGadget.result()) == (value ? FieldT(3) : FieldT(7))));
+        REQUIRE((pb.val(zeroGadget.result()) == (value ? FieldT::zero() : FieldT(3))));
+    }
+
+    pb.val(constantGadget.result()) = FieldT(7);
+    REQUIRE(!pb.is_satisfied());
+}
+
 TEST_CASE("ternary array", "[ArrayTernaryGadget]")
 {
     unsigned int maxNumInputs = 1024;
@@ -2105,3 +2144,73 @@ TEST_CASE("SignedSub", "[SignedSubGadget]")
 //         }
 //     }
 // }
+
+TEST_CASE("Constants", "[Constants]")
+{
+    protoboard<FieldT> pb;
+    Constants constants(pb, "constants");
+    constants.generate_r1cs_constraints();
+    constants.generate_r1cs_witness();
+
+    REQUIRE(pb.is_satisfied());
+    for (unsigned int i = 0; i < constants.values.size(); i++)
+    {
+        REQUIRE((pb.val(constants.values[i]) == FieldT(i)));
+    }
+
+    // One is the constant term of the protoboard, only _0, _2.._17 and the 13 named constants are allocated
+    REQUIRE(constants._1.index == 0);
+    REQUIRE(pb.num_variables() == 17 + 13);
+}
+
+TEST_CASE("Select zero padding", "[SelectGadget]")
+{
+    protoboard<FieldT> pb;
+    Constants constants(pb, "constants");
+    VariableArrayT selector = make_var_array(pb, 3, ".selector");
+    std::vector<VariableT> values = {
+      make_variable(pb, FieldT(5), ".a"), make_variable(pb, FieldT(6), ".b"), make_variable(pb, FieldT(7), ".c")};
+    std::vector<VariableArrayT> arrayValues = {
+      make_var_array(pb, 4, ".A"), make_var_array(pb, 4, ".B"), make_var_array(pb, 4, ".C")};
+    constants.generate_r1cs_witness();
+
+    SelectGadget selectGadget(pb, constants, selector, values, "selectGadget");
+    ArraySelectGadget arraySelectGadget(pb, constants, selector, arrayValues, "arraySelectGadget");
+    const size_t firstConstraint = pb.num_constraints();
+    selectGadget.generate_r1cs_constraints();
+    arraySelectGadget.generate_r1cs_constraints();
+
+    // The selects are padded with the constant 0, not with the variable constants._0
+    auto requireNoZeroVariable = [&](const libsnark::linear_combination<FieldT> &lc) {
+        for (const auto &term : lc.getTerms())
+        {
+            REQUIRE(term.index != constants._0.index);
+        }
+    };
+    for (size_t i = firstConstraint; i < pb.num_constraints(); i++)
+    {
+        const auto &constraint = pb.constraint_system.constraints[i];
+        requireNoZeroVariable(constraint->getA());
+        requireNoZeroVariable(constraint->getB());
+        requireNoZeroVariable(constraint->getC());
+    }
+
+    // Nothing selected
+    selectGadget.generate_r1cs_witness();
+    arraySelectGadget.generate_r1cs_witness();
+    REQUIRE(pb.is_satisfied());
+    REQUIRE((pb.val(selectGadget.result()) == FieldT::zero()));
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        REQUIRE((pb.val(arraySelectGadget.result()[i]) == FieldT::zero()));
+    }
+
+    // The second value selected
+    pb.val(selector[1]) = FieldT::one();
+    pb.val(arrayValues[1][2]) = FieldT(9);
+    selectGadget.generate_r1cs_witness();
+    arraySelectGadget.generate_r1cs_witness();
+    REQUIRE(pb.is_satisfied());
+    REQUIRE((pb.val(selectGadget.result()) == FieldT(6)));
+    REQUIRE((pb.val(arraySelectGadget.result()[2]) == FieldT(9)));
+}
@@ -223,3 +223,271 @@ TEST_CASE("UpdateStorage", "[UpdateStorageGadget]")
         updateStorageChecked(modifiedStorageUpdate, false);
     }
 }
+
+TEST_CASE("MerklePathUpdate", "[merkle_path_update_4]")
+{
+    const unsigned int depth = 4;
+
+    auto pathUpdateChecked = [&](unsigned int address, bool validRootBefore) {
+        protoboard<FieldT> pb;
+
+        VariableArrayT addressBits = make_var_array(pb, depth * 2, ".address");
+        addressBits.fill_with_bits_of_field_element(pb, FieldT(address));
+        VariableT leafBefore = make_variable(pb, getRandomFieldElement(), ".leafBefore");
+        VariableT leafAfter = make_variable(pb, getRandomFieldElement(), ".leafAfter");
+        VariableArrayT proof = make_var_array(pb, depth * 3, ".proof");
+        for (unsigned int i = 0; i < proof.size(); i++)
+        {
+            pb.val(proof[i]) = getRandomFieldElement();
+        }
+
+        // Reference implementation
+        MerklePathT pathBefore(pb, depth, addressBits, leafBefore, proof, "pathBefore");
+        MerklePathT pathAfter(pb, depth, addressBits, leafAfter, proof, "pathAfter");
+        pathBefore.generate_r1cs_witness();
+        pathAfter.generate_r1cs_witness();
+
+        VariableT rootBefore = make_variable(pb, pb.val(pathBefore.result()), ".rootBefore");
+        if (!validRootBefore)
+        {
+            pb.val(rootBefore) += FieldT::one();
+        }
+        MerklePathUpdateT pathUpdate(pb, depth, addressBits, leafBefore, leafAfter, rootBefore, proof, "pathUpdate");
+        pathUpdate.generate_r1cs_constraints();
+        pathUpdate.generate_r1cs_witness();
+
+        REQUIRE(pb.is_satisfied() == validRootBefore);
+        REQUIRE((pb.val(pathUpdate.rootBefore()) == pb.val(pathBefore.result())));
+        REQUIRE((pb.val(pathUpdate.result()) == pb.val(pathAfter.result())));
+    };
+
+    SECTION("All positions")
+    {
+        // Every level has its node at every position at least once
+        pathUpdateChecked(0x00, true);
+        pathUpdateChecked(0x55, true);
+        pathUpdateChecked(0xAA, true);
+        pathUpdateChecked(0xFF, true);
+        pathUpdateChecked(0x1B, true);
+    }
+
+    SECTION("Incorrect root before")
+    {
+        pathUpdateChecked(0x1B, false);
+    }
+}
+
+TEST_CASE("MerkleDualPathUpdate", "[merkle_dual_path_update_4]")
+{
+    const unsigned int depth = 4;
+
+    auto dualPathUpdateChecked = [&](unsigned int address, bool validSecondRootBefore) {
+        protoboard<FieldT> pb;
+
+        VariableArrayT addressBits = make_var_array(pb, depth * 2, ".address");
+        addressBits.fill_with_bits_of_field_element(pb, FieldT(address));
+        std::vector<VariableT> leaves;
+        std::vector<VariableArrayT> proofs;
+        for (unsigned int t = 0; t < 2; t++)
+        {
+            leaves.push_back(make_variable(pb, getRandomFieldElement(), ".leafBefore"));
+            leaves.push_back(make_variable(pb, getRandomFieldElement(), ".leafAfter"));
+            proofs.push_back(make_var_array(pb, depth * 3, ".proof"));
+            for (unsigned int i = 0; i < proofs.back().size(); i++)
+            {
+                pb.val(proofs.back()[i]) = getRandomFieldElement();
+            }
+        }
+
+        // Reference implementation
+        MerklePathT pathBefore(pb, depth, addressBits, leaves[0], proofs[0], "pathBefore");
+        MerklePathT pathAfter(pb, depth, addressBits, leaves[1], proofs[0], "pathAfter");
+        MerklePathT secondPathBefore(pb, depth, addressBits, leaves[2], proofs[1], "secondPathBefore");
+        MerklePathT secondPathAfter(pb, depth, addressBits, leaves[3], proofs[1], "secondPathAfter");
+        pathBefore.generate_r1cs_witness();
+        pathAfter.generate_r1cs_witness();
+        secondPathBefore.generate_r1cs_witness();
+        secondPathAfter.generate_r1cs_witness();
+
+        VariableT rootBefore = make_variable(pb, pb.val(pathBefore.result()), ".rootBefore");
+        VariableT secondRootBefore = make_variable(pb, pb.val(secondPathBefore.result()), ".secondRootBefore");
+        if (!validSecondRootBefore)
+        {
+            pb.val(secondRootBefore) += FieldT::one();
+        }
+        MerkleDualPathUpdateT pathUpdate(
+          pb,
+          depth,
+          addressBits,
+          leaves[0],
+          leaves[1],
+          rootBefore,
+          proofs[0],
+          leaves[2],
+          leaves[3],
+          secondRootBefore,
+          proofs[1],
+          "pathUpdate");
+        pathUpdate.generate_r1cs_constraints();
+        pathUpdate.generate_r1cs_witness();
+
+        REQUIRE(pb.is_satisfied() == validSecondRootBefore);
+        REQUIRE((pb.val(pathUpdate.result()) == pb.val(pathAfter.result())));
+        REQUIRE((pb.val(pathUpdate.secondResult()) == pb.val(secondPathAfter.result())));
+    };
+
+    SECTION("All positions")
+    {
+        dualPathUpdateChecked(0x00, true);
+        dualPathUpdateChecked(0x55, true);
+        dualPathUpdateChecked(0xAA, true);
+        dualPathUpdateChecked(0xFF, true);
+        dualPathUpdateChecked(0x1B, true);
+    }
+
+    SECTION("Incorrect second root before")
+    {
+        dualPathUpdateChecked(0x1B, false);
+    }
+
+    SECTION("Constraint count")
+    {
+        // The position of the node at every level is shared between both trees
+        protoboard<FieldT> pbDual;
+        VariableArrayT address = make_var_array(pbDual, depth * 2, ".address");
+        VariableArrayT proof = make_var_array(pbDual, depth * 3, ".proof");
+        VariableT leaf = make_variable(pbDual, ".leaf");
+        MerkleDualPathUpdateT dual(pbDual, depth, address, leaf, leaf, leaf, proof, leaf, leaf, leaf, proof, "dual");
+        dual.generate_r1cs_constraints();
+
+        protoboard<FieldT> pbSingle;
+        address = make_var_array(pbSingle, depth * 2, ".address");
+        proof = make_var_array(pbSingle, depth * 3, ".proof");
+        leaf = make_variable(pbSingle, ".leaf");
+        MerklePathUpdateT single(pbSingle, depth, address, leaf, leaf, leaf, proof, "single");
+        single.generate_r1cs_constraints();
+
+        REQUIRE(pbDual.num_constraints() == 2 * pbSingle.num_constraints() - depth);
+    }
+}
+
+static FieldT hashMerkleNode(const std::vector<FieldT> &children)
+{
+    protoboard<FieldT> pb;
+    VariableArrayT inputs = make_var_array(pb, children.size(), ".inputs");
+    inputs.fill_with_field_elements(pb, children);
+    HashMerkleTree hasher(pb, inputs, ".hasher");
+    hasher.generate_r1cs_witness();
+    return pb.val(hasher.result());
+}
+
+TEST_CASE("MerkleMultiUpdate", "[merkle_multi_update_4]")
+{
+    // Quad tree of depth 2: 16 leaves
+    const unsigned int depth = 2;
+
+    struct Tree
+    {
+        std::vector<FieldT> leaves;
+
+        std::vector<FieldT> nodes() const
+        {
+            std::vector<FieldT> nodes;
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                nodes.push_back(
+                  hashMerkleNode({leaves[i * 4 + 0], leaves[i * 4 + 1], leaves[i * 4 + 2], leaves[i * 4 + 3]}));
+            }
+            return nodes;
+        }
+
+        FieldT root() const
+        {
+            return hashMerkleNode(nodes());
+        }
+
+        std::vector<FieldT> proof(unsigned int address) const
+        {
+            std::vector<FieldT> proof;
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                if (i != address % 4)
+                {
+                    proof.push_back(leaves[(address / 4) * 4 + i]);
+                }
+            }
+            std::vector<FieldT> levelNodes = nodes();
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                if (i != address / 4)
+                {
+                    proof.push_back(levelNodes[i]);
+                }
+            }
+            return proof;
+        }
+    };
+
+    auto multiUpdateChecked = [&](const std::vector<unsigned int> &addresses, bool staleProofs) {
+        protoboard<FieldT> pb;
+
+        Tree tree;
+        for (unsigned int i = 0; i < 16; i++)
+        {
+            tree.leaves.push_back(getRandomFieldElement());
+        }
+        const Tree initialTree = tree;
+        VariableT rootBefore = make_variable(pb, tree.root(), ".rootBefore");
+
+        std::vector<VariableArrayT> addressBits;
+        std::vector<VariableT> leavesBefore;
+        std::vector<VariableT> leavesAfter;
+        std::vector<VariableArrayT> proofs;
+        for (unsigned int j = 0; j < addresses.size(); j++)
+        {
+            const unsigned int address = addresses[j];
+            addressBits.push_back(make_var_array(pb, depth * 2, ".address"));
+            addressBits.back().fill_with_bits_of_field_element(pb, FieldT(address));
+            proofs.push_back(make_var_array(pb, depth * 3, ".proof"));
+            proofs.back().fill_with_field_elements(pb, (staleProofs ? initialTree : tree).proof(address));
+
+            leavesBefore.push_back(make_variable(pb, tree.leaves[address], ".leafBefore"));
+            tree.leaves[address] = getRandomFieldElement();
+            leavesAfter.push_back(make_variable(pb, tree.leaves[address], ".leafAfter"));
+        }
+
+        MerkleMultiUpdateT multiUpdate(
+          pb, depth, addressBits, leavesBefore, leavesAfter, rootBefore, proofs, "multiUpdate");
+        multiUpdate.generate_r1cs_constraints();
+        multiUpdate.generate_r1cs_witness();
+
+        REQUIRE(pb.is_satisfied() == !staleProofs);
+        if (!staleProofs)
+        {
+            REQUIRE((pb.val(multiUpdate.rootBefore()) == initialTree.root()));
+            REQUIRE((pb.val(multiUpdate.result()) == tree.root()));
+        }
+    };
+
+    SECTION("Single leaf")
+    {
+        multiUpdateChecked({6}, false);
+    }
+
+    SECTION("Multiple leaves")
+    {
+        multiUpdateChecked({5, 9, 6, 15}, false);
+        multiUpdateChecked({0, 1, 2, 3}, false);
+    }
+
+    SECTION("Same leaf")
+    {
+        multiUpdateChecked({7, 7}, false);
+    }
+
+    SECTION("Proofs not in the updated tree")
+    {
+        multiUpdateChecked({5, 6}, true);
+        multiUpdateChecked({5, 9}, true);
+    }
+}
@@ -0,0 +1,65 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Utils/Profiler.h"
+
+TEST_CASE("Profiler", "[Profiler]")
+{
+    protoboard<FieldT> pb;
+    Profiler profiler;
+    Profiler::active() = &profiler;
+
+    VariableT a = make_variable(pb, FieldT(3), ".a");
+    VariableT b = make_variable(pb, FieldT(5), ".b");
+    VariableT c = make_variable(pb, FieldT(15), ".c");
+    VariableT d = make_variable(pb, FieldT(3), ".d");
+    VariableT e = make_variable(pb, FieldT(15), ".e");
+    VariableT unused = make_variable(pb, FieldT(7), ".unused");
+
+    {
+        ProfileConstraints outer(pb, "tx_0");
+        pb.add_r1cs_constraint(ConstraintT(a, b, c), "a * b == c");
+        {
+            ProfileConstraints inner(pb, "tx_0.inner");
+            pb.add_r1cs_constraint(ConstraintT(d, FieldT::one(), a), "d == a");
+            pb.add_r1cs_constraint(ConstraintT(d, b, c), "d * b == c");
+        }
+    }
+    {
+        ProfileConstraints other(pb, "tx_1");
+        pb.add_r1cs_constraint(ConstraintT(e, FieldT::one(), c), "e == c");
+    }
+    {
+        ProfileWitness outer("tx_0");
+        ProfileWitness inner("tx_0.inner");
+    }
+    profiler.analyzeConstraints(pb);
+    Profiler::active() = nullptr;
+
+    const Profiler::Costs &costs = profiler.getCosts();
+    // Only the constraints added outside the nested scope, and the variables first used by them
+    REQUIRE(costs.at("tx_0").constraints == 1);
+    REQUIRE(costs.at("tx_0").variables == 3);
+    REQUIRE(costs.at("tx_0").nonzeroCoefficients == 3);
+    REQUIRE(costs.at("tx_0.inner").constraints == 2);
+    REQUIRE(costs.at("tx_0.inner").variables == 1);
+    REQUIRE(costs.at("tx_0.inner").nonzeroCoefficients == 6);
+    REQUIRE(costs.at("tx_0.inner").witnessTime >= 0.0);
+    REQUIRE(costs.at("tx_1").constraints == 1);
+    REQUIRE(costs.at("tx_1").variables == 1);
+    REQUIRE(costs.at(Profiler::UNCONSTRAINED).variables == 1);
+    REQUIRE(unused.index == pb.num_variables());
+
+    Profiler::Costs slotCosts = profiler.getSlotCosts(0);
+    REQUIRE(slotCosts.size() == 2);
+    REQUIRE(slotCosts.count("tx_1") == 0);
+
+    Profiler::Costs collapsedCosts = profiler.getCollapsedCosts();
+    REQUIRE(collapsedCosts.at("tx_*").constraints == 2);
+    REQUIRE(collapsedCosts.at("tx_*").variables == 4);
+    REQUIRE(collapsedCosts.at("tx_*.inner").constraints == 2);
+
+    std::stringstream report;
+    Profiler::print(report, collapsedCosts);
+    REQUIRE(report.str().find("tx_*.inner") != std::string::npos);
+}
@@ -180,3 +180,53 @@ TEST_CASE("CompressPublicKey", "[CompressPublicKey]")
         compressPublicKeyChecked(pubKeyX_2, pubKeyY_1, false);
     }
 }
+
+TEST_CASE("FixedBaseMulWindowed", "[FixedBaseMulWindowed]")
+{
+    auto fixedBaseMulChecked = [](const FieldT &scalar, unsigned int numBits) {
+        protoboard<FieldT> pb;
+        jubjub::Params params;
+
+        VariableArrayT bits = make_var_array(pb, numBits, "bits");
+        bits.fill_with_bits_of_field_element(pb, scalar);
+
+        FixedBaseMulWindowed windowed(pb, params, params.Gx, params.Gy, bits, "windowed");
+        windowed.generate_r1cs_constraints();
+        windowed.generate_r1cs_witness();
+
+        // Compare against the bit by bit implementation
+        fixed_base_mul expected(pb, params, params.Gx, params.Gy, bits, "expected");
+        expected.generate_r1cs_constraints();
+        expected.generate_r1cs_witness();
+
+        REQUIRE(pb.is_satisfied());
+        REQUIRE((pb.val(windowed.result_x()) == pb.val(expected.result_x())));
+        REQUIRE((pb.val(windowed.result_y()) == pb.val(expected.result_y())));
+
+        // A different lookup result doesn't satisfy the constraints
+        pb.val(windowed.lookups[0].x) += FieldT::one();
+        REQUIRE(!pb.is_satisfied());
+    };
+
+    SECTION("Zero")
+    {
+        fixedBaseMulChecked(FieldT::zero(), 254);
+    }
+
+    SECTION("Max")
+    {
+        fixedBaseMulChecked(getMaxFieldElement(252), 252);
+    }
+
+    SECTION("Random")
+    {
+        // Also tests partial windows (fixed_base_mul needs an even number of bits)
+        for (unsigned int numBits : {252, 254})
+        {
+            for (unsigned int i = 0; i < 8; i++)
+            {
+                fixedBaseMulChecked(getRandomFieldElement(numBits), numBits);
+            }
+        }
+    }
+}
@@ -0,0 +1,186 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Circuits/UniversalCircuit.h"
+#include "../Gadgets/MathGadgets.h"
+#include "../Utils/SubProtoboard.h"
+
+TEST_CASE("SubProtoboard", "[SubProtoboard]")
+{
+    unsigned int maxLength = 32;
+    FieldT _A = FieldT(5);
+    FieldT _B = FieldT(7);
+
+    // Reference: the gadgets created directly on the main protoboard
+    protoboard<FieldT> expectedPb;
+    Constants expectedConstants(expectedPb, "constants");
+    VariableT expectedA = make_variable(expectedPb, _A, ".A");
+    VariableT expectedB = make_variable(expectedPb, _B, ".B");
+    AddGadget expectedAdd(expectedPb, expectedA, expectedB, maxLength, "add");
+    UnsafeMulGadget expectedMul(expectedPb, expectedAdd.result(), expectedB, "mul");
+    EqualGadget expectedEqual(expectedPb, expectedMul.result(), expectedConstants._0, "equal");
+    expectedAdd.generate_r1cs_constraints();
+    expectedMul.generate_r1cs_constraints();
+    expectedEqual.generate_r1cs_constraints();
+
+    // The same gadgets created on a SubProtoboard and spliced into the main protoboard
+    protoboard<FieldT> pb;
+    Constants constants(pb, "constants");
+    VariableT A = make_variable(pb, _A, ".A");
+    VariableT B = make_variable(pb, _B, ".B");
+
+    SubProtoboard sub;
+    Constants subConstants(sub.pb, "constants");
+    VariableT subA = make_variable(sub.pb, ".A");
+    VariableT subB = make_variable(sub.pb, ".B");
+    sub.endImports();
+    AddGadget add(sub.pb, subA, subB, maxLength, "add");
+    UnsafeMulGadget mul(sub.pb, add.result(), subB, "mul");
+    EqualGadget equal(sub.pb, mul.result(), subConstants._0, "equal");
+    add.generate_r1cs_constraints();
+    mul.generate_r1cs_constraints();
+    equal.generate_r1cs_constraints();
+
+    bindConstants(sub, subConstants, constants);
+    sub.bind(subA, A);
+    sub.bind(subB, B);
+    sub.splice(pb, "sub");
+
+    requireSameConstraints(pb, expectedPb);
+    REQUIRE(sub.pb.num_constraints() == 0);
+    REQUIRE(sub.toMain(mul.result()).index == expectedMul.result().index);
+    REQUIRE(sub.toMain(subConstants._0).index == constants._0.index);
+
+    // Witness
+    expectedConstants.generate_r1cs_witness();
+    expectedAdd.generate_r1cs_witness();
+    expectedMul.generate_r1cs_witness();
+    expectedEqual.generate_r1cs_witness();
+
+    constants.generate_r1cs_witness();
+    sub.pullWitness(pb);
+    add.generate_r1cs_witness();
+    mul.generate_r1cs_witness();
+    equal.generate_r1cs_witness();
+    sub.pushWitness(pb);
+
+    REQUIRE(expectedPb.is_satisfied());
+    REQUIRE(pb.is_satisfied());
+    REQUIRE(pb.full_variable_assignment() == expectedPb.full_variable_assignment());
+    REQUIRE(pb.val(sub.toMain(mul.result())) == (_A + _B) * _B);
+}
+
+TEST_CASE("SubProtoboard stamp", "[SubProtoboard]")
+{
+    // Reference: the same gadget created twice on the main protoboard, the second one uses the first one
+    protoboard<FieldT> expectedPb;
+    VariableT expectedA = make_variable(expectedPb, FieldT(3), ".A");
+    VariableT expectedB = make_variable(expectedPb, FieldT(4), ".B");
+    UnsafeMulGadget expectedFirst(expectedPb, expectedA, expectedB, "first");
+    UnsafeMulGadget expectedSecond(expectedPb, expectedFirst.result(), expectedB, "second");
+    expectedFirst.generate_r1cs_constraints();
+    expectedSecond.generate_r1cs_constraints();
+
+    // A single template stamped twice
+    protoboard<FieldT> pb;
+    VariableT A = make_variable(pb, FieldT(3), ".A");
+    VariableT B = make_variable(pb, FieldT(4), ".B");
+
+    SubProtoboard sub;
+    VariableT subValue = make_variable(sub.pb, ".value");
+    VariableT subB = make_variable(sub.pb, ".B");
+    sub.endImports();
+    UnsafeMulGadget mul(sub.pb, subValue, subB, "mul");
+    mul.generate_r1cs_constraints();
+
+    sub.bind(subValue, A);
+    sub.bind(subB, B);
+    sub.stamp(pb, "first");
+    SubProtoboard::Relocation first = sub.relocation;
+    sub.bind(subValue, first.toMain(mul.result()));
+    sub.stamp(pb, "second");
+    SubProtoboard::Relocation second = sub.relocation;
+
+    REQUIRE(sub.pb.num_constraints() == 1);
+    REQUIRE(pb.num_variables() == expectedPb.num_variables());
+    REQUIRE(pb.num_constraints() == expectedPb.num_constraints());
+    REQUIRE(first.toMain(mul.result()).index == expectedFirst.result().index);
+    REQUIRE(second.toMain(mul.result()).index == expectedSecond.result().index);
+    REQUIRE(second.toMain(subB).index == B.index);
+
+    // The witness of every copy is generated with the template gadget, one copy after the other
+    for (const SubProtoboard::Relocation &relocation : {first, second})
+    {
+        sub.relocation = relocation;
+        sub.pullWitness(pb);
+        mul.generate_r1cs_witness();
+        sub.pushWitness(pb);
+    }
+    REQUIRE(pb.is_satisfied());
+    REQUIRE(pb.val(second.toMain(mul.result())) == FieldT(48));
+
+    // The import values can be read beforehand, the other variables start from zero again for every copy
+    const std::vector<FieldT> importValues = first.importValues(pb);
+    REQUIRE(importValues == std::vector<FieldT>{FieldT(3), FieldT(4)});
+    sub.relocation = first;
+    sub.clearWitness();
+    REQUIRE(sub.pb.val(mul.result()) == FieldT::zero());
+    sub.pullWitness(importValues);
+    mul.generate_r1cs_witness();
+    REQUIRE(sub.pb.val(mul.result()) == FieldT(12));
+}
+
+TEST_CASE("UniversalCircuit transaction slots", "[SubProtoboard][UniversalCircuit]")
+{
+    // Small layout with two slots of the same kind (the withdrawals), the operator fee table uses variables of
+    // every transaction
+    const unsigned int blockSize = 4;
+    const BlockLayout layout =
+      json::parse(R"({"deposits": 1, "accountUpdates": 1, "withdrawals": 2, "operatorFeeTokens": 2})")
+        .get<BlockLayout>();
+
+    auto generateConstraints = [&](protoboard<FieldT> &pb, bool parallelTransactions, bool stampTransactions) {
+        UniversalCircuit circuit(pb, "circuit");
+        circuit.layout = layout;
+        circuit.parallelTransactions = parallelTransactions;
+        circuit.stampTransactions = stampTransactions;
+        circuit.generateConstraints(blockSize);
+        REQUIRE(circuit.relocations.size() == ((parallelTransactions || stampTransactions) ? blockSize : 0));
+        REQUIRE(circuit.isStamped() == stampTransactions);
+        if (parallelTransactions)
+        {
+            // The variables of the withdrawal data hash are allocated after all other variables of the transaction
+            const WithdrawCircuit &withdraw = *circuit.transactions[blockSize - 1]->withdraw;
+            REQUIRE(
+              withdraw.requireValidOnChainDataHash->res.res.result().index ==
+              circuit.slots[blockSize - 1]->sub.pb.num_variables());
+        }
+        if (stampTransactions)
+        {
+            // Three kinds of slots, the copies for another thread need to have the same variables
+            REQUIRE(circuit.slots.size() == 3);
+            REQUIRE(circuit.slots[0]->sub.pb.num_constraints() == 0);
+            circuit.createThreadTemplates(2);
+            REQUIRE(circuit.threadTransactions.size() == 1);
+            REQUIRE(circuit.threadTransactions[0].size() == circuit.slots.size());
+        }
+    };
+
+    // Reference: all transactions created on the main protoboard
+    protoboard<FieldT> expectedPb;
+    generateConstraints(expectedPb, false, false);
+
+    SECTION("Parallel")
+    {
+        protoboard<FieldT> pb;
+        generateConstraints(pb, true, false);
+        requireSameConstraints(pb, expectedPb);
+    }
+
+    SECTION("Stamped")
+    {
+        protoboard<FieldT> pb;
+        generateConstraints(pb, false, true);
+        requireSameConstraints(pb, expectedPb);
+    }
+}
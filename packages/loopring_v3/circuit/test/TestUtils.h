@@ -194,4 +194,31 @@ static PowResult pow_approx(const FieldT& _x, const FieldT& _y, unsigned int ite
     return {valid, toFieldElement(sum)};
 }
 
+static void requireSameTerms(
+  const libsnark::linear_combination<FieldT> &x,
+  const libsnark::linear_combination<FieldT> &y)
+{
+    REQUIRE(x.getTerms().size() == y.getTerms().size());
+    for (size_t i = 0; i < x.getTerms().size(); i++)
+    {
+        REQUIRE(x.getTerms()[i].index == y.getTerms()[i].index);
+        REQUIRE(x.getTerms()[i].coeff == y.getTerms()[i].coeff);
+    }
+}
+
+static void requireSameConstraints(const protoboard<FieldT> &pb, const protoboard<FieldT> &expectedPb)
+{
+    REQUIRE(pb.num_inputs() == expectedPb.num_inputs());
+    REQUIRE(pb.num_variables() == expectedPb.num_variables());
+    REQUIRE(pb.num_constraints() == expectedPb.num_constraints());
+    for (size_t i = 0; i < pb.num_constraints(); i++)
+    {
+        const auto &constraint = pb.constraint_system.constraints[i];
+        const auto &expectedConstraint = expectedPb.constraint_system.constraints[i];
+        requireSameTerms(constraint->getA(), expectedConstraint->getA());
+        requireSameTerms(constraint->getB(), expectedConstraint->getB());
+        requireSameTerms(constraint->getC(), expectedConstraint->getC());
+    }
+}
+
 #endif
\ No newline at end of file